@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Accuracy and speed check of the quartic solvers used by the torus
+ * and blob primitives.  Synthetic rays are shot at tori of decreasing
+ * tube radius and through clusters of metaballs; for each ray the
+ * nearest hit found by SolveQuartic() (closed form, all roots, as the
+ * primitives used to do it) and by SolvePolyRange() (only the nearest
+ * root in the clipped interval) is compared with a reference found by
+ * sampling the implicit function in long double precision.
+ *
+ * usage: rootbench [nrays [seed]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "libcommon/common.h"
+
+#define NSAMPLE		4000	/* reference samples per ray */
+#define NREPEAT		20	/* timing passes over the rays */
+#define TOLERANCE	1e-6	/* agreement, relative to object size */
+#define NBALL		3
+
+
+typedef struct {
+	Vector pos, dir;	/* ray, dir normalized */
+	double c[5];		/* coefficients about pos */
+	double cs[5];		/* coefficients about pos + shift*dir */
+	double lo, hi;		/* interval worth searching */
+	double shift;
+	double ref;		/* reference distance, or -1 */
+	double s4, sr;		/* SolveQuartic, SolvePolyRange results */
+} BenchRay;
+
+typedef struct {
+	Vector pos;
+	Float r, s;		/* radius and strength */
+} BenchBall;
+
+typedef struct {
+	char *name;
+	long nhit, nmiss, nfalse;
+	double maxerr, sumerr;
+	double secs;
+} BenchStat;
+
+Float RSabstmp;			/* for fabs() in common.h */
+static unsigned long Seed;
+
+static Float TorA, TorB, Thresh;
+static BenchBall Balls[NBALL];
+
+extern int SolveQuartic(), SolvePolyRange();
+extern double sqrt();
+
+static Float frand();
+static void Unit(), TorusRay(), TorusCoef(), BlobRay(), Reference(), Solve();
+static long double TorusF(), BlobF();
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	BenchRay *rays;
+	int n, i;
+	static Float tube[] = {0.5, 0.1, 0.01, 0.001};
+
+	n = argc > 1 ? atoi(argv[1]) : 20000;
+	Seed = argc > 2 ? atoi(argv[2]) : 1;
+	rays = (BenchRay *)malloc(n * sizeof(BenchRay));
+	if (rays == (BenchRay *)0) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	printf("%-14s %8s %8s %8s %8s %10s %10s %9s\n", "case", "solver",
+		"hits", "missed", "false", "max err", "mean err", "us/ray");
+	for (i = 0; i < sizeof(tube) / sizeof(Float); i++) {
+		char name[32];
+		TorA = 1.;
+		TorB = tube[i];
+		sprintf(name, "torus b=%g", TorB);
+		TorusRay(rays, n);
+		Solve(rays, n, name);
+	}
+	BlobRay(rays, n);
+	Solve(rays, n, "blob");
+	exit(0);
+}
+
+/*
+ * Same numbers everywhere, whatever rand() the system has.
+ */
+static Float
+frand()
+{
+	Seed = (Seed * 1103515245L + 12345L) & 0x7fffffffL;
+	return (Float)Seed / 2147483648.;
+}
+
+static void
+Unit(v)
+Vector *v;
+{
+	Float len;
+
+	len = sqrt(dotp(v, v));
+	VecScale(1. / len, *v, v);
+}
+
+/*
+ * Rays from a shell around the torus aimed at random points in its
+ * bounding box.  The interval is clipped exactly as in TorusIntersect.
+ */
+static void
+TorusRay(rays, n)
+BenchRay *rays;
+int n;
+{
+	BenchRay *r;
+	Vector to;
+	Float b, disc, t1, t2;
+	int i;
+
+	for (r = rays, i = 0; i < n; r++, i++) {
+		r->pos.x = frand() - .5;
+		r->pos.y = frand() - .5;
+		r->pos.z = frand() - .5;
+		Unit(&r->pos);
+		VecScale(2. + 8.*frand(), r->pos, &r->pos);
+		to.x = (2.*frand() - 1.) * (TorA + TorB);
+		to.y = (2.*frand() - 1.) * (TorA + TorB);
+		to.z = (2.*frand() - 1.) * TorB;
+		VecSub(to, r->pos, &r->dir);
+		Unit(&r->dir);
+
+		r->lo = 0.;
+		r->hi = FAR_AWAY;
+		b = dotp(&r->pos, &r->dir);
+		disc = b*b - dotp(&r->pos, &r->pos) +
+			(TorA + TorB)*(TorA + TorB);
+		if (disc > 0.) {
+			disc = sqrt(disc);
+			if (-b - disc > r->lo)
+				r->lo = -b - disc;
+			if (-b + disc < r->hi)
+				r->hi = -b + disc;
+		} else
+			r->hi = -1.;
+		if (r->dir.z != 0.) {
+			t1 = (-TorB - r->pos.z) / r->dir.z;
+			t2 = (TorB - r->pos.z) / r->dir.z;
+			if (t1 > t2) {
+				b = t1; t1 = t2; t2 = b;
+			}
+			if (t1 > r->lo)
+				r->lo = t1;
+			if (t2 < r->hi)
+				r->hi = t2;
+		}
+
+		/*
+		 * The closed form was handed coefficients about the ray
+		 * origin, the range solver gets them about the start of
+		 * the interval.
+		 */
+		TorusCoef(&r->pos, &r->dir, r->c);
+		r->shift = r->hi > r->lo ? r->lo : 0.;
+		VecAddScaled(r->pos, r->shift, r->dir, &to);
+		TorusCoef(&to, &r->dir, r->cs);
+		Reference(r, TorusF);
+	}
+}
+
+static void
+TorusCoef(pos, dir, c)
+Vector *pos, *dir;
+double c[5];
+{
+	Float g0s, g2s, as, bs;
+
+	as = TorA*TorA;
+	bs = TorB*TorB;
+	g0s = dotp(pos, pos) - as - bs;
+	g2s = dotp(pos, dir);
+	c[4] = 1.;
+	c[3] = 4.*g2s;
+	c[2] = 2.*(g0s + 2.*g2s*g2s + 2.*as*dir->z*dir->z);
+	c[1] = 4.*(g2s*g0s + 2.*as*pos->z*dir->z);
+	c[0] = g0s*g0s + 4.*as*(pos->z*pos->z - bs);
+}
+
+/*
+ * Rays through a cluster of metaballs whose spheres of influence all
+ * contain the middle of the ray; the interval is the part of the ray
+ * inside all of them, so one polynomial holds throughout.
+ */
+static void
+BlobRay(rays, n)
+BenchRay *rays;
+int n;
+{
+	BenchRay *r;
+	BenchBall *bl;
+	Vector d;
+	Float a0, a1, b, disc, c4, c2;
+	int i, j;
+
+	for (r = rays, i = 0; i < n; r++, i++) {
+		r->pos.x = 4.*frand() - 2.;
+		r->pos.y = 4.*frand() - 2.;
+		r->pos.z = -5.;
+		r->dir.x = -r->pos.x * (.8 + .4*frand());
+		r->dir.y = -r->pos.y * (.8 + .4*frand());
+		r->dir.z = 5.;
+		Unit(&r->dir);
+		for (j = 0; j < NBALL; j++) {
+			bl = &Balls[j];
+			bl->pos.x = .6*frand() - .3;
+			bl->pos.y = .6*frand() - .3;
+			bl->pos.z = .6*frand() - .3;
+			bl->r = 2.5 + frand();
+			bl->s = .2 + frand();
+		}
+		Thresh = .3 + .5*frand();
+
+		r->lo = 0.;
+		r->hi = FAR_AWAY;
+		r->c[0] = -Thresh;
+		r->c[1] = r->c[2] = r->c[3] = r->c[4] = 0.;
+		for (j = 0; j < NBALL; j++) {
+			bl = &Balls[j];
+			VecSub(r->pos, bl->pos, &d);
+			a0 = dotp(&d, &d);
+			a1 = dotp(&d, &r->dir);
+			b = -a1;
+			disc = b*b - a0 + bl->r*bl->r;
+			if (disc <= 0.) {
+				r->hi = -1.;
+				continue;
+			}
+			disc = sqrt(disc);
+			if (b - disc > r->lo)
+				r->lo = b - disc;
+			if (b + disc < r->hi)
+				r->hi = b + disc;
+			c4 = bl->s / (bl->r*bl->r*bl->r*bl->r);
+			c2 = -2. * bl->s / (bl->r*bl->r);
+			r->c[4] += c4;
+			r->c[3] += 4.*c4*a1;
+			r->c[2] += 2.*c4*(2.*a1*a1 + a0) + c2;
+			r->c[1] += 2.*a1*(2.*c4*a0 + c2);
+			r->c[0] += c4*a0*a0 + c2*a0 + bl->s;
+		}
+		for (j = 0; j < 5; j++)
+			r->cs[j] = r->c[j];
+		r->shift = 0.;
+		Reference(r, BlobF);
+	}
+}
+
+static long double
+TorusF(p)
+long double p[3];
+{
+	long double rr, w;
+
+	rr = p[0]*p[0] + p[1]*p[1];
+	w = rr + p[2]*p[2] + (long double)TorA*TorA - (long double)TorB*TorB;
+	return w*w - 4.L*TorA*TorA*rr;
+}
+
+static long double
+BlobF(p)
+long double p[3];
+{
+	long double d, f, x, y, z;
+	int j;
+
+	f = -Thresh;
+	for (j = 0; j < NBALL; j++) {
+		x = p[0] - Balls[j].pos.x;
+		y = p[1] - Balls[j].pos.y;
+		z = p[2] - Balls[j].pos.z;
+		d = 1.L - (x*x + y*y + z*z) / ((long double)Balls[j].r*Balls[j].r);
+		f += Balls[j].s * d * d;
+	}
+	return f;
+}
+
+/*
+ * Reference: first sign change of the implicit function, sampled
+ * finely over the interval and then bisected.  Grazing hits that
+ * touch the surface between two samples are not seen, so a few
+ * "false" hits are to be expected from either solver.
+ */
+static void
+Reference(r, f)
+BenchRay *r;
+long double (*f)();
+{
+	long double p[3], a, b, m, fa, fm;
+	int j, k;
+
+	r->ref = -1.;
+	if (r->hi <= r->lo)
+		return;
+	a = r->lo;
+	p[0] = r->pos.x + a*r->dir.x;
+	p[1] = r->pos.y + a*r->dir.y;
+	p[2] = r->pos.z + a*r->dir.z;
+	fa = (*f)(p);
+	for (j = 1; j <= NSAMPLE; j++) {
+		b = r->lo + (r->hi - r->lo) * (long double)j / NSAMPLE;
+		p[0] = r->pos.x + b*r->dir.x;
+		p[1] = r->pos.y + b*r->dir.y;
+		p[2] = r->pos.z + b*r->dir.z;
+		if (((*f)(p) < 0.) != (fa < 0.))
+			break;
+		a = b;
+	}
+	if (j > NSAMPLE)
+		return;
+	for (k = 0; k < 80; k++) {
+		m = .5L * (a + b);
+		p[0] = r->pos.x + m*r->dir.x;
+		p[1] = r->pos.y + m*r->dir.y;
+		p[2] = r->pos.z + m*r->dir.z;
+		fm = (*f)(p);
+		if ((fm < 0.) == (fa < 0.))
+			a = m;
+		else
+			b = m;
+	}
+	r->ref = (double)(.5L * (a + b));
+}
+
+/*
+ * Nearest root as the primitives used to find it: all real roots
+ * from the closed form, smallest one in front of the origin and
+ * within the interval.
+ */
+static double
+OldNearest(r)
+BenchRay *r;
+{
+	double s[4], dist;
+	int i, num;
+
+	num = SolveQuartic(r->c, s);
+	dist = -1.;
+	for (i = 0; i < num; i++) {
+		if (s[i] <= 0. || s[i] < r->lo - EPSILON ||
+		    s[i] > r->hi + EPSILON)
+			continue;
+		if (dist < 0. || s[i] < dist)
+			dist = s[i];
+	}
+	return dist;
+}
+
+static double
+NewNearest(r)
+BenchRay *r;
+{
+	double dist;
+
+	if (r->hi <= r->lo ||
+	    !SolvePolyRange(r->cs, 4, r->lo - r->shift, r->hi - r->shift,
+			&dist))
+		return -1.;
+	return dist + r->shift;
+}
+
+static void
+Tally(st, rays, n, which)
+BenchStat *st;
+BenchRay *rays;
+int n, which;
+{
+	BenchRay *r;
+	double d, err;
+	int i;
+
+	st->nhit = st->nmiss = st->nfalse = 0;
+	st->maxerr = st->sumerr = 0.;
+	for (r = rays, i = 0; i < n; r++, i++) {
+		d = which ? r->sr : r->s4;
+		if (r->ref < 0.) {
+			if (d >= 0.)
+				st->nfalse++;
+			continue;
+		}
+		err = d < 0. ? FAR_AWAY : fabs(d - r->ref);
+		if (err > TOLERANCE) {
+			st->nmiss++;
+			continue;
+		}
+		st->nhit++;
+		st->sumerr += err;
+		if (err > st->maxerr)
+			st->maxerr = err;
+	}
+}
+
+static void
+Solve(rays, n, name)
+BenchRay *rays;
+int n;
+char *name;
+{
+	BenchStat st[2];
+	clock_t t;
+	int i, j;
+
+	st[0].name = "closed";
+	st[1].name = "range";
+
+	t = clock();
+	for (j = 0; j < NREPEAT; j++)
+		for (i = 0; i < n; i++)
+			rays[i].s4 = OldNearest(&rays[i]);
+	st[0].secs = (double)(clock() - t) / CLOCKS_PER_SEC;
+
+	t = clock();
+	for (j = 0; j < NREPEAT; j++)
+		for (i = 0; i < n; i++)
+			rays[i].sr = NewNearest(&rays[i]);
+	st[1].secs = (double)(clock() - t) / CLOCKS_PER_SEC;
+
+	for (j = 0; j < 2; j++) {
+		Tally(&st[j], rays, n, j);
+		printf("%-14s %8s %8ld %8ld %8ld %10.3g %10.3g %9.3f\n",
+			name, st[j].name, st[j].nhit, st[j].nmiss,
+			st[j].nfalse, st[j].maxerr,
+			st[j].nhit ? st[j].sumerr / st[j].nhit : 0.,
+			1e6 * st[j].secs / ((double)n * NREPEAT));
+	}
+}
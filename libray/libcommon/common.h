@@ -113,7 +113,9 @@ extern char *share_malloc(), *share_calloc();
 #define max(a, b)		((a) > (b) ? (a) : (b))
 #define min(a, b)		((a) < (b) ? (a) : (b))
 
-extern voidstar Malloc(), Calloc();
+extern voidstar Malloc(), Calloc(), ScratchAlloc();
+extern void	ScratchReserve(), ScratchRelease();
+extern unsigned long ScratchMark();
 extern char	*strsave();
 extern double	drand48();	/* just in case */
 
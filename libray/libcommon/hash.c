@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "common.h"
+#include "hash.h"
+
+#define HASH_PRIME	16777619UL
+
+/*
+ * Fold n bytes into the hash 'key'.
+ */
+unsigned long
+HashBytes(key, p, n)
+unsigned long key;
+char *p;
+int n;
+{
+	while (n--) {
+		key ^= (unsigned char)*p++;
+		key = (key * HASH_PRIME) & 0xffffffffUL;
+	}
+	return key;
+}
+
+/*
+ * Fold a string, and its terminating null, into the hash.  A NULL
+ * string is folded in as an empty one.
+ */
+unsigned long
+HashString(key, s)
+unsigned long key;
+char *s;
+{
+	if (s != (char *)NULL) {
+		for (; *s; s++)
+			key = HashBytes(key, s, 1);
+	}
+	return HashBytes(key, "", 1);
+}
+
+unsigned long
+HashInt(key, i)
+unsigned long key;
+int i;
+{
+	return HashBytes(key, (char *)&i, sizeof(int));
+}
+
+unsigned long
+HashFloat(key, f)
+unsigned long key;
+Float f;
+{
+	return HashBytes(key, (char *)&f, sizeof(Float));
+}
+
+unsigned long
+HashVector(key, v)
+unsigned long key;
+Vector *v;
+{
+	key = HashFloat(key, v->x);
+	key = HashFloat(key, v->y);
+	return HashFloat(key, v->z);
+}
+
+unsigned long
+HashColor(key, c)
+unsigned long key;
+Color *c;
+{
+	key = HashFloat(key, c->r);
+	key = HashFloat(key, c->g);
+	return HashFloat(key, c->b);
+}
+
+unsigned long
+HashMatrix(key, m)
+unsigned long key;
+RSMatrix *m;
+{
+	int i, j;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			key = HashFloat(key, m->matrix[i][j]);
+	return HashVector(key, &m->translate);
+}
+
+/*
+ * Fold a list of transformations into the hash, followed by a mark
+ * of its end.
+ */
+unsigned long
+HashTrans(key, trans)
+unsigned long key;
+Trans *trans;
+{
+	for (; trans; trans = trans->next)
+		key = HashMatrix(key, &trans->trans);
+	return HashBytes(key, "-", 1);
+}
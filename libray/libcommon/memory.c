@@ -32,6 +32,25 @@
 
 unsigned long TotalAllocated;
 
+/*
+ * Allocations made while rendering, which should be none: everything
+ * the renderer needs is set up before the first ray is traced.  The
+ * exceptions are the caches that fill on demand -- image pages (-M)
+ * and texture bakes (-B) -- and a G-buffer being recorded (-d), which
+ * grows with the number of eye rays that supersampling calls for.
+ */
+static int Watching;
+static unsigned long WatchedBytes, WatchedBlocks;
+
+/*
+ * Scratch space for work done while tracing a ray, handed out and
+ * given back in stack order.  Anything that may need more than it
+ * can keep on the stack reserves its worst case when it is created.
+ */
+#define SCRATCH_ALIGN	sizeof(double)
+static char *Scratch;
+static unsigned long ScratchSize, ScratchUsed;
+
 voidstar
 Malloc(bytes)
 unsigned bytes;
@@ -39,6 +58,10 @@ unsigned bytes;
 	voidstar res;
 
 	TotalAllocated += bytes;
+	if (Watching) {
+		WatchedBytes += bytes;
+		WatchedBlocks++;
+	}
 
 	res = (voidstar)malloc(bytes);
 	if (res == (voidstar)NULL)
@@ -58,12 +81,78 @@ unsigned nelem, elen;
 	return res;
 }
 
+/*
+ * Make sure there are at least 'bytes' of scratch space.  Users of the
+ * space do not nest, so the largest reservation is enough for all.
+ * Must not be called while scratch space is in use.
+ */
+void
+ScratchReserve(bytes)
+unsigned long bytes;
+{
+	if (bytes <= ScratchSize)
+		return;
+	if (ScratchUsed)
+		RLerror(RL_PANIC, "Scratch space resized while in use.\n");
+	if (Scratch)
+		free((voidstar)Scratch);
+	Scratch = (char *)Malloc((unsigned)bytes);
+	ScratchSize = bytes;
+}
+
+/*
+ * Take 'bytes' of scratch space, or return NULL if not enough was
+ * reserved, in which case the caller must make do with Malloc.
+ */
+voidstar
+ScratchAlloc(bytes)
+unsigned long bytes;
+{
+	voidstar res;
+
+	bytes = (bytes + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+	if (ScratchUsed + bytes > ScratchSize)
+		return (voidstar)NULL;
+	res = (voidstar)(Scratch + ScratchUsed);
+	ScratchUsed += bytes;
+	return res;
+}
+
+/*
+ * Scratch space taken after ScratchMark() is given back, all at once,
+ * by passing its value to ScratchRelease().
+ */
+unsigned long
+ScratchMark()
+{
+	return ScratchUsed;
+}
+
+void
+ScratchRelease(mark)
+unsigned long mark;
+{
+	ScratchUsed = mark;
+}
+
+/*
+ * Start or stop counting the allocations made while rendering.
+ */
+void
+MemoryWatch(on)
+int on;
+{
+	Watching = on;
+}
+
 void
 PrintMemoryStats(fp)
 FILE *fp;
 {
 	fprintf(fp,"Total memory allocated:\t\t%lu bytes\n",
 			TotalAllocated);
+	fprintf(fp,"Allocated while rendering:\t%lu bytes (%lu blocks)\n",
+			WatchedBytes, WatchedBlocks);
 }
 
 /*
@@ -35,7 +35,16 @@ typedef struct Ray {
 		dir;			/* Direction */
 	int 	depth,			/* depth in ray tree */
 		sample;			/* current sample # */
-	Float	time;
+	Float	time,
+		width,			/* Width of footprint at origin */
+		spread;			/* ... and its growth with distance */
 	struct Medium *media;		/* Medium ray is passing through */
 } Ray;
+
+/*
+ * The footprint of a ray is the width of the cone of space around it
+ * that it stands for, such as the part of the scene seen through a
+ * pixel.  RayFootprint() gives the width at distance d along ray r.
+ */
+#define RayFootprint(r, d)	((r)->width + (d) * (r)->spread)
 #endif
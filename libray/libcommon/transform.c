@@ -395,15 +395,21 @@ RSMatrix *it;
 
 /*
  * Transform "ray" by transforming the origin point and direction vector.
+ * The width of its footprint is scaled as distances along it are; its
+ * spread, being a ratio of the two, is left alone.
  */
 Float
 RayTransform(ray, trans)
 Ray *ray;
 RSMatrix *trans;
 {
+	Float len;
+
 	PointTransform(&ray->pos, trans);
 	VecTransform(&ray->dir, trans);
-	return VecNormalize(&ray->dir);
+	len = VecNormalize(&ray->dir);
+	ray->width *= len;
+	return len;
 }
 
 void
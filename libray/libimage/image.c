@@ -26,26 +26,72 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "libcommon/common.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
 #include "image.h"
 #ifdef URT
 #include "rle.h"
 #endif
 
+/*
+ * Page of a level holding pixel (x, y), and the offset of the pixel
+ * within the page.
+ */
+#define PAGEOF(lev, x, y)	(((y) >> IMAGE_PAGESHIFT) * (lev)->xpages + \
+				 ((x) >> IMAGE_PAGESHIFT))
+#define INPAGE(img, x, y)	((img)->totalchan * \
+	((((((((y) & (IMAGE_PAGE-1)) >> IMAGE_TILESHIFT) << \
+	     (IMAGE_PAGESHIFT-IMAGE_TILESHIFT)) + \
+	    (((x) & (IMAGE_PAGE-1)) >> IMAGE_TILESHIFT)) << \
+	   (IMAGE_TILESHIFT+IMAGE_TILESHIFT)) + \
+	  (((y) & (IMAGE_TILE-1)) << IMAGE_TILESHIFT) + \
+	  ((x) & (IMAGE_TILE-1)))))
+/*
+ * Address of the first channel of pixel (x, y) of a level.
+ */
+#define PIXEL(img, lev, x, y)	(((lev)->data ? \
+	(lev)->data + PAGEOF(lev, x, y) * (img)->pagesize : \
+	PageFetch(img, lev, PAGEOF(lev, x, y))) + INPAGE(img, x, y))
+
+#define LN2		0.69314718055994530942
+
 Image *image_list = NULL;		/* Linked list of images */
 
+/*
+ * Pages of images read from tiled files, most recently used first.
+ */
+static ImagePage *PageHead, *PageTail;
+static long ImageBudget;		/* bytes images may use, or 0 */
+static long ImageKept;			/* bytes of images kept in full */
+static long ImageResident, ImagePeak;	/* bytes pages use, and most */
+static unsigned long ImageHits, ImageMisses, ImageDropped;
+
+static int ImageReadFile(), ImageReadTiled(), ImageLoadTiled(),
+	ImageWriteTiled();
+static void ImageLayout(), ImageBuild();
+static void LevelSample(), LevelIndex();
+static unsigned char *LevelAlloc(), *PageFetch();
+
 Image *
 ImageCreate(filename)
 char *filename;
 {
 	Image *new;
 
-	new = (Image *)Malloc(sizeof(Image));
+	new = (Image *)Calloc(1, sizeof(Image));
 	new->filename = strsave(filename);
 	new->width = 0;
 	new->height = 0;
 	new->chan = 0;
-	new->data = NULL;
+	new->nlevels = 0;
+	new->tiled = (FILE *)NULL;
 	new->next = image_list;
 	image_list = new;
 	return new;
@@ -65,16 +111,34 @@ char *name;
 	return (Image *)NULL;
 }
 
-#ifdef URT
+/*
+ * Keep at most the given number of megabytes of images in memory.
+ * Images are then read from their tiled files a page at a time, as
+ * they are used.  By default, images are kept in memory in full.
+ */
+void
+ImageCacheSetup(megabytes)
+Float megabytes;
+{
+	if (megabytes <= 0.) {
+		ImageBudget = 0;
+		return;
+	}
+	ImageBudget = (long)(megabytes * 1048576.);
+	if (ImageBudget < IMAGE_MINBUDGET)
+		ImageBudget = IMAGE_MINBUDGET;
+}
+
 Image *
 ImageRead(filename)
 char *filename;
 {
 	FILE *fp;
-	int i, y, chan;
-	rle_hdr in_hdr;
 	Image *image;
-	rle_pixel **inrows;
+	ImageHeader head;
+	struct stat st;
+	char *tiledname;
+	int statok, n;
 
 	/*
 	 * See if image has been read before.
@@ -85,22 +149,93 @@ char *filename;
 
 	fp = fopen(filename, "r");
 	if (fp == (FILE *)NULL) {
-		RLerror(RL_ABORT, "Cannot open RLE file %s.\n",filename);
+		RLerror(RL_ABORT, "Cannot open image file %s.\n",filename);
 		return (Image *)NULL;
 	}
 
-	in_hdr.rle_file = fp;
-   
-	/* Try to open the RLE file */
-	if (rle_get_setup(&in_hdr) < 0) {
-		RLerror(RL_ABORT, "Error reading header of %s\n", filename);
-		return (Image *)NULL;
+	image = ImageCreate(filename);
+	/*
+	 * See if the file is already in tiled form.
+	 */
+	if (fread((char *)&head, sizeof(ImageHeader), 1, fp) == 1 &&
+	    head.magic == IMAGE_MAGIC) {
+		if (!ImageLoadTiled(image, fp, &head)) {
+			RLerror(RL_ABORT, "Bad tiled image file %s.\n",
+				filename);
+			return (Image *)NULL;
+		}
+		return image;
 	}
+	rewind(fp);
 
 	/*
-	 * Read new image
+	 * If images are to be read a page at a time, use the tiled
+	 * cache of the file if there is an up-to-date one.
 	 */
-	image = ImageCreate(filename);
+	tiledname = (char *)NULL;
+	statok = FALSE;
+	if (ImageBudget) {
+		tiledname = Malloc((unsigned)(strlen(filename) +
+				strlen(IMAGE_CACHESUFFIX) + 1));
+		sprintf(tiledname, "%s%s", filename, IMAGE_CACHESUFFIX);
+		statok = fstat(fileno(fp), &st) == 0;
+		if (statok && ImageReadTiled(image, tiledname, &st)) {
+			(void)fclose(fp);
+			free((voidstar)tiledname);
+			return image;
+		}
+	}
+
+	/*
+	 * Read the image and build its levels.  If need be, save them
+	 * in tiled form, and read them back a page at a time from there.
+	 * Failing that, the image is simply kept in memory, and the
+	 * pages of other images have that much less room.
+	 */
+	if (!ImageReadFile(image, fp))
+		return (Image *)NULL;
+	(void)fclose(fp);
+	ImageBuild(image);
+	if (ImageBudget) {
+		if (!statok || !ImageWriteTiled(image, tiledname, &st) ||
+		    !ImageReadTiled(image, tiledname, &st)) {
+			RLerror(RL_WARN,
+		"Cannot use tiled cache %s; keeping image in memory.\n",
+				tiledname);
+			for (n = 0; n < image->nlevels; n++)
+				ImageKept += image->level[n].xpages *
+					image->level[n].ypages *
+					image->pagesize;
+			if (ImageKept + ImageResident > ImagePeak)
+				ImagePeak = ImageKept + ImageResident;
+		}
+		free((voidstar)tiledname);
+	}
+	return image;
+}
+
+#ifdef URT
+/*
+ * Read the full-size level of an image from an RLE file.
+ */
+static int
+ImageReadFile(image, fp)
+Image *image;
+FILE *fp;
+{
+	int i, x, y, chan;
+	rle_hdr in_hdr;
+	rle_pixel **inrows;
+	unsigned char *row, *pix;
+
+	in_hdr.rle_file = fp;
+
+	/* Try to open the RLE file */
+	if (rle_get_setup(&in_hdr) < 0) {
+		RLerror(RL_ABORT, "Error reading header of %s\n",
+			image->filename);
+		return FALSE;
+	}
 
 	in_hdr.xmax -= in_hdr.xmin;
 	in_hdr.xmin = 0;
@@ -109,107 +244,393 @@ char *filename;
 	image->chan = in_hdr.ncolors;
 	image->has_alpha = in_hdr.alpha ? 1 : 0;
 	image->totalchan = image->chan + image->has_alpha;
-	image->chansize = image->width * image->height;
-
-	image->data = (unsigned char *) Malloc(
-		image->chansize * image->totalchan * sizeof(unsigned char));
+	ImageLayout(image);
+	image->level[0].data = LevelAlloc(image, &image->level[0]);
 
 	/*
-	 * Allocate array of pointers to pass to rle_getrow.
+	 * rle_getrow returns a scanline one channel at a time;
+	 * allocate a scanline to read into, and an array of
+	 * pointers to each channel of it to pass to rle_getrow.
 	 */
+	row = (unsigned char *)Malloc(image->width * image->totalchan *
+			sizeof(unsigned char));
 	inrows = (rle_pixel **)Malloc(image->totalchan *
 			sizeof(rle_pixel *));
-	/*
-	 * Set inrows to point to appropriate initial location in image.
-	 */
-	inrows[0] = (rle_pixel *)image->data;
+	inrows[0] = (rle_pixel *)row;
 	for (i = 1; i < image->totalchan; i++)
-		inrows[i] = inrows[i-1] + image->chansize;
+		inrows[i] = inrows[i-1] + image->width;
 	if (image->has_alpha)
 		/* Alpha channel lives in channel -1 */
 		inrows++;
 
-	/* Read the image */
+	/* Read the image, interleaving the channels of each pixel */
 	for ( y = 0; y < image->height; y++ ) {
 		rle_getrow( &in_hdr, inrows );
-		/*
-		 * Update inrows to point to next scanline for
-		 * each channel.
-		 */
-		for (i = 0; i < image->chan; i++)
-			inrows[i] += image->width;
-		if (image->has_alpha)
-			inrows[-1] += image->width;
+		for (x = 0; x < image->width; x++) {
+			pix = PIXEL(image, &image->level[0], x, y);
+			for (chan = 0; chan < image->totalchan; chan++)
+				pix[chan] = row[chan*image->width + x];
+		}
 	}
 
-	(void)fclose(fp);
-	return image;
+	if (image->has_alpha)
+		inrows--;
+	free((voidstar)inrows);
+	free((voidstar)row);
+	return TRUE;
 }
 
 #else /* !URT */
 
-Image *
-ImageRead(filename)
-char *filename;
+/*
+ * Read the full-size level of an image from a generic image file.
+ */
+static int
+ImageReadFile(image, fp)
+Image *image;
+FILE *fp;
 {
-	FILE *fp;
 	char buf[80];
-	Image *image;
 	int y, x;
-	unsigned char *rbuf, *gbuf, *bbuf;
-
-	image = ImageFind(filename);
-	if (image)
-		return image;
+	unsigned char *pix;
 
-	fp = fopen(filename, "r");
-	if (fp == (FILE *)NULL) {
-		RLerror(RL_ABORT, "Cannot open image file %s.\n",filename);
-		return (Image *)NULL;
-	}
-
-	image = ImageCreate(filename);
 	/*
 	 * Read image header.
 	 */
 	if (fgets(buf, 100, fp) == (char *)NULL ||
 	    sscanf(buf, "%d %d\n", &image->width, &image->height) != 2) {
 		RLerror(RL_ABORT, "Cannot read header of image file %s.\n",
-			filename);
+			image->filename);
 		fclose(fp);
-		return (Image *)NULL;
+		return FALSE;
 	}
 	/*
 	 * Generic image files always have 3 channels, no alpha.
 	 */
 	image->chan = image->totalchan = 3;
 	image->has_alpha = 0;
-	image->chansize = image->width * image->height;
+	ImageLayout(image);
+	image->level[0].data = LevelAlloc(image, &image->level[0]);
 
-	image->data = (unsigned char *) Malloc(
-		image->chansize * image->totalchan * sizeof(unsigned char));
-
-	rbuf = image->data;
-	gbuf = &image->data[image->chansize];
-	bbuf = &image->data[image->chansize+image->chansize];
 	for (y = 0; y < image->height; y++ ) {
 		for (x = 0; x < image->width; x++) {
-			*(rbuf++) = getc(fp);
-			*(gbuf++) = getc(fp);
-			*(bbuf++) = getc(fp);
+			pix = PIXEL(image, &image->level[0], x, y);
+			pix[0] = getc(fp);
+			pix[1] = getc(fp);
+			pix[2] = getc(fp);
 			if (feof(fp)) {
 				RLerror(RL_ABORT,
-				"Error reading image %s\n",filename);
+				"Error reading image %s\n",image->filename);
 				fclose(fp);
-				return (Image *)NULL;
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+#endif
+
+/*
+ * Set the size, number of pages and place in a tiled file of each
+ * level of an image of known size and number of channels.
+ */
+static void
+ImageLayout(image)
+Image *image;
+{
+	ImageLevel *lev;
+	int width, height, n;
+	long offset;
+
+	image->pagesize = (long)IMAGE_PAGE * IMAGE_PAGE * image->totalchan;
+	offset = (long)sizeof(ImageHeader);
+	width = image->width;
+	height = image->height;
+	for (n = 0; n < IMAGE_LEVELS; ) {
+		lev = &image->level[n++];
+		lev->width = width;
+		lev->height = height;
+		lev->xpages = (width + IMAGE_PAGE - 1) >> IMAGE_PAGESHIFT;
+		lev->ypages = (height + IMAGE_PAGE - 1) >> IMAGE_PAGESHIFT;
+		lev->offset = offset;
+		offset += lev->xpages * lev->ypages * image->pagesize;
+		if (width == 1 && height == 1)
+			break;
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+	image->nlevels = n;
+}
+
+static unsigned char *
+LevelAlloc(image, lev)
+Image *image;
+ImageLevel *lev;
+{
+	return (unsigned char *)Calloc((unsigned)(lev->xpages*lev->ypages),
+			(unsigned)image->pagesize);
+}
+
+/*
+ * Build the rest of the level chain of an image once its full-size
+ * level has been read.  Each level is a box-filtered copy of the one
+ * before.  The image wraps around, as it does when it is applied.
+ */
+static void
+ImageBuild(image)
+Image *image;
+{
+	ImageLevel *lev, *prev;
+	unsigned char *pix, *a, *b, *c, *d;
+	int n, x, y, x1, y1, chan;
+
+	for (n = 1; n < image->nlevels; n++) {
+		prev = &image->level[n-1];
+		lev = &image->level[n];
+		lev->data = LevelAlloc(image, lev);
+		for (y = 0; y < lev->height; y++) {
+			y1 = (2*y + 1) % prev->height;
+			for (x = 0; x < lev->width; x++) {
+				x1 = (2*x + 1) % prev->width;
+				a = PIXEL(image, prev, 2*x, 2*y);
+				b = PIXEL(image, prev, x1, 2*y);
+				c = PIXEL(image, prev, 2*x, y1);
+				d = PIXEL(image, prev, x1, y1);
+				pix = PIXEL(image, lev, x, y);
+				for (chan = 0; chan < image->totalchan; chan++)
+					pix[chan] = (a[chan] + b[chan] +
+						c[chan] + d[chan] + 2) >> 2;
 			}
 		}
 	}
+}
+
+/*
+ * Read the tiled cache of an image, if it was made from the file
+ * described by st.
+ */
+static int
+ImageReadTiled(image, name, st)
+Image *image;
+char *name;
+struct stat *st;
+{
+	FILE *fp;
+	ImageHeader head;
 
+	fp = fopen(name, "r");
+	if (fp == (FILE *)NULL)
+		return FALSE;
+	if (fread((char *)&head, sizeof(ImageHeader), 1, fp) == 1 &&
+	    head.magic == IMAGE_MAGIC &&
+	    head.srcsize == (long)st->st_size &&
+	    head.srcmtime == (long)st->st_mtime &&
+	    ImageLoadTiled(image, fp, &head))
+		return TRUE;
 	(void)fclose(fp);
-	return image;
+	return FALSE;
+}
+
+/*
+ * Load an image in tiled form, the header of which has been read.
+ * If images are being read a page at a time, the file is kept open
+ * for the purpose, and any levels already in memory are freed;
+ * otherwise every page is read in and the file closed.
+ */
+static int
+ImageLoadTiled(image, fp, head)
+Image *image;
+FILE *fp;
+ImageHeader *head;
+{
+	ImageLevel *lev;
+	int n, npages;
+
+	if (head->version != IMAGE_VERSION || head->page != IMAGE_PAGE ||
+	    head->width < 1 || head->height < 1 || head->chan < 1 ||
+	    head->chan + (head->has_alpha ? 1 : 0) > 4)
+		return FALSE;
+	image->width = head->width;
+	image->height = head->height;
+	image->chan = head->chan;
+	image->has_alpha = head->has_alpha ? 1 : 0;
+	image->totalchan = image->chan + image->has_alpha;
+	ImageLayout(image);
+	if (image->nlevels != head->nlevels)
+		return FALSE;
+
+	for (n = 0; n < image->nlevels; n++) {
+		lev = &image->level[n];
+		npages = lev->xpages * lev->ypages;
+		if (ImageBudget) {
+			if (lev->data)
+				free((voidstar)lev->data);
+			lev->data = (unsigned char *)NULL;
+			lev->page = (ImagePage **)Calloc((unsigned)npages,
+						sizeof(ImagePage *));
+			continue;
+		}
+		lev->data = LevelAlloc(image, lev);
+		if (fseek(fp, lev->offset, 0) != 0 ||
+		    fread((char *)lev->data, (int)image->pagesize, npages, fp)
+				!= npages)
+			return FALSE;
+	}
+	if (ImageBudget)
+		image->tiled = fp;
+	else
+		(void)fclose(fp);
+	return TRUE;
+}
+
+/*
+ * Save an image in tiled form as the cache of the file described by
+ * st.  The cache is written under a temporary name and then renamed,
+ * so that other processes never see it half-written.  Returns FALSE
+ * if the cache could not be written.
+ */
+static int
+ImageWriteTiled(image, name, st)
+Image *image;
+char *name;
+struct stat *st;
+{
+	FILE *fp;
+	ImageHeader head;
+	ImageLevel *lev;
+	char *tmpname;
+	int n, npages, ok;
+
+	tmpname = Malloc((unsigned)(strlen(name) + 16));
+	sprintf(tmpname, "%s.%d", name, (int)getpid());
+	fp = fopen(tmpname, "w");
+	if (fp == (FILE *)NULL) {
+		free((voidstar)tmpname);
+		return FALSE;
+	}
+	bzero((char *)&head, sizeof(ImageHeader));
+	head.magic = IMAGE_MAGIC;
+	head.version = IMAGE_VERSION;
+	head.page = IMAGE_PAGE;
+	head.width = image->width;
+	head.height = image->height;
+	head.chan = image->chan;
+	head.has_alpha = image->has_alpha;
+	head.nlevels = image->nlevels;
+	head.srcsize = (long)st->st_size;
+	head.srcmtime = (long)st->st_mtime;
+	ok = fwrite((char *)&head, sizeof(ImageHeader), 1, fp) == 1;
+	for (n = 0; ok && n < image->nlevels; n++) {
+		lev = &image->level[n];
+		npages = lev->xpages * lev->ypages;
+		ok = fwrite((char *)lev->data, (int)image->pagesize, npages,
+				fp) == npages;
+	}
+	if (fclose(fp) != 0 || !ok || rename(tmpname, name) != 0) {
+		(void)unlink(tmpname);
+		ok = FALSE;
+	}
+	free((voidstar)tmpname);
+	return ok;
+}
+
+/*
+ * Return the given page of a level of an image read from its tiled
+ * file, reading it in if need be.  Pages may use what the budget
+ * leaves over from images kept in full, but never less than
+ * IMAGE_MINBUDGET.  To make room, pages least recently used are
+ * dropped; the most recently used are always kept, so that the four
+ * pixels around a point may safely be fetched in turn.
+ */
+static unsigned char *
+PageFetch(img, lev, index)
+Image *img;
+ImageLevel *lev;
+int index;
+{
+	ImagePage *page, *drop;
+	long limit;
+
+	page = lev->page[index];
+	if (page) {
+		ImageHits++;
+		if (page == PageHead)
+			return page->data;
+		/*
+		 * Move page to the head of the list.
+		 */
+		page->prev->next = page->next;
+		if (page->next)
+			page->next->prev = page->prev;
+		else
+			PageTail = page->prev;
+	} else {
+		ImageMisses++;
+		page = (ImagePage *)NULL;
+		limit = ImageBudget - ImageKept;
+		if (limit < IMAGE_MINBUDGET)
+			limit = IMAGE_MINBUDGET;
+		while (PageTail && ImageResident + img->pagesize > limit) {
+			drop = PageTail;
+			PageTail = drop->prev;
+			if (PageTail)
+				PageTail->next = (ImagePage *)NULL;
+			else
+				PageHead = (ImagePage *)NULL;
+			drop->level->page[drop->index] = (ImagePage *)NULL;
+			ImageResident -= drop->size;
+			ImageDropped++;
+			/*
+			 * Reuse the first page dropped, if it's the right size.
+			 */
+			if (page == (ImagePage *)NULL &&
+			    drop->size == img->pagesize) {
+				page = drop;
+			} else {
+				free((voidstar)drop->data);
+				free((voidstar)drop);
+			}
+		}
+		if (page == (ImagePage *)NULL) {
+			page = (ImagePage *)Malloc(sizeof(ImagePage));
+			page->size = img->pagesize;
+			page->data = (unsigned char *)Malloc(
+					(unsigned)page->size);
+		}
+		if (fseek(img->tiled, lev->offset + index * img->pagesize, 0)
+				!= 0 ||
+		    fread((char *)page->data, (int)page->size, 1, img->tiled)
+				!= 1)
+			RLerror(RL_ABORT, "Cannot read image %s.\n",
+				img->filename);
+		page->level = lev;
+		page->index = index;
+		lev->page[index] = page;
+		ImageResident += page->size;
+		if (ImageKept + ImageResident > ImagePeak)
+			ImagePeak = ImageKept + ImageResident;
+	}
+	page->prev = (ImagePage *)NULL;
+	page->next = PageHead;
+	if (PageHead)
+		PageHead->prev = page;
+	else
+		PageTail = page;
+	PageHead = page;
+	return page->data;
+}
+
+void
+ImageStats(fp)
+FILE *fp;
+{
+	if (!ImageBudget)
+		return;
+	fprintf(fp, "Image page lookups:\t\t%lu (%lu read, %lu dropped)\n",
+		ImageHits + ImageMisses, ImageMisses, ImageDropped);
+	fprintf(fp, "Image memory:\t\t\t%ld bytes (%ld allowed)\n",
+		ImagePeak, ImageBudget);
 }
-#endif
 
 void
 ImageIndex(img, ix, iy, fx, fy, smooth, outval)
@@ -218,47 +639,115 @@ int ix, iy, smooth;
 Float fx, fy;
 Float outval[4];
 {
-	int xplus, yplus, chan, offset;
+	LevelIndex(img, &img->level[0], ix, iy, fx, fy, smooth, outval);
+}
+
+/*
+ * Look up the value of an image at (u, v), each in [0, 1), for a
+ * footprint 'size' pixels of the full image across.  Footprints of a
+ * pixel or less use the full image, as ImageIndex does; larger ones
+ * blend the two levels whose pixels come nearest that size.
+ */
+void
+ImageLookup(img, u, v, size, smooth, outval)
+Image *img;
+Float u, v, size;
+int smooth;
+Float outval[4];
+{
+	Float lod, lo[4], hi[4];
+	int level, chan;
+
+	if (size <= 1. || img->nlevels == 1) {
+		LevelSample(img, 0, u, v, smooth, outval);
+		return;
+	}
+	lod = log(size) / LN2;
+	level = (int)lod;
+	if (level >= img->nlevels - 1) {
+		LevelSample(img, img->nlevels - 1, u, v, smooth, outval);
+		return;
+	}
+	lod -= level;
+	LevelSample(img, level, u, v, smooth, lo);
+	LevelSample(img, level + 1, u, v, smooth, hi);
+	for (chan = 0; chan < img->totalchan; chan++)
+		outval[chan] = lo[chan] + lod * (hi[chan] - lo[chan]);
+}
+
+static void
+LevelSample(img, level, u, v, smooth, outval)
+Image *img;
+int level, smooth;
+Float u, v;
+Float outval[4];
+{
+	ImageLevel *lev;
+	Float x, y;
+	int ix, iy;
+
+	lev = &img->level[level];
+	x = u * (Float)lev->width;
+	y = v * (Float)lev->height;
+	if (smooth && level) {
+		/*
+		 * When smoothing, pixel i of the full image sits at
+		 * u = i / width.  Line up the pixels of coarser levels,
+		 * each of which covers several of those, to match.
+		 */
+		x -= .5 - .5 * (Float)lev->width / (Float)img->width;
+		y -= .5 - .5 * (Float)lev->height / (Float)img->height;
+	}
+	ix = (int)floor(x);
+	iy = (int)floor(y);
+	x -= (Float)ix;
+	y -= (Float)iy;
+	ix %= lev->width;
+	if (ix < 0)
+		ix += lev->width;
+	iy %= lev->height;
+	if (iy < 0)
+		iy += lev->height;
+	LevelIndex(img, lev, ix, iy, x, y, smooth, outval);
+}
+
+static void
+LevelIndex(img, lev, ix, iy, fx, fy, smooth, outval)
+Image *img;
+ImageLevel *lev;
+int ix, iy, smooth;
+Float fx, fy;
+Float outval[4];
+{
+	int xplus, yplus, chan;
 	Float x0y0, x1y0, x0y1, x1y1;
-	unsigned char *data;
+	unsigned char *p00, *p10, *p01, *p11;
 
+	p00 = PIXEL(img, lev, ix, iy);
 	if (smooth) {
 		/*
 		 * bi-linear interp of four pixels.  Note this blends
 		 * the top with the bottom, and the left with the right.
 		 */
-		if (ix == img->width - 1)
-			xplus = 1 - img->width;
-		else 
-			xplus = 1;
-		if (iy == img->height - 1)
-			yplus = (1 - img->height) * img->width;
-		else
-			yplus = img->width;
-		data = img->data;
-		/* compute offset into first channel */
-		offset = ix + iy * img->width;
+		xplus = (ix == lev->width - 1) ? 0 : ix + 1;
+		yplus = (iy == lev->height - 1) ? 0 : iy + 1;
+		p10 = PIXEL(img, lev, xplus, iy);
+		p01 = PIXEL(img, lev, ix, yplus);
+		p11 = PIXEL(img, lev, xplus, yplus);
 		for (chan = 0; chan < img->totalchan; chan++) {
-			x0y0 = (Float)data[offset] / 255.0;
-			x1y0 = (Float)data[offset+xplus] / 255.0;
-			x0y1 = (Float)data[offset+yplus] / 255.0;
-			x1y1 = (Float)data[offset+xplus+yplus]/255.0;
+			x0y0 = (Float)p00[chan] / 255.0;
+			x1y0 = (Float)p10[chan] / 255.0;
+			x0y1 = (Float)p01[chan] / 255.0;
+			x1y1 = (Float)p11[chan] / 255.0;
 			outval[chan] = (x0y0*(1.0-fx)*(1.0-fy) +
 					x1y0*(fx)*(1.0-fy) +
 					x0y1*(1.0-fx)*(fy) +  x1y1*(fx)*(fy));
-			/* Make offset point to next channel */
-			offset += img->chansize;
 		}
 	} else {
 		/*
 		 * Hard edged image pixels (rectangles)
-		 * Compute offset into first channel
 		 */
-		offset = ix + iy * img->width;
-		for (chan = 0; chan < img->totalchan; chan++) {
-			outval[chan] = (Float)img->data[offset]/255.0;
-			/* Make offset point to next channel */
-			offset += img->chansize;
-		}
+		for (chan = 0; chan < img->totalchan; chan++)
+			outval[chan] = (Float)p00[chan]/255.0;
 	}
 }
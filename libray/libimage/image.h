@@ -28,6 +28,64 @@
 #ifndef IMAGE_H
 #define IMAGE_H
 
+/*
+ * Images are stored as a chain of levels, each half the size of the
+ * one before, down to a single pixel.  Each level is cut into square
+ * pages of IMAGE_PAGE pixels on a side, laid out one after another.
+ * Within a page, pixels are kept in tiles of IMAGE_TILE pixels on a
+ * side, with the channels of a pixel together, so that neighbouring
+ * lookups touch the same few cache lines.
+ */
+#define IMAGE_TILE	8		/* tile side, in pixels */
+#define IMAGE_TILESHIFT	3		/* log2(IMAGE_TILE) */
+#define IMAGE_PAGE	64		/* page side, in pixels */
+#define IMAGE_PAGESHIFT	6		/* log2(IMAGE_PAGE) */
+#define IMAGE_LEVELS	16		/* most levels kept per image */
+
+/*
+ * An image read from a file in one of the usual formats may be cached
+ * in tiled form, with its levels, in a file of the same name with
+ * IMAGE_CACHESUFFIX appended.  A file in tiled form begins with
+ * IMAGE_MAGIC and may itself be named as an image.  If a memory budget
+ * is set for images, pages of images in tiled form are read only as
+ * they are needed, and those least recently used are dropped to stay
+ * within the budget.
+ */
+#define IMAGE_CACHESUFFIX	".tiled"
+#define IMAGE_MAGIC		0x52534d50	/* "RSMP" */
+#define IMAGE_VERSION		1
+#define IMAGE_MINBUDGET		(1L << 20)	/* smallest budget, bytes */
+
+/*
+ * Header of an image file in tiled form.  It is followed by the pages
+ * of each level in turn.  When the file is a cache, srcsize and
+ * srcmtime are those of the file from which it was made.
+ */
+typedef struct {
+	int magic, version;
+	int page, width, height, chan, has_alpha, nlevels;
+	long srcsize, srcmtime;
+} ImageHeader;
+
+typedef struct ImageLevel {
+	int	width, height,		/* Level size */
+		xpages, ypages;		/* # of pages across and down */
+	unsigned char *data;		/* Pages, if all are in memory */
+	struct ImagePage **page;	/* else pages now in memory */
+	long	offset;			/* Offset of pages in tiled file */
+} ImageLevel;
+
+/*
+ * A page of an image read from its tiled file.
+ */
+typedef struct ImagePage {
+	unsigned char *data;		/* Pixels */
+	long	size;			/* Size of data */
+	ImageLevel *level;		/* Level of which it is ... */
+	int	index;			/* ... this page */
+	struct ImagePage *prev, *next;	/* More and less recently used */
+} ImagePage;
+
 /*
  * Generic image object for texture map storage.
  */
@@ -35,13 +93,15 @@ typedef struct Image {
 	int	width, height,		/* Image size */
 		chan, has_alpha,	/* # of channels, has alpha info? */
 		totalchan,		/* # channels + any alpha channel */
-		chansize;		/* width * height */
-	unsigned char *data;		/* Image */
+		nlevels;		/* # of levels in chain */
+	long	pagesize;		/* Bytes in a page */
+	ImageLevel level[IMAGE_LEVELS];	/* Level 0 is the full image */
+	FILE	*tiled;			/* Tiled file pages are read from */
 	char	*filename;		/* Filename (identifier) */
 	struct Image *next;		/* Next image in list. */
 } Image;
 
 Image	*ImageCreate(), *ImageFind(), *ImageRead();
-void	ImageIndex();
+void	ImageIndex(), ImageLookup(), ImageCacheSetup(), ImageStats();
 
 #endif /* IMAGE_H */
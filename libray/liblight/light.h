@@ -29,27 +29,65 @@
 #define LIGHT_H
 
 #include "libobj/geom.h"
+#include "libobj/cull.h"
 
 #define SHADOW_NONE	001
 #define SHADOW_TRANSP	002
 #define SHADOW_CSG	004
 #define SHADOW_CACHE	010
 #define SHADOW_BLUR	020
+#define SHADOW_BATCH	040
 
 #define NOSHADOWS(f)	((f) & SHADOW_NONE)
 #define SHADOWTRANSP(f)	((f) & SHADOW_TRANSP)
 #define SHADOWCSG(f)	((f) & SHADOW_CSG)
 #define SHADOWCACHE(f)	((f) & SHADOW_CACHE)
 #define SHADOWBLUR(f)	((f) & SHADOW_BLUR)
+#define SHADOWBATCH(f)	((f) & SHADOW_BATCH)
 
 #define SHADOW_EPSILON	(4. * EPSILON)
 
 typedef char * LightRef;
 
+/*
+ * Number of occluders remembered per light source per ray depth.
+ * An occluder's score goes up by one each time it blocks a shadow
+ * ray and down by one each time it is tried and fails to;  it is
+ * dropped from the cache when its score reaches zero.  New entries
+ * start at NEWSCORE, so they survive a miss or two, and the score is
+ * capped at MAXSCORE so that an occluder that was once popular does
+ * not linger long after it has stopped blocking light.
+ */
+#define SHADOW_CACHE_SIZE	4
+#define SHADOW_CACHE_NEWSCORE	2
+#define SHADOW_CACHE_MAXSCORE	8
+
 typedef struct {
 	struct Geom *obj;	/* Pointer to cached object */
 	RSMatrix trans;	/* World-to-object transformation */
 	char dotrans;		/* TRUE if above trans is non-identity */
+	short score;		/* hits less misses, capped */
+} ShadowCacheEntry;
+
+/*
+ * Shadow rays cast from eye-ray hits toward a light during one batch
+ * (a scanline) are traced against the part of the scene that lies
+ * within the region swept by the previous batch's rays, grown by
+ * SHADOW_BATCH_PAD of its size along each axis.  Rays that stray
+ * outside of this region are traced against the whole world.
+ */
+#define SHADOW_BATCH_PAD	0.25
+
+typedef struct {
+	CullList *cull;		/* objects in the current region */
+	int valid;		/* has cull list been built? */
+	Float seen[2][3];	/* region swept by rays in this batch */
+} ShadowBatch;
+
+typedef struct {
+	int nentries;		/* # of entries in use */
+	ShadowCacheEntry entry[SHADOW_CACHE_SIZE]; /* highest score first */
+	ShadowBatch *batch;	/* batch state, depth 0 only */
 } ShadowCache;
 
 typedef struct {
@@ -71,6 +109,7 @@ extern LightMethods	*LightMethodsCreate();
 extern Light	*LightCreate();
 extern void	LightAllocateCache(), LightAddToDefined();
 extern int	LightIntens(), LightDirection();
-extern void	ShadowSetOptions(), ShadowStats();
+extern void	ShadowSetOptions(), ShadowStats(), ShadowBatchSetup(),
+		ShadowBatchNext(), ShadowBatchStats();
 
 #endif /* LIGHT_H */
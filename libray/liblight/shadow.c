@@ -31,16 +31,25 @@
 
 /*
  * Shadow stats.
- * External functions have read access via ShadowStats().
+ * External functions have read access via ShadowStats() and
+ * ShadowBatchStats().
  */
-static unsigned long	ShadowRays, ShadowHits, CacheMisses, CacheHits;
+static unsigned long	ShadowRays, ShadowHits, CacheMisses, CacheHits,
+			BatchRays, BatchMisses, BatchBuilds;
 /*
  * Options controlling how shadowing information is determined.
  * Set by external modules via ShadowSetOptions().
  */
 static long		ShadowOptions;
+/*
+ * Top-level object, as given to the most recent ShadowBatchNext().
+ */
+static Geom		*BatchWorld;
 
 void LightCacheHit();
+static int CacheOccludes(), ShadowTrace();
+static void ShadowCacheUpdate();
+static int ShadowCacheSame();
 
 /*
  * Trace ray from point of intersection to a light.  If an intersection
@@ -59,10 +68,9 @@ int noshadow;		/* If TRUE, no shadow ray is cast. */
 {
 	int i, smooth, enter;
 	HitList hitlist;
-	Ray tmpray;
 	ShadowCache *cp;
 	Vector hitpos, norm, gnorm;
-	Surface surf, *sptr, *prevsurf;
+	Surface scratch, *sptr, *prevsurf;
 	Float s, totaldist, statten;
 	Color res;
 
@@ -76,55 +84,40 @@ int noshadow;		/* If TRUE, no shadow ray is cast. */
 	cp = &cache[ray->depth];
 	/*
 	 * Check shadow cache.  SHADOWCACHE() is implied.
+	 * Entries are kept sorted by score, so the occluders that
+	 * have been blocking neighboring rays are tried first.
 	 */
-	if (cp->obj) {
-		/*
-		 * Transform ray to the space of the cached primitive.
-		 */
-		tmpray = *ray;
-		if (cp->dotrans)
-			s *= RayTransform(&tmpray, &cp->trans);
-		/*
-		 * s = distance to light source in 'primitive space'.
-		 * Intersect ray with cached object.
-		 */
-		if (cp->obj->animtrans) {
-			/*
-			 * Geom has animated transformation --
-			 * call intersect so that the transformation
-			 * is resolved properly.
-			 */
-			if (intersect(cp->obj, &tmpray, &hitlist,
-			    SHADOW_EPSILON, &s)) {
-				CacheHits++;
-				return TRUE;
-			}
-		} else if (IsAggregate(cp->obj)) {
-			if ((*cp->obj->methods->intersect)(cp->obj->obj,
-				&tmpray, &hitlist, SHADOW_EPSILON, &s)) {
+	if (cp->nentries) {
+		for (i = 0; i < cp->nentries; i++) {
+			if (CacheOccludes(&cp->entry[i], ray, dist,
+			    &hitlist)) {
 				CacheHits++;
+				if (cp->entry[i].score < SHADOW_CACHE_MAXSCORE)
+					cp->entry[i].score++;
+				ShadowCacheUpdate(cp);
 				return TRUE;
 			}
-		} else if ((*cp->obj->methods->intersect)(cp->obj->obj,
-					&tmpray, SHADOW_EPSILON, &s)) {
-			/* Hit cached object. */
-			CacheHits++;
-			return TRUE;
+			/*
+			 * Tested and missed -- age the entry.
+			 */
+			cp->entry[i].score--;
 		}
 		/*
-		 * Did not hit anything -- zero out the cache.
+		 * Did not hit anything in the cache.  Entries that
+		 * have aged out are dropped; the occluder found
+		 * below, if any, replaces the lowest-scoring one.
 		 */
 		CacheMisses++;
-		/*
-		 * Transformed -- reset s for use below.
-		 */
-		s = dist;
-		cp->obj = (Geom *)NULL;
-		cp->dotrans = FALSE;
+		ShadowCacheUpdate(cp);
 	}
 
+	/*
+	 * If we're not worrying about transparent objects, any
+	 * occluder will do; otherwise we need the closest one.
+	 */
 	hitlist.nodes = 0;
-	if (!TraceRay(ray, &hitlist, SHADOW_EPSILON, &s)) {
+	if (!ShadowTrace(cp, ray, &hitlist, SHADOW_EPSILON, &s,
+	    !SHADOWTRANSP(ShadowOptions))) {
 		/* Shadow ray didn't hit anything. */
 		*result = *color;
 		return FALSE;
@@ -190,19 +183,17 @@ int noshadow;		/* If TRUE, no shadow ray is cast. */
 		 * Perform texturing and the like in case surface
 		 * transparency is modulated.
 		 */
-		/* copy the surface to be used... */
-		surf = *sptr;
 		enter = ComputeSurfProps(&hitlist, ray, &hitpos,
-			&norm, &gnorm, &surf, &smooth);
+			&norm, &gnorm, &sptr, &scratch, &smooth);
 		if (enter)
-			prevsurf = &surf;
+			prevsurf = sptr;
 		else
 			prevsurf = (Surface *)NULL;
 		/*
 		 * Attenuate light source by body color of surface.
 		 */
-		ColorScale(surf.transp, res, &res);
-		ColorMultiply(res, surf.body, &res);
+		ColorScale(sptr->transp, res, &res);
+		ColorMultiply(res, sptr->body, &res);
 		/*
 		 * Return if attenuation becomes large.
 		 * In this case, the light was attenuated to nothing,
@@ -223,7 +214,7 @@ int noshadow;		/* If TRUE, no shadow ray is cast. */
 		 * same direction.
 		 */
 		hitlist.nodes = 0;
-	} while (TraceRay(ray, &hitlist, totaldist, &s));
+	} while (ShadowTrace(cp, ray, &hitlist, totaldist, &s, FALSE));
 
 	*result = res;
 	return FALSE;
@@ -239,6 +230,15 @@ unsigned long *shadowrays, *shadowhit, *cachehit, *cachemiss;
 	*cachemiss = CacheMisses;
 }
 
+void
+ShadowBatchStats(batched, unbatched, builds)
+unsigned long *batched, *unbatched, *builds;
+{
+	*batched = BatchRays;
+	*unbatched = BatchMisses;
+	*builds = BatchBuilds;
+}
+
 void
 ShadowSetOptions(options)
 long options;
@@ -246,15 +246,114 @@ long options;
 	ShadowOptions = options;
 }
 
-void
-LightCacheHit(hitlist, cache)
+/*
+ * Does the cached occluder block the given shadow ray?
+ */
+static int
+CacheOccludes(cp, ray, dist, hitlist)
+ShadowCacheEntry *cp;
+Ray *ray;
+Float dist;
 HitList *hitlist;
+{
+	Ray tmpray;
+	Float s;
+
+	s = dist;
+	/*
+	 * Transform ray to the space of the cached primitive.
+	 */
+	tmpray = *ray;
+	if (cp->dotrans)
+		s *= RayTransform(&tmpray, &cp->trans);
+	/*
+	 * s = distance to light source in 'primitive space'.
+	 * Intersect ray with cached object.
+	 */
+	if (cp->obj->animtrans) {
+		/*
+		 * Geom has animated transformation --
+		 * call intersect so that the transformation
+		 * is resolved properly.
+		 */
+		return intersect(cp->obj, &tmpray, hitlist,
+			SHADOW_EPSILON, &s);
+	}
+	if (IsAggregate(cp->obj))
+		return (*cp->obj->methods->intersect)(cp->obj->obj,
+			&tmpray, hitlist, SHADOW_EPSILON, &s);
+	return (*cp->obj->methods->intersect)(cp->obj->obj,
+			&tmpray, SHADOW_EPSILON, &s);
+}
+
+/*
+ * Restore highest-score-first order after scores have changed and
+ * drop entries that have aged out.  The sort is stable, so among
+ * equal scores the entry that has been in the cache longest is
+ * tried first.
+ */
+static void
+ShadowCacheUpdate(cache)
 ShadowCache *cache;
+{
+	int i, j;
+	ShadowCacheEntry tmp;
+
+	for (i = 1; i < cache->nentries; i++) {
+		if (cache->entry[i].score <= cache->entry[i-1].score)
+			continue;
+		tmp = cache->entry[i];
+		for (j = i; j > 0 && cache->entry[j-1].score < tmp.score; j--)
+			cache->entry[j] = cache->entry[j-1];
+		cache->entry[j] = tmp;
+	}
+	while (cache->nentries && cache->entry[cache->nentries-1].score <= 0)
+		cache->nentries--;
+}
+
+/*
+ * Are two cache entries the same occluder, i.e., the same object
+ * seen through the same transformation?
+ */
+static int
+ShadowCacheSame(a, b)
+ShadowCacheEntry *a, *b;
+{
+	int i, j;
+
+	if (a->obj != b->obj || a->dotrans != b->dotrans)
+		return FALSE;
+	if (!a->dotrans)
+		return TRUE;
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			if (a->trans.matrix[i][j] != b->trans.matrix[i][j])
+				return FALSE;
+	return a->trans.translate.x == b->trans.translate.x &&
+	       a->trans.translate.y == b->trans.translate.y &&
+	       a->trans.translate.z == b->trans.translate.z;
+}
+
+/*
+ * Add the occluder found in hitlist to the cache, replacing the
+ * lowest-scoring entry if the cache is full.  If the occluder is
+ * already cached (an entry can miss a ray that its own object
+ * blocks, e.g., behind a transparent surface), the existing entry
+ * is credited with the hit instead.
+ */
+void
+LightCacheHit(hitlist, shadcache)
+HitList *hitlist;
+ShadowCache *shadcache;
 {
 	HitNode *np;
+	ShadowCacheEntry entry, *cache;
 	int i, n;
 	extern long ShadowOptions;
 
+	cache = &entry;
+	cache->score = SHADOW_CACHE_NEWSCORE;
+
 	i = 0;
 
 	if (SHADOWCSG(ShadowOptions)) {
@@ -315,4 +414,145 @@ ShadowCache *cache;
 		i++;
 		np++;
 	}
+
+	for (i = 0; i < shadcache->nentries; i++) {
+		if (ShadowCacheSame(&shadcache->entry[i], &entry)) {
+			if (shadcache->entry[i].score < SHADOW_CACHE_NEWSCORE)
+				shadcache->entry[i].score =
+					SHADOW_CACHE_NEWSCORE;
+			else if (shadcache->entry[i].score <
+				 SHADOW_CACHE_MAXSCORE)
+				shadcache->entry[i].score++;
+			ShadowCacheUpdate(shadcache);
+			return;
+		}
+	}
+	if (shadcache->nentries < SHADOW_CACHE_SIZE)
+		shadcache->entry[shadcache->nentries++] = entry;
+	else
+		shadcache->entry[SHADOW_CACHE_SIZE -1] = entry;
+	ShadowCacheUpdate(shadcache);
+}
+
+/*
+ * Trace a shadow ray.  If the light is batching shadow rays and
+ * the part of the ray that lies within the world's bounding box
+ * falls inside the region the batch was culled to, only the objects
+ * that survived culling are tested.  Otherwise, the entire world is.
+ */
+static int
+ShadowTrace(cache, ray, hitlist, mindist, maxdist, anyhit)
+ShadowCache *cache;
+Ray *ray;
+HitList *hitlist;
+Float mindist, *maxdist;
+int anyhit;
+{
+	ShadowBatch *batch;
+	Vector p0, p1;
+	Float t0, t1;
+
+	batch = cache->batch;
+	if (batch == (ShadowBatch *)NULL)
+		return TraceRay(ray, hitlist, mindist, maxdist);
+
+	t0 = mindist;
+	t1 = *maxdist;
+	if (!BoundsClipRay(ray, BatchWorld->bounds, &t0, &t1)) {
+		/*
+		 * The ray can only hit unbounded objects, none of
+		 * which are ever culled -- but only a valid batch
+		 * has a cull list holding them.
+		 */
+		if (!batch->valid) {
+			BatchMisses++;
+			return TraceRay(ray, hitlist, mindist, maxdist);
+		}
+	} else {
+		VecAddScaled(ray->pos, t0, ray->dir, &p0);
+		VecAddScaled(ray->pos, t1, ray->dir, &p1);
+		BoundsAddPoint(batch->seen, &p0);
+		BoundsAddPoint(batch->seen, &p1);
+		if (!batch->valid || OutOfBounds(&p0, batch->cull->bounds) ||
+		    OutOfBounds(&p1, batch->cull->bounds)) {
+			BatchMisses++;
+			return TraceRay(ray, hitlist, mindist, maxdist);
+		}
+	}
+	BatchRays++;
+	return CullIntersect(batch->cull, ray, hitlist, mindist, maxdist,
+			anyhit);
+}
+
+/*
+ * Prepare to batch the shadow rays for the light with the given cache,
+ * making room for the objects that culling the world may keep, so that
+ * starting a batch while rendering allocates nothing.
+ */
+void
+ShadowBatchSetup(cache, world)
+ShadowCache *cache;
+Geom *world;
+{
+	ShadowBatch *batch;
+
+	if (!SHADOWBATCH(ShadowOptions) || NOSHADOWS(ShadowOptions))
+		return;
+
+	batch = cache->batch;
+	if (batch == (ShadowBatch *)NULL) {
+		batch = (ShadowBatch *)Malloc(sizeof(ShadowBatch));
+		batch->cull = CullListCreate();
+		batch->valid = FALSE;
+		BoundsInit(batch->seen);
+		cache->batch = batch;
+	}
+	CullListReserve(batch->cull, world, CULL_MAXKIDS);
+}
+
+/*
+ * Start a new batch of shadow rays for the light with the given
+ * cache.  The scene is culled to the region swept by the
+ * shadow rays in the previous batch.
+ */
+void
+ShadowBatchNext(cache, world)
+ShadowCache *cache;
+Geom *world;
+{
+	ShadowBatch *batch;
+	Float bounds[2][3], pad;
+	int i;
+
+	if (!SHADOWBATCH(ShadowOptions) || NOSHADOWS(ShadowOptions))
+		return;
+
+	BatchWorld = world;
+	batch = cache->batch;
+	if (batch == (ShadowBatch *)NULL) {
+		batch = (ShadowBatch *)Malloc(sizeof(ShadowBatch));
+		batch->cull = CullListCreate();
+		batch->valid = FALSE;
+		BoundsInit(batch->seen);
+		cache->batch = batch;
+		return;
+	}
+	if (batch->seen[LOW][X] > batch->seen[HIGH][X]) {
+		/*
+		 * No rays were cast; nothing to go on.
+		 */
+		batch->valid = FALSE;
+		return;
+	}
+
+	for (i = 0; i < 3; i++) {
+		pad = SHADOW_BATCH_PAD *
+			(batch->seen[HIGH][i] - batch->seen[LOW][i]) + EPSILON;
+		bounds[LOW][i] = batch->seen[LOW][i] - pad;
+		bounds[HIGH][i] = batch->seen[HIGH][i] + pad;
+	}
+	CullListBuild(batch->cull, world, bounds, CULL_MAXKIDS);
+	batch->valid = TRUE;
+	BoundsInit(batch->seen);
+	BatchBuilds++;
 }
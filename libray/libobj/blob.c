@@ -27,12 +27,23 @@
  */
 #include "geom.h"
 #include "blob.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
 
 static Methods *iBlobMethods = NULL;
 static char blobName[] = "blob";
 
 unsigned long BlobTests, BlobHits;
 
+static void BlobRelease();
+static int BlobGrow();
+
+extern void qsort();
+extern int SolvePolyRange(), SolvePolyRangeAll();
+
 /*
  * Blob/Metaball Description
  *
@@ -91,7 +102,9 @@ MetaList *mlist;
 int npoints;
 {
 	Blob *blob;
-	int i;
+	MetaVector *tmplist;
+	Float (*box)[2][3], r;
+	int i, *order;
 	MetaList *cur;
 
 /* 
@@ -110,7 +123,7 @@ int npoints;
  */
 	blob = (Blob *)Malloc(sizeof(Blob));
 	blob->T = T;
-	blob->list=(MetaVector *)
+	tmplist=(MetaVector *)
 	    Malloc( (unsigned)(npoints*sizeof(MetaVector)) );
 	blob->num = npoints;
 
@@ -126,25 +139,50 @@ int npoints;
 			return (Blob *)NULL;
 		}
 		/* store radius squared */
-		blob->list[i].rs = cur->mvec.rs * cur->mvec.rs;
+		tmplist[i].rs = cur->mvec.rs * cur->mvec.rs;
 		/* Calculate and store coefficients for each metaball */
-		blob->list[i].c0 = cur->mvec.c0;
-		blob->list[i].c2 = -(2.0 * cur->mvec.c0) / blob->list[i].rs;
-		blob->list[i].c4 = cur->mvec.c0 /
-				(blob->list[i].rs * blob->list[i].rs);
-		blob->list[i].x = cur->mvec.x;
-		blob->list[i].y = cur->mvec.y;
-		blob->list[i].z = cur->mvec.z;
+		tmplist[i].c0 = cur->mvec.c0;
+		tmplist[i].c2 = -(2.0 * cur->mvec.c0) / tmplist[i].rs;
+		tmplist[i].c4 = cur->mvec.c0 /
+				(tmplist[i].rs * tmplist[i].rs);
+		tmplist[i].x = cur->mvec.x;
+		tmplist[i].y = cur->mvec.y;
+		tmplist[i].z = cur->mvec.z;
 		mlist = mlist->next;
 		free((voidstar)cur);
 	}
-	/* 
-	 * Allocate room for Intersection Structures and
-	 * Allocate room for an array of pointers to point to
-	 * the Intersection Structures.
+	/*
+	 * Build a tree over the spheres of influence, so that a ray
+	 * need only visit the metaballs near its path, and store the
+	 * metaballs in the order of its leaves.
+	 */
+	box = (Float (*)[2][3])Malloc((unsigned)
+			(npoints*sizeof(Float [2][3])));
+	for (i = 0; i < npoints; i++) {
+		r = sqrt(tmplist[i].rs);
+		box[i][LOW][X] = tmplist[i].x - r;
+		box[i][HIGH][X] = tmplist[i].x + r;
+		box[i][LOW][Y] = tmplist[i].y - r;
+		box[i][HIGH][Y] = tmplist[i].y + r;
+		box[i][LOW][Z] = tmplist[i].z - r;
+		box[i][HIGH][Z] = tmplist[i].z + r;
+	}
+	order = (int *)Malloc((unsigned)(npoints*sizeof(int)));
+	blob->nodes = BoundsTreeBuild(box, npoints, BLOB_LEAFSIZE, order,
+				      &blob->nnodes);
+	free((voidstar)box);
+	blob->list = (MetaVector *)
+	    Malloc( (unsigned)(npoints*sizeof(MetaVector)) );
+	for (i = 0; i < npoints; i++)
+		blob->list[i] = tmplist[order[i]];
+	free((voidstar)order);
+	free((voidstar)tmplist);
+	/*
+	 * Room for the lists BlobIntersect keeps for a ray that meets
+	 * every metaball.
 	 */
-	blob->ilist = (MetaInt *)Malloc( 2 * blob->num * sizeof(MetaInt));
-	blob->iarr = (MetaInt **)Malloc( 2 * blob->num * sizeof(MetaInt *));
+	ScratchReserve((unsigned long)npoints*(5*sizeof(Float) +
+		2*sizeof(MetaInt) + sizeof(int)) + 3*sizeof(double));
 	return blob;
 }
 
@@ -173,13 +211,13 @@ int
 MetaCompare(A,B)
 char *A,*B;
 {
-	MetaInt **AA,**BB;
+	MetaInt *AA,*BB;
 
-	AA = (MetaInt **) A;
-	BB = (MetaInt **) B;
-	if (AA[0]->bound == BB[0]->bound) return(0);
-	if (AA[0]->bound <  BB[0]->bound) return(-1);
-	return(1);  /* AA[0]->bound is > BB[0]->bound */
+	AA = (MetaInt *) A;
+	BB = (MetaInt *) B;
+	if (AA->bound == BB->bound) return(0);
+	if (AA->bound <  BB->bound) return(-1);
+	return(1);  /* AA->bound is > BB->bound */
 }
 
 /*****************************************************************************
@@ -191,17 +229,20 @@ Blob *blob;
 Ray *ray;
 Float mindist, *maxdist;
 {
-	double c[5], s[4];
+	double c[5], s[4], lo, hi;
 	Float dist;
-	MetaInt *ilist,**iarr;
-	register int i,j,inum;
-	extern void qsort();
+	Float cstack[BLOB_NSCRATCH][5], (*coef)[5];
+	MetaInt istack[2*BLOB_NSCRATCH], *iarr, *strt;
+	BoundsWalk walk;
+	BoundsNode *np;
+	int astack[BLOB_NSCRATCH], *active;
+	int size, heap;
+	unsigned long mark;
+	register int i,j,k,inum,nballs;
+	int inside;
 
 	BlobTests++;
 
-	ilist = blob->ilist;
-	iarr = blob->iarr;
-
 /*
  * The first step in calculating the Ray/Blob intersection is to 
  * divide the Ray into intervals such that only a fixed set of 
@@ -209,79 +250,130 @@ Float mindist, *maxdist;
  * This is done by finding the set of intersections between the Ray 
  * and each Metaball's Sphere/Region of influence, which has a 
  * radius  ri  and is centered at (xi,yi,zi).
+ * Only those metaballs in the leaves of the tree whose bounds the ray
+ * passes through (between mindist and maxdist) need be considered.
  * Intersection information is kept track of in the MetaInt 
  * structure and consists of:
  *
  *   type    indicates whether this intersection is the start(R_START)
  *           of a Region or the end(R_END) of one. 
- *   pnt     the Metaball of this intersection
+ *   pnt     the Metaball of this intersection, as an index into coef
  *   bound   the distance from Ray origin to this intersection
  *
- * This list is then sorted by  bound  and used later to find the Ray/Blob 
- * intersection.
+ * The coefficients of each metaball's density function along the ray
+ * are computed once, as its region is found, and kept in coef.
+ * The intersection list is then sorted by  bound  and used later to
+ * find the Ray/Blob intersection.
+ *
+ * The lists start out on the stack and are moved to scratch space
+ * with room for every metaball should the ray pass through more than
+ * BLOB_NSCRATCH regions, so nothing here belongs to the blob.
  */
+	coef = cstack;
+	iarr = istack;
+	active = astack;
+	size = BLOB_NSCRATCH;
+	heap = FALSE;
+	mark = ScratchMark();
+	nballs = 0;
+
+	BoundsWalkInit(&walk, ray);
+	while ((np = BoundsWalkNext(&walk, blob->nodes, mindist, *maxdist))
+	       != (BoundsNode *)NULL) {
+		for(i=np->first; i < np->first + np->num; i++)
+		{
+			register MetaVector *ml;
+			register Float xadj, yadj, zadj;
+			register Float b, t, rs;
+			register Float dmin,dmax;
+			register Float a1,a0;
+
+			ml = &(blob->list[i]);
+			rs   = ml->rs;
+			xadj = ml->x - ray->pos.x;
+			yadj = ml->y - ray->pos.y;
+			zadj = ml->z - ray->pos.z;
 
-	inum = 0;
-	for(i=0; i < blob->num; i++)
-	{
-		register Float xadj, yadj, zadj;
-		register Float b, t, rs;
-		register Float dmin,dmax;
-
-		rs   = blob->list[i].rs;
-		xadj = blob->list[i].x - ray->pos.x;
-		yadj = blob->list[i].y - ray->pos.y;
-		zadj = blob->list[i].z - ray->pos.z;
-
-	/*
-	 * Ray/Sphere of Influence intersection
-	 */
-		b = xadj * ray->dir.x + yadj * ray->dir.y + zadj * ray->dir.z;
-		t = b * b - xadj * xadj - yadj * yadj - zadj * zadj + rs;
+		/*
+		 * Ray/Sphere of Influence intersection
+		 */
+			b = xadj * ray->dir.x + yadj * ray->dir.y +
+				zadj * ray->dir.z;
+			a0 = xadj * xadj + yadj * yadj + zadj * zadj;
+			t = b * b - a0 + rs;
 
-	/* 
-	 * don't except imaginary or single roots. A single root is a ray
-	 * tangent to the Metaball's Sphere/Region. The Metaball's
-	 * contribution to the overall density function at this point is
-	 * zero anyway.
-	 */
-		if (t > 0.0) /* we have two roots */
-		{
+		/* 
+		 * don't except imaginary or single roots. A single root is
+		 * a ray tangent to the Metaball's Sphere/Region. The
+		 * Metaball's contribution to the overall density function
+		 * at this point is zero anyway.
+		 */
+			if (t <= 0.0)
+				continue;
 			t = sqrt(t);
 			dmin = b - t;
-	/* 
-	 * only interested in stuff in front of ray origin 
-	 */
+		/* 
+		 * only interested in stuff in front of ray origin, and
+		 * before anything already hit.
+		 */
 			if (dmin < mindist) dmin = mindist;
 			dmax = b + t;
-			if (dmax > dmin) /* we have a valid Region */
+			if (dmax <= dmin || dmin >= *maxdist)
+				continue;
+
+			if (nballs == size)
 			{
-		/*
-	         * Initialize min/start and max/end Intersections Structures
-	         * for this Metaball
-	         */
-				ilist[inum].type = R_START;
-				ilist[inum].pnt = i;
-				ilist[inum].bound = dmin;
-				for(j=0;j<5;j++) ilist[inum].c[j] = 0.0;
-				iarr[inum] = &(ilist[inum]);
-				inum++;
-
-				ilist[inum].type = R_END;
-				ilist[inum].pnt = i;
-				ilist[inum].bound = dmax;
-				for(j=0;j<5;j++) ilist[inum].c[j] = 0.0;
-				iarr[inum] = &(ilist[inum]);
-				inum++;
-			} /* End of valid Region */
-		} /* End of two roots */
-	} /* End of loop through metaballs */
+				heap = BlobGrow(blob, &coef, &iarr, &active,
+						nballs);
+				size = blob->num;
+			}
+
+	/*
+	 * The density function of the metaball along the ray, as
+	 * promised below.  Here
+	 *
+	 *   c[4] = c4*a2*a2; 
+	 *   c[3] = 4.0*c4*a1*a2;
+	 *   c[2] = 4.0*c4*a1*a1 + 2.0*c4*a2*a0 + c2*a2;
+	 *   c[1] = 4.0*c4*a1*a0 + 2.0*c2*a1;
+	 *   c[0] = c4*a0*a0 + c2*a0 + c0;
+	 *
+	 * where
+	 *        a2 = (x1*x1 + y1*y1 + z1*z1) = 1.0 because the ray 
+	 *                                           is normalized
+	 *        a1 = (xd*x1 + yd*y1 + zd*z1) = -b
+	 *        a0 = (xd*xd + yd*yd + zd*zd)
+	 *        xd = (x0 - xi)
+	 *        yd = (y0 - yi)
+	 *        zd = (z0 - zi)
+	 *        (xi,yi,zi) is center of Metaball
+	 *        (x0,y0,z0) is Ray origin
+	 *        (x1,y1,z1) is normalized Ray direction
+	 *        c4,c2,c0   are the coefficients for the
+	 *                       Metaball's density function
+	 */
+			a1 = -b;
+			coef[nballs][4] = ml->c4;
+			coef[nballs][3] = 4.0*ml->c4*a1;
+			coef[nballs][2] = 2.0*ml->c4*(2.0*a1*a1 + a0) + ml->c2;
+			coef[nballs][1] = 2.0*a1*(2.0*ml->c4*a0 + ml->c2);
+			coef[nballs][0] = ml->c4*a0*a0 + ml->c2*a0 + ml->c0;
+
+			iarr[2*nballs].type = R_START;
+			iarr[2*nballs].pnt = nballs;
+			iarr[2*nballs].bound = dmin;
+			iarr[2*nballs+1].type = R_END;
+			iarr[2*nballs+1].pnt = nballs;
+			iarr[2*nballs+1].bound = dmax;
+			nballs++;
+		}
+	}
 
 	/*
 	 * If there are no Ray/Metaball intersections there will 
 	 * not be a Ray/Blob intersection. Exit now.
 	 */
-	if (inum == 0)
+	if (nballs == 0)
 	{
 		return FALSE;
 	}
@@ -289,22 +381,10 @@ Float mindist, *maxdist;
 	/* 
 	 * Sort Intersection list. No sense using qsort if there's only
 	 * two intersections.
-	 *
-	 * Note: we actually aren't sorting the Intersection structures, but
-	 * an array of pointers to the Intersection structures. 
-	 * This is faster than sorting the Intersection structures themselves.
 	 */
-	if (inum==2)
-	{
-		MetaInt *t;
-		if (ilist[0].bound > ilist[1].bound)
-		{
-			t = iarr[0];
-			iarr[0] = iarr[1];
-			iarr[1] = t;
-		}
-	}
-	else qsort((voidstar)(iarr), (unsigned)inum, sizeof(MetaInt *),
+	inum = 2*nballs;
+	if (inum > 2)
+		qsort((voidstar)iarr, (unsigned)inum, sizeof(MetaInt),
 			MetaCompare);
 
 /*
@@ -326,7 +406,7 @@ Float mindist, *maxdist;
 *     z  = z0 + z1 * t
 *
 * to get a big mess :^). Actually, it's a Quartic in t and it's fully 
-* listed farther down. Here's a short version:
+* listed above. Here's a short version:
 *
 *   c[4] * t^4  +  c[3] * t^3  +  c[2] * t^2  +  c[1] * t  +  c[0]  =  T
 *
@@ -337,222 +417,167 @@ Float mindist, *maxdist;
 * together. We can do this since we're working with polynomials.
 * The points of intersection are the roots of the resultant equation.
 *
-* The algorithm loops through the intersection list, calculating
-* the coefficients if an intersection is the start of a Region and 
-* adding them to all intersections in that region.
-* When it detects a valid interval, it calculates the 
-* roots from the starting intersection's coefficients and if any of 
-* the roots are in the interval, the smallest one is returned.
-*
+* The algorithm walks the intersection list keeping track of the
+* metaballs whose regions it is inside, in the order in which it entered
+* them.  Whenever it is inside a region and the next intersection is not
+* at the same place, it has found a valid interval: it adds up the 
+* coefficients of those metaballs, calculates the roots of the summed
+* equation and if any of the roots are in the interval, the smallest
+* one is returned.  (The sum is formed afresh for each interval, rather
+* than kept up to date as regions begin and end, since the terms are
+* large and nearly cancel, and subtracting them would lose precision.)
 */
 
-	{
-		register Float *tmpc;
-		MetaInt *strt,*tmp;
-		register int istrt,itmp;
-		register int num,exitflag,inside;
-
-	/*
-	 * Start the algorithm outside the first interval
-	 */
-		inside = 0;
-		istrt = 0; 
-		strt = iarr[istrt];
-		if (strt->type != R_START)
-			RLerror(RL_WARN,"MetaInt sanity check FAILED!\n");
+	inside = 0;
+	if (iarr[0].type != R_START)
+		RLerror(RL_WARN,"MetaInt sanity check FAILED!\n");
 
+	for (i = 0; i < inum; i++)
+	{
+		strt = &iarr[i];
+		if (strt->type == R_START)
+		{
+			/* we're inside */
+			active[inside++] = strt->pnt;
+		}
 		/*
-		 * Loop through intersection. If a root is found the code
-		 * will return at that point.
+		 * Since the intersection wasn't the start of a region, it
+		 * must the end of one.
 		 */
-		while( istrt < inum )
+		else
 		{
-			/* 
-			 * Check for multiple intersections  at the same point.
-			 * This is also where the coefficients are calculated
-			 * and spread throughout that Metaball's sphere of
-			 * influence.
-			 */
-			do
-			{
-				/* find out which metaball */
-				i = strt->pnt;
-				/* only at starting boundaries do this */
-				if (strt->type == R_START)
-				{
-					register MetaVector *ml;
-					register Float a1,a0;
-					register Float xd,yd,zd;
-					register Float c4,c2,c0;
-
-					/* we're inside */
-					inside++;
-
-	/*  As promised, the full equations
-	 *
-	 *   c[4] = c4*a2*a2; 
-	 *   c[3] = 4.0*c4*a1*a2;
-	 *   c[2] = 4.0*c4*a1*a1 + 2.0*c4*a2*a0 + c2*a2;
-	 *   c[1] = 4.0*c4*a1*a0 + 2.0*c2*a1;
-	 *   c[0] = c4*a0*a0 + c2*a0 + c0;
-	 *
-	 * where
-	 *        a2 = (x1*x1 + y1*y1 + z1*z1) = 1.0 because the ray 
-	 *                                           is normalized
-	 *        a1 = (xd*x1 + yd*y1 + zd*z1)
-	 *        a0 = (xd*xd + yd*yd + zd*zd)
-	 *        xd = (x0 - xi)
-	 *        yd = (y0 - yi)
-	 *        zd = (z0 - zi)
-	 *        (xi,yi,zi) is center of Metaball
-	 *        (x0,y0,z0) is Ray origin
-	 *        (x1,y1,z1) is normalized Ray direction
-	 *        c4,c2,c0   are the coefficients for the
-	 *                       Metaball's density function
-	 *
-	 */
-
-					/*
-					 * Some compilers would recalculate
-					 * this each time its used.
-					 */
-					ml = &(blob->list[i]);
-
-					xd = ray->pos.x - ml->x;
-					yd = ray->pos.y - ml->y;
-					zd = ray->pos.z - ml->z;
-					a1 = (xd * ray->dir.x + yd * ray->dir.y
-						+ zd * ray->dir.z);
-					a0 = (xd * xd + yd * yd + zd * zd);
-
-					c0 = ml->c0;
-					c2 = ml->c2;
-					c4 = ml->c4;
-
-					c[4] = c4;
-					c[3] = 4.0*c4*a1;
-					c[2] = 2.0*c4*(2.0*a1*a1 + a0) + c2;
-					c[1] = 2.0*a1*(2.0*c4*a0 + c2);
-					c[0] = c4*a0*a0 + c2*a0 + c0;
-
-		/* 
-		 * Since we've gone through the trouble of calculating the 
-		 * coefficients, put them where they'll be used.
-		 * Starting at the current intersection(It's also the start of
-		 * a region), add the coefficients to each intersection until
-		 * we reach the end of this region.
-		 */
-					itmp = istrt; 
-					tmp = strt;
-					while( (tmp->pnt != i) ||
-					       (tmp->type != R_END) )
-					{
-						tmpc = tmp->c;
-						for(j=0;j<5;j++)
-							*tmpc++ += c[j];
-						itmp++; 
-						tmp = iarr[itmp];
-					}
-
-				} /* End of start of a Region */ 
-				/* 
-				 * Since the intersection wasn't the start
-				 * of a region, it must the end of one.
-				 */
-				else inside--;
+			for (k = 0; active[k] != strt->pnt; k++)
+				;
+			for (inside--; k < inside; k++)
+				active[k] = active[k+1];
+		}
 
 		/*
-		 * If we are inside a region(or regions) and the next
-		 * intersection is not at the same place, then we have
-		 * the start of an interval. Set the exitflag.
+		 * Carry on until we are inside a region(or regions) and the
+		 * next intersection is not at the same place.
 		 */
-				if ((inside > 0)
-				    && (strt->bound != iarr[istrt+1]->bound) )
-					exitflag = 1;
-				else 
-				/* move to next intersection */
-				{
-					istrt++; 
-					strt = iarr[istrt];
-					exitflag = 0;
-				}
-		/* 
-		 * Check to see if we're at the end. If so then exit with
-		 * no intersection found.
-		 */
-				if (istrt >= inum)
-				{
-					return FALSE;
-				}
-			} while(!exitflag);
-				/* End of Search for valid interval */
+		if (inside == 0 || i + 1 >= inum ||
+		    strt->bound == iarr[i+1].bound)
+			continue;
 
 		/*
 		 * Find Roots along this interval
 		 */
+		for(j=0;j<5;j++) c[j] = 0.0;
+		for (k = 0; k < inside; k++)
+			for(j=0;j<5;j++) c[j] += coef[active[k]][j];
 
-			/* get coefficients from Intersection structure */
-			tmpc = strt->c;
-			for(j=0;j<5;j++) c[j] = *tmpc++;
-
-			/* Don't forget to put in threshold */
-			c[0] -= blob->T;
-
-			/* Use Graphic Gem's Quartic Root Finder */
-			num = SolveQuartic(c,s);
+		/* Don't forget to put in threshold */
+		c[0] -= blob->T;
 
 		/*
-		 * If there are roots, search for roots within the interval.
+		 * Find the first root within the interval.  Not sure if
+		 * EPSILON is truly needed, but it might cause small cracks
+		 * between intervals in some cases.  In any case I don't
+		 * believe it hurts.
 		 */
-			dist = 0.0;
-			if (num>0)
-			{
-				for(j=0;j<num;j++)
-				{
-		/* 
-		 * Not sure if EPSILON is truly needed, but it might cause
-		 * small cracks between intervals in some cases. In any case 
-		 * I don't believe it hurts.
-		 */
-					if ((s[j] >= (strt->bound - EPSILON))
-					    && (s[j] <= (iarr[istrt+1]->bound +
-					        EPSILON) ) )
-					{
-						if (dist == 0.0)
-						/* first valid root */
-							dist = s[j];
-						else if (s[j] < dist)
-	 					/* else only if smaller */
-							dist = s[j];
-					}
-				}
-				/*
-				 * Found a valid root 
-				 */
-				if (dist > mindist && dist < *maxdist)
-				{
-					*maxdist = dist;
-					BlobHits++;
-					return TRUE;
-					/* Yeah! Return valid root */
-				}
-			}
-
-		/* 
-		 * Move to next intersection
+		lo = strt->bound - EPSILON;
+		if (lo < mindist)
+			lo = mindist;
+		else if (lo >= *maxdist)
+			break;
+		hi = iarr[i+1].bound + EPSILON;
+		if (hi > *maxdist)
+			hi = *maxdist;
+		if (!SolvePolyRange(c, 4, lo, hi, &dist))
+			continue;
+		if (dist <= mindist)
+		{
+			/*
+			 * Too near; the next root in the interval may not be.
+			 */
+			k = SolvePolyRangeAll(c, 4, lo, hi, s);
+			for (j = 0; j < k && s[j] <= mindist; j++)
+				;
+			if (j == k)
+				continue;
+			dist = s[j];
+		}
+		/*
+		 * Found a valid root 
 		 */
-			istrt++;
-			strt = iarr[istrt];
-
-		} /* End of loop through Intersection List */
-	} /* End of Solving for Ray/Blob Intersection */
+		if (dist < *maxdist)
+		{
+			*maxdist = dist;
+			BlobHits++;
+			BlobRelease(coef, iarr, active, heap, mark);
+			return TRUE;
+			/* Yeah! Return valid root */
+		}
+	}
 
 	/* 
 	 * return negative
 	 */
+	BlobRelease(coef, iarr, active, heap, mark);
 	return FALSE;
 }
 
+/*
+ * Move the lists for the n metaballs met so far off the stack, to
+ * room for all of the blob's metaballs.  The room is taken from the
+ * scratch space reserved by BlobCreate, or malloc'd should that be
+ * in use.  Returns TRUE if it was malloc'd.
+ */
+static int
+BlobGrow(blob, coef, iarr, active, n)
+Blob *blob;
+Float (**coef)[5];
+MetaInt **iarr;
+int **active, n;
+{
+	Float (*newcoef)[5];
+	MetaInt *newiarr;
+	int *newactive, heap;
+	unsigned long mark;
+
+	mark = ScratchMark();
+	newcoef = (Float (*)[5])ScratchAlloc(blob->num*5*sizeof(Float));
+	newiarr = (MetaInt *)ScratchAlloc(2*blob->num*sizeof(MetaInt));
+	newactive = (int *)ScratchAlloc(blob->num*sizeof(int));
+	heap = !newcoef || !newiarr || !newactive;
+	if (heap) {
+		ScratchRelease(mark);
+		newcoef = (Float (*)[5])Malloc((unsigned)
+				(blob->num*5*sizeof(Float)));
+		newiarr = (MetaInt *)Malloc((unsigned)
+				(2*blob->num*sizeof(MetaInt)));
+		newactive = (int *)Malloc((unsigned)
+				(blob->num*sizeof(int)));
+	}
+	bcopy((char *)*coef, (char *)newcoef, n*5*sizeof(Float));
+	bcopy((char *)*iarr, (char *)newiarr, 2*n*sizeof(MetaInt));
+	*coef = newcoef;
+	*iarr = newiarr;
+	/*
+	 * The list of regions the ray is inside is not yet in use.
+	 */
+	*active = newactive;
+	return heap;
+}
+
+/*
+ * Give back the lists, wherever they are.
+ */
+static void
+BlobRelease(coef, iarr, active, heap, mark)
+Float (*coef)[5];
+MetaInt *iarr;
+int *active, heap;
+unsigned long mark;
+{
+	if (heap) {
+		free((voidstar)coef);
+		free((voidstar)iarr);
+		free((voidstar)active);
+	}
+	ScratchRelease(mark);
+}
 
 /***********************************************
  * Find the Normal of a Blob at a given point
@@ -599,37 +624,56 @@ Blob *blob;
 Vector *pos, *nrm, *gnrm;
 {
 	register int i;
+	BoundsNode *np;
+	int stack[BOUNDS_MAXDEPTH], sp;
 
 	/*  
 	 * Initialize normals to zero 
 	 */
 	nrm->x = nrm->y = nrm->z = 0.0;
 	/*
-	 * Loop through Metaballs. If the point is within a Metaball's
+	 * Loop through the Metaballs in those leaves of the tree that
+	 * contain the point. If the point is within a Metaball's
 	 * Sphere of influence, calculate the gradient and add it to the
 	 * normals
 	 */
-	for(i=0;i < blob->num; i++)
+	stack[0] = 0;
+	sp = 1;
+	while (sp > 0)
 	{
-		register MetaVector *sl;
-		register Float dist,xd,yd,zd;
-
-		sl = &(blob->list[i]);
-		xd = pos->x - sl->x;
-		yd = pos->y - sl->y;
-		zd = pos->z - sl->z;
-
-		dist  = xd*xd + yd*yd + zd*zd;
-		if (dist <= sl->rs )
+		np = &blob->nodes[stack[--sp]];
+		if (OutOfBounds(pos, np->bounds))
+			continue;
+		if (np->num == 0)
+		{
+			stack[sp++] = np->first;
+			stack[sp++] = np->first + 1;
+			continue;
+		}
+		for(i=np->first;i < np->first + np->num; i++)
 		{
-			register Float temp;
+			register MetaVector *sl;
+			register Float dist,xd,yd,zd;
+
+			sl = &(blob->list[i]);
+			xd = pos->x - sl->x;
+			yd = pos->y - sl->y;
+			zd = pos->z - sl->z;
 
-			/* temp is negative so normal points out of blob */
-			temp = -2.0 * (2.0 * sl->c4 * dist  +  sl->c2);
-			nrm->x += xd * temp;
-			nrm->y += yd * temp;
-			nrm->z += zd * temp;
+			dist  = xd*xd + yd*yd + zd*zd;
+			if (dist <= sl->rs )
+			{
+				register Float temp;
 
+				/*
+				 * temp is negative so normal points out
+				 * of blob
+				 */
+				temp = -2.0 * (2.0 * sl->c4 * dist  +  sl->c2);
+				nrm->x += xd * temp;
+				nrm->y += yd * temp;
+				nrm->z += zd * temp;
+			}
 		}
 	}
 	(void)VecNormalize(nrm);
@@ -33,6 +33,10 @@
 #define R_START 1
 #define R_END   0
 
+#define BLOB_LEAFSIZE	4	/* max. metaballs in a leaf of the tree */
+#define BLOB_NSCRATCH	32	/* metaballs a ray may meet before its
+				 * lists move off the stack */
+
 /*
  * Blob
  */
@@ -46,18 +50,21 @@ typedef struct {
 	Float z;	/* z position */
 } MetaVector;
 
+/*
+ * Start or end of a ray's passage through a sphere of influence.
+ */
 typedef struct {
-	int type,pnt;
-	Float bound;
-	Float c[5];
+	int type,pnt;		/* R_START/R_END, index into coefficients */
+	Float bound;		/* distance along ray */
 } MetaInt;
 
+
 typedef struct {
 	Float T;		/* Threshold   */
         int num;		/* number of points */
         MetaVector *list;	/* list of points */
-	MetaInt *ilist, **iarr;
-        
+	BoundsNode *nodes;	/* tree of spheres of influence */
+	int nnodes;
 } Blob;
 
 typedef struct MetaList {
@@ -27,6 +27,10 @@
  */
 #include "geom.h"
 
+#define BoxCentre(b,i,a)	((b)[i][LOW][a] + (b)[i][HIGH][a])
+
+static void BoundsTreeNode(), BoundsTreeSelect();
+
 /*
  * Check for intersection between bounding box and the given ray.
  * If there is an intersection between mindist and *maxdist along
@@ -157,6 +161,88 @@ Float bounds[2][3], mindist, *maxdist;
 	return FALSE;	/* hit, but not closer than maxdist */
 }
 
+/*
+ * Clip the segment of the ray between *mindist and *maxdist to the
+ * given box.  Return FALSE if no part of the segment lies inside it.
+ */
+int
+BoundsClipRay(ray, bounds, mindist, maxdist)
+Ray *ray;
+Float bounds[2][3], *mindist, *maxdist;
+{
+	Float t0, t1, tnear, tfar, pos, dir, tmp;
+	int i;
+
+	tnear = *mindist;
+	tfar = *maxdist;
+
+	for (i = 0; i < 3; i++) {
+		if (i == X) {
+			pos = ray->pos.x; dir = ray->dir.x;
+		} else if (i == Y) {
+			pos = ray->pos.y; dir = ray->dir.y;
+		} else {
+			pos = ray->pos.z; dir = ray->dir.z;
+		}
+		if (dir == 0.) {
+			if (pos < bounds[LOW][i] || pos > bounds[HIGH][i])
+				return FALSE;
+			continue;
+		}
+		t0 = (bounds[LOW][i] - pos) / dir;
+		t1 = (bounds[HIGH][i] - pos) / dir;
+		if (t0 > t1) {
+			tmp = t0;
+			t0 = t1;
+			t1 = tmp;
+		}
+		if (t0 > tnear)
+			tnear = t0;
+		if (t1 < tfar)
+			tfar = t1;
+		if (tnear > tfar)
+			return FALSE;
+	}
+	*mindist = tnear;
+	*maxdist = tfar;
+	return TRUE;
+}
+
+/*
+ * As BoundsClipRay(), but given the ray origin and the reciprocals of
+ * the components of its direction, for callers that clip one ray to
+ * many boxes.  A zero component has an infinite reciprocal, for which
+ * the slab test below still gives the right answer.
+ */
+int
+BoundsClipRayInv(org, inv, bounds, mindist, maxdist)
+Float org[3], inv[3], bounds[2][3], *mindist, *maxdist;
+{
+	Float t0, t1, tnear, tfar;
+	int i;
+
+	tnear = *mindist;
+	tfar = *maxdist;
+	for (i = 0; i < 3; i++) {
+		if (inv[i] >= 0.) {
+			t0 = (bounds[LOW][i] - org[i]) * inv[i];
+			t1 = (bounds[HIGH][i] - org[i]) * inv[i];
+		} else {
+			t0 = (bounds[HIGH][i] - org[i]) * inv[i];
+			t1 = (bounds[LOW][i] - org[i]) * inv[i];
+		}
+		if (t0 > tnear)
+			tnear = t0;
+		if (t1 < tfar)
+			tfar = t1;
+		if (tnear > tfar)
+			return FALSE;
+	}
+	*mindist = tnear;
+	*maxdist = tfar;
+	return TRUE;
+}
+
 /*
  * Transform an object's bounding box by the given transformation
  * matrix.
@@ -233,6 +319,22 @@ Float old[2][3], new[2][3];
 	SetIfGreater(old[HIGH][Z], new[HIGH][Z]);
 }
 
+/*
+ * Enlarge the given bounding box to include the given point.
+ */
+void
+BoundsAddPoint(bounds, pos)
+Float bounds[2][3];
+Vector *pos;
+{
+	SetIfLess(bounds[LOW][X], pos->x);
+	SetIfLess(bounds[LOW][Y], pos->y);
+	SetIfLess(bounds[LOW][Z], pos->z);
+	SetIfGreater(bounds[HIGH][X], pos->x);
+	SetIfGreater(bounds[HIGH][Y], pos->y);
+	SetIfGreater(bounds[HIGH][Z], pos->z);
+}
+
 void
 BoundsPrint(box, fp)
 Float box[2][3];
@@ -242,3 +344,189 @@ FILE *fp;
 	fprintf(fp,"\tY: %f to %f\n",box[LOW][Y], box[HIGH][Y]);
 	fprintf(fp,"\tZ: %f to %f\n",box[LOW][Z], box[HIGH][Z]);
 }
+
+/*
+ * Build a bounding volume hierarchy over n items, given the bounding
+ * box of each, and return its nodes, root first, setting *nnodes to
+ * their number.  order[] is set to the item indices in the order of
+ * the leaves.  Each node is split so that its first child holds a
+ * multiple of leafsize items and the two children hold about as many
+ * each, at the median of the items' box centres along the longest
+ * axis of their extent.  Every leaf thus holds at most leafsize
+ * items, and only the last leaf holds fewer, so that the items of a
+ * leaf beginning at order[first] are the (first/leafsize)th run of
+ * leafsize items.
+ */
+BoundsNode *
+BoundsTreeBuild(box, n, leafsize, order, nnodes)
+Float (*box)[2][3];
+int n, leafsize, *order, *nnodes;
+{
+	BoundsNode *nodes;
+	int i;
+
+	for (i = 0; i < n; i++)
+		order[i] = i;
+	nodes = (BoundsNode *)Malloc((unsigned)
+		((2*((n + leafsize - 1)/leafsize) - 1)*sizeof(BoundsNode)));
+	*nnodes = 1;
+	BoundsTreeNode(nodes, nnodes, box, order, 0, 0, n, leafsize);
+	return nodes;
+}
+
+/*
+ * Build the subtree rooted at nodes[node] over the n items listed
+ * beginning at order[first].
+ */
+static void
+BoundsTreeNode(nodes, nnodes, box, order, node, first, n, leafsize)
+BoundsNode *nodes;
+Float (*box)[2][3];
+int *nnodes, *order, node, first, n, leafsize;
+{
+	BoundsNode *np;
+	Float cb[2][3], c;
+	int i, axis, left;
+
+	np = &nodes[node];
+	BoundsInit(np->bounds);
+	BoundsInit(cb);
+	for (i = first; i < first + n; i++) {
+		BoundsEnlarge(np->bounds, box[order[i]]);
+		for (axis = 0; axis < 3; axis++) {
+			c = BoxCentre(box, order[i], axis);
+			if (c < cb[LOW][axis])
+				cb[LOW][axis] = c;
+			if (c > cb[HIGH][axis])
+				cb[HIGH][axis] = c;
+		}
+	}
+	/*
+	 * Pad the box so that hits on items lying in its sides
+	 * aren't lost to roundoff.
+	 */
+	for (axis = 0; axis < 3; axis++) {
+		np->bounds[LOW][axis] -= EPSILON;
+		np->bounds[HIGH][axis] += EPSILON;
+	}
+
+	if (n <= leafsize) {
+		np->first = first;
+		np->num = n;
+		np->axis = X;
+		return;
+	}
+
+	axis = X;
+	if (cb[HIGH][Y] - cb[LOW][Y] > cb[HIGH][axis] - cb[LOW][axis])
+		axis = Y;
+	if (cb[HIGH][Z] - cb[LOW][Z] > cb[HIGH][axis] - cb[LOW][axis])
+		axis = Z;
+
+	left = leafsize * (((n + leafsize - 1) / leafsize) / 2);
+	BoundsTreeSelect(box, &order[first], n, left, axis);
+
+	np->first = *nnodes;
+	np->num = 0;
+	np->axis = axis;
+	*nnodes += 2;
+	BoundsTreeNode(nodes, nnodes, box, order, np->first, first, left,
+			leafsize);
+	BoundsTreeNode(nodes, nnodes, box, order, np->first + 1, first + left,
+			n - left, leafsize);
+}
+
+/*
+ * Reorder the n items listed in order[] so that the kth is the one
+ * that would be kth were they sorted by box centre along the given
+ * axis, those before it have centres no greater and those after it
+ * centres no less.
+ */
+static void
+BoundsTreeSelect(box, order, n, k, axis)
+Float (*box)[2][3];
+int *order, n, k, axis;
+{
+	Float pivot;
+	int lo, hi, i, j, tmp;
+
+	lo = 0;
+	hi = n - 1;
+	while (lo < hi) {
+		pivot = BoxCentre(box, order[(lo + hi) / 2], axis);
+		i = lo;
+		j = hi;
+		do {
+			while (BoxCentre(box, order[i], axis) < pivot)
+				i++;
+			while (BoxCentre(box, order[j], axis) > pivot)
+				j--;
+			if (i <= j) {
+				tmp = order[i];
+				order[i] = order[j];
+				order[j] = tmp;
+				i++;
+				j--;
+			}
+		} while (i <= j);
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+/*
+ * Start a walk along the given ray through a BoundsTree.
+ */
+void
+BoundsWalkInit(walk, ray)
+BoundsWalk *walk;
+Ray *ray;
+{
+	walk->org[X] = ray->pos.x;
+	walk->org[Y] = ray->pos.y;
+	walk->org[Z] = ray->pos.z;
+	walk->inv[X] = 1. / ray->dir.x;
+	walk->inv[Y] = 1. / ray->dir.y;
+	walk->inv[Z] = 1. / ray->dir.z;
+	walk->stack[0] = 0;
+	walk->sp = 1;
+}
+
+/*
+ * Return the next leaf of the tree whose box the ray passes through
+ * between mindist and maxdist, or NULL when there are no more.
+ * Nearer children are visited first, so that a caller narrowing
+ * maxdist as it finds hits skips as much of the tree as it can.
+ */
+BoundsNode *
+BoundsWalkNext(walk, nodes, mindist, maxdist)
+BoundsWalk *walk;
+BoundsNode *nodes;
+Float mindist, maxdist;
+{
+	BoundsNode *np;
+	Float tnear, tfar;
+
+	while (walk->sp > 0) {
+		np = &nodes[walk->stack[--walk->sp]];
+		tnear = mindist;
+		tfar = maxdist;
+		if (!BoundsClipRayInv(walk->org, walk->inv, np->bounds,
+				      &tnear, &tfar))
+			continue;
+		if (np->num)
+			return np;
+		if (walk->inv[np->axis] < 0.) {
+			walk->stack[walk->sp++] = np->first;
+			walk->stack[walk->sp++] = np->first + 1;
+		} else {
+			walk->stack[walk->sp++] = np->first + 1;
+			walk->stack[walk->sp++] = np->first;
+		}
+	}
+	return (BoundsNode *)NULL;
+}
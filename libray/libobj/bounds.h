@@ -51,9 +51,34 @@
 			  (p)->y < b[0][1] || (p)->y > b[1][1] ||\
 			  (p)->z < b[0][2] || (p)->z > b[1][2])
 
+#define BOUNDS_MAXDEPTH	64	/* max. depth of a BoundsTree */
+
+/*
+ * Node of a bounding volume hierarchy built by BoundsTreeBuild().
+ * Leaves hold num > 0 items listed beginning at order[first];
+ * interior nodes have num == 0 and children node[first] and
+ * node[first+1].
+ */
+typedef struct {
+	Float bounds[2][3];
+	int first, num;
+	int axis;		/* split axis of an interior node */
+} BoundsNode;
+
+/*
+ * State of a walk along a ray through a BoundsTree.
+ */
+typedef struct {
+	Float org[3], inv[3];	/* ray origin, reciprocal direction */
+	int stack[BOUNDS_MAXDEPTH], sp;
+} BoundsWalk;
+
 extern void 	BoundsCopy(), BoundsPrint(),
 		BoundsInit(), BoundsEnlarge(),
-		BoundsTransform();
+		BoundsTransform(), BoundsAddPoint(),
+		BoundsWalkInit();
+
+extern int	BoundsIntersect(), BoundsClipRay(), BoundsClipRayInv();
 
-extern int	BoundsIntersect();
+extern BoundsNode *BoundsTreeBuild(), *BoundsWalkNext();
 #endif /* BOUNDS_H */
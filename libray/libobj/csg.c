@@ -93,7 +93,8 @@ Ray *ray;
 HitList *hit1, *hit2;
 Float mindist, *dist1, *dist2;
 {
-	int operator;
+	int operator, hit;
+	Float tnear, tfar;
 
 	hit1->nodes = 0;
 	hit2->nodes = 0;
@@ -101,7 +102,8 @@ Float mindist, *dist1, *dist2;
 	*dist2 = FAR_AWAY;
 	operator = csg->operator;
 
-	if (!intersect(csg->obj1, ray, hit1, mindist, dist1) &&
+	hit = intersect(csg->obj1, ray, hit1, mindist, dist1);
+	if (!hit &&
 	    ((operator == CSG_INTERSECT) || (operator == CSG_DIFFERENCE))) {
 		/*
 		 * Intersection and Difference cases: if you miss the first
@@ -110,6 +112,28 @@ Float mindist, *dist1, *dist2;
 		return FALSE;
 	}
 
+	/*
+	 * See where the ray meets the bounds of the second object.  If
+	 * not until after the hit on the first, that hit is outside the
+	 * second object and nearer than any hit on it, so for union and
+	 * difference it is the answer and the second object need not be
+	 * intersected at all.  For intersection, missing the bounds of
+	 * the second object means missing the whole thing.  An
+	 * unbounded object has no bounds worth testing.
+	 */
+	if (!UNBOUNDED(csg->obj2)) {
+		tnear = mindist;
+		tfar = FAR_AWAY;
+		if (!BoundsClipRay(ray, csg->obj2->bounds, &tnear, &tfar)) {
+			if (operator == CSG_INTERSECT)
+				return FALSE;
+			return hit;
+		}
+		if (hit && operator != CSG_INTERSECT &&
+		    tnear > *dist1 + EPSILON)
+			return TRUE;
+	}
+
 	if (!intersect(csg->obj2, ray, hit2, mindist, dist2) &&
 	    ((operator == CSG_INTERSECT) ||
 	     (hit1->nodes == 0) && (operator == CSG_UNION))) {
@@ -130,18 +154,18 @@ HitList *hitp;
 	if (hitp->data[0].enter)
 		return hitp->data[0].enter - 1;
 
-	return PrimEnter(hitp->data[0].obj, &hitp->data[0].ray,
-			hitp->data[0].mindist, hitp->data[0].dist);
+	return PrimEnter(hitp->data[0].obj, &hitp->ray,
+			hitp->mindist, hitp->data[0].dist);
 }
 
 static int
-CsgUnionInt(ray, hit1p, hit2p, dist1, dist2, hitclose, distclose)
+CsgUnionInt(ray, hit1p, hit2p, spare, dist1, dist2, hitclose, distclose)
 Ray *ray;
-HitList *hit1p, *hit2p, **hitclose;
+HitList *hit1p, *hit2p, *spare, **hitclose;
 Float dist1, dist2, *distclose;
 {
 	Float distnext;
-	HitList hitnext, *hittmp;
+	HitList *hittmp;
 
 	while (TRUE) {
 		if (hit2p->nodes == 0 ||
@@ -153,9 +177,9 @@ Float dist1, dist2, *distclose;
 			return TRUE;
 		} else {
 			distnext = FAR_AWAY;
-			hitnext.nodes = 0;
+			spare->nodes = 0;
 			if (!intersect(hit1p->data[hit1p->nodes-1].obj,
-			    ray, &hitnext, dist2+EPSILON, &distnext)) {
+			    ray, spare, dist2+EPSILON, &distnext)) {
 				/*
 				 * None of obj1 beyond, return hit2 (leaving)
 				 */
@@ -166,13 +190,14 @@ Float dist1, dist2, *distclose;
 			} else {
 				/*
 				 * Since hit1 is supposed to be the close one,
-				 * swap them and copy hitnext into hit2.
+				 * hit2 becomes hit1 and the new hit becomes
+				 * hit2; the old hit1 is free for the next go.
 	     			 */
 				hittmp = hit1p;
 				hit1p = hit2p;
-				hit2p = hittmp;
+				hit2p = spare;
+				spare = hittmp;
 				dist1 = dist2;
-				CsgHitlistCopy(&hitnext, hit2p);
 				dist2 = distnext;
 				/* and continue */
 			}
@@ -181,12 +206,12 @@ Float dist1, dist2, *distclose;
 }
 
 static int
-CsgIntersectInt(ray, hit1p, hit2p, dist1, dist2, hitclose, distclose)
+CsgIntersectInt(ray, hit1p, hit2p, spare, dist1, dist2, hitclose, distclose)
 Ray *ray;
-HitList *hit1p, *hit2p, **hitclose;
+HitList *hit1p, *hit2p, *spare, **hitclose;
 Float dist1, dist2, *distclose;
 {
-	HitList *hittmp, hitnext;
+	HitList *hittmp;
 	Float distnext;
 
 	while (TRUE) {
@@ -199,9 +224,9 @@ Float dist1, dist2, *distclose;
 			return TRUE;
 		} else {
 			distnext = FAR_AWAY;
-			hitnext.nodes = 0;
+			spare->nodes = 0;
 			if (!intersect(hit1p->data[hit1p->nodes-1].obj,
-			    ray, &hitnext, dist2+EPSILON, &distnext)) {
+			    ray, spare, dist2+EPSILON, &distnext)) {
 				/*
 				 * None of obj1 beyond, so return miss
 				 */
@@ -209,14 +234,14 @@ Float dist1, dist2, *distclose;
 			} else {
 				/*
 				 * Since hit1 is supposed to be the
-				 * close one, swap them and copy
-				 * hitnext into hit2.
+				 * close one, hit2 becomes hit1 and
+				 * the new hit becomes hit2.
 				 */
 				hittmp = hit1p;
 				hit1p = hit2p;
-				hit2p = hittmp;
+				hit2p = spare;
+				spare = hittmp;
 				dist1 = dist2;
-				CsgHitlistCopy(&hitnext, hit2p);
 				dist2 = distnext;
 				/* and continue */
 			}
@@ -225,13 +250,13 @@ Float dist1, dist2, *distclose;
 }
 
 static int
-CsgDifferenceInt(ray, hit1p, hit2p, dist1, dist2, hitclose, distclose)
+CsgDifferenceInt(ray, hit1p, hit2p, spare, dist1, dist2, hitclose, distclose)
 Ray *ray;
-HitList *hit1p, *hit2p, **hitclose;
+HitList *hit1p, *hit2p, *spare, **hitclose;
 Float dist1, dist2, *distclose;
 {
 	Float distnext;
-	HitList hitnext;
+	HitList *hittmp;
 
 	while (TRUE) {
 		if (dist1 < dist2) {
@@ -244,9 +269,9 @@ Float dist1, dist2, *distclose;
 				return TRUE;
 			} else {
 				distnext = FAR_AWAY;
-				hitnext.nodes = 0;
+				spare->nodes = 0;
 				if (!intersect(hit1p->data[hit1p->nodes-1].obj,
-				    ray, &hitnext, dist2+EPSILON, &distnext)) {
+				    ray, spare, dist2+EPSILON, &distnext)) {
 					/*
 					 * None of obj1 beyond, so
 					 * return miss
@@ -254,7 +279,9 @@ Float dist1, dist2, *distclose;
 					return FALSE;
 				} else {
 					dist1 = distnext;
-					CsgHitlistCopy(&hitnext, hit1p);
+					hittmp = hit1p;
+					hit1p = spare;
+					spare = hittmp;
 					/* and continue */
 				}
 			}
@@ -274,9 +301,9 @@ Float dist1, dist2, *distclose;
 				return TRUE;
 			} else {
 				distnext = FAR_AWAY;
-				hitnext.nodes = 0;
+				spare->nodes = 0;
 				if (!intersect(hit2p->data[hit2p->nodes-1].obj,
-				    ray, &hitnext, dist1+EPSILON, &distnext)) {
+				    ray, spare, dist1+EPSILON, &distnext)) {
 					/*
 					 * None of obj2 beyond, so
 					 * return hit1
@@ -288,7 +315,9 @@ Float dist1, dist2, *distclose;
 					return TRUE;
 				} else {
 					dist2 = distnext;
-					CsgHitlistCopy(&hitnext, hit2p);
+					hittmp = hit2p;
+					hit2p = spare;
+					spare = hittmp;
 					/* and continue */
 				}
 			}
@@ -303,8 +332,23 @@ Ray *ray;
 HitList *hitlist;
 Float mindist, *maxdist;
 {
-	Float dist1, dist2, disttmp, distclose;
-	HitList hit1, hit2, *hit1p, *hit2p, *hitclose;
+	Float dist1, dist2, disttmp, distclose, tnear, tfar;
+	HitList hit1, hit2, spare, *hit1p, *hit2p, *hitclose;
+
+	/*
+	 * All of the surface lies within the bounds, so if the ray
+	 * misses them between mindist and maxdist there is nothing to
+	 * find.  Csg objects aren't bounds-checked by intersect().
+	 * Inverted bounds bound nothing, and those of a union leave out
+	 * an unbounded operand, so neither is tested.
+	 */
+	if (!UNBOUNDED(csg) && (csg->operator != CSG_UNION ||
+	    (!UNBOUNDED(csg->obj1) && !UNBOUNDED(csg->obj2)))) {
+		tnear = mindist;
+		tfar = *maxdist;
+		if (!BoundsClipRay(ray, csg->bounds, &tnear, &tfar))
+			return FALSE;
+	}
 
 	hit1p = &hit1;
 	hit2p = &hit2;
@@ -328,7 +372,7 @@ Float mindist, *maxdist;
 	 * Call appropriate intersection method.  If FALSE is return,
 	 * no hit of any kind was found.
 	 */
-	if (!(*csg->intmeth)(ray, hit1p, hit2p, dist1, dist2,
+	if (!(*csg->intmeth)(ray, hit1p, hit2p, &spare, dist1, dist2,
 	    &hitclose, &distclose))
 		return FALSE;
 
@@ -351,6 +395,8 @@ HitList *from, *to;
 	int i;
 
 	to->nodes = from->nodes;
+	to->ray = from->ray;
+	to->mindist = from->mindist;
 	for (i = 0; i < from->nodes; i++)
 		to->data[i] = from->data[i];
 }
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "geom.h"
+#include "list.h"
+#include "grid.h"
+#include "cull.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+static void CullWalk(), CullAdd(), CullCount();
+static int CullOpen(), CullAncAdd(), CullOverlaps();
+static voidstar CullGrow();
+
+/*
+ * Has the aggregate whose survivors start at 'first' too many of them?
+ */
+#define CullTooMany(cl, first)	((cl)->maxkids && \
+					(cl)->nobjs - (first) > (cl)->maxkids)
+
+CullList *
+CullListCreate()
+{
+	CullList *cl;
+
+	cl = (CullList *)Calloc(1, sizeof(CullList));
+	BoundsInit(cl->bounds);
+	return cl;
+}
+
+/*
+ * Make room in the given list for as many objects and ancestors as
+ * culling obj could ever keep, given that no aggregate with more than
+ * 'maxkids' survivors, which must not be zero, is opened up, so that
+ * building the list later allocates nothing.  As the walk stops
+ * opening an aggregate once it has too many survivors, that is at
+ * most maxkids objects for each level of nested aggregates, plus one.
+ */
+void
+CullListReserve(cl, obj, maxkids)
+CullList *cl;
+Geom *obj;
+int maxkids;
+{
+	int depth, naggs, n;
+
+	depth = naggs = 0;
+	CullCount(obj, 0, &depth, &naggs);
+	n = maxkids * depth + 1;
+	while (cl->maxobjs < n) {
+		cl->objs = (Geom **)CullGrow((voidstar)cl->objs,
+			cl->maxobjs, sizeof(Geom *));
+		cl->parent = (int *)CullGrow((voidstar)cl->parent,
+			cl->maxobjs, sizeof(int));
+		cl->maxobjs = cl->maxobjs ? 2 * cl->maxobjs : CULL_MAXKIDS;
+	}
+	while (cl->maxanc < naggs) {
+		cl->anc = (CullAnc *)CullGrow((voidstar)cl->anc,
+			cl->maxanc, sizeof(CullAnc));
+		cl->maxanc = cl->maxanc ? 2 * cl->maxanc : CULL_MAXKIDS;
+	}
+}
+
+/*
+ * Find the deepest nesting of aggregates that CullWalk() would open
+ * up in obj, and how many it could open in all.
+ */
+static void
+CullCount(obj, level, depth, naggs)
+Geom *obj;
+int level, *depth, *naggs;
+{
+	Geom *bounded, *unbounded, *otmp;
+	Float *aggbounds;
+
+	if (!CullOpen(obj, &bounded, &unbounded, &aggbounds))
+		return;
+	level++;
+	if (level > *depth)
+		*depth = level;
+	(*naggs)++;
+	for (otmp = unbounded; otmp; otmp = otmp->next)
+		CullCount(otmp, level, depth, naggs);
+	for (otmp = bounded; otmp; otmp = otmp->next)
+		CullCount(otmp, level, depth, naggs);
+}
+
+/*
+ * Fill the given list with those objects in obj that might be hit by
+ * a ray segment lying inside 'bounds'.  Untransformed lists and grids
+ * are opened up, so that the ancestors of a surviving object are
+ * remembered and may be put back on the hitlist by CullHitPath().
+ * An aggregate with more than 'maxkids' survivors is kept whole,
+ * unless maxkids is zero.
+ */
+void
+CullListBuild(cl, obj, bounds, maxkids)
+CullList *cl;
+Geom *obj;
+Float bounds[2][3];
+int maxkids;
+{
+	cl->nobjs = cl->nanc = 0;
+	cl->maxkids = maxkids;
+	cl->nplanes = 0;
+	BoundsCopy(bounds, cl->bounds);
+	CullWalk(cl, obj, -1);
+}
+
+/*
+ * As above, but keep those objects that might be hit by rays leaving
+ * 'pos' in any direction lying within the four given directions,
+ * which must be in order around the quadrilateral they span.
+ */
+void
+CullListFrustum(cl, obj, pos, dir, maxkids)
+CullList *cl;
+Geom *obj;
+Vector *pos, dir[4];
+int maxkids;
+{
+	Vector center;
+	int i;
+
+	cl->nobjs = cl->nanc = 0;
+	cl->maxkids = maxkids;
+	cl->bounds[LOW][X] = cl->bounds[LOW][Y] = cl->bounds[LOW][Z] =
+		-FAR_AWAY;
+	cl->bounds[HIGH][X] = cl->bounds[HIGH][Y] = cl->bounds[HIGH][Z] =
+		FAR_AWAY;
+
+	VecAdd(dir[0], dir[1], &center);
+	VecAdd(center, dir[2], &center);
+	VecAdd(center, dir[3], &center);
+	for (i = 0; i < 4; i++) {
+		VecCross(&dir[i], &dir[(i+1) % 4], &cl->norm[i]);
+		if (dotp(&cl->norm[i], &center) < 0.)
+			VecScale(-1., cl->norm[i], &cl->norm[i]);
+		cl->d[i] = dotp(&cl->norm[i], pos);
+	}
+	cl->nplanes = 4;
+	CullWalk(cl, obj, -1);
+}
+
+static void
+CullWalk(cl, obj, parent)
+CullList *cl;
+Geom *obj;
+int parent;
+{
+	Geom *bounded, *unbounded, *otmp;
+	Float *aggbounds;
+	int anc, first;
+
+	if (!CullOpen(obj, &bounded, &unbounded, &aggbounds)) {
+		/*
+		 * Primitives, and aggregates that check their own
+		 * bounding box, cannot be hit by a segment that
+		 * doesn't enter that box.  Any other aggregate might
+		 * hold something unbounded, so is always kept.
+		 */
+		if (CullBounded(obj) && !CullOverlaps(cl, obj->bounds))
+			return;
+		CullAdd(cl, obj, parent);
+		return;
+	}
+
+	/*
+	 * Mirror ListIntersect() and GridIntersect():  unbounded
+	 * objects are always tried, bounded ones only if the
+	 * segment can enter the aggregate's bounding box.  Once
+	 * there are too many survivors, the rest needn't be walked.
+	 */
+	first = cl->nobjs;
+	anc = CullAncAdd(cl, obj, parent);
+	for (otmp = unbounded; otmp && !CullTooMany(cl, first);
+	     otmp = otmp->next)
+		CullWalk(cl, otmp, anc);
+	if (!CullTooMany(cl, first) &&
+	    CullOverlaps(cl, (Float (*)[3])aggbounds)) {
+		for (otmp = bounded; otmp && !CullTooMany(cl, first);
+		     otmp = otmp->next)
+			CullWalk(cl, otmp, anc);
+	}
+	if (CullTooMany(cl, first)) {
+		/*
+		 * Not worth it -- keep the whole aggregate.
+		 */
+		cl->nobjs = first;
+		cl->nanc = anc;
+		CullAdd(cl, obj, parent);
+	}
+}
+
+/*
+ * If obj is an untransformed list or grid, which may be opened up,
+ * find its bounded and unbounded objects and its bounding box.
+ */
+static int
+CullOpen(obj, bounded, unbounded, aggbounds)
+Geom *obj, **bounded, **unbounded;
+Float **aggbounds;
+{
+	if (obj->trans != (Trans *)NULL)
+		return FALSE;
+	if (obj->methods == ListMethods()) {
+		*unbounded = ((List *)obj->obj)->unbounded;
+		*bounded = ((List *)obj->obj)->list;
+		*aggbounds = &((List *)obj->obj)->bounds[0][0];
+		return TRUE;
+	}
+	if (obj->methods == GridMethods()) {
+		*unbounded = ((Grid *)obj->obj)->unbounded;
+		*bounded = ((Grid *)obj->obj)->objects;
+		*aggbounds = &((Grid *)obj->obj)->bounds[0][0];
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Can obj only be hit by rays that pass through its bounding box?
+ */
+int
+CullBounded(obj)
+Geom *obj;
+{
+	return (!IsAggregate(obj) || obj->methods->checkbounds) &&
+		!UNBOUNDED(obj);
+}
+
+/*
+ * Might the given box overlap the region the list is culled to?
+ */
+static int
+CullOverlaps(cl, a)
+CullList *cl;
+Float a[2][3];
+{
+	Float (*b)[3];
+	Vector p;
+	int i;
+
+	b = cl->bounds;
+	if (a[LOW][X] > b[HIGH][X] || a[HIGH][X] < b[LOW][X] ||
+	    a[LOW][Y] > b[HIGH][Y] || a[HIGH][Y] < b[LOW][Y] ||
+	    a[LOW][Z] > b[HIGH][Z] || a[HIGH][Z] < b[LOW][Z])
+		return FALSE;
+	/*
+	 * The box is outside the frustum if the corner of the box
+	 * farthest along the inward normal of one of its planes lies
+	 * outside that plane.
+	 */
+	for (i = 0; i < cl->nplanes; i++) {
+		p.x = cl->norm[i].x > 0. ? a[HIGH][X] : a[LOW][X];
+		p.y = cl->norm[i].y > 0. ? a[HIGH][Y] : a[LOW][Y];
+		p.z = cl->norm[i].z > 0. ? a[HIGH][Z] : a[LOW][Z];
+		if (dotp(&cl->norm[i], &p) < cl->d[i])
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+CullAdd(cl, obj, parent)
+CullList *cl;
+Geom *obj;
+int parent;
+{
+	if (cl->nobjs == cl->maxobjs) {
+		cl->objs = (Geom **)CullGrow((voidstar)cl->objs,
+			cl->maxobjs, sizeof(Geom *));
+		cl->parent = (int *)CullGrow((voidstar)cl->parent,
+			cl->maxobjs, sizeof(int));
+		cl->maxobjs = cl->maxobjs ? 2 * cl->maxobjs : CULL_MAXKIDS;
+	}
+	cl->objs[cl->nobjs] = obj;
+	cl->parent[cl->nobjs] = parent;
+	cl->nobjs++;
+}
+
+static int
+CullAncAdd(cl, obj, parent)
+CullList *cl;
+Geom *obj;
+int parent;
+{
+	if (cl->nanc == cl->maxanc) {
+		cl->anc = (CullAnc *)CullGrow((voidstar)cl->anc,
+			cl->maxanc, sizeof(CullAnc));
+		cl->maxanc = cl->maxanc ? 2 * cl->maxanc : CULL_MAXKIDS;
+	}
+	cl->anc[cl->nanc].obj = obj;
+	cl->anc[cl->nanc].parent = parent;
+	return cl->nanc++;
+}
+
+/*
+ * Double the size of an array of 'num' elements of the given size,
+ * or allocate a new one.
+ */
+static voidstar
+CullGrow(old, num, size)
+voidstar old;
+int num;
+unsigned size;
+{
+	voidstar new;
+
+	if (num == 0)
+		return Malloc(CULL_MAXKIDS * size);
+	new = Malloc(2 * num * size);
+	bcopy((char *)old, (char *)new, (int)(num * size));
+	free(old);
+	return new;
+}
+
+/*
+ * Intersect ray with the objects on a culled list.  The segment
+ * of the ray between mindist and *maxdist is assumed to lie within
+ * the region the list was culled to.  If 'anyhit' is TRUE, the first
+ * intersection found is returned, rather than the closest.  On
+ * return, hitlist holds the same path through the DAG that
+ * intersecting the original object would have produced.
+ */
+int
+CullIntersect(cl, ray, hitlist, mindist, maxdist, anyhit)
+CullList *cl;
+Ray *ray;
+HitList *hitlist;
+Float mindist, *maxdist;
+int anyhit;
+{
+	int i, last;
+
+	last = -1;
+	for (i = 0; i < cl->nobjs; i++) {
+		if (intersect(cl->objs[i], ray, hitlist, mindist, maxdist)) {
+			last = i;
+			if (anyhit)
+				break;
+		}
+	}
+	if (last < 0)
+		return FALSE;
+
+	CullHitPath(cl, last, hitlist, *maxdist);
+	return TRUE;
+}
+
+/*
+ * Given the hitlist resulting from intersecting the i'th object on
+ * the list, add the aggregates through which it was reached.
+ */
+void
+CullHitPath(cl, i, hitlist, dist)
+CullList *cl;
+int i;
+HitList *hitlist;
+Float dist;
+{
+	HitNode *np;
+	int a;
+
+	for (a = cl->parent[i]; a >= 0; a = cl->anc[a].parent) {
+		np = &hitlist->data[hitlist->nodes++];
+		np->obj = cl->anc[a].obj;
+		np->dist = dist;
+		np->enter = 0;
+		np->dotrans = FALSE;
+	}
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef CULL_H
+#define CULL_H
+
+/*
+ * Once it has grown beyond this many survivors, an aggregate that is
+ * being culled is kept whole; its own acceleration scheme will do a
+ * better job than a linear list.
+ */
+#define CULL_MAXKIDS	16
+
+/*
+ * Aggregate through which a culled object was reached.
+ */
+typedef struct CullAnc {
+	struct Geom *obj;		/* untransformed list or grid */
+	int parent;			/* index of enclosing one, or -1 */
+} CullAnc;
+
+/*
+ * The objects in a DAG that may be hit by a ray segment lying
+ * entirely within a given region:  a box, or the frustum swept by
+ * rays leaving a point through a quadrilateral.
+ */
+typedef struct CullList {
+	Float bounds[2][3];		/* region culled to */
+	int nplanes;			/* # of frustum planes, or 0 */
+	Vector norm[4];			/* inward-facing plane normals */
+	Float d[4];			/* dot(norm, point on plane) */
+	int maxkids;			/* largest aggregate opened up */
+	int nobjs, maxobjs;		/* # of survivors, space for */
+	struct Geom **objs;		/* survivors */
+	int *parent;			/* index of each one's ancestor */
+	int nanc, maxanc;		/* # of ancestors, space for */
+	CullAnc *anc;			/* enclosing aggregates */
+} CullList;
+
+extern CullList	*CullListCreate();
+extern void	CullListBuild(), CullListFrustum(), CullListReserve(),
+		CullHitPath();
+extern int	CullIntersect(), CullBounded();
+
+#endif /* CULL_H */
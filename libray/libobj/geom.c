@@ -347,6 +347,19 @@ Vec2d *uv;
 		(*prim->methods->uv)(prim->obj,pos,norm,uv,dpdu,dpdv);
 }
 
+/*
+ * Return the surface given to the part of the primitive last hit,
+ * or NULL if the primitive has no say in the matter.
+ */
+struct Surface *
+PrimSurface(prim)
+Geom *prim;
+{
+	if (prim->methods->surface == NULL)
+		return (struct Surface *)NULL;
+	return (*prim->methods->surface)(prim->obj);
+}
+
 int
 PrimNormal(prim, pos, norm, gnorm)
 Geom *prim;
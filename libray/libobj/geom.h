@@ -60,7 +60,9 @@ typedef struct Methods {
 	int		(*intersect)(),		/* Ray/obj intersection */
 			(*normal)(),		/* Geom normal (p) */
 			(*enter)(),		/* Ray enter or exit? (p) */
-			(*convert)();		/* Convert from list (a) */
+			(*convert)(),		/* Convert from list (a) */
+			(*xform)();		/* Absorb transformation (p) */
+	struct Surface	*(*surface)();		/* Surface of last hit (p) */
 	void		(*uv)(),		/* 2D mapping (p) */
 			(*stats)(),		/* Statistics */
 			(*bounds)(),		/* Bounding volume */
@@ -106,25 +108,26 @@ typedef struct GeomList {
 
 /*
  * Array of hit information.  Stores a path through an object DAG,
- * as well as the ray in 'model' (object) space and the distance from
- * the ray origin to the point of intersection.
+ * and the distance from the ray origin to the point of intersection
+ * in the space of each object along it.  The transformation
+ * for a node, if any, is found using HitTrans().
  */
 typedef struct HitNode {
 	Geom *obj;			/* Geom hit */
-	Ray	ray;			/* Ray */
-	Float	mindist;		/* Amount of ray to ignore */
 	Float	dist;			/* Distance from ray origin to hit */
 	short	enter,			/* Enter (TRUE) or Leave (FALSE) obj */
 		dotrans;		/* transformations non-identity? */
-	Trans	trans;			/* parent-->obj and inverse trans */
 } HitNode;
 
 /*
  * Structure holding a list of HitNodes.  A maximum of MAXMODELDEPTH
- * nodes can be referenced.
+ * nodes can be referenced.  The ray is that given to the primitive,
+ * data[0].obj.
  */
 typedef struct HitList {
 	int nodes;
+	Ray	ray;			/* Ray in primitive space */
+	Float	mindist;		/* Amount of ray to ignore */
 	HitNode data[MAXMODELDEPTH];
 } HitList;
 
@@ -137,11 +140,15 @@ extern Geom	*GeomCreate(), *GeomCopy(), *GeomCopyNamed(),
 extern GeomList	*GeomStackPush(), *GeomStackPop();
 
 extern void 	PrimUV(), AggregatePrintInfo(),
-		IntersectStats();
+		IntersectStats(), IntersectHit();
 
 extern int	AggregateConvert(), PrimNormal(),
 		TraceRay();	/* application-provided */
 
 extern Methods	*MethodsCreate();
 
+extern Trans	*HitTrans();
+
+extern struct Surface *PrimSurface();
+
 #endif /* OBJECT_H */
@@ -33,7 +33,7 @@ static char gridName[] = "grid";
 
 static unsigned long raynumber = 1;		/* Current "ray number". */
 						/* (should be "grid number") */
-static void engrid(), GridFreeVoxels();
+static void engrid(), GridFreeVoxels(), GridBlockVoxel();
 static int pos2grid(), CheckVoxel();
 
 Grid *
@@ -72,7 +72,9 @@ HitList *hitlist;
 Float mindist, *maxdist;
 {
 	GeomList *list;
+	GridBlock *blocks;
 	Geom *obj;
+	TriRay tr;
 	int hit;
 	Float offset, tMaxX, tMaxY, tMaxZ;
 	Float tDeltaX, tDeltaY, tDeltaZ, *raybounds[2][3];
@@ -111,6 +113,11 @@ Float mindist, *maxdist;
 		offset = mindist;
 
 	counter = raynumber++;
+	/*
+	 * The ray is set up for triangle testing only once a voxel
+	 * holding triangle blocks is reached.
+	 */
+	tr.kz = -1;
 
 	/*
 	 * tMaxX is the absolute distance from the ray origin we must move
@@ -202,10 +209,11 @@ Float mindist, *maxdist;
 
 	while (TRUE) {
 		list = grid->cells[x][y][z];
+		blocks = grid->blocks[x][y][z];
 		if (tMaxX < tMaxY && tMaxX < tMaxZ) {
-			if (list) {
+			if (list || blocks) {
 				np = nXp;
-			    	if (CheckVoxel(list,ray,raybounds,
+			    	if (CheckVoxel(list,blocks,ray,&tr,raybounds,
 			    	    hitlist,counter,offset,maxdist))
 					hit = TRUE;
 			}
@@ -218,9 +226,9 @@ Float mindist, *maxdist;
 			nXp.y += pDeltaX.y;
 			nXp.z += pDeltaX.z;
 		} else if (tMaxZ < tMaxY) {
-			if (list) {
+			if (list || blocks) {
 				np = nZp;
-			    	if (CheckVoxel(list,ray, raybounds,
+			    	if (CheckVoxel(list,blocks,ray,&tr,raybounds,
 			    	    hitlist,counter,offset,maxdist))
 					hit = TRUE;
 			}
@@ -233,9 +241,9 @@ Float mindist, *maxdist;
 			nZp.y += pDeltaZ.y;
 			nZp.z += pDeltaZ.z;
 		} else {
-			if (list) {
+			if (list || blocks) {
 				np = nYp;
-			    	if (CheckVoxel(list,ray,raybounds,
+			    	if (CheckVoxel(list,blocks,ray,&tr,raybounds,
 			    	    hitlist,counter,offset,maxdist))
 					hit = TRUE;
 			}
@@ -255,19 +263,26 @@ Float mindist, *maxdist;
 /*
  * Intersect ray with objects in grid cell.  Note that there are a many ways
  * to speed up this routine, all of which uglify the code to a large extent.
+ * Runs of triangles are tested a block at a time, with the same culling
+ * applied to each lane; the hit with the triangle found nearest in a
+ * block is recorded from the lane's distance and barycentrics.
  */
 static int
-CheckVoxel(list,ray,raybounds,hitlist,counter,mindist,maxdist)
+CheckVoxel(list,blocks,ray,tr,raybounds,hitlist,counter,mindist,maxdist)
 GeomList *list;
+GridBlock *blocks;
 Ray *ray;
+TriRay *tr;
 Float *raybounds[2][3];
 HitList *hitlist;
 unsigned long counter;
 Float mindist, *maxdist;
 {
 	Geom *obj;
-	int hit;
-	Float lx, hx, ly, hy, lz, hz;
+	Triangle *tri;
+	int hit, lane, mask, i;
+	Float lx, hx, ly, hy, lz, hz, dist, b[3];
+	extern unsigned long TriHits;
 
 	lx = *raybounds[LOW][X];
 	hx = *raybounds[HIGH][X];
@@ -278,7 +293,50 @@ Float mindist, *maxdist;
 
 	hit = FALSE;
 
-	do {
+	for (; blocks; blocks = blocks->next) {
+		mask = 0;
+		for (i = 0; i < blocks->tris.n; i++) {
+			obj = blocks->obj[i];
+#ifdef SHAREDMEM
+			if (*obj->counter < counter &&
+#else
+			if (obj->counter < counter &&
+#endif
+			    obj->bounds[LOW][X] <= hx  &&
+			    obj->bounds[HIGH][X] >= lx &&
+			    obj->bounds[LOW][Y] <= hy  &&
+			    obj->bounds[HIGH][Y] >= ly &&
+			    obj->bounds[LOW][Z] <= hz  &&
+			    obj->bounds[HIGH][Z] >= lz) {
+#ifdef SHAREDMEM
+				*obj->counter = counter;
+#else
+				obj->counter = counter;
+#endif
+				mask |= 1 << i;
+			}
+		}
+		if (mask == 0)
+			continue;
+		if (tr->kz < 0)
+			TriRaySetup(ray, tr);
+		dist = *maxdist;
+		lane = TriBlockIntersect(&blocks->tris, tr, mask,
+					 mindist, &dist, b);
+		if (lane < 0)
+			continue;
+		obj = blocks->obj[lane];
+		tri = (Triangle *)obj->obj;
+		tri->b[0] = b[0];
+		tri->b[1] = b[1];
+		tri->b[2] = b[2];
+		IntersectHit(obj, ray, hitlist, mindist, dist);
+		*maxdist = dist;
+		TriHits++;
+		hit = TRUE;
+	}
+
+	for (; list; list = list->next) {
 		obj = list->obj;
 		/*
 		 * If object's counter is greater than or equal to the
@@ -306,7 +364,7 @@ Float mindist, *maxdist;
 			if (intersect(obj, ray, hitlist, mindist, maxdist))
 				hit = TRUE;
 		}
-	} while ((list = list->next) != (GeomList *)0);
+	}
 
 	return hit;
 }
@@ -364,12 +422,19 @@ Float bounds[2][3];
 	 	 */
 		grid->cells = (GeomList ****)share_malloc(grid->xsize *
 					sizeof(GeomList ***));
+		grid->blocks = (GridBlock ****)share_malloc(grid->xsize *
+					sizeof(GridBlock ***));
 		for (x = 0; x < grid->xsize; x++) {
 			grid->cells[x] = (GeomList ***)share_malloc(grid->ysize *
 				sizeof(GeomList **));
-			for (y = 0; y < grid->ysize; y++)
+			grid->blocks[x] = (GridBlock ***)share_malloc(
+				grid->ysize * sizeof(GridBlock **));
+			for (y = 0; y < grid->ysize; y++) {
 				grid->cells[x][y] = (GeomList **)share_calloc(
 					(unsigned)grid->zsize,sizeof(GeomList *));
+				grid->blocks[x][y] = (GridBlock **)share_calloc(
+					(unsigned)grid->zsize,sizeof(GridBlock *));
+			}
 		}
 	} else {
 		/*
@@ -384,6 +449,54 @@ Float bounds[2][3];
 	 */
 	for (ltmp = grid->objects; ltmp != (Geom *)0; ltmp = ltmp->next)
 		engrid(ltmp, grid);
+
+	for (x = 0; x < grid->xsize; x++)
+		for (y = 0; y < grid->ysize; y++)
+			for (i = 0; i < grid->zsize; i++)
+				GridBlockVoxel(grid, x, y, i);
+}
+
+/*
+ * Move the untransformed triangles of a voxel, if there are at least
+ * two of them, from its object list into blocks.
+ */
+static void
+GridBlockVoxel(grid, x, y, z)
+Grid *grid;
+int x, y, z;
+{
+	GeomList **lp, *ltmp;
+	GridBlock *blk;
+	Triangle *tri;
+	int n;
+
+	n = 0;
+	for (ltmp = grid->cells[x][y][z]; ltmp; ltmp = ltmp->next)
+		if (ltmp->obj->methods == TriangleMethods() &&
+		    ltmp->obj->trans == (Trans *)NULL)
+			n++;
+	if (n < 2)
+		return;
+
+	blk = (GridBlock *)NULL;
+	for (lp = &grid->cells[x][y][z]; (ltmp = *lp) != (GeomList *)NULL; ) {
+		if (ltmp->obj->methods != TriangleMethods() ||
+		    ltmp->obj->trans != (Trans *)NULL) {
+			lp = &ltmp->next;
+			continue;
+		}
+		if (blk == (GridBlock *)NULL || blk->tris.n == TRIBLOCK_SIZE) {
+			blk = (GridBlock *)share_malloc(sizeof(GridBlock));
+			TriBlockInit(&blk->tris);
+			blk->next = grid->blocks[x][y][z];
+			grid->blocks[x][y][z] = blk;
+		}
+		tri = (Triangle *)ltmp->obj->obj;
+		blk->obj[blk->tris.n] = ltmp->obj;
+		TriBlockAdd(&blk->tris, &tri->p[0], &tri->p[1], &tri->p[2]);
+		*lp = ltmp->next;
+		free((voidstar)ltmp);
+	}
 }
 
 static void
@@ -392,6 +505,7 @@ Grid *grid;
 {
 	int x, y, z;
 	GeomList *cell, *next;
+	GridBlock *blk, *bnext;
 
 	for (x = 0; x < grid->xsize; x++) {
 		for (y = 0; y < grid->ysize; y++) {
@@ -401,6 +515,12 @@ Grid *grid;
 					free((voidstar)cell);
 				}
 				grid->cells[x][y][z] = (GeomList *)NULL;
+				for (blk = grid->blocks[x][y][z]; blk;
+				     blk = bnext) {
+					bnext = blk->next;
+					free((voidstar)blk);
+				}
+				grid->blocks[x][y][z] = (GridBlock *)NULL;
 			}
 		}
 	}
@@ -28,6 +28,8 @@
 #ifndef GRID_H
 #define GRID_H
 
+#include "triangle.h"
+
 #define GeomGridCreate(x,y,z)	GeomCreate((GeomRef)GridCreate(x,y,z), \
 					GridMethods())
 /*
@@ -43,6 +45,15 @@
 #define y2voxel(g,y)		(((y) - g->bounds[0][1]) / g->voxsize[1])
 #define z2voxel(g,z)		(((z) - g->bounds[0][2]) / g->voxsize[2])
 
+/*
+ * Run of untransformed triangles sharing a voxel, tested together.
+ */
+typedef struct GridBlock {
+	TriBlock	tris;
+	struct Geom	*obj[TRIBLOCK_SIZE];	/* triangle in each lane */
+	struct GridBlock *next;
+} GridBlock;
+
 /*
  * Grid object
  */
@@ -53,6 +64,7 @@ typedef struct {
 	struct	Geom	*unbounded,	/* unbounded objects */
 			*objects;	/* all bounded objects */
 	struct	GeomList	****cells;	/* Voxels */
+	GridBlock	****blocks;		/* triangle runs in voxels */
 } Grid;
 
 extern char	*GridName();
@@ -27,26 +27,37 @@
  */
 #include "geom.h"
 #include "hf.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef MMAP
+#include <sys/mman.h>
+#endif
 
 static Methods *iHfMethods = NULL;
 static char hfName[] = "heighfield";
 
-static void integrate_grid(), QueueTri();
-static int DDA2D(), CheckCell();
+static void integrate_grid(), HfBind(), HfWriteCache(), HfNodeTri();
+static int CheckCell(), CreateHfTriangle(), HfRead(), HfReadCache();
+static int HfLoadTiled();
+static long HfLayout(), HfArrayInit();
 static Float intHftri();
 static float minalt(), maxalt();
-
-typedef struct {
-	int stepX, stepY;
-	Float tDX, tDY;
-	float minz, maxz;
-	int outX, outY;
-	Vector cp, pDX, pDY;
-} Trav2D;
-
-hfTri *CreateHfTriangle(), *GetQueuedTri();
+static Hf *HfSetup();
 
 unsigned long HFTests, HFHits;
+static Float HfDetail;		/* footprint scale for level of detail */
+
+/*
+ * Height fields read so far.  A file named more than once is read only
+ * once, its height field being shared by every object that uses it.
+ */
+static Hf *HfList = (Hf *)NULL;
 
 Hf *
 HfCreate(filename)
@@ -54,8 +65,14 @@ char *filename;
 {
 	Hf *hf;
 	FILE *fp;
-	float val, *maxptr, *minptr;
-	int i, j;
+	HfHeader head;
+	struct stat st;
+	char *cachename;
+	int statok;
+
+	for (hf = HfList; hf; hf = hf->next)
+		if (strcmp(hf->name, filename) == 0)
+			return hf;
 
 	fp = fopen(filename, "r");
 	if (fp == (FILE *)NULL) {
@@ -64,107 +81,348 @@ char *filename;
 		return (Hf *)NULL;
 	}
 
-	hf = (Hf *)Malloc(sizeof(Hf));
+	hf = (Hf *)share_calloc(1, sizeof(Hf));
 	/*
-	 * Make the following an option someday.
+	 * Get HF size, or find that the file is already in tiled form.
 	 */
-	hf->BestSize = BESTSIZE;
+	if (fread((char *)&hf->size, sizeof(int), 1, fp) == 0) {
+		RLerror(RL_ABORT, "Cannot read height field size.\n");
+		return (Hf *)NULL;
+	}
+	if (hf->size == HF_MAGIC) {
+		rewind(fp);
+		if (fread((char *)&head, sizeof(HfHeader), 1, fp) == 0 ||
+		    !HfLoadTiled(hf, fp, &head)) {
+			RLerror(RL_ABORT, "Bad tiled height field \"%s\".\n",
+					filename);
+			return (Hf *)NULL;
+		}
+		(void)fclose(fp);
+		return HfSetup(hf, filename);
+	}
+
 	/*
-	 * Store the inverse for faster computation.
+	 * Use the tiled cache of the file if there is an up-to-date one.
 	 */
-	hf->iBestSize = 1. / (float)hf->BestSize;
+	cachename = Malloc((unsigned)(strlen(filename) +
+				strlen(HF_CACHESUFFIX) + 1));
+	sprintf(cachename, "%s%s", filename, HF_CACHESUFFIX);
+	statok = fstat(fileno(fp), &st) == 0;
+	if (statok && HfReadCache(hf, cachename, &st)) {
+		(void)fclose(fp);
+		free((voidstar)cachename);
+		return HfSetup(hf, filename);
+	}
+
 	/*
-	 * Get HF size.
+	 * Read the altitudes a row at a time into their tiles and build
+	 * the bounds at each level, then save the lot for next time.
 	 */
-	if (fread((char *)&hf->size, sizeof(int), 1, fp) == 0) {
-		RLerror(RL_ABORT, "Cannot read height field size.\n");
+	if (!HfRead(hf, fp)) {
+		RLerror(RL_ABORT, "Not enough heightfield data.\n");
 		return (Hf *)NULL;
 	}
-		
-	hf->data = (float **)share_malloc(hf->size * sizeof(float *));
+	(void)fclose(fp);
+	if (statok)
+		HfWriteCache(hf, cachename, &st);
+	free((voidstar)cachename);
+	return HfSetup(hf, filename);
+}
+
+/*
+ * Finish setting up a height field and add it to the list of those read.
+ */
+static Hf *
+HfSetup(hf, filename)
+Hf *hf;
+char *filename;
+{
+	hf->name = strsave(filename);
+
+	hf->boundbox[LOW][X] = hf->boundbox[LOW][Y] = 0;
+	hf->boundbox[HIGH][X] = hf->boundbox[HIGH][Y] = 1;
+	hf->boundbox[LOW][Z] = hf->minz;
+	hf->boundbox[HIGH][Z] = hf->maxz;
+
+	hf->next = HfList;
+	HfList = hf;
+	return hf;
+}
+
+/*
+ * Read the altitudes of a height field in the original format, the size
+ * having been read already, and compute the bounds at each level.
+ */
+static int
+HfRead(hf, fp)
+Hf *hf;
+FILE *fp;
+{
+	float val, *row;
+	int i, j;
+
+	hf->ndata = HfLayout(hf);
+	HfBind(hf, (float *)share_calloc((unsigned)hf->ndata, sizeof(float)));
+
+	hf->minz = FAR_AWAY;
+	hf->maxz = -FAR_AWAY;
+	row = (float *)Malloc((unsigned)(hf->size * sizeof(float)));
 	for (i = 0; i < hf->size; i++) {
-		hf->data[i] = (float *)share_malloc(hf->size * sizeof(float));
 		/*
 		 * Read in row of HF data.
 		 */
-		if (fread((char *)hf->data[i],sizeof(float),hf->size,fp)
+		if (fread((char *)row, sizeof(float), hf->size, fp)
 		    != hf->size) {
-			RLerror(RL_ABORT, "Not enough heightfield data.\n");
-			return (Hf *)NULL;
+			free((voidstar)row);
+			return FALSE;
 		}
 		for (j = 0; j < hf->size; j++) {
-			val = hf->data[i][j];
+			val = row[j];
 			if (val <= HF_UNSET) {
-				hf->data[i][j] = HF_UNSET;
+				HfAlt(hf, j, i) = HF_UNSET;
 				/*
 				 * Don't include the point in min/max
 				 * calculations.
 				 */
 				continue;
 			}
+			HfAlt(hf, j, i) = val;
 			if (val > hf->maxz)
 				hf->maxz = val;
 			if (val < hf->minz)
 				hf->minz = val;
 		}
 	}
-	(void)fclose(fp);
-	/*
-	 * Allocate levels of grid.  hf->levels = log base BestSize of hf->size
-	 */
-	for (i = hf->size, hf->levels = 0; i > hf->BestSize; i /= hf->BestSize,
-				hf->levels++)
-			;
-	hf->levels++;
-	hf->qsize = CACHESIZE;
-	hf->q = (hfTri **)Calloc((unsigned)hf->qsize, sizeof(hfTri *));
-	hf->qtail = 0;
+	free((voidstar)row);
 
-	hf->lsize = (int *)share_malloc(hf->levels * sizeof(int));
-	hf->spacing = (float *)share_malloc(hf->levels * sizeof(float));
-	hf->boundsmax = (float ***)share_malloc(hf->levels * sizeof(float **));
-	hf->boundsmin = (float ***)share_malloc(hf->levels * sizeof(float **));
-
-	hf->spacing[0] = hf->size -1;
-	hf->lsize[0] = (int)hf->spacing[0];
-	hf->boundsmax[0] = (float **)share_malloc(hf->lsize[0]*sizeof(float *));
-	hf->boundsmin[0] = (float **)share_malloc(hf->lsize[0]*sizeof(float *));
 	/*
 	 * Compute initial bounding boxes
 	 */
 	for (i = 0; i < hf->lsize[0]; i++) {
-		hf->boundsmax[0][i]=(float *)share_malloc(hf->lsize[0]*sizeof(float));
-		hf->boundsmin[0][i]=(float *)share_malloc(hf->lsize[0]*sizeof(float));
-		maxptr = hf->boundsmax[0][i];
-		minptr = hf->boundsmin[0][i];
 		for (j = 0; j < hf->lsize[0]; j++) {
-			*maxptr++ = maxalt(i, j, hf->data) + EPSILON;
-			*minptr++ = minalt(i, j, hf->data) - EPSILON;
+			HfArrayVal(&hf->boundsmax[0], j, i) =
+				maxalt(i, j, hf) + EPSILON;
+			HfArrayVal(&hf->boundsmin[0], j, i) =
+				minalt(i, j, hf) - EPSILON;
 		}
 	}
+	for (i = 1; i < hf->levels; i++)
+		integrate_grid(hf, i);
+	return TRUE;
+}
+
+/*
+ * Compute the number of levels of the grid and the sizes of each, and
+ * lay out the tiles of the altitudes and of the bounds at every level.
+ * Returns the number of values needed to hold them all.
+ */
+static long
+HfLayout(hf)
+Hf *hf;
+{
+	long n;
+	int i;
+
+	/*
+	 * Each level has half as many cells per side as the one below,
+	 * rounding up, the top level having but one.
+	 */
+	for (i = hf->size - 1, hf->levels = 1; i > 1; i = (i + 1) / 2,
+				hf->levels++)
+			;
+
+	hf->lsize = (int *)share_malloc(hf->levels * sizeof(int));
+	hf->boundsmax = (HfArray *)share_malloc(hf->levels * sizeof(HfArray));
+	hf->boundsmin = (HfArray *)share_malloc(hf->levels * sizeof(HfArray));
+
+	hf->lsize[0] = hf->size - 1;
+	for (i = 1; i < hf->levels; i++)
+		hf->lsize[i] = (hf->lsize[i-1] + 1) / 2;
+
+	n = HfArrayInit(&hf->alt, hf->size);
+	for (i = 0; i < hf->levels; i++) {
+		n += HfArrayInit(&hf->boundsmax[i], hf->lsize[i]);
+		n += HfArrayInit(&hf->boundsmin[i], hf->lsize[i]);
+	}
+	return n;
+}
 
-	for (i = 1; i < hf->levels; i++) {
-		hf->spacing[i] = hf->spacing[i-1] * hf->iBestSize;
-		hf->lsize[i] = (int)hf->spacing[i];
-		if ((Float)hf->lsize[i] != hf->spacing[i])
-			hf->lsize[i]++;
-		hf->boundsmax[i]=(float **)share_malloc(hf->lsize[i]*sizeof(float *));
-		hf->boundsmin[i]=(float **)share_malloc(hf->lsize[i]*sizeof(float *));
-		for (j = 0; j < hf->lsize[i]; j++) {
-			hf->boundsmax[i][j] = (float *)share_malloc(hf->lsize[i] *
-							sizeof(float));
-			hf->boundsmin[i][j] = (float *)share_malloc(hf->lsize[i] *
-							sizeof(float));
+/*
+ * Set up the table of tile offsets for a square array of the given size,
+ * numbering the tiles in Morton order.  Tiles that would lie wholly
+ * outside the array are skipped, so that no space is wasted when the
+ * number of tiles per side is not a power of two.  Returns the number
+ * of values in the array's tiles.
+ */
+static long
+HfArrayInit(a, size)
+HfArray *a;
+int size;
+{
+	long n;
+	int code, p, b, tx, ty;
+
+	a->size = size;
+	a->ntiles = (size + HF_TILEMASK) >> HF_TILEBITS;
+	a->tile = (long *)share_malloc(a->ntiles * a->ntiles * sizeof(long));
+	a->data = (float *)NULL;
+	for (p = 1; p < a->ntiles; p <<= 1)
+		;
+	n = 0;
+	for (code = 0; code < p*p; code++) {
+		tx = ty = 0;
+		for (b = 0; (1 << b) < p; b++) {
+			tx |= ((code >> (2*b)) & 1) << b;
+			ty |= ((code >> (2*b + 1)) & 1) << b;
+		}
+		if (tx < a->ntiles && ty < a->ntiles) {
+			a->tile[ty*a->ntiles + tx] = n;
+			n += HF_TILEAREA;
 		}
-		integrate_grid(hf, i);
 	}
+	return n;
+}
 
-	hf->boundbox[LOW][X] = hf->boundbox[LOW][Y] = 0;
-	hf->boundbox[HIGH][X] = hf->boundbox[HIGH][Y] = 1;
-	hf->boundbox[LOW][Z] = hf->minz;
-	hf->boundbox[HIGH][Z] = hf->maxz;
+/*
+ * Point the arrays laid out by HfLayout() at their places in the given
+ * block of values.
+ */
+static void
+HfBind(hf, data)
+Hf *hf;
+float *data;
+{
+	int i;
+
+	hf->alt.data = data;
+	data += hf->alt.ntiles * hf->alt.ntiles * HF_TILEAREA;
+	for (i = 0; i < hf->levels; i++) {
+		hf->boundsmax[i].data = data;
+		data += hf->boundsmax[i].ntiles * hf->boundsmax[i].ntiles *
+			HF_TILEAREA;
+		hf->boundsmin[i].data = data;
+		data += hf->boundsmin[i].ntiles * hf->boundsmin[i].ntiles *
+			HF_TILEAREA;
+	}
+}
 
-	return hf;
+/*
+ * Read the tiled cache of a height field, if it was made from the file
+ * described by st and from a height field of the same size.
+ */
+static int
+HfReadCache(hf, name, st)
+Hf *hf;
+char *name;
+struct stat *st;
+{
+	FILE *fp;
+	HfHeader head;
+	int ok;
+
+	fp = fopen(name, "r");
+	if (fp == (FILE *)NULL)
+		return FALSE;
+	ok = fread((char *)&head, sizeof(HfHeader), 1, fp) == 1 &&
+		head.magic == HF_MAGIC && head.size == hf->size &&
+		head.srcsize == (long)st->st_size &&
+		head.srcmtime == (long)st->st_mtime &&
+		HfLoadTiled(hf, fp, &head);
+	(void)fclose(fp);
+	return ok;
+}
+
+/*
+ * Load the tiles of a height field in tiled form, the header of which
+ * has been read.  Where possible the file is mapped rather than read,
+ * so that its pages are shared by every process rendering the height
+ * field and only those parts of it that are used are ever read in.
+ */
+static int
+HfLoadTiled(hf, fp, head)
+Hf *hf;
+FILE *fp;
+HfHeader *head;
+{
+	float *data;
+#ifdef MMAP
+	struct stat st;
+	unsigned long len;
+	char *map;
+#endif
+
+	if (head->version != HF_VERSION || head->tilebits != HF_TILEBITS ||
+	    head->size < 2)
+		return FALSE;
+	hf->size = head->size;
+	hf->ndata = HfLayout(hf);
+	if (hf->levels != head->levels)
+		return FALSE;
+	hf->minz = head->minz;
+	hf->maxz = head->maxz;
+#ifdef MMAP
+	len = sizeof(HfHeader) + hf->ndata * sizeof(float);
+	if (fstat(fileno(fp), &st) == 0 && st.st_size >= len) {
+		map = (char *)mmap((caddr_t)0, (size_t)len, PROT_READ,
+				MAP_SHARED, fileno(fp), (off_t)0);
+		if (map != (char *)MAP_FAILED) {
+			hf->map = map;
+			hf->maplen = len;
+			HfBind(hf, (float *)(map + sizeof(HfHeader)));
+			return TRUE;
+		}
+	}
+#endif
+	data = (float *)share_malloc((unsigned)(hf->ndata * sizeof(float)));
+	if (fseek(fp, (long)sizeof(HfHeader), 0) != 0 ||
+	    fread((char *)data, sizeof(float), hf->ndata, fp) != hf->ndata) {
+		free((voidstar)data);
+		return FALSE;
+	}
+	HfBind(hf, data);
+	return TRUE;
+}
+
+/*
+ * Save a height field in tiled form as the cache of the file described
+ * by st.  The cache is written under a temporary name and then renamed,
+ * so that other processes never see it half-written.  Failure is not
+ * an error; the height field will simply be read the slow way next time.
+ */
+static void
+HfWriteCache(hf, name, st)
+Hf *hf;
+char *name;
+struct stat *st;
+{
+	FILE *fp;
+	HfHeader head;
+	char *tmpname;
+	int ok;
+
+	tmpname = Malloc((unsigned)(strlen(name) + 16));
+	sprintf(tmpname, "%s.%d", name, (int)getpid());
+	fp = fopen(tmpname, "w");
+	if (fp == (FILE *)NULL) {
+		free((voidstar)tmpname);
+		return;
+	}
+	bzero((char *)&head, sizeof(HfHeader));
+	head.magic = HF_MAGIC;
+	head.version = HF_VERSION;
+	head.size = hf->size;
+	head.tilebits = HF_TILEBITS;
+	head.levels = hf->levels;
+	head.minz = hf->minz;
+	head.maxz = hf->maxz;
+	head.srcsize = (long)st->st_size;
+	head.srcmtime = (long)st->st_mtime;
+	ok = fwrite((char *)&head, sizeof(HfHeader), 1, fp) == 1 &&
+		fwrite((char *)hf->alt.data, sizeof(float), hf->ndata, fp)
+			== hf->ndata;
+	if (fclose(fp) != 0 || !ok || rename(tmpname, name) != 0)
+		(void)unlink(tmpname);
+	free((voidstar)tmpname);
 }
 
 Methods *
@@ -187,7 +445,31 @@ HfMethods()
 }
 
 /*
- * Intersect ray with height field.
+ * Set the factor by which ray footprints are scaled when deciding how
+ * finely to intersect height fields.  If 0, rays always go down to
+ * single cells.
+ */
+void
+HfSetDetail(detail)
+Float detail;
+{
+	HfDetail = detail;
+}
+
+/*
+ * Intersect ray with height field.  The cells of the height field are
+ * the leaves of a quadtree, each node of which records the range of
+ * altitudes below it.  The ray walks the tree front to back, descending
+ * into a node only if the ray's altitude over the node overlaps that
+ * range, and climbing back up as it leaves its parent, until it finds
+ * the first cell whose triangles it hits.  Nothing is cached between
+ * calls, so any number of rays may be traced at once.
+ *
+ * When a level of detail is set, a node no wider than the ray's
+ * footprint where the ray enters it is taken as a single cell, the
+ * two triangles between its corners standing in for the finer ones
+ * below, so long as it lies wholly within the height field and has no
+ * unset altitudes.
  */
 int
 HfIntersect(hf, ray, mindist, maxdist)
@@ -195,328 +477,200 @@ Hf *hf;
 Ray *ray;
 Float mindist, *maxdist;
 {
-	Vector hitpos;
-	Float offset;
-	Trav2D trav;
+	Float org[3], inv[3], t, tend, tx, ty, tnext, z0, z1, width, cell;
+	Float near;
+	int level, top, x, y, ox, oy, stepX, stepY;
 
 	HFTests++;
 
+	org[X] = ray->pos.x;
+	org[Y] = ray->pos.y;
+	org[Z] = ray->pos.z;
+	inv[X] = 1. / ray->dir.x;
+	inv[Y] = 1. / ray->dir.y;
+	inv[Z] = 1. / ray->dir.z;
 	/*
-	 * Find where we hit the hf cube.
+	 * A ray cast from a hit, such as a shadow ray, may see the surface
+	 * it starts on in other detail than the ray that found the hit.
+	 * Hits closer than its footprint there are taken to be that
+	 * surface, and ignored.
 	 */
-	VecAddScaled(ray->pos, mindist, ray->dir, &hitpos);
-	if (OutOfBounds(&hitpos, hf->boundbox)) {
-		offset = *maxdist;
-		if (!BoundsIntersect(ray, hf->boundbox, mindist, &offset))
-			return FALSE;
-		hitpos.x = ray->pos.x + ray->dir.x * offset;
-		hitpos.y = ray->pos.y + ray->dir.y * offset;
-		hitpos.z = ray->pos.z + ray->dir.z * offset;
-	} else
-		hitpos = ray->pos;
+	near = HfDetail * ray->width;
 	/*
-	 * Find out in which cell "hitpoint" is.
+	 * Find where we enter and leave the hf cube.
 	 */
-	if (equal(hitpos.x, 1.))
-		hitpos.x -= EPSILON;
-	if (equal(hitpos.y, 1.))
-		hitpos.y -= EPSILON;
-
-	if (ray->dir.x < 0.) {
-		trav.stepX = trav.outX = -1;
-		trav.tDX = -1. / (ray->dir.x * hf->spacing[hf->levels -1]);
-	} else if (ray->dir.x > 0.) {
-		trav.stepX = 1;
-		trav.outX = hf->lsize[hf->levels -1];
-		/*
-		 * (1./size) / ray
-		 */
-		trav.tDX = 1. / (ray->dir.x * hf->spacing[hf->levels -1]);
-	}
-
-	if (ray->dir.y < 0.) {
-		trav.stepY = trav.outY = -1;
-		trav.tDY = -1. / (ray->dir.y * hf->spacing[hf->levels -1]);
-	} else if (ray->dir.y > 0.) {
-		trav.stepY = 1;
-		trav.outY = hf->lsize[hf->levels -1];
-		trav.tDY = 1. / (ray->dir.y * hf->spacing[hf->levels -1]);
-	}
+	t = max(mindist, near);
+	tend = *maxdist;
+	if (!BoundsClipRayInv(org, inv, hf->boundbox, &t, &tend))
+		return FALSE;
 
-	trav.pDX.x = ray->dir.x * trav.tDX;
-	trav.pDX.y = ray->dir.y * trav.tDX;
-	trav.pDX.z = ray->dir.z * trav.tDX;
-	trav.pDY.x = ray->dir.x * trav.tDY;
-	trav.pDY.y = ray->dir.y * trav.tDY;
-	trav.pDY.z = ray->dir.z * trav.tDY;
-
-	trav.cp = hitpos;
-	trav.minz = hf->minz;
-	trav.maxz = hf->maxz;
-	if (DDA2D(hf, &ray->pos, &ray->dir, hf->levels -1, &trav, maxdist)) {
-		HFHits++;
-		return TRUE;
-	}
-	return FALSE;
-}
+	stepX = ray->dir.x < 0. ? -1 : 1;
+	stepY = ray->dir.y < 0. ? -1 : 1;
+	cell = 1. / (Float)(hf->size - 1);
+	top = hf->levels - 1;
+	level = top;
+	x = y = 0;
 
-/*
- * Traverse the grid using a modified DDA algorithm.  If the extent of
- * the ray over a cell intersects the bounding volume defined by the
- * four corners of the cell, either recurse or perform ray/surface
- * intersection test.
- */
-static int
-DDA2D(hf, pos, ray, level, trav, maxdist)
-Hf *hf;
-Vector *pos, *ray;
-int level;
-Trav2D *trav;
-Float *maxdist;
-{
-	int x, y, size, posZ;
-	float **boundsmin, **boundsmax, spacing;
-	Float tX, tY;
-	Trav2D newtrav;
-	Vector nxp, nyp;
-
-	size = hf->lsize[level];
-	spacing = hf->spacing[level];
-
-	posZ = (ray->z > 0.);
-
-	x = trav->cp.x * hf->spacing[level];
-	if (x == size)
-		x--;
-	y = trav->cp.y * hf->spacing[level];
-	if (y == size)
-		y--;
-	boundsmax = hf->boundsmax[level];
-	boundsmin = hf->boundsmin[level];
-
-	if (trav->outX > size) trav->outX = size;
-	if (trav->outY > size) trav->outY = size;
-	if (trav->outX < 0) trav->outX = -1;
-	if (trav->outY < 0) trav->outY = -1;
-
-	if (ray->x < 0.) {
-		tX = (x /spacing - trav->cp.x) / ray->x;
-	} else if (ray->x > 0.)
-		tX = ((x+1)/spacing - trav->cp.x) / ray->x;
-	else
-		tX = FAR_AWAY;
-	if (ray->y < 0.) {
-		tY = (y /spacing - trav->cp.y) / ray->y;
-	} else if (ray->y > 0.)
-		tY = ((y+1)/spacing - trav->cp.y) / ray->y;
-	else
-		tY = FAR_AWAY;
-
-	nxp.x = trav->cp.x + tX * ray->x;
-	nxp.y = trav->cp.y + tX * ray->y;
-	nxp.z = trav->cp.z + tX * ray->z;
-
-	nyp.x = trav->cp.x + tY * ray->x;
-	nyp.y = trav->cp.y + tY * ray->y;
-	nyp.z = trav->cp.z + tY * ray->z;
-
-	do {
-		if (tX < tY) {
-			if ((posZ && trav->cp.z <= boundsmax[y][x] &&
-			     nxp.z >= boundsmin[y][x]) ||
-			    (!posZ && trav->cp.z >= boundsmin[y][x] &&
-			     nxp.z <= boundsmax[y][x])) {
-				if (level) {
-					/*
-					 * Recurse -- compute constants
-					 * needed for next level.
-					 * Nicely enough, this just
-					 * involves a few multiplications.
-					 */
-					newtrav = *trav;
-					newtrav.tDX *= hf->iBestSize;
-					newtrav.tDY *= hf->iBestSize;
-					newtrav.maxz = boundsmax[y][x];
-					newtrav.minz = boundsmin[y][x];
-					if (ray->x < 0.)
-						newtrav.outX=hf->BestSize*x-1;
-					else
-						newtrav.outX=hf->BestSize*(x+1);
-					if (ray->y < 0.)
-						newtrav.outY=hf->BestSize*y-1;
-					else
-						newtrav.outY=hf->BestSize*(y+1);
-					newtrav.pDX.x *= hf->iBestSize;
-					newtrav.pDX.y *= hf->iBestSize;
-					newtrav.pDX.z *= hf->iBestSize;
-					newtrav.pDY.x *= hf->iBestSize;
-					newtrav.pDY.y *= hf->iBestSize;
-					newtrav.pDY.z *= hf->iBestSize;
-					if (DDA2D(hf,pos,ray,level-1,
-						&newtrav, maxdist))
-						return TRUE;
-				} else if (CheckCell(x,y,hf,ray,pos,maxdist))
-					return TRUE;
+	for (;;) {
+		/*
+		 * Find where the ray leaves the current node, and its
+		 * altitude over the node.
+		 */
+		width = (Float)(1 << level) * cell;
+		if (ray->dir.x > 0.)
+			tx = ((x + 1) * width - org[X]) * inv[X];
+		else if (ray->dir.x < 0.)
+			tx = (x * width - org[X]) * inv[X];
+		else
+			tx = FAR_AWAY;
+		if (ray->dir.y > 0.)
+			ty = ((y + 1) * width - org[Y]) * inv[Y];
+		else if (ray->dir.y < 0.)
+			ty = (y * width - org[Y]) * inv[Y];
+		else
+			ty = FAR_AWAY;
+		tnext = min(tx, ty);
+		if (tnext > tend)
+			tnext = tend;
+		z0 = org[Z] + t * ray->dir.z;
+		z1 = org[Z] + tnext * ray->dir.z;
+
+		if (min(z0, z1) <= HfArrayVal(&hf->boundsmax[level], x, y) &&
+		    max(z0, z1) >= HfArrayVal(&hf->boundsmin[level], x, y)) {
+			if (level && (HfDetail <= 0. ||
+			    HfDetail * RayFootprint(ray, t) < width ||
+			    ((x + 1) << level) >= hf->size ||
+			    ((y + 1) << level) >= hf->size ||
+			    HfArrayVal(&hf->boundsmin[level], x, y) <= HF_UNSET)) {
+				/*
+				 * Descend into the child the ray is in.
+				 */
+				level--;
+				width *= 0.5;
+				x = 2*x + (org[X] + t*ray->dir.x >=
+						(2*x + 1) * width);
+				y = 2*y + (org[Y] + t*ray->dir.y >=
+						(2*y + 1) * width);
+				if (x >= hf->lsize[level])
+					x = hf->lsize[level] - 1;
+				if (y >= hf->lsize[level])
+					y = hf->lsize[level] - 1;
+				continue;
 			}
-			x += trav->stepX;		/* Move in X */
-			if (*maxdist < tX || x == trav->outX)
-				/* If outside, quit */
-				return FALSE;
-			tX += trav->tDX;	/* Update position on ray */
-			trav->cp = nxp;		/* cur pos gets next pos */
-			nxp.x += trav->pDX.x;	/* Compute next pos */
-			nxp.y += trav->pDX.y;
-			nxp.z += trav->pDX.z;
-		} else {
-			if ((posZ && trav->cp.z <= boundsmax[y][x] &&
-			     nyp.z >= boundsmin[y][x]) ||
-			    (!posZ && trav->cp.z >= boundsmin[y][x] &&
-			     nyp.z <= boundsmax[y][x])) {
-				if (level) {
-					/* Recurse */
-					newtrav = *trav;
-					newtrav.tDX *= hf->iBestSize;
-					newtrav.tDY *= hf->iBestSize;
-					newtrav.maxz = boundsmax[y][x];
-					newtrav.minz = boundsmin[y][x];
-					if (ray->x < 0.)
-						newtrav.outX=hf->BestSize*x-1;
-					else
-						newtrav.outX=hf->BestSize*(x+1);
-					if (ray->y < 0.)
-						newtrav.outY=hf->BestSize*y-1;
-					else
-						newtrav.outY=hf->BestSize*(y+1);
-					newtrav.pDX.x *= hf->iBestSize;
-					newtrav.pDX.y *= hf->iBestSize;
-					newtrav.pDX.z *= hf->iBestSize;
-					newtrav.pDY.x *= hf->iBestSize;
-					newtrav.pDY.y *= hf->iBestSize;
-					newtrav.pDY.z *= hf->iBestSize;
-					if (DDA2D(hf,pos,ray,level-1,
-							&newtrav, maxdist))
-						return TRUE;
-				} else if (CheckCell(x,y,hf,ray,pos,maxdist))
-					return TRUE;
+			if (CheckCell(x << level, y << level, 1 << level, hf,
+			    &ray->dir, &ray->pos, near, maxdist)) {
+				HFHits++;
+				return TRUE;
 			}
-			y += trav->stepY;
-			if (*maxdist < tY || y == trav->outY)
-				return FALSE;
-			tY += trav->tDY;
-			trav->cp = nyp;
-			nyp.x += trav->pDY.x;
-			nyp.y += trav->pDY.y;
-			nyp.z += trav->pDY.z;
 		}
-	} while ((trav->cp.x <= 1. && trav->cp.y <= 1.) &&
-		 ((posZ && trav->cp.z <= trav->maxz) ||
-		 (!posZ && trav->cp.z >= trav->minz)));
 
 		/*
-		 * while ((we're inside the horizontal bounding box)
-		 *		(usually caught by outX & outY, but
-		 *		 it's possible to go "too far" due to
-		 *		 the fact that our levels of grids do
-		 *		 not "nest" exactly if gridsize%BestSize != 0)
-		 *	  and
-		 *	  ((if ray->z is positive and we haven't gone through
-		 *	   the upper bounding plane) or
-		 *	  (if ray->z is negative and we haven't gone through
-		 *	   the lower bounding plane)));
+		 * Move on to the next node at this level, then climb to
+		 * the coarsest level whose node we have newly entered.
 		 */
-
-	return FALSE;
+		if (tnext >= tend)
+			return FALSE;
+		t = tnext;
+		ox = x;
+		oy = y;
+		if (tx <= ty)
+			x += stepX;
+		else
+			y += stepY;
+		if (x < 0 || y < 0 || x >= hf->lsize[level] ||
+		    y >= hf->lsize[level])
+			return FALSE;
+		while (level < top && ((x >> 1) != (ox >> 1) ||
+				       (y >> 1) != (oy >> 1))) {
+			x >>= 1;
+			y >>= 1;
+			ox >>= 1;
+			oy >>= 1;
+			level++;
+		}
+	}
 }
 
 /*
- * Check for ray/cell intersection
+ * Check for intersection of the ray with the square of the given width,
+ * in cells, whose lower-left corner is at (x, y), no nearer than 'near'.
  */
 static int
-CheckCell(x, y, hf, ray, pos, maxdist)
-int x, y;
+CheckCell(x, y, w, hf, ray, pos, near, maxdist)
+int x, y, w;
 Hf *hf;
 Vector *ray, *pos;
-Float *maxdist;
+Float near, *maxdist;
 {
-	hfTri *tri1, *tri2;
+	hfTri tri;
 	Float d1, d2;
 
 	d1 = d2 = FAR_AWAY;
 
-	if (tri1 = CreateHfTriangle(hf, x, y, x+1, y, x, y+1, TRI1))
-		d1 = intHftri(ray, pos, tri1);
-	if (tri2 = CreateHfTriangle(hf, x+1, y, x+1, y+1, x, y+1, TRI2))
-		d2 = intHftri(ray, pos, tri2);
-
-	if (d1 == FAR_AWAY && d2 == FAR_AWAY)
-		return FALSE;
-
-	if (d1 < d2) {
-		if (d1 < *maxdist) {
-			hf->hittri = *tri1;
-			*maxdist = d1;
-			return TRUE;
-		}
-		return FALSE;
-	}
-
-	if (d2 < *maxdist) {
-		hf->hittri = *tri2;
-		*maxdist = d2;
+	if (CreateHfTriangle(hf, x, y, x+w, y, x, y+w, TRI1, &tri))
+		d1 = intHftri(ray, pos, &tri);
+	if (CreateHfTriangle(hf, x+w, y, x+w, y+w, x, y+w, TRI2, &tri))
+		d2 = intHftri(ray, pos, &tri);
+	if (d1 < near)
+		d1 = FAR_AWAY;
+	if (d2 < near)
+		d2 = FAR_AWAY;
+
+	if (d2 < d1)
+		d1 = d2;
+	if (d1 < *maxdist) {
+		*maxdist = d1;
 		return TRUE;
 	}
 	return FALSE;
 }
 
-static hfTri *
-CreateHfTriangle(hf, x1, y1, x2, y2, x3, y3, which)
+/*
+ * Compute the given triangle of a cell.
+ */
+static int
+CreateHfTriangle(hf, x1, y1, x2, y2, x3, y3, which, tri)
 Hf *hf;
 int x1, y1, x2, y2, x3, y3, which;
+hfTri *tri;
 {
-	hfTri *tri;
-	Float xid, yid;
 	Vector tmp1, tmp2;
 
 	/*
 	 * Don't use triangles with "unset" vertices.
 	 */
-	if (hf->data[y1][x1] == HF_UNSET ||
-	    hf->data[y2][x2] == HF_UNSET ||
-	    hf->data[y3][x3] == HF_UNSET)
-		return (hfTri *)0;
-
-	xid = (Float)x1 / (Float)(hf->size -1);
-	yid = (Float)y1 / (Float)(hf->size -1);
-
-	if ((tri = GetQueuedTri(hf, xid, yid, which)) != (hfTri *)0)
-		return tri;
-
-	tri = (hfTri *)Malloc(sizeof(hfTri));
+	if (HfAlt(hf, x1, y1) == HF_UNSET ||
+	    HfAlt(hf, x2, y2) == HF_UNSET ||
+	    HfAlt(hf, x3, y3) == HF_UNSET)
+		return FALSE;
 
 	tri->type = which;
-	tri->v1.x = xid;
-	tri->v1.y = yid;
-	tri->v1.z = hf->data[y1][x1];
+	tri->v1.x = (Float)x1 / (Float)(hf->size-1);
+	tri->v1.y = (Float)y1 / (Float)(hf->size-1);
+	tri->v1.z = HfAlt(hf, x1, y1);
 	tri->v2.x = (Float)x2 / (Float)(hf->size-1);
 	tri->v2.y = (Float)y2 / (Float)(hf->size-1);
-	tri->v2.z = hf->data[y2][x2];
+	tri->v2.z = HfAlt(hf, x2, y2);
 	tri->v3.x = (Float)x3 / (Float)(hf->size-1);
 	tri->v3.y = (Float)y3 / (Float)(hf->size-1);
-	tri->v3.z = hf->data[y3][x3];
+	tri->v3.z = HfAlt(hf, x3, y3);
 
-	tmp1.x = tri->v2.x - tri->v1.x;
-	tmp1.y = tri->v2.y - tri->v1.y;
-	tmp1.z = tri->v2.z - tri->v1.z;
-	tmp2.x = tri->v3.x - tri->v1.x;
-	tmp2.y = tri->v3.y - tri->v1.y;
-	tmp2.z = tri->v3.z - tri->v1.z;
+	/*
+	 * Find the normal from the edges measured in cells, rather than
+	 * in units of the whole field, lest the cells of a large field be
+	 * so small that their cross product is taken to be zero.
+	 */
+	tmp1.x = (Float)(x2 - x1);
+	tmp1.y = (Float)(y2 - y1);
+	tmp1.z = (tri->v2.z - tri->v1.z) * (Float)(hf->size-1);
+	tmp2.x = (Float)(x3 - x1);
+	tmp2.y = (Float)(y3 - y1);
+	tmp2.z = (tri->v3.z - tri->v1.z) * (Float)(hf->size-1);
 
 	(void)VecNormCross(&tmp1, &tmp2, &tri->norm);
 
 	tri->d = -dotp(&tri->v1, &tri->norm);
-
-	QueueTri(hf, tri);
-	return tri;
+	return TRUE;
 }
 
 /*
@@ -554,18 +708,80 @@ Vector *pos, *ray;
 }
 
 /*
- * Compute normal to height field.
+ * Compute normal to height field at the point hit, that of whichever
+ * triangle pos lies in of the node that was hit -- a single cell
+ * unless a coarser level of detail was used.  As nothing is recorded
+ * of the hit, the node is found again from pos: it is the one, of
+ * those containing pos that HfIntersect() may stop at, on whose
+ * triangle pos lies most nearly.  The finest such node wins ties,
+ * as where the triangles of several levels are coplanar.
  */
-/*ARGSUSED*/
 int
 HfNormal(hf, pos, nrm, gnrm)
 Hf *hf;
 Vector *pos, *nrm, *gnrm;
 {
-	*gnrm = *nrm = hf->hittri.norm;
+	hfTri tri, best;
+	Float fx, fy, err, besterr;
+	int level, x, y;
+
+	fx = pos->x * (Float)(hf->size - 1);
+	fy = pos->y * (Float)(hf->size - 1);
+	x = (int)fx;
+	y = (int)fy;
+	if (x < 0)
+		x = 0;
+	else if (x > hf->size - 2)
+		x = hf->size - 2;
+	if (y < 0)
+		y = 0;
+	else if (y > hf->size - 2)
+		y = hf->size - 2;
+	HfNodeTri(hf, fx, fy, x, y, 1, &best);
+	besterr = fabs(dotp(&best.norm, pos) + best.d);
+	for (level = 1; HfDetail > 0. && level < hf->levels; level++) {
+		/*
+		 * Nodes HfIntersect() never stops at have no coarser
+		 * ancestors that it does.
+		 */
+		x >>= 1;
+		y >>= 1;
+		if (((x + 1) << level) >= hf->size ||
+		    ((y + 1) << level) >= hf->size ||
+		    HfArrayVal(&hf->boundsmin[level], x, y) <= HF_UNSET)
+			break;
+		HfNodeTri(hf, fx, fy, x << level, y << level, 1 << level,
+				&tri);
+		err = fabs(dotp(&tri.norm, pos) + tri.d);
+		if (err < besterr) {
+			best = tri;
+			besterr = err;
+		}
+	}
+	*gnrm = *nrm = best.norm;
 	return FALSE;
 }
 
+/*
+ * Compute the triangle of the square of the given width, in cells,
+ * whose lower-left corner is at (x, y), that the point (fx, fy), in
+ * cells, lies in.
+ */
+static void
+HfNodeTri(hf, fx, fy, x, y, w, tri)
+Hf *hf;
+Float fx, fy;
+int x, y, w;
+hfTri *tri;
+{
+	if (fx - x + fy - y <= (Float)w) {
+		if (!CreateHfTriangle(hf, x, y, x+w, y, x, y+w, TRI1, tri))
+			(void)CreateHfTriangle(hf, x+w, y, x+w, y+w, x, y+w,
+						TRI2, tri);
+	} else if (!CreateHfTriangle(hf, x+w, y, x+w, y+w, x, y+w, TRI2, tri))
+		(void)CreateHfTriangle(hf, x, y, x+w, y, x, y+w, TRI1, tri);
+}
+
 /*ARGSUSED*/
 void
 HfUV(hf, pos, norm, uv, dpdu, dpdv)
@@ -601,89 +817,43 @@ Float bounds[2][3];
 }
 
 /*
- * Build min/max altitude value arrays for the given grid level.
+ * Build min/max altitude value arrays for the given grid level from
+ * the 2x2 blocks of nodes of the level below.
  */
 static void
 integrate_grid(hf, level)
 Hf *hf;
 int level;
 {
-	int i, j, k, l, ii, ji;
-	float max_alt, min_alt;
-	float **maxinto, **mininto, **frommax, **frommin, *minptr, *maxptr;
-	int insize, fromsize, fact;
+	int i, j, k, l, insize, fromsize;
+	float max_alt, min_alt, val;
+	HfArray *maxinto, *mininto, *frommax, *frommin;
 
-	maxinto = hf->boundsmax[level];
-	mininto = hf->boundsmin[level];
+	maxinto = &hf->boundsmax[level];
+	mininto = &hf->boundsmin[level];
 	insize = hf->lsize[level];
-	frommax = hf->boundsmax[level-1];
-	frommin = hf->boundsmin[level-1];
-	fact = hf->BestSize;
+	frommax = &hf->boundsmax[level-1];
+	frommin = &hf->boundsmin[level-1];
 	fromsize = hf->lsize[level-1];
 
-	ii = 0;
-
 	for (i = 0; i < insize; i++) {
-		ji = 0;
 		for (j = 0; j < insize; j++) {
 			max_alt = HF_UNSET;
 			min_alt = -HF_UNSET;
-			for (k = 0; k <= fact; k++) {
-				if (ii+k >= fromsize)
-					continue;
-				maxptr = &frommax[ii+k][ji];
-				minptr = &frommin[ii+k][ji];
-				for (l = 0; l <= fact; l++,maxptr++,minptr++) {
-					if (ji+l >= fromsize)
-						continue;
-					if (*maxptr > max_alt)
-						max_alt = *maxptr;
-					if (*minptr < min_alt)
-						min_alt = *minptr;
+			for (k = 2*i; k < 2*i + 2 && k < fromsize; k++) {
+				for (l = 2*j; l < 2*j + 2 && l < fromsize; l++) {
+					val = HfArrayVal(frommax, l, k);
+					if (val > max_alt)
+						max_alt = val;
+					val = HfArrayVal(frommin, l, k);
+					if (val < min_alt)
+						min_alt = val;
 				}
 			}
-			maxinto[i][j] = max_alt + EPSILON;
-			mininto[i][j] = min_alt - EPSILON;
-			ji += fact;
+			HfArrayVal(maxinto, j, i) = max_alt;
+			HfArrayVal(mininto, j, i) = min_alt;
 		}
-		ii += fact;
-	}
-}
-
-/*
- * Place the given triangle in the triangle cache.
- */
-static void
-QueueTri(hf, tri)
-Hf *hf;
-hfTri *tri;
-{
-	if (hf->q[hf->qtail])		/* Free old triangle data */
-		free((voidstar)hf->q[hf->qtail]);
-	hf->q[hf->qtail] = tri;		/* Put on tail */
-	hf->qtail = (hf->qtail + 1) % hf->qsize;	/* Increment tail */
-}
-
-/*
- * Search list of cached trianges to see if this triangle has been
- * cached.  If so, return a pointer to it.  If not, return null pointer.
- */
-static hfTri *
-GetQueuedTri(hf, x, y, flag)
-Hf *hf;
-Float x, y;
-int flag;
-{
-	register int i;
-	register hfTri **tmp;
-
-	for (i = 0, tmp = hf->q; i < hf->qsize; i++, tmp++) {
-		if (*tmp && (*tmp)->v1.x == x && (*tmp)->v1.y == y &&
-		    (*tmp)->type == flag)
-			return *tmp;	/* vertices & flag match, return it */
 	}
-
-	return (hfTri *)0;
 }
 
 /*
@@ -691,15 +861,15 @@ int flag;
  * as a macro, but many C compliers will choke on it.
  */
 static float
-minalt(y,x,data)
+minalt(y,x,hf)
 int x, y;
-float **data;
+Hf *hf;
 {
 	float  min_alt;
 
-	min_alt = min(data[y][x], data[y+1][x]);
-	min_alt = min(min_alt, data[y][x+1]);
-	min_alt = min(min_alt, data[y+1][x+1]);
+	min_alt = min(HfAlt(hf, x, y), HfAlt(hf, x, y+1));
+	min_alt = min(min_alt, HfAlt(hf, x+1, y));
+	min_alt = min(min_alt, HfAlt(hf, x+1, y+1));
 	return min_alt;
 }
 
@@ -707,15 +877,15 @@ float **data;
  * Return maximum cell height, as above.
  */
 static float
-maxalt(y,x,data)
+maxalt(y,x,hf)
 int x, y;
-float **data;
+Hf *hf;
 {
 	float  max_alt;
 
-	max_alt = max(data[y][x], data[y+1][x]);
-	max_alt = max(max_alt, data[y][x+1]);
-	max_alt = max(max_alt, data[y+1][x+1]);
+	max_alt = max(HfAlt(hf, x, y), HfAlt(hf, x, y+1));
+	max_alt = max(max_alt, HfAlt(hf, x+1, y));
+	max_alt = max(max_alt, HfAlt(hf, x+1, y+1));
 	return max_alt;
 }
 
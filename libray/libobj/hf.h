@@ -37,18 +37,24 @@
  */
 #define HF_UNSET		(-1000.)
 /*
- * Number of datapoints in a single cell.  If you've got loads of memory,
- * decrease this number.  The 'optimal' number is quite system-dependent,
- * but something around 20 seems to work well. For systems without much
- * memory, this constant should be greater than or equal to the largest
- * height field which will be rendered, thus making the algorithm
- * non-hierarchical.
+ * Altitudes and the min/max bounds of each level are stored as square
+ * tiles of HF_TILE x HF_TILE values, the tiles laid out one after
+ * another in Morton (Z) order so that the values around a ray's path
+ * are close together in memory whichever way the ray runs.
  */
-#define BESTSIZE		16
+#define HF_TILEBITS		4
+#define HF_TILE			(1 << HF_TILEBITS)
+#define HF_TILEMASK		(HF_TILE - 1)
+#define HF_TILEAREA		(HF_TILE * HF_TILE)
 /*
- * Size of triangle cache.
+ * A height field read from a file in the original format is cached
+ * in tiled form, with its bounds, in a file of the same name with
+ * HF_CACHESUFFIX appended.  A file in tiled form begins with HF_MAGIC
+ * and may itself be named as a height field.
  */
-#define CACHESIZE		6
+#define HF_CACHESUFFIX		".tiled"
+#define HF_MAGIC		0x52534846	/* "RSHF" */
+#define HF_VERSION		2
 /*
  * Used to differentiate between the two triangles used to represent a cell:
  *	a------d
@@ -67,32 +73,55 @@ typedef struct hfTri {
 	Vector v1, v2, v3, norm;
 	Float d;
 	char type;
-	struct hfTri *next, *prev;
 } hfTri;
 
+/*
+ * Square array of values stored as tiles.
+ */
 typedef struct {
-	int len;
-	hfTri *head, *tail;
-} TriQueue;
+	float *data;		/* tiles, in Morton order */
+	long *tile;		/* offset into data of each tile, row by row */
+	int size, ntiles;	/* values and tiles per side */
+} HfArray;
 
+#define HfArrayVal(a,x,y)	((a)->data[(a)->tile[((y) >> HF_TILEBITS) * \
+				(a)->ntiles + ((x) >> HF_TILEBITS)] + \
+				(((y) & HF_TILEMASK) << HF_TILEBITS) + \
+				((x) & HF_TILEMASK)])
+
+/*
+ * Header of a height field file in tiled form.  It is followed by the
+ * tiles of altitudes, then those of boundsmax and boundsmin for each
+ * level in turn.  When the file is a cache, srcsize and srcmtime are
+ * those of the file from which it was made.
+ */
 typedef struct {
-	float **data;		/* Altitude points */
+	int magic, version;
+	int size, tilebits, levels;
+	float minz, maxz;
+	long srcsize, srcmtime;
+} HfHeader;
+
+typedef struct Hf {
+	char *name;		/* file from which it was read */
+	HfArray alt;		/* Altitude points */
+	long ndata;		/* # of values in alt and all bounds */
 	float minz, maxz;
-	int size, *lsize;	/* # of points/side */
-	int BestSize; 		/* "best" division size */
-	float iBestSize;	/* inverse of above (for faster computation) */
-	int levels;		/* log base BestSize of size */
-	float ***boundsmax;	/* high data values at various resolutions. */
-	float ***boundsmin;
-	float *spacing;
-	hfTri hittri, **q;	/* hit triangle and triangle cache */
-	int qtail, qsize;	/* end and length of cache */
+	int size, *lsize;	/* # of points, and of cells at each level/side */
+	int levels;		/* 1 + log base 2 of # of cells/side */
+	HfArray *boundsmax;	/* high data values at various resolutions. */
+	HfArray *boundsmin;
 	Float boundbox[2][3];	/* bounding box of Hf */
+	char *map;		/* mapped tiled file, or NULL */
+	unsigned long maplen;	/* length of above */
+	struct Hf *next;	/* next height field read */
 } Hf;
 
+#define HfAlt(h,x,y)		HfArrayVal(&(h)->alt, x, y)
+
 extern Hf	*HfCreate();
 extern int	HfIntersect(), HfEnter(), HfNormal();
-extern void	HfBounds(), HfUV(), HfStats();
+extern void	HfBounds(), HfUV(), HfStats(), HfSetDetail();
 extern char	*HfName();
 extern Methods	*HfMethods();
 
@@ -45,7 +45,7 @@ Ray *ray;				/* Ray origin, direction. */
 HitList *hitlist;			/* Intersection path */
 Float mindist, *maxdist;
 {
-	Ray newray;
+	Ray newray, *rp;
 	Vector vtmp;
 	Trans *curtrans;	
 	Float distfact, nmindist, nmaxdist;
@@ -64,12 +64,13 @@ Float mindist, *maxdist;
 		}
 	}
 
-	newray = *ray;
+	rp = ray;
 	nmindist = mindist;
 	nmaxdist = *maxdist;
 
 	/*
-	 * Transform the ray if necessary.
+	 * Transform the ray if necessary.  Otherwise, the
+	 * given ray is passed down as is.
 	 */
 	if (obj->trans != (Trans *)0) {
 		/*
@@ -86,6 +87,8 @@ Float mindist, *maxdist;
 		 * We save the amount the ray is "stretched" and later
 		 * divide the computed distance by this amount.
 		 */
+		newray = *ray;
+		rp = &newray;
 		distfact = 1.;
 		for (curtrans = obj->transtail; curtrans; 
 		     curtrans = curtrans->prev)
@@ -106,22 +109,27 @@ Float mindist, *maxdist;
 		 * Aggregate
 		 */
 		if (!(*obj->methods->intersect)
-		     (obj->obj, &newray, hitlist, nmindist, &nmaxdist))
+		     (obj->obj, rp, hitlist, nmindist, &nmaxdist))
 		return FALSE;
 	} else {
 		/*
 		 * Primitive
 		 */
 		if (!(*obj->methods->intersect)
-		      (obj->obj, &newray, nmindist, &nmaxdist))
+		      (obj->obj, rp, nmindist, &nmaxdist))
 			return FALSE;
+		/*
+		 * The ray in primitive space is needed for shading.
+		 */
 		hitlist->nodes = 0;
+		hitlist->ray = *rp;
+		hitlist->mindist = nmindist;
 	}
 
 	/*
-	 * Had a hit -- add ray, distance and object to tail of hitlist.
+	 * Had a hit -- add distance and object to tail of hitlist.
 	 */
-	AddToHitList(hitlist, &newray, nmindist, nmaxdist, obj);
+	AddToHitList(hitlist, nmaxdist, obj);
 
 	/*
 	 * Set dist to distance to intersection point from the origin
@@ -135,35 +143,67 @@ Float mindist, *maxdist;
 	return TRUE;
 }
 
+/*
+ * Record a hit at distance dist along ray with the primitive obj,
+ * which has no transformation and which the caller has already
+ * intersected by other means, just as intersect() would have.
+ */
+void
+IntersectHit(obj, ray, hitlist, mindist, dist)
+Geom *obj;
+Ray *ray;
+HitList *hitlist;
+Float mindist, dist;
+{
+	obj->timenow = ray->time;
+	hitlist->nodes = 0;
+	hitlist->ray = *ray;
+	hitlist->mindist = mindist;
+	AddToHitList(hitlist, dist, obj);
+}
+
+/*
+ * Only the object and distance are recorded; many of the hits found
+ * during traversal are replaced by closer ones before shading.  The
+ * object's total transformation is found when needed by HitTrans().
+ */
 static void
-AddToHitList(hitlist, ray, mind, dist, obj)
+AddToHitList(hitlist, dist, obj)
 HitList *hitlist;
-Ray *ray;
-Float mind, dist;
+Float dist;
 Geom *obj;
 {
 	HitNode *np;
-	Trans *list;
 
 	np = &hitlist->data[hitlist->nodes++];
 
-	np->ray = *ray;
 	np->obj = obj;
-	np->mindist = mind;
 	np->dist = dist;
 	np->enter = 0;
+	np->dotrans = obj->trans != (Trans *)0;
+}
 
-	if (obj->trans) {
-		/*
-		 * Compute total transformation, forward and inverse,
-		 * for this object, and store in hitlist for use later.
-		 */
-		TransCopy(obj->trans, &np->trans);
-		for (list = obj->trans->next; list; list = list->next)
-			TransCompose(&np->trans, list, &np->trans);
-		np->dotrans = TRUE;
-	} else
-		np->dotrans = FALSE;
+/*
+ * Return total transformation, forward and inverse, for the
+ * object in the given hitlist node.  The object's transformation
+ * is returned as is, unless it is animated and made up of a list
+ * of transformations, in which case the list is composed into 'tmp'.
+ * As with the object's own transformation, the result is valid only
+ * until the object is intersected with a ray at a different time.
+ */
+Trans *
+HitTrans(np, tmp)
+HitNode *np;
+Trans *tmp;
+{
+	Trans *list;
+
+	if (np->obj->trans->next == (Trans *)0)
+		return np->obj->trans;
+	TransCopy(np->obj->trans, tmp);
+	for (list = np->obj->trans->next; list; list = list->next)
+		TransCompose(tmp, list, tmp);
+	return tmp;
 }
 
 /*
@@ -0,0 +1,457 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "geom.h"
+#include "triangle.h"
+#include "mesh.h"
+
+static Methods *iMeshMethods = NULL;
+static char meshName[] = "mesh";
+
+unsigned long MeshTests, MeshHits;
+
+static int MeshFaceSetup();
+static void MeshFaceBounds();
+
+/*
+ * Create a mesh from the given vertex and face lists, freeing the
+ * lists as we go.  If every vertex carries a normal, the mesh is
+ * Phong-shaded; if every vertex carries uv coordinates, they are
+ * interpolated across each face.  Faces are set up as TriangleCreate()
+ * would set up the corresponding triangles and intersected with the
+ * same arithmetic, so that a mesh renders just as the equivalent
+ * list of triangles.
+ */
+Mesh *
+MeshCreate(vlist, nverts, flist, nfaces, flipflag)
+MeshVertList *vlist;
+MeshFaceList *flist;
+int nverts, nfaces, flipflag;
+{
+	Mesh *mesh;
+	MeshVertList *vp, *vtmp;
+	MeshFaceList *fp, *ftmp;
+	MeshFace *faces;
+	Float (*box)[2][3];
+	int i, j, flags, partial, nbad, nflipped, *idx;
+	char *bad;
+	Vector p[3];
+	Vec2d t[3];
+
+	if (nverts < 3 || nfaces < 1) {
+		RLerror(RL_WARN, "Degenerate mesh.\n");
+		for (vp = vlist; vp != (MeshVertList *)NULL; vp = vtmp) {
+			vtmp = vp->next;
+			free((voidstar)vp);
+		}
+		for (fp = flist; fp != (MeshFaceList *)NULL; fp = ftmp) {
+			ftmp = fp->next;
+			free((voidstar)fp);
+		}
+		return (Mesh *)NULL;
+	}
+
+	/*
+	 * Copy the vertex list into arrays, noting which of normals
+	 * and uv coordinates were given for every vertex.
+	 */
+	mesh = (Mesh *)share_malloc(sizeof(Mesh));
+	mesh->nverts = nverts;
+	mesh->verts = (Vector *)Malloc((unsigned)(nverts*sizeof(Vector)));
+	mesh->norms = (Vector *)Malloc((unsigned)(nverts*sizeof(Vector)));
+	mesh->uv = (Vec2d *)Malloc((unsigned)(nverts*sizeof(Vec2d)));
+	flags = MESH_NORMAL | MESH_UV;
+	partial = 0;
+	i = nverts - 1;
+	for (vp = vlist; vp != (MeshVertList *)NULL; vp = vtmp) {
+		mesh->verts[i] = vp->pos;
+		mesh->norms[i] = vp->norm;
+		mesh->uv[i] = vp->uv;
+		flags &= vp->flags;
+		partial |= vp->flags;
+		i--;
+		vtmp = vp->next;
+		free((voidstar)vp);
+	}
+
+	/*
+	 * Likewise for the faces, which end up in the order given.
+	 */
+	idx = (int *)Malloc((unsigned)(3*nfaces*sizeof(int)));
+	i = nfaces - 1;
+	for (fp = flist; fp != (MeshFaceList *)NULL; fp = ftmp) {
+		idx[3*i] = fp->v[0];
+		idx[3*i+1] = fp->v[1];
+		idx[3*i+2] = fp->v[2];
+		i--;
+		ftmp = fp->next;
+		free((voidstar)fp);
+	}
+
+	if (partial & ~flags & MESH_NORMAL)
+		RLerror(RL_WARN,
+			"Not every mesh vertex has a normal; using flat shading.\n");
+	if (partial & ~flags & MESH_UV)
+		RLerror(RL_WARN,
+			"Not every mesh vertex has uv; using default mapping.\n");
+
+	/*
+	 * Normalize (and perhaps flip) the vertex normals, as
+	 * TriangleCreate() does.  Faces touching a vertex whose normal
+	 * is degenerate are dropped.
+	 */
+	bad = (char *)Calloc((unsigned)nverts, sizeof(char));
+	if (flags & MESH_NORMAL) {
+		mesh->type = PHONGTRI;
+		nbad = 0;
+		for (i = 0; i < nverts; i++) {
+			if (VecNormalize(&mesh->norms[i]) == 0.) {
+				bad[i] = TRUE;
+				nbad++;
+			} else if (flipflag)
+				VecScale(-1, mesh->norms[i], &mesh->norms[i]);
+		}
+		if (nbad)
+			RLerror(RL_WARN, "%d degenerate vertex normal%s.\n",
+				nbad, nbad == 1 ? "" : "s");
+	} else {
+		mesh->type = FLATTRI;
+		free((voidstar)mesh->norms);
+		mesh->norms = (Vector *)NULL;
+	}
+	if (!(flags & MESH_UV)) {
+		free((voidstar)mesh->uv);
+		mesh->uv = (Vec2d *)NULL;
+	}
+
+	/*
+	 * Set up the faces, discarding bad ones.
+	 */
+	mesh->faces = (MeshFace *)Malloc((unsigned)(nfaces*sizeof(MeshFace)));
+	mesh->nfaces = 0;
+	nflipped = 0;
+	for (i = 0; i < nfaces; i++) {
+		for (j = 0; j < 3; j++) {
+			if (idx[3*i+j] < 0 || idx[3*i+j] >= nverts) {
+				RLerror(RL_WARN,
+				    "Mesh face %d: no vertex %d (%d vertices).\n",
+				    i, idx[3*i+j], nverts);
+				break;
+			}
+			if (bad[idx[3*i+j]])
+				break;
+			mesh->faces[mesh->nfaces].v[j] = idx[3*i+j];
+		}
+		if (j < 3)
+			continue;
+		if (MeshFaceSetup(mesh, &mesh->faces[mesh->nfaces], flipflag,
+				  &nflipped))
+			mesh->nfaces++;
+	}
+	free((voidstar)idx);
+	free((voidstar)bad);
+
+	if (nflipped)
+		RLerror(RL_ADVISE, "%d inconsistant mesh face normal%s.\n",
+			nflipped, nflipped == 1 ? "" : "s");
+
+	if (mesh->nfaces == 0) {
+		RLerror(RL_WARN, "Degenerate mesh.\n");
+		free((voidstar)mesh->verts);
+		if (mesh->norms)
+			free((voidstar)mesh->norms);
+		if (mesh->uv)
+			free((voidstar)mesh->uv);
+		free((voidstar)mesh->faces);
+		return (Mesh *)NULL;
+	}
+
+	/*
+	 * Build the face hierarchy and store the faces in the order of
+	 * its leaves.  The uv axes are computed afterwards.
+	 */
+	box = (Float (*)[2][3])Malloc((unsigned)
+			(mesh->nfaces*sizeof(Float [2][3])));
+	for (i = 0; i < mesh->nfaces; i++)
+		MeshFaceBounds(mesh, &mesh->faces[i], box[i]);
+	idx = (int *)Malloc((unsigned)(mesh->nfaces*sizeof(int)));
+	mesh->nodes = BoundsTreeBuild(box, mesh->nfaces, MESH_LEAFSIZE, idx,
+				      &mesh->nnodes);
+	faces = (MeshFace *)Malloc((unsigned)(mesh->nfaces*sizeof(MeshFace)));
+	for (i = 0; i < mesh->nfaces; i++)
+		faces[i] = mesh->faces[idx[i]];
+	free((voidstar)mesh->faces);
+	mesh->faces = faces;
+	free((voidstar)idx);
+	free((voidstar)box);
+
+	if (mesh->uv) {
+		mesh->dpdu = (Vector *)Malloc((unsigned)
+				(mesh->nfaces*sizeof(Vector)));
+		mesh->dpdv = (Vector *)Malloc((unsigned)
+				(mesh->nfaces*sizeof(Vector)));
+		for (i = 0; i < mesh->nfaces; i++) {
+			for (j = 0; j < 3; j++) {
+				p[j] = mesh->verts[mesh->faces[i].v[j]];
+				t[j] = mesh->uv[mesh->faces[i].v[j]];
+			}
+			TriangleSetdPdUV(p, t, &mesh->dpdu[i], &mesh->dpdv[i]);
+		}
+	} else
+		mesh->dpdu = mesh->dpdv = (Vector *)NULL;
+
+	mesh->hit = 0;
+	return mesh;
+}
+
+/*
+ * Compute the normal and scaled first edge of a face, mirroring
+ * TriangleCreate().  Returns FALSE if the face is degenerate.
+ */
+static int
+MeshFaceSetup(mesh, face, flipflag, nflipped)
+Mesh *mesh;
+MeshFace *face;
+int flipflag, *nflipped;
+{
+	Vector *p1, *p2, *p3, e1, ptmp, anorm;
+
+	p1 = &mesh->verts[face->v[0]];
+	p2 = &mesh->verts[face->v[1]];
+	p3 = &mesh->verts[face->v[2]];
+
+	VecSub(*p2, *p1, &face->edge);
+	VecSub(*p3, *p2, &e1);
+
+	VecCross(&face->edge, &e1, &ptmp);
+	face->nrm = ptmp;
+	if (VecNormalize(&face->nrm) == 0.) {
+		RLerror(RL_ADVISE, "Degenerate triangle.\n");
+		return FALSE;
+	}
+
+	if (flipflag)
+		VecScale(-1, face->nrm, &face->nrm);
+
+	if (mesh->type == PHONGTRI && !flipflag &&
+	    dotp(&mesh->norms[face->v[0]], &face->nrm) < 0.) {
+		/*
+		 * Trust the vertex normals rather than the vertex order.
+		 */
+		(*nflipped)++;
+		VecScale(-1., face->nrm, &face->nrm);
+		VecScale(-1., ptmp, &ptmp);
+		VecScale(-1., face->edge, &face->edge);
+	}
+
+	/*
+	 * Scale the edge by the dominant part of the normal.  Only its
+	 * direction matters, for the default uv mapping.
+	 */
+	anorm.x = fabs(ptmp.x);
+	anorm.y = fabs(ptmp.y);
+	anorm.z = fabs(ptmp.z);
+
+	if (anorm.x > anorm.y && anorm.x > anorm.z)
+		VecScale(1. / ptmp.x, face->edge, &face->edge);
+	else if (anorm.y > anorm.z)
+		VecScale(1. / ptmp.y, face->edge, &face->edge);
+	else
+		VecScale(1. /ptmp.z, face->edge, &face->edge);
+
+	return TRUE;
+}
+
+static void
+MeshFaceBounds(mesh, face, bounds)
+Mesh *mesh;
+MeshFace *face;
+Float bounds[2][3];
+{
+	BoundsInit(bounds);
+	BoundsAddPoint(bounds, &mesh->verts[face->v[0]]);
+	BoundsAddPoint(bounds, &mesh->verts[face->v[1]]);
+	BoundsAddPoint(bounds, &mesh->verts[face->v[2]]);
+}
+
+Methods *
+MeshMethods()
+{
+	if (iMeshMethods == (Methods *)NULL) {
+		iMeshMethods = MethodsCreate();
+		iMeshMethods->create = (GeomCreateFunc *)MeshCreate;
+		iMeshMethods->methods = MeshMethods;
+		iMeshMethods->name = MeshName;
+		iMeshMethods->intersect = MeshIntersect;
+		iMeshMethods->normal = MeshNormal;
+		iMeshMethods->uv = MeshUV;
+		iMeshMethods->bounds = MeshBounds;
+		iMeshMethods->stats = MeshStats;
+		iMeshMethods->checkbounds = TRUE;
+		iMeshMethods->closed = FALSE;
+	}
+	return iMeshMethods;
+}
+
+/*
+ * Intersect ray with mesh by walking the face hierarchy, nearer
+ * child first, narrowing maxdist as the faces in the leaves are hit.
+ * The faces are tested with the same arithmetic as triangles.
+ */
+int
+MeshIntersect(mesh, ray, mindist, maxdist)
+Mesh *mesh;
+Ray *ray;
+Float mindist, *maxdist;
+{
+	BoundsWalk walk;
+	BoundsNode *np;
+	MeshFace *face;
+	TriRay tr;
+	int i, hit;
+
+	MeshTests++;
+	TriRaySetup(ray, &tr);
+	BoundsWalkInit(&walk, ray);
+	hit = FALSE;
+	while ((np = BoundsWalkNext(&walk, mesh->nodes, mindist, *maxdist))
+	       != (BoundsNode *)NULL) {
+		for (i = np->first; i < np->first + np->num; i++) {
+			face = &mesh->faces[i];
+			if (TriRayIntersect(&tr, &mesh->verts[face->v[0]],
+					    &mesh->verts[face->v[1]],
+					    &mesh->verts[face->v[2]],
+					    mindist, maxdist, mesh->b)) {
+				mesh->hit = i;
+				hit = TRUE;
+			}
+		}
+	}
+	if (hit)
+		MeshHits++;
+	return hit;
+}
+
+int
+MeshNormal(mesh, pos, nrm, gnrm)
+Mesh *mesh;
+Vector *pos, *nrm, *gnrm;
+{
+	MeshFace *face;
+	Vector *n0, *n1, *n2;
+
+	face = &mesh->faces[mesh->hit];
+	*gnrm = face->nrm;
+
+	if (mesh->type == FLATTRI) {
+		*nrm = face->nrm;
+		return FALSE;
+	}
+
+	n0 = &mesh->norms[face->v[0]];
+	n1 = &mesh->norms[face->v[1]];
+	n2 = &mesh->norms[face->v[2]];
+	nrm->x = mesh->b[0]*n0->x + mesh->b[1]*n1->x + mesh->b[2]*n2->x;
+	nrm->y = mesh->b[0]*n0->y + mesh->b[1]*n1->y + mesh->b[2]*n2->y;
+	nrm->z = mesh->b[0]*n0->z + mesh->b[1]*n1->z + mesh->b[2]*n2->z;
+	(void)VecNormalize(nrm);
+	return TRUE;
+}
+
+/*ARGSUSED*/
+void
+MeshUV(mesh, pos, norm, uv, dpdu, dpdv)
+Mesh *mesh;
+Vector *pos, *norm, *dpdu, *dpdv;
+Vec2d *uv;
+{
+	MeshFace *face;
+	Vec2d *t0, *t1, *t2;
+	Float d;
+
+	face = &mesh->faces[mesh->hit];
+
+	d = mesh->b[0]+mesh->b[1]+mesh->b[2];
+	mesh->b[0] /= d;
+	mesh->b[1] /= d;
+	mesh->b[2] /= d;
+
+	if (dpdu) {
+		if (mesh->uv == (Vec2d *)NULL) {
+			*dpdu = face->edge;
+			(void)VecNormalize(dpdu);
+			VecSub(mesh->verts[face->v[0]], *pos, dpdv);
+			(void)VecNormalize(dpdv);
+		} else {
+			*dpdu = mesh->dpdu[mesh->hit];
+			*dpdv = mesh->dpdv[mesh->hit];
+		}
+	}
+
+	if (mesh->uv == (Vec2d *)NULL) {
+		uv->v = mesh->b[2];
+		if (equal(uv->v, 1.))
+			uv->u = 0.;
+		else
+			uv->u = mesh->b[1] / (mesh->b[0] + mesh->b[1]);
+	} else {
+		t0 = &mesh->uv[face->v[0]];
+		t1 = &mesh->uv[face->v[1]];
+		t2 = &mesh->uv[face->v[2]];
+		uv->u = mesh->b[0]*t0->u + mesh->b[1]*t1->u + mesh->b[2]*t2->u;
+		uv->v = mesh->b[0]*t0->v + mesh->b[1]*t1->v + mesh->b[2]*t2->v;
+	}
+}
+
+void
+MeshBounds(mesh, bounds)
+Mesh *mesh;
+Float bounds[2][3];
+{
+	int i;
+
+	BoundsInit(bounds);
+	for (i = 0; i < mesh->nfaces; i++) {
+		BoundsAddPoint(bounds, &mesh->verts[mesh->faces[i].v[0]]);
+		BoundsAddPoint(bounds, &mesh->verts[mesh->faces[i].v[1]]);
+		BoundsAddPoint(bounds, &mesh->verts[mesh->faces[i].v[2]]);
+	}
+}
+
+char *
+MeshName()
+{
+	return meshName;
+}
+
+void
+MeshStats(tests, hits)
+unsigned long *tests, *hits;
+{
+	*tests = MeshTests;
+	*hits = MeshHits;
+}
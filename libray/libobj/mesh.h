@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef MESH_H
+#define MESH_H
+
+#define GeomMeshCreate(v,nv,f,nf,s) \
+		GeomCreate((GeomRef)MeshCreate(v,nv,f,nf,s), MeshMethods())
+
+#define MESH_NORMAL	01	/* vertex carries a normal */
+#define MESH_UV		02	/* vertex carries uv coordinates */
+
+#define MESH_LEAFSIZE	4	/* max. faces in a leaf */
+
+/*
+ * A face of a mesh.  Its vertices are shared with its neighbours.
+ */
+typedef struct {
+	Vector nrm,		/* face normal */
+	       edge;		/* first edge, scaled as a Triangle's e[0] */
+	int v[3];		/* indices into vertex arrays */
+} MeshFace;
+
+typedef struct {
+	Vector *verts,		/* vertex positions */
+	       *norms,		/* vertex normals, Phong meshes only */
+	       *dpdu, *dpdv;	/* per-face u and v axes, if uv given */
+	Vec2d *uv;		/* vertex uv coordinates, if given */
+	MeshFace *faces;	/* faces */
+	BoundsNode *nodes;	/* face hierarchy, nodes[0] is the root */
+	int nverts, nfaces, nnodes;
+	int hit;		/* index of face last hit */
+	Float b[3];		/* barycentric coords of last hit */
+	char type;		/* FLATTRI or PHONGTRI */
+} Mesh;
+
+/*
+ * Vertex and face lists as built by the parser.  Both are given
+ * in reverse order, and both are freed by MeshCreate().
+ */
+typedef struct MeshVertList {
+	Vector pos, norm;
+	Vec2d uv;
+	int flags;		/* MESH_NORMAL | MESH_UV */
+	struct MeshVertList *next;
+} MeshVertList;
+
+typedef struct MeshFaceList {
+	int v[3];
+	struct MeshFaceList *next;
+} MeshFaceList;
+
+extern Mesh	*MeshCreate();
+extern Methods	*MeshMethods();
+extern int	MeshIntersect(), MeshNormal();
+extern void	MeshBounds(), MeshUV(), MeshStats();
+extern char	*MeshName();
+
+#endif /* MESH_H */
@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "geom.h"
+#include "list.h"
+#include "grid.h"
+#include "csg.h"
+#include "instance.h"
+#include "plane.h"
+#include "poly.h"
+#include "optimize.h"
+#include "libcommon/xform.h"
+
+static void OptCount(), OptSlot(), OptEach(), OptClip(), OptGrow();
+static int OptFlatten(), OptAbsorb();
+static OptRef *OptLookup(), *OptFind();
+static Trans *OptCompose();
+
+#define OptHash(r)	(((unsigned long)(r) >> 3) * 2654435761UL)
+
+/*
+ * Tidy up a freshly parsed world before it is set up for rendering:
+ *
+ *	o Lists with a single member, and instances, are replaced by the
+ *	  object they hold, which takes on their transformation.
+ *	o Static transformations of planes, polygons, triangles and
+ *	  (for similarities) spheres are folded into the primitive, so
+ *	  that rays need not be transformed to hit them.
+ *	o If clipsize is positive, planes that are members of the world
+ *	  itself are replaced by polygons clipsize times the extent of
+ *	  the rest of the world.  This changes the image if the plane
+ *	  can be seen past that extent.
+ *
+ * Nothing is changed that might be seen in the image (other than the
+ * clipped planes):  anything reached through a texture keeps its
+ * transformation, as textures may depend upon it, and object data
+ * that are used by more than one Geom are left alone.  What was done
+ * is reported on fp, if non-NULL.
+ */
+void
+GeomOptimize(world, clipsize, fp)
+Geom *world;
+Float clipsize;
+FILE *fp;
+{
+	Optimizer opt;
+	OptRef *ref;
+
+	opt.nrefs = opt.maxrefs = 0;
+	opt.refs = (OptRef *)NULL;
+	opt.flattened = opt.composed = opt.absorbed = opt.clipped = 0;
+
+	/*
+	 * Find out who uses what, then optimize from the bottom up.
+	 */
+	ref = OptLookup(&opt, world->obj);
+	ref->obj = world;
+	ref->reached = world->texture ? OPT_TEXTURED : OPT_PLAIN;
+	OptEach(&opt, world, OptCount, world->texture != (struct Texture *)NULL);
+	OptLookup(&opt, world->obj)->done = TRUE;
+	OptEach(&opt, world, OptSlot, FALSE);
+	if (clipsize > 0.)
+		OptClip(&opt, world, clipsize);
+	free((voidstar)opt.refs);
+
+	if (fp) {
+		fprintf(fp,"Scene optimization:\n");
+		fprintf(fp,"\t%lu trivial aggregates removed\n",
+			opt.flattened);
+		fprintf(fp,"\t%lu transformations composed\n", opt.composed);
+		fprintf(fp,"\t%lu transformations absorbed by primitives\n",
+			opt.absorbed);
+		if (clipsize > 0.)
+			fprintf(fp,"\t%lu planes clipped to polygons\n",
+				opt.clipped);
+	}
+}
+
+/*
+ * Call func for each slot holding a child of the given aggregate:
+ * func(opt, slot, textured, inst), where inst is TRUE if the slot
+ * belongs to an instance (and so the child is the named object,
+ * which other instances use too).
+ */
+static void
+OptEach(opt, obj, func, textured)
+Optimizer *opt;
+Geom *obj;
+void (*func)();
+int textured;
+{
+	Geom **slot;
+
+	if (obj->methods == ListMethods()) {
+		for (slot = &((List *)obj->obj)->list; *slot;
+		     slot = &(*slot)->next)
+			(*func)(opt, slot, textured, FALSE);
+		for (slot = &((List *)obj->obj)->unbounded; *slot;
+		     slot = &(*slot)->next)
+			(*func)(opt, slot, textured, FALSE);
+	} else if (obj->methods == GridMethods()) {
+		for (slot = &((Grid *)obj->obj)->objects; *slot;
+		     slot = &(*slot)->next)
+			(*func)(opt, slot, textured, FALSE);
+		for (slot = &((Grid *)obj->obj)->unbounded; *slot;
+		     slot = &(*slot)->next)
+			(*func)(opt, slot, textured, FALSE);
+	} else if (obj->methods == CsgMethods()) {
+		(*func)(opt, &((Csg *)obj->obj)->obj1, textured, FALSE);
+		(*func)(opt, &((Csg *)obj->obj)->obj2, textured, FALSE);
+	} else if (obj->methods == InstanceMethods()) {
+		(*func)(opt, &((Instance *)obj->obj)->obj, textured, TRUE);
+	}
+}
+
+/*
+ * Note who uses the data of the object in the given slot, and how it
+ * is reached.  An aggregate's children are looked at once for each
+ * way in which the aggregate is reached.
+ */
+/*ARGSUSED*/
+static void
+OptCount(opt, slot, textured, inst)
+Optimizer *opt;
+Geom **slot;
+int textured, inst;
+{
+	Geom *obj;
+	OptRef *ref;
+	int how;
+
+	obj = *slot;
+	if (obj->texture)
+		textured = TRUE;
+	how = textured ? OPT_TEXTURED : OPT_PLAIN;
+
+	ref = OptLookup(opt, obj->obj);
+	if (ref->obj == (Geom *)NULL)
+		ref->obj = obj;
+	else if (ref->obj != obj)
+		ref->shared = TRUE;
+	if (ref->reached & how)
+		return;
+	ref->reached |= how;
+	if (IsAggregate(obj))
+		OptEach(opt, obj, OptCount, textured);
+}
+
+/*
+ * Optimize the object in the given slot, after its children.
+ */
+/*ARGSUSED*/
+static void
+OptSlot(opt, slot, textured, inst)
+Optimizer *opt;
+Geom **slot;
+int textured, inst;
+{
+	OptRef *ref;
+
+	if (IsAggregate(*slot)) {
+		ref = OptLookup(opt, (*slot)->obj);
+		if (!ref->done) {
+			ref->done = TRUE;
+			OptEach(opt, *slot, OptSlot, FALSE);
+		}
+		while (OptFlatten(opt, slot, inst))
+			;
+	}
+	if (!IsAggregate(*slot))
+		(void)OptAbsorb(opt, *slot);
+}
+
+/*
+ * If the given slot holds a list with a single member, or an instance,
+ * put the object it holds there instead.  That object is changed in
+ * place if nothing else can reach it; otherwise it is copied.
+ */
+static int
+OptFlatten(opt, slot, inst)
+Optimizer *opt;
+Geom **slot;
+int inst;
+{
+	Geom *obj, *child, *new;
+	List *list;
+
+	obj = *slot;
+	if (obj->methods == ListMethods()) {
+		list = (List *)obj->obj;
+		if (list->list == (Geom *)NULL ||
+		    list->list->next != (Geom *)NULL ||
+		    list->unbounded != (Geom *)NULL)
+			return FALSE;
+		child = list->list;
+	} else if (obj->methods == InstanceMethods()) {
+		child = ((Instance *)obj->obj)->obj;
+		inst = TRUE;
+	} else
+		return FALSE;
+
+	/*
+	 * The child's texture is applied in the space of obj, so
+	 * it can't take on obj's transformation.
+	 */
+	if (obj->texture || obj->animtrans || child->animtrans ||
+	    (obj->trans && child->texture))
+		return FALSE;
+
+	if (inst || OptLookup(opt, obj->obj)->shared) {
+		new = GeomCopy(child);
+		OptLookup(opt, child->obj)->shared = TRUE;
+	} else
+		new = child;
+
+	if (obj->trans) {
+		if (new->trans) {
+			new->trans = OptCompose(new->trans, obj->trans);
+			opt->composed++;
+		} else
+			new->trans = obj->trans;
+		new->transtail = new->trans;
+		new->frame = -1;
+	}
+	if (new->surf == (struct Surface *)NULL)
+		new->surf = obj->surf;
+	if (new->name == (char *)NULL)
+		new->name = obj->name;
+	new->next = obj->next;
+	*slot = new;
+	opt->flattened++;
+	return TRUE;
+}
+
+/*
+ * Have the given primitive absorb its transformation, if it knows how,
+ * if the transformation is static, and if nobody could tell.
+ */
+static int
+OptAbsorb(opt, obj)
+Optimizer *opt;
+Geom *obj;
+{
+	OptRef *ref;
+
+	if (obj->trans == (Trans *)NULL || obj->animtrans ||
+	    obj->methods->xform == NULL)
+		return FALSE;
+	ref = OptLookup(opt, obj->obj);
+	if (ref->shared || (ref->reached & OPT_TEXTURED))
+		return FALSE;
+	if (!(*obj->methods->xform)(obj->obj, obj->trans))
+		return FALSE;
+	obj->trans = obj->transtail = (Trans *)NULL;
+	obj->frame = -1;
+	opt->absorbed++;
+	return TRUE;
+}
+
+/*
+ * Return a new transformation equal to t1 followed by t2.
+ * Neither is changed, as other objects may share them.
+ */
+static Trans *
+OptCompose(t1, t2)
+Trans *t1, *t2;
+{
+	Trans *res;
+
+	res = TransCreate((TransRef)XformCreate(), XformMethods());
+	TransCompose(t1, t2, res);
+	return res;
+}
+
+/*
+ * Replace untransformed, untextured planes that are members of the
+ * world by polygons.  Each is the rectangle on the plane that holds
+ * the projection of the bounding box of the rest of the world, grown
+ * about its center by 'size'.
+ */
+static void
+OptClip(opt, world, size)
+Optimizer *opt;
+Geom *world;
+Float size;
+{
+	Geom **slot, *obj, *head;
+	Float bounds[2][3], a, b, lo[2], hi[2], mid[2], half[2];
+	Vector u, v, corner, pos;
+	Plane *plane;
+	Polygon *poly;
+	PointList *plist, *pl;
+	OptRef *ref;
+	int i;
+
+	if (world->texture)
+		return;
+	if (world->methods == ListMethods())
+		slot = &((List *)world->obj)->list;
+	else if (world->methods == GridMethods())
+		slot = &((Grid *)world->obj)->objects;
+	else
+		return;
+	head = *slot;
+
+	BoundsInit(bounds);
+	for (obj = head; obj; obj = obj->next) {
+		if (obj->methods == PlaneMethods())
+			continue;
+		GeomComputeBounds(obj);
+		if (!UNBOUNDED(obj))
+			BoundsEnlarge(bounds, obj->bounds);
+	}
+	if (bounds[LOW][X] > bounds[HIGH][X])
+		return;		/* nothing to clip to */
+
+	for (; *slot; slot = &(*slot)->next) {
+		obj = *slot;
+		if (obj->methods != PlaneMethods() || obj->trans ||
+		    obj->texture)
+			continue;
+		ref = OptLookup(opt, obj->obj);
+		if (ref->shared || (ref->reached & OPT_TEXTURED))
+			continue;
+		plane = (Plane *)obj->obj;
+
+		/*
+		 * Project the corners of the box onto the plane, using
+		 * axes u and v in it such that u X v is the plane normal.
+		 */
+		VecCoordSys(&plane->norm, &u, &v);
+		lo[0] = lo[1] = FAR_AWAY;
+		hi[0] = hi[1] = -FAR_AWAY;
+		for (i = 0; i < 8; i++) {
+			corner.x = bounds[i & 1][X] - plane->pos.x;
+			corner.y = bounds[(i >> 1) & 1][Y] - plane->pos.y;
+			corner.z = bounds[(i >> 2) & 1][Z] - plane->pos.z;
+			a = dotp(&corner, &u);
+			b = dotp(&corner, &v);
+			lo[0] = min(lo[0], a);
+			hi[0] = max(hi[0], a);
+			lo[1] = min(lo[1], b);
+			hi[1] = max(hi[1], b);
+		}
+		for (i = 0; i < 2; i++) {
+			mid[i] = 0.5 * (lo[i] + hi[i]);
+			half[i] = 0.5 * size * (hi[i] - lo[i]);
+		}
+
+		/*
+		 * Counter-clockwise about the normal.  PolygonCreate()
+		 * reverses the list, so the last corner goes first.
+		 */
+		plist = (PointList *)NULL;
+		for (i = 0; i < 4; i++) {
+			a = mid[0] + ((i == 1 || i == 2) ? half[0] : -half[0]);
+			b = mid[1] + (i >= 2 ? half[1] : -half[1]);
+			VecAddScaled(plane->pos, a, u, &pos);
+			VecAddScaled(pos, b, v, &pos);
+			pl = (PointList *)Malloc(sizeof(PointList));
+			pl->vec = pos;
+			pl->next = plist;
+			plist = pl;
+		}
+		poly = PolygonCreate(plist, 4, FALSE);
+		if (poly == (Polygon *)NULL)
+			continue;
+		obj->obj = (GeomRef)poly;
+		obj->methods = PolygonMethods();
+		obj->frame = -1;
+		opt->clipped++;
+	}
+}
+
+/*
+ * Return the table entry for the given object data, making a new one
+ * if need be.
+ */
+static OptRef *
+OptLookup(opt, ref)
+Optimizer *opt;
+GeomRef ref;
+{
+	OptRef *r;
+
+	if (2 * (opt->nrefs + 1) > opt->maxrefs)
+		OptGrow(opt);
+	r = OptFind(opt, ref);
+	if (r->ref == (GeomRef)NULL) {
+		r->ref = ref;
+		opt->nrefs++;
+	}
+	return r;
+}
+
+/*
+ * Return the entry for ref, or the free one where it would go.
+ */
+static OptRef *
+OptFind(opt, ref)
+Optimizer *opt;
+GeomRef ref;
+{
+	unsigned long i, mask;
+
+	mask = opt->maxrefs - 1;
+	for (i = OptHash(ref) & mask; opt->refs[i].ref != (GeomRef)NULL;
+	     i = (i + 1) & mask)
+		if (opt->refs[i].ref == ref)
+			break;
+	return &opt->refs[i];
+}
+
+/*
+ * Double the size of the table, or allocate it.
+ */
+static void
+OptGrow(opt)
+Optimizer *opt;
+{
+	OptRef *old;
+	int i, num;
+
+	old = opt->refs;
+	num = opt->maxrefs;
+	opt->maxrefs = num ? 2 * num : OPT_MINREFS;
+	opt->refs = (OptRef *)Calloc((unsigned)opt->maxrefs,
+		sizeof(OptRef));
+	for (i = 0; i < num; i++)
+		if (old[i].ref != (GeomRef)NULL)
+			*OptFind(opt, old[i].ref) = old[i];
+	if (old)
+		free((voidstar)old);
+}
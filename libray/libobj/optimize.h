@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+/*
+ * Ways in which a piece of object data may be reached from the world.
+ */
+#define OPT_PLAIN	1		/* with no texture on the way */
+#define OPT_TEXTURED	2		/* through a textured object */
+
+#define OPT_MINREFS	64		/* initial size of reference table */
+
+/*
+ * What is known about a piece of object data (the 'obj' of a Geom):
+ * who uses it and how it is reached.  Data used by more than one
+ * Geom may not be changed on behalf of any one of them.
+ */
+typedef struct OptRef {
+	GeomRef ref;			/* object data, or NULL if free */
+	struct Geom *obj;		/* first Geom found using it */
+	char shared,			/* used by some other Geom as well? */
+		reached,		/* OPT_PLAIN and/or OPT_TEXTURED */
+		done;			/* children optimized? */
+} OptRef;
+
+/*
+ * Hash table of OptRefs, and a tally of what was done.
+ */
+typedef struct Optimizer {
+	int nrefs, maxrefs;		/* # of refs in table, table size */
+	OptRef *refs;
+	unsigned long flattened,	/* trivial aggregates removed */
+		composed,		/* transformations composed */
+		absorbed,		/* transformations absorbed */
+		clipped;		/* planes clipped to polygons */
+} Optimizer;
+
+extern void	GeomOptimize();
+
+#endif /* OPTIMIZE_H */
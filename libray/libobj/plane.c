@@ -68,6 +68,7 @@ PlaneMethods()
 		iPlaneMethods->normal = PlaneNormal;
 		iPlaneMethods->uv = PlaneUV;
 		iPlaneMethods->bounds = PlaneBounds;
+		iPlaneMethods->xform = PlaneXform;
 		iPlaneMethods->stats = PlaneStats;
 		iPlaneMethods->checkbounds = FALSE;
 		iPlaneMethods->closed = FALSE;
@@ -142,6 +143,20 @@ Float bounds[2][3];
 	bounds[HIGH][X] = -1.0;
 }
 
+/*
+ * Move the plane by the given transformation.
+ */
+int
+PlaneXform(plane, trans)
+Plane *plane;
+Trans *trans;
+{
+	PointTransform(&plane->pos, &trans->trans);
+	NormalTransform(&plane->norm, &trans->itrans);
+	plane->d = dotp(&plane->norm, &plane->pos);
+	return TRUE;
+}
+
 char *
 PlaneName()
 {
@@ -40,7 +40,7 @@ typedef struct {
 } Plane;
 
 extern Plane	*PlaneCreate();
-extern int	PlaneIntersect(), PlaneNormal();
+extern int	PlaneIntersect(), PlaneNormal(), PlaneXform();
 extern void	PlaneBounds(), PlaneUV(), PlaneStats();
 extern char	*PlaneName();
 extern Methods	*PlaneMethods();
@@ -33,6 +33,17 @@ static char polyName[] = "polygon";
 
 unsigned long PolyTests, PolyHits;
 
+static void PolygonIndex(), PolygonSlabs();
+static int PolygonWinding();
+
+/*
+ * Index of the slab holding v.  Monotone in v, so an edge entered in
+ * the slabs of both of its endpoints is in every slab between them.
+ */
+#define SlabIndex(p, v, k)	{ k = (int)(((v) - (p)->vmin) * (p)->vscale); \
+				  if (k < 0) k = 0; \
+				  else if (k >= (p)->nslab) k = (p)->nslab - 1; }
+
 /*
  * Create a reference to a polygon with vertices equal to those
  * on the linked-list "plist."
@@ -43,8 +54,7 @@ PointList *plist;
 int npoints, flipflag;
 {
 	Polygon *poly;
-	Float indexval;
-	Vector *prev, *cur, anorm;
+	Vector *prev, *cur;
 	PointList *curp, *pltmp;
 	int i;
 
@@ -103,10 +113,23 @@ int npoints, flipflag;
 	 */
 	poly->d = dotp(&poly->norm, &poly->points[0]);
 
-	/*
-	 * Find the "dominant" part of the normal vector.  This
-	 * is used to turn the point-in-polygon test into a 2D problem.
-	 */
+	PolygonIndex(poly);
+	PolygonSlabs(poly);
+
+	return poly;
+}
+
+/*
+ * Find the "dominant" part of the normal vector.  This
+ * is used to turn the point-in-polygon test into a 2D problem.
+ */
+static void
+PolygonIndex(poly)
+Polygon *poly;
+{
+	Float indexval;
+	Vector anorm;
+
 	anorm.x = fabs(poly->norm.x);
 	anorm.y = fabs(poly->norm.y);
 	anorm.z = fabs(poly->norm.z);
@@ -119,8 +142,111 @@ int npoints, flipflag;
 		poly->index = YNORMAL;
 	else
 		poly->index = ZNORMAL;
+}
 
-	return poly;
+/*
+ * Move the polygon by the given transformation.  The slabs are
+ * rebuilt, as the dominant axis may have changed.
+ */
+int
+PolygonXform(poly, trans)
+Polygon *poly;
+Trans *trans;
+{
+	int i;
+
+	for (i = 0; i < poly->npoints; i++)
+		PointTransform(&poly->points[i], &trans->trans);
+	NormalTransform(&poly->norm, &trans->itrans);
+	poly->d = dotp(&poly->norm, &poly->points[0]);
+	PolygonIndex(poly);
+	if (poly->nslab) {
+		free((voidstar)poly->slab);
+		free((voidstar)poly->edge);
+	}
+	PolygonSlabs(poly);
+	return TRUE;
+}
+
+/*
+ * Sort the edges of a polygon with many vertices into slabs.  Long
+ * edges land in several slabs; if that makes the index too big, use
+ * fewer slabs.
+ */
+static void
+PolygonSlabs(poly)
+Polygon *poly;
+{
+	Vec2d last, cur;
+	int i, k, k0, k1, n, total, *fill;
+
+	poly->nslab = 0;
+	n = poly->npoints;
+	if (n < POLY_SLABMIN)
+		return;
+
+	VecProject(cur, poly->points[0], poly->index);
+	poly->vmin = poly->vmax = cur.v;
+	for (i = 1; i < n; i++) {
+		VecProject(cur, poly->points[i], poly->index);
+		if (cur.v < poly->vmin)
+			poly->vmin = cur.v;
+		if (cur.v > poly->vmax)
+			poly->vmax = cur.v;
+	}
+	if (poly->vmax <= poly->vmin)
+		return;
+
+	for (poly->nslab = n / POLY_SLABEDGES; ; poly->nslab /= 2) {
+		poly->vscale = poly->nslab / (poly->vmax - poly->vmin);
+		total = 0;
+		VecProject(last, poly->points[n -1], poly->index);
+		for (i = 0; i < n; i++, last = cur) {
+			VecProject(cur, poly->points[i], poly->index);
+			if (cur.v == last.v)
+				continue;	/* never crossed */
+			SlabIndex(poly, last.v, k0);
+			SlabIndex(poly, cur.v, k1);
+			total += (k0 < k1 ? k1 - k0 : k0 - k1) + 1;
+		}
+		if (total <= POLY_SLABFILL * n || poly->nslab == 1)
+			break;
+	}
+
+	poly->slab = (int *)Calloc((unsigned)poly->nslab + 1, sizeof(int));
+	poly->edge = (int *)Malloc((unsigned)total * sizeof(int));
+	fill = (int *)Malloc((unsigned)poly->nslab * sizeof(int));
+
+	/*
+	 * Count the edges in each slab, turn the counts into offsets,
+	 * then drop the edges in.
+	 */
+	for (k = 0; k < 2; k++) {
+		VecProject(last, poly->points[n -1], poly->index);
+		for (i = 0; i < n; i++, last = cur) {
+			VecProject(cur, poly->points[i], poly->index);
+			if (cur.v == last.v)
+				continue;
+			SlabIndex(poly, last.v, k0);
+			SlabIndex(poly, cur.v, k1);
+			if (k0 > k1) {
+				k0 ^= k1; k1 ^= k0; k0 ^= k1;
+			}
+			for (; k0 <= k1; k0++) {
+				if (k == 0)
+					poly->slab[k0 +1]++;
+				else
+					poly->edge[fill[k0]++] = i;
+			}
+		}
+		if (k == 0) {
+			for (i = 0; i < poly->nslab; i++) {
+				poly->slab[i +1] += poly->slab[i];
+				fill[i] = poly->slab[i];
+			}
+		}
+	}
+	free((voidstar)fill);
 }
 
 Methods *
@@ -135,6 +261,7 @@ PolygonMethods()
 		iPolygonMethods->normal = PolygonNormal;
 		iPolygonMethods->uv = PolygonUV;
 		iPolygonMethods->bounds = PolygonBounds;
+		iPolygonMethods->xform = PolygonXform;
 		iPolygonMethods->stats = PolygonStats;
 		iPolygonMethods->checkbounds = TRUE;
 		iPolygonMethods->closed = FALSE;
@@ -207,43 +334,48 @@ Float mindist, *maxdist;
 
 	/*
 	 * Is the point inside the polygon?
-	 *
-	 * Compute the winding number by finding the quadrant each
-	 * polygon point lies in with respect to the the point in
-	 * question, and computing a "delta" (winding number).  If we
-	 * end up going around in a complete circle around
-	 * the point (winding number is non-zero at the end), then
-	 * we're inside.  Otherwise, the point is outside.
-	 *
-	 * Note that we can turn this into a 2D problem by projecting
-	 * all the points along the axis defined by poly->index,
-	 * the "dominant" part of the polygon's normal vector.
 	 */
-	winding = 0;
-	VecProject(last, poly->points[poly->npoints -1], poly->index);
-	lastquad = quadrant(last, center);
-	for(i = 0; i < poly->npoints; i++, last = cur) {
-		VecProject(cur, poly->points[i], poly->index);
-		quad = quadrant(cur, center);
-		if (quad == lastquad)
-			continue;
-		if(((lastquad + 1) & 3) == quad)
-			winding++;
-		else if(((quad + 1) & 3) == lastquad)
-			winding--;
-		else {
-			/*
-			 * Find where edge crosses
-			 * center's X axis.
-			 */
-			right = last.u - cur.u;
-			left = (last.v - cur.v) * (center.u - last.u);
-			if(left + last.v * right > right * center.v)
-				winding += 2;
-			else
-				winding -= 2;
+	if (poly->nslab)
+		winding = PolygonWinding(poly, &center);
+	else {
+		/*
+		 * Compute the winding number by finding the quadrant each
+		 * polygon point lies in with respect to the the point in
+		 * question, and computing a "delta" (winding number).  If we
+		 * end up going around in a complete circle around
+		 * the point (winding number is non-zero at the end), then
+		 * we're inside.  Otherwise, the point is outside.
+		 *
+		 * Note that we can turn this into a 2D problem by projecting
+		 * all the points along the axis defined by poly->index,
+		 * the "dominant" part of the polygon's normal vector.
+		 */
+		winding = 0;
+		VecProject(last, poly->points[poly->npoints -1], poly->index);
+		lastquad = quadrant(last, center);
+		for(i = 0; i < poly->npoints; i++, last = cur) {
+			VecProject(cur, poly->points[i], poly->index);
+			quad = quadrant(cur, center);
+			if (quad == lastquad)
+				continue;
+			if(((lastquad + 1) & 3) == quad)
+				winding++;
+			else if(((quad + 1) & 3) == lastquad)
+				winding--;
+			else {
+				/*
+				 * Find where edge crosses
+				 * center's X axis.
+				 */
+				right = last.u - cur.u;
+				left = (last.v - cur.v) * (center.u - last.u);
+				if(left + last.v * right > right * center.v)
+					winding += 2;
+				else
+					winding -= 2;
+			}
+			lastquad = quad;
 		}
-		lastquad = quad;
 	}
 
 	if (winding != 0) {
@@ -254,6 +386,55 @@ Float mindist, *maxdist;
 	return FALSE;
 }
 
+/*
+ * Winding number of the polygon about center, counted as signed
+ * crossings of the ray from center toward +u.  Only the edges in the
+ * slab holding center can cross it.  Edges are classified exactly as
+ * in the quadrant test above, and edges that straddle center.u are
+ * decided with the same arithmetic, so the two agree on which points
+ * are inside.
+ */
+static int
+PolygonWinding(poly, center)
+Polygon *poly;
+Vec2d *center;
+{
+	register int i, e;
+	int k, up, winding;
+	Float left, right;
+	Vec2d cur, last;
+
+	if (center->v <= poly->vmin || center->v > poly->vmax)
+		return 0;
+	SlabIndex(poly, center->v, k);
+	winding = 0;
+	for (i = poly->slab[k]; i < poly->slab[k +1]; i++) {
+		e = poly->edge[i];
+		VecProject(cur, poly->points[e], poly->index);
+		VecProject(last, poly->points[e ? e -1 : poly->npoints -1],
+			poly->index);
+		up = last.v < center->v;
+		if (up == (cur.v < center->v))
+			continue;
+		if (last.u < center->u) {
+			if (cur.u < center->u)
+				continue;
+		} else if (cur.u >= center->u) {
+			winding += up ? 1 : -1;
+			continue;
+		}
+		/*
+		 * Edge goes from one side of center to the other;
+		 * does it pass to the right?
+		 */
+		right = last.u - cur.u;
+		left = (last.v - cur.v) * (center->u - last.u);
+		if ((left + last.v * right > right * center->v) == up)
+			winding += up ? 1 : -1;
+	}
+	return winding;
+}
+
 /*
  * Return the normal to the polygon surface.
  */
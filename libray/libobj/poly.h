@@ -31,8 +31,17 @@
 #define GeomPolygonCreate(r,p,f) GeomCreate((GeomRef)PolygonCreate(r,p,f), \
 					PolygonMethods())
 
+#define POLY_SLABMIN	32	/* polygons with fewer vertices test every edge */
+#define POLY_SLABEDGES	4	/* aim for this many edges per slab */
+#define POLY_SLABFILL	16	/* max. slab entries per vertex */
+
 /*
  * Polygon
+ *
+ * Polygons with many vertices keep their edges sorted into horizontal
+ * slabs of the projected plane, so that the point-in-polygon test
+ * need only look at the edges whose v-extent spans the slab holding
+ * the hit point.  Edge i runs from vertex i-1 to vertex i.
  */
 typedef struct {
 	Vector norm;		/* Normal to polygon */
@@ -40,11 +49,17 @@ typedef struct {
 	char index;		/* Which normal coord is "dominant"? */
 	Vector *points;		/* Array of vertices */
 	int npoints;		/* Number of vertices */
+	int nslab;		/* Number of slabs, 0 if none */
+	Float vmin, vmax;	/* Projected v-extent */
+	Float vscale;		/* Slabs per unit v */
+	int *slab;		/* Start of each slab in edge[], nslab+1 */
+	int *edge;		/* Edges overlapping each slab */
 } Polygon;
 
 extern Polygon	*PolygonCreate();
 extern Methods	*PolygonMethods();
-extern int	PolygonIntersect(), PolygonEnter(), PolygonNormal();
+extern int	PolygonIntersect(), PolygonEnter(), PolygonNormal(),
+		PolygonXform();
 extern void	PolygonBounds(), PolygonUV(), PolygonStats();
 extern char	*PolygonName();
 
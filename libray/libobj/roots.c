@@ -22,6 +22,11 @@
  *                  reduced considerably (e.g. to 1E-30), results will be
  *                  correct but multiple roots might be reported more
  *                  than once.
+ *  		    SolvePolyRange() added: finds only the nearest root
+ *  		    inside a given interval, by splitting it at the
+ *  		    roots of the derivative and polishing the first
+ *  		    bracketed sign change with Newton/bisection.
+ *  		    SolvePolyRangeAll() finds all of them.
  */
 
 #include "libcommon/common.h"
@@ -40,6 +45,10 @@ extern double   sqrt(), cbrt(), cos(), acos();
 #define     EQN_EPS     1e-9
 #define	    IsZero(x)	((x) > -EQN_EPS && (x) < EQN_EPS)
 
+#define     ROOT_EPS    1e-12	/* relative accuracy of polished roots */
+#define     ROOT_MAXITER 64	/* enough to bisect a double to nothing */
+#define     ROOT_MAXDEG 4
+
 #ifndef CBRT
 #define     cbrt(x)     ((x) > 0.0 ? pow((double)(x), 1.0/3.0) : \
 			  ((x) < 0.0 ? -pow((double)-(x), 1.0/3.0) : 0.0))
@@ -246,3 +255,221 @@ int SolveQuartic(c, s)
     return num;
 }
 
+
+/*
+ * Evaluate c[0] + c[1]*x + ... + c[n]*x^n.  If mag is non-null, it is
+ * set to the same sum taken over absolute values, which bounds the
+ * rounding error in the result.
+ */
+static double
+PolyEval(c, n, x, mag)
+    double c[], x, *mag;
+    int n;
+{
+    double f, m, ax;
+    int i;
+
+    f = c[ n ];
+    if (mag == (double *)0) {
+	for (i = n - 1; i >= 0; --i)
+	    f = f * x + c[ i ];
+	return f;
+    }
+    ax = fabs(x);
+    m = fabs(f);
+    for (i = n - 1; i >= 0; --i) {
+	f = f * x + c[ i ];
+	m = m * ax + fabs(c[ i ]);
+    }
+    *mag = m;
+    return f;
+}
+
+/*
+ * Polish the root of a polynomial that changes sign on [a, b]; fa and
+ * fb are the values at the ends.  Starting from the secant through
+ * the ends, Newton steps are taken while they stay inside the
+ * shrinking bracket, bisection otherwise.
+ */
+static double
+PolyPolish(c, n, a, b, fa, fb)
+    double c[], a, b, fa, fb;
+    int n;
+{
+    double x, xn, f, df, dx, axn;
+    int i, j;
+
+    x = a - fa * (b - a) / (fb - fa);
+    if ((x <= a && x <= b) || (x >= a && x >= b))
+	x = 0.5 * (a + b);
+    for (i = 0; i < ROOT_MAXITER; ++i) {
+	f = c[ n ];
+	df = 0.;
+	for (j = n - 1; j >= 0; --j) {
+	    df = df * x + f;
+	    f = f * x + c[ j ];
+	}
+	if (f == 0.)
+	    return x;
+	if ((f < 0.) == (fa < 0.))
+	    a = x;
+	else
+	    b = x;
+	xn = df != 0. ? x - f / df : a;
+	if ((xn <= a && xn <= b) || (xn >= a && xn >= b))
+	    xn = 0.5 * (a + b);
+	dx = fabs(xn - x);
+	axn = fabs(xn);
+	if (dx <= ROOT_EPS * (1. + axn))
+	    return xn;
+	x = xn;
+    }
+    return x;
+}
+
+/*
+ * Find the roots of c[0] + ... + c[n]*x^n lying in [lo, hi], in
+ * increasing order.  The roots of the second derivative split the
+ * interval into pieces on which the polynomial is convex or concave,
+ * so each piece holds at most two roots, and then only if the first
+ * derivative changes sign in it.  The extremum is polished only in
+ * that case, and only for pieces we actually get to; an extremum at
+ * which the polynomial is zero to within rounding is reported as a
+ * (double) root, which catches grazing hits.  If first is TRUE, stop
+ * after the first root.
+ */
+static int
+PolyRoots(c, n, lo, hi, s, first)
+    double c[], lo, hi, s[];
+    int n, first;
+{
+    double d[ ROOT_MAXDEG ], e[ ROOT_MAXDEG ], infl[ ROOT_MAXDEG ];
+    double end[ 2 ], a, b, fa, fb, u, fu, du, v, fv, dv, mag, x;
+    int i, j, k, ni, num;
+
+    while (n > 0 && c[ n ] == 0.)
+	--n;
+    if (n == 0 || lo > hi)
+	return 0;
+    if (n == 1) {
+	x = -c[ 0 ] / c[ 1 ];
+	if (x < lo || x > hi)
+	    return 0;
+	s[ 0 ] = x;
+	return 1;
+    }
+    if (n == 2) {
+	/* closed form, arranged to avoid cancellation */
+	a = c[ 1 ] * c[ 1 ] - 4. * c[ 2 ] * c[ 0 ];
+	if (a < 0.)
+	    return 0;
+	a = c[ 1 ] < 0. ? -0.5 * (c[ 1 ] - sqrt(a)) : -0.5 * (c[ 1 ] + sqrt(a));
+	if (a == 0.) {
+	    if (lo > 0. || hi < 0.)
+		return 0;
+	    s[ 0 ] = 0.;
+	    return 1;
+	}
+	end[ 0 ] = a / c[ 2 ];
+	end[ 1 ] = c[ 0 ] / a;
+	if (end[ 0 ] > end[ 1 ]) {
+	    x = end[ 0 ]; end[ 0 ] = end[ 1 ]; end[ 1 ] = x;
+	}
+	num = 0;
+	for (i = 0; i < 2; ++i)
+	    if (end[ i ] >= lo && end[ i ] <= hi)
+		s[ num++ ] = end[ i ];
+	return num;
+    }
+
+    for (i = 0; i < n; ++i)
+	d[ i ] = (i + 1) * c[ i + 1 ];
+    for (i = 0; i < n - 1; ++i)
+	e[ i ] = (i + 1) * d[ i + 1 ];
+    ni = PolyRoots(e, n - 2, lo, hi, infl, FALSE);
+
+    num = 0;
+    u = lo;
+    fu = PolyEval(c, n, u, (double *)0);
+    du = PolyEval(d, n - 1, u, (double *)0);
+    if (fu == 0.) {
+	s[ num++ ] = u;
+	if (first)
+	    return num;
+    }
+    for (i = 0; i <= ni; ++i) {
+	v = i < ni ? infl[ i ] : hi;
+	fv = PolyEval(c, n, v, (double *)0);
+	dv = PolyEval(d, n - 1, v, (double *)0);
+
+	/*
+	 * Split the piece at the extremum unless the ends already
+	 * bracket its only root.
+	 */
+	k = 0;
+	if ((fu == 0. || fv == 0. || (fu < 0.) == (fv < 0.)) &&
+	    du != 0. && dv != 0. && (du < 0.) != (dv < 0.))
+	    end[ k++ ] = PolyPolish(d, n - 1, u, v, du, dv);
+	end[ k++ ] = v;
+
+	a = u;
+	fa = fu;
+	for (j = 0; j < k; ++j) {
+	    b = end[ j ];
+	    if (j < k - 1) {
+		fb = PolyEval(c, n, b, &mag);
+		if (fabs(fb) <= ROOT_EPS * mag)
+		    fb = 0.;
+	    } else
+		fb = fv;
+	    if (fb == 0.) {
+		if (b != a || fa != 0.)
+		    s[ num++ ] = b;
+	    } else if (fa != 0. && (fa < 0.) != (fb < 0.))
+		s[ num++ ] = PolyPolish(c, n, a, b, fa, fb);
+	    if (first && num)
+		return num;
+	    a = b;
+	    fa = fb;
+	}
+	u = v;
+	fu = fv;
+	du = dv;
+    }
+    return num;
+}
+
+/*
+ * Find the smallest root in [lo, hi] of the polynomial of degree
+ * n <= 4 with coefficients c.  Returns 1 and sets *root if there is
+ * one, 0 otherwise.  Ray intersection code knows the range of
+ * distances it cares about, so unlike SolveQuartic() this never
+ * computes roots outside of it and never loses a root to the
+ * cancellation in the closed-form solution.
+ */
+int SolvePolyRange(c, n, lo, hi, root)
+    double c[], lo, hi, *root;
+    int n;
+{
+    double s[ ROOT_MAXDEG ];
+
+    if (n > ROOT_MAXDEG || PolyRoots(c, n, lo, hi, s, TRUE) == 0)
+	return 0;
+    *root = s[ 0 ];
+    return 1;
+}
+
+/*
+ * Find all of the roots in [lo, hi] of the polynomial of degree
+ * n <= 4 with coefficients c, putting them into s in increasing
+ * order.  Returns the number of roots found.  For callers that must
+ * pass over roots that SolvePolyRange() would report first.
+ */
+int SolvePolyRangeAll(c, n, lo, hi, s)
+    double c[], lo, hi, s[];
+    int n;
+{
+    if (n > ROOT_MAXDEG)
+	return 0;
+    return PolyRoots(c, n, lo, hi, s, FALSE);
+}
@@ -33,6 +33,9 @@ static char sphereName[] = "sphere";
 
 unsigned long SphTests, SphHits;
 
+#define RowDot(m, i, j)	((m)[i][0]*(m)[j][0] + (m)[i][1]*(m)[j][1] + \
+			 (m)[i][2]*(m)[j][2])
+
 /*
  * Create & return reference to a sphere.
  */
@@ -74,6 +77,7 @@ SphereMethods()
 		iSphereMethods->uv = SphereUV;
 		iSphereMethods->enter = SphereEnter;
 		iSphereMethods->bounds = SphereBounds;
+		iSphereMethods->xform = SphereXform;
 		iSphereMethods->stats = SphereStats;
 		iSphereMethods->checkbounds = TRUE;
 		iSphereMethods->closed = TRUE;
@@ -224,6 +228,45 @@ Float bounds[2][3];
 	bounds[HIGH][Z] = s->z + s->r;
 }
 
+/*
+ * Move the sphere by the given transformation, provided that it
+ * is a similarity (rotation, uniform scale and translation) and so
+ * leaves it a sphere.  Returns FALSE if it is not.
+ */
+int
+SphereXform(sphere, trans)
+Sphere *sphere;
+Trans *trans;
+{
+	RSMatrix *m;
+	Vector pos;
+	Float s, d;
+	int i, j;
+
+	m = &trans->trans;
+	s = RowDot(m->matrix, 0, 0);
+	for (i = 0; i < 3; i++) {
+		for (j = i; j < 3; j++) {
+			d = RowDot(m->matrix, i, j);
+			if (i == j)
+				d -= s;
+			if (fabs(d) > s * EPSILON * EPSILON)
+				return FALSE;
+		}
+	}
+
+	pos.x = sphere->x;
+	pos.y = sphere->y;
+	pos.z = sphere->z;
+	PointTransform(&pos, m);
+	sphere->x = pos.x;
+	sphere->y = pos.y;
+	sphere->z = pos.z;
+	sphere->r *= sqrt(s);
+	sphere->rsq = sphere->r * sphere->r;
+	return TRUE;
+}
+
 char *
 SphereName()
 {
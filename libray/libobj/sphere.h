@@ -41,7 +41,8 @@ typedef struct {
 
 extern Sphere	*SphereCreate();
 extern Methods	*SphereMethods();
-extern int	SphereIntersect(), SphereEnter(), SphereNormal();
+extern int	SphereIntersect(), SphereEnter(), SphereNormal(),
+		SphereXform();
 extern void	SphereBounds(), SphereUV(), SphereStats();
 extern char	*SphereName();
 
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "geom.h"
+#include "spheres.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+static Methods *iSphereSetMethods = NULL;
+static char spheresName[] = "spheres";
+
+unsigned long SphSetTests, SphSetHits;
+
+static int SphBlockIntersect();
+static void SphereSetGet();
+static struct Surface **SphereSetGrow();
+
+/*
+ * Create a set of spheres from the given list, freeing the list as we
+ * go.  Spheres given a surface of their own are shaded with it rather
+ * than with that of the set as a whole.
+ */
+SphereSet *
+SphereSetCreate(list, nspheres)
+SphereSetList *list;
+int nspheres;
+{
+	SphereSet *set;
+	SphereSetList *sp, *stmp;
+	SphBlock *blk;
+	Sphere *sph, *tmpsph;
+	struct Surface **surfs;
+	Float (*box)[2][3];
+	short *tmpsurf;
+	int i, n, ndegen, nsurfs, *order;
+
+	if (nspheres < 1) {
+		RLerror(RL_WARN, "Empty sphere set.\n");
+		return (SphereSet *)NULL;
+	}
+
+	/*
+	 * Copy the list into arrays, dropping degenerate spheres and
+	 * numbering the distinct surfaces given.  The list is in
+	 * reverse order, so fill the arrays from the top.
+	 */
+	tmpsph = (Sphere *)Malloc((unsigned)(nspheres*sizeof(Sphere)));
+	tmpsurf = (short *)Malloc((unsigned)(nspheres*sizeof(short)));
+	surfs = (struct Surface **)NULL;
+	n = nspheres;
+	ndegen = nsurfs = 0;
+	for (sp = list; sp != (SphereSetList *)NULL; sp = stmp) {
+		stmp = sp->next;
+		if (sp->r < EPSILON) {
+			ndegen++;
+			free((voidstar)sp);
+			continue;
+		}
+		sph = &tmpsph[--n];
+		sph->r = sp->r;
+		sph->rsq = sp->r * sp->r;
+		sph->x = sp->pos.x;
+		sph->y = sp->pos.y;
+		sph->z = sp->pos.z;
+		tmpsurf[n] = -1;
+		if (sp->surf) {
+			/*
+			 * Neighbouring spheres usually share a surface, so
+			 * search from the one most recently added.
+			 */
+			for (i = nsurfs - 1; i >= 0; i--)
+				if (surfs[i] == sp->surf)
+					break;
+			if (i < 0 && nsurfs < SPHERES_MAXSURF) {
+				if (nsurfs % 16 == 0)
+					surfs = SphereSetGrow(surfs, nsurfs);
+				surfs[nsurfs] = sp->surf;
+				i = nsurfs++;
+			} else if (i < 0)
+				RLerror(RL_WARN,
+				   "Too many sphere surfaces; using the set's.\n");
+			tmpsurf[n] = i;
+		}
+		free((voidstar)sp);
+	}
+	if (ndegen)
+		RLerror(RL_WARN, "%d degenerate sphere%s.\n", ndegen,
+			ndegen == 1 ? "" : "s");
+	if (n == nspheres) {
+		RLerror(RL_WARN, "Empty sphere set.\n");
+		free((voidstar)tmpsph);
+		free((voidstar)tmpsurf);
+		return (SphereSet *)NULL;
+	}
+
+	set = (SphereSet *)share_malloc(sizeof(SphereSet));
+	set->nspheres = nspheres - n;
+
+	/*
+	 * Build the hierarchy over the spheres, then pack them (and
+	 * their surface indices) into blocks in the order it gives.
+	 */
+	box = (Float (*)[2][3])Malloc((unsigned)
+			(set->nspheres*sizeof(Float [2][3])));
+	for (i = 0; i < set->nspheres; i++)
+		SphereBounds(&tmpsph[n + i], box[i]);
+	order = (int *)Malloc((unsigned)(set->nspheres*sizeof(int)));
+	set->nodes = BoundsTreeBuild(box, set->nspheres, SPHBLOCK_SIZE,
+				     order, &set->nnodes);
+	free((voidstar)box);
+
+	set->nblocks = (set->nspheres + SPHBLOCK_SIZE - 1) / SPHBLOCK_SIZE;
+	set->blocks = (SphBlock *)Calloc((unsigned)set->nblocks,
+					 sizeof(SphBlock));
+	for (i = 0; i < set->nspheres; i++) {
+		blk = &set->blocks[i / SPHBLOCK_SIZE];
+		sph = &tmpsph[n + order[i]];
+		blk->x[blk->n] = sph->x;
+		blk->y[blk->n] = sph->y;
+		blk->z[blk->n] = sph->z;
+		blk->r[blk->n] = sph->r;
+		blk->rsq[blk->n] = sph->rsq;
+		blk->n++;
+	}
+	set->nsurfs = nsurfs;
+	set->surfs = surfs;
+	if (nsurfs > 0) {
+		set->surf = (short *)Malloc((unsigned)
+				(set->nspheres*sizeof(short)));
+		for (i = 0; i < set->nspheres; i++)
+			set->surf[i] = tmpsurf[n + order[i]];
+	} else
+		set->surf = (short *)NULL;
+	free((voidstar)order);
+	free((voidstar)tmpsph);
+	free((voidstar)tmpsurf);
+
+	set->hit = 0;
+	return set;
+}
+
+/*
+ * Make room for 16 more surfaces in the given table of n.
+ */
+static struct Surface **
+SphereSetGrow(surfs, n)
+struct Surface **surfs;
+int n;
+{
+	struct Surface **new;
+
+	new = (struct Surface **)Malloc((unsigned)
+			((n + 16)*sizeof(struct Surface *)));
+	if (surfs) {
+		bcopy((char *)surfs, (char *)new,
+			n*sizeof(struct Surface *));
+		free((voidstar)surfs);
+	}
+	return new;
+}
+
+Methods *
+SphereSetMethods()
+{
+	if (iSphereSetMethods == (Methods *)NULL) {
+		iSphereSetMethods = MethodsCreate();
+		iSphereSetMethods->create = (GeomCreateFunc *)SphereSetCreate;
+		iSphereSetMethods->methods = SphereSetMethods;
+		iSphereSetMethods->name = SphereSetName;
+		iSphereSetMethods->intersect = SphereSetIntersect;
+		iSphereSetMethods->normal = SphereSetNormal;
+		iSphereSetMethods->uv = SphereSetUV;
+		iSphereSetMethods->enter = SphereSetEnter;
+		iSphereSetMethods->surface = SphereSetSurface;
+		iSphereSetMethods->bounds = SphereSetBounds;
+		iSphereSetMethods->stats = SphereSetStats;
+		iSphereSetMethods->checkbounds = TRUE;
+		iSphereSetMethods->closed = TRUE;
+	}
+	return iSphereSetMethods;
+}
+
+/*
+ * Intersect ray with set by walking the sphere hierarchy, nearer
+ * child first, narrowing maxdist as the blocks of spheres in the
+ * leaves are hit.
+ */
+int
+SphereSetIntersect(set, ray, mindist, maxdist)
+SphereSet *set;
+Ray *ray;
+Float mindist, *maxdist;
+{
+	BoundsWalk walk;
+	BoundsNode *np;
+	int lane, hit;
+
+	SphSetTests++;
+	BoundsWalkInit(&walk, ray);
+	hit = FALSE;
+	while ((np = BoundsWalkNext(&walk, set->nodes, mindist, *maxdist))
+	       != (BoundsNode *)NULL) {
+		lane = SphBlockIntersect(&set->blocks[np->first /
+				SPHBLOCK_SIZE], ray, mindist, maxdist);
+		if (lane >= 0) {
+			set->hit = np->first + lane;
+			hit = TRUE;
+		}
+	}
+	if (hit)
+		SphSetHits++;
+	return hit;
+}
+
+/*
+ * Test ray against every sphere of the block.  The quadratic for each
+ * lane is set up in a straight-line loop over fixed-length arrays, which
+ * the compiler is free to turn into vector code; the roots are then
+ * taken lane by lane exactly as SphereIntersect() takes them.  Returns
+ * the lane of the nearest hit, with *maxdist set, or -1.
+ */
+static int
+SphBlockIntersect(blk, ray, mindist, maxdist)
+SphBlock *blk;
+Ray *ray;
+Float mindist, *maxdist;
+{
+	Float b[SPHBLOCK_SIZE], t[SPHBLOCK_SIZE];
+	Float xadj, yadj, zadj, s;
+	int i, hit;
+
+	for (i = 0; i < SPHBLOCK_SIZE; i++) {
+		xadj = blk->x[i] - ray->pos.x;
+		yadj = blk->y[i] - ray->pos.y;
+		zadj = blk->z[i] - ray->pos.z;
+		b[i] = xadj * ray->dir.x + yadj * ray->dir.y +
+			zadj * ray->dir.z;
+		t[i] = b[i] * b[i] - xadj * xadj - yadj * yadj -
+			zadj * zadj + blk->rsq[i];
+	}
+
+	hit = -1;
+	for (i = 0; i < blk->n; i++) {
+		if (t[i] < 0.)
+			continue;
+		t[i] = (Float)sqrt((double)t[i]);
+		s = b[i] - t[i];
+		if (s <= mindist)
+			s = b[i] + t[i];
+		if (s > mindist && s < *maxdist) {
+			*maxdist = s;
+			hit = i;
+		}
+	}
+	return hit;
+}
+
+/*
+ * Set sph to the ith sphere of the set.
+ */
+static void
+SphereSetGet(set, i, sph)
+SphereSet *set;
+int i;
+Sphere *sph;
+{
+	SphBlock *blk;
+	int lane;
+
+	blk = &set->blocks[i / SPHBLOCK_SIZE];
+	lane = i % SPHBLOCK_SIZE;
+	sph->x = blk->x[lane];
+	sph->y = blk->y[lane];
+	sph->z = blk->z[lane];
+	sph->r = blk->r[lane];
+	sph->rsq = blk->rsq[lane];
+}
+
+int
+SphereSetNormal(set, pos, nrm, gnrm)
+SphereSet *set;
+Vector *pos, *nrm, *gnrm;
+{
+	Sphere sph;
+
+	SphereSetGet(set, set->hit, &sph);
+	return SphereNormal(&sph, pos, nrm, gnrm);
+}
+
+int
+SphereSetEnter(set, ray, mind, hitd)
+SphereSet *set;
+Ray *ray;
+Float mind, hitd;
+{
+	Sphere sph;
+
+	SphereSetGet(set, set->hit, &sph);
+	return SphereEnter(&sph, ray, mind, hitd);
+}
+
+void
+SphereSetUV(set, pos, norm, uv, dpdu, dpdv)
+SphereSet *set;
+Vector *pos, *norm, *dpdu, *dpdv;
+Vec2d *uv;
+{
+	Sphere sph;
+
+	SphereSetGet(set, set->hit, &sph);
+	SphereUV(&sph, pos, norm, uv, dpdu, dpdv);
+}
+
+struct Surface *
+SphereSetSurface(set)
+SphereSet *set;
+{
+	if (set->surf == (short *)NULL || set->surf[set->hit] < 0)
+		return (struct Surface *)NULL;
+	return set->surfs[set->surf[set->hit]];
+}
+
+void
+SphereSetBounds(set, bounds)
+SphereSet *set;
+Float bounds[2][3];
+{
+	Sphere sph;
+	Float sb[2][3];
+	int i;
+
+	BoundsInit(bounds);
+	for (i = 0; i < set->nspheres; i++) {
+		SphereSetGet(set, i, &sph);
+		SphereBounds(&sph, sb);
+		BoundsEnlarge(bounds, sb);
+	}
+}
+
+char *
+SphereSetName()
+{
+	return spheresName;
+}
+
+void
+SphereSetStats(tests, hits)
+unsigned long *tests, *hits;
+{
+	*tests = SphSetTests;
+	*hits = SphSetHits;
+}
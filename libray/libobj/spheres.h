@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef SPHERES_H
+#define SPHERES_H
+
+#include "sphere.h"
+
+#define GeomSphereSetCreate(l,n) GeomCreate((GeomRef)SphereSetCreate(l,n), \
+					SphereSetMethods())
+
+#define SPHBLOCK_SIZE		4	/* spheres per SphBlock */
+#define SPHERES_MAXSURF		32767	/* max. distinct per-sphere surfaces */
+
+/*
+ * Block of spheres held structure-of-arrays, so that one ray can
+ * be tested against all of them at once.
+ */
+typedef struct {
+	Float x[SPHBLOCK_SIZE], y[SPHBLOCK_SIZE], z[SPHBLOCK_SIZE],
+	      r[SPHBLOCK_SIZE], rsq[SPHBLOCK_SIZE];
+	int n;			/* lanes in use */
+} SphBlock;
+
+/*
+ * A set of spheres.  The spheres are kept only in blocks:  sphere i
+ * is lane i % SPHBLOCK_SIZE of blocks[i / SPHBLOCK_SIZE], and the
+ * spheres of each leaf of the hierarchy make up one block.  Shading
+ * is done by the Sphere methods applied to the sphere last hit.
+ */
+typedef struct {
+	SphBlock *blocks;	/* the spheres */
+	short *surf;		/* index into surfs of each, or NULL */
+	struct Surface **surfs;	/* distinct per-sphere surfaces */
+	BoundsNode *nodes;	/* sphere hierarchy, nodes[0] is the root */
+	int nspheres, nsurfs, nnodes, nblocks;
+	int hit;		/* index of sphere last hit */
+} SphereSet;
+
+/*
+ * Spheres as built by the parser, in reverse order.  The list is
+ * freed by SphereSetCreate().
+ */
+typedef struct SphereSetList {
+	Float r;
+	Vector pos;
+	struct Surface *surf;	/* surface, or NULL for the set's */
+	struct SphereSetList *next;
+} SphereSetList;
+
+extern SphereSet *SphereSetCreate();
+extern Methods	*SphereSetMethods();
+extern int	SphereSetIntersect(), SphereSetEnter(), SphereSetNormal();
+extern void	SphereSetBounds(), SphereSetUV(), SphereSetStats();
+extern char	*SphereSetName();
+extern struct Surface *SphereSetSurface();
+
+#endif /* SPHERES_H */
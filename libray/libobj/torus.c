@@ -32,6 +32,8 @@ static Methods *iTorusMethods = NULL;
 static char torusName[] = "torus";
 unsigned long TorusTests, TorusHits;
 
+extern int SolvePolyRange(), SolvePolyRangeAll();
+
 /*
  * Create & return reference to a torus.
  */
@@ -79,9 +81,9 @@ Ray *inray;
 Float mindist, *maxdist;
 {
 	Vector pos,ray;
-	double c[5],s[4], dist, nmin;
+	double c[5], s[4], dist, nmin, nmax, b, disc;
 	Float distfactor;
-	register int num,i;
+	int i, n;
 
 	TorusTests++;
 
@@ -93,8 +95,46 @@ Float mindist, *maxdist;
 		ray = tmpray.dir;
 		pos = tmpray.pos;
 		nmin = mindist * distfactor;
+		nmax = *maxdist * distfactor;
 	}
 
+	/*
+	 * Clip the ray to the bounding sphere of radius a+b and to the
+	 * slab |z| <= b.  Besides rejecting most misses cheaply, this
+	 * bounds the interval in which the root finder need look.
+	 */
+	b = dotp(&pos, &ray);
+	disc = torus->a + torus->b;
+	disc = b*b - dotp(&pos, &pos) + disc*disc;
+	if (disc <= 0.)
+		return FALSE;
+	disc = sqrt(disc);
+	if (-b - disc > nmin)
+		nmin = -b - disc;
+	if (-b + disc < nmax)
+		nmax = -b + disc;
+	if (ray.z != 0.) {
+		double t1, t2;
+		t1 = (-torus->b - pos.z) / ray.z;
+		t2 = (torus->b - pos.z) / ray.z;
+		if (t1 > t2) {
+			b = t1; t1 = t2; t2 = b;
+		}
+		if (t1 > nmin)
+			nmin = t1;
+		if (t2 < nmax)
+			nmax = t2;
+	} else if (pos.z > torus->b || pos.z < -torus->b)
+		return FALSE;
+	if (nmin >= nmax)
+		return FALSE;
+
+	/*
+	 * Move the origin up to the start of the interval; the
+	 * coefficients are better conditioned near the torus.
+	 */
+	VecAddScaled(pos, nmin, ray, &pos);
+
 	/*
  * Original Equations for Toroid with position of (0,0,0) and axis (0,0,1)
  *
@@ -164,26 +204,26 @@ Float mindist, *maxdist;
 		c[0] =   g0s * g0s  +  4.0 * as * (z0s - bs);
 	}
 
-	/* use GraphGem's Solve Quartic to find roots */
-	num = SolveQuartic(c,s);
+	/* find the nearest root in the clipped interval */
+	if (!SolvePolyRange(c, 4, 0., nmax - nmin, &dist))
+		return FALSE;
 
-	/* no roots - return 0. */
-	if (num==0) return FALSE;
-
-	/* of roots return the smallest root > EPSILON */
-	dist = 0.0;
-	for(i=0;i<num;i++)
-	{
-		/* if root is in front of ray origin */
-		if (s[i] > nmin) {
-			/* first valid root */
-			if (dist == 0.0) dist = s[i];
-			/* else update only if it's closer to ray origin */
-			else if (s[i] < dist) dist = s[i];
+	dist = (nmin + dist) / distfactor;
+	if (dist <= mindist) {
+		/*
+		 * The nearest root is too near, most likely because the
+		 * ray leaves the torus's surface; look beyond it.
+		 */
+		n = SolvePolyRangeAll(c, 4, 0., nmax - nmin, s);
+		for (i = 0; i < n; i++) {
+			dist = (nmin + s[i]) / distfactor;
+			if (dist > mindist)
+				break;
 		}
+		if (i == n)
+			return FALSE;
 	}
-	dist /= distfactor;
-	if (dist > mindist && dist < *maxdist) {
+	if (dist < *maxdist) {
 		*maxdist = dist;
 		TorusHits++;
 		return TRUE;
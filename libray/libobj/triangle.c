@@ -33,7 +33,7 @@ static char triName[] = "triangle";
 
 unsigned long TriTests, TriHits;
 
-static void TriangleSetdPdUV();
+static void TriangleEdges();
 
 /*
  * Create and return reference to a triangle.
@@ -46,8 +46,7 @@ Vec2d	*u1, *u2, *u3;
 int flipflag;
 {
 	Triangle *triangle;
-	Vector ptmp, anorm;
-	Float d;
+	Vector ptmp;
 
 	/*
 	 * Allocate new triangle and primitive to point to it.
@@ -131,33 +130,80 @@ int flipflag;
 		triangle->uv = (Vec2d *)NULL;
 	}
 
-	/*
-	 * Find "dominant" part of normal vector.
-	 */
-	anorm.x = fabs(ptmp.x);
-	anorm.y = fabs(ptmp.y);
-	anorm.z = fabs(ptmp.z);
+	TriangleEdges(triangle, &ptmp);
+
+	return triangle;
+}
+
+/*
+ * Find "dominant" part of the (unnormalized) normal vector ptmp, and
+ * scale the edges by it.  This makes intersection testing a bit faster.
+ */
+static void
+TriangleEdges(triangle, ptmp)
+Triangle *triangle;
+Vector *ptmp;
+{
+	Vector anorm;
+	Float d;
+
+	anorm.x = fabs(ptmp->x);
+	anorm.y = fabs(ptmp->y);
+	anorm.z = fabs(ptmp->z);
 
-	/*
-	 * Scale edges by dominant part of normal.  This makes intersection
-	 * testing a bit faster.
-	 */ 
 	if (anorm.x > anorm.y && anorm.x > anorm.z) {
 		triangle->index = XNORMAL;
-		d = 1. / ptmp.x;
+		d = 1. / ptmp->x;
 	} else if (anorm.y > anorm.z) {
 		triangle->index = YNORMAL;
-		d = 1. / ptmp.y;
+		d = 1. / ptmp->y;
 	} else {
 		triangle->index = ZNORMAL;
-		d = 1. /ptmp.z;
+		d = 1. / ptmp->z;
 	}
 
 	VecScale(d, triangle->e[0], &triangle->e[0]);
 	VecScale(d, triangle->e[1], &triangle->e[1]);
 	VecScale(d, triangle->e[2], &triangle->e[2]);
+}
 
-	return triangle;
+/*
+ * Move the triangle by the given transformation.  Normals are carried
+ * along by the inverse transpose, so that they keep their sense.
+ */
+int
+TriangleXform(tri, trans)
+Triangle *tri;
+Trans *trans;
+{
+	Vector p[3], e[3], ptmp;
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		p[i] = tri->p[i];
+		PointTransform(&p[i], &trans->trans);
+	}
+	VecSub(p[1], p[0], &e[0]);
+	VecSub(p[2], p[1], &e[1]);
+	VecSub(p[0], p[2], &e[2]);
+	VecCross(&e[0], &e[1], &ptmp);
+	if (ptmp.x == 0. && ptmp.y == 0. && ptmp.z == 0.)
+		return FALSE;
+
+	for (i = 0; i < 3; i++) {
+		tri->p[i] = p[i];
+		tri->e[i] = e[i];
+	}
+	TriangleEdges(tri, &ptmp);
+	NormalTransform(&tri->nrm, &trans->itrans);
+	tri->d = dotp(&tri->nrm, &tri->p[0]);
+	if (tri->type == PHONGTRI) {
+		for (i = 0; i < 3; i++)
+			NormalTransform(&tri->vnorm[i], &trans->itrans);
+	}
+	if (tri->uv)
+		TriangleSetdPdUV(tri->p, tri->uv, tri->dpdu, tri->dpdv);
+	return TRUE;
 }
 
 Methods *
@@ -172,6 +218,7 @@ TriangleMethods()
 		iTriangleMethods->normal = TriangleNormal;
 		iTriangleMethods->uv = TriangleUV;
 		iTriangleMethods->bounds = TriangleBounds;
+		iTriangleMethods->xform = TriangleXform;
 		iTriangleMethods->stats = TriangleStats;
 		iTriangleMethods->checkbounds = TRUE;
 		iTriangleMethods->closed = FALSE;
@@ -180,8 +227,9 @@ TriangleMethods()
 }
 
 /*
- * Intersect ray with triangle.  This is an optimized version of the
- * intersection routine from Snyder and Barr's '87 SIGGRAPH paper.
+ * Intersect ray with triangle, using the watertight test of Woop,
+ * Benthin and Wald (JCGT, 2013):  a ray passing through an edge
+ * shared by two triangles hits exactly one of them.
  */
 int
 TriangleIntersect(tri, ray, mindist, maxdist)
@@ -189,78 +237,205 @@ Triangle *tri;
 Ray *ray;
 Float mindist, *maxdist;
 {
-	Float qi1, qi2, s, k, b0, b1, b2;
-	Vector pos, dir;
+	TriRay tr;
 
 	TriTests++;
-	pos = ray->pos;
-	dir = ray->dir;
-	/*
-	 * Plane intersection.
-	 */
-	k = dotp(&tri->nrm, &dir);
-	if (fabs(k) < EPSILON)
-		return FALSE;
-	s = (tri->d - dotp(&tri->nrm, &pos)) / k;
-	if (s < mindist || s > *maxdist)
+	TriRaySetup(ray, &tr);
+	if (!TriRayIntersect(&tr, &tri->p[0], &tri->p[1], &tri->p[2],
+			     mindist, maxdist, tri->b))
 		return FALSE;
-	
-	if (tri->index == XNORMAL) {
-		qi1 = pos.y + s * dir.y;
-		qi2 = pos.z + s * dir.z;
-		b0 = tri->e[1].y * (qi2 - tri->p[1].z) -
-				tri->e[1].z * (qi1 - tri->p[1].y);
-		if (b0 < 0. || b0 > 1.)
-			return FALSE;
-		b1 = tri->e[2].y * (qi2 - tri->p[2].z) -
-				tri->e[2].z * (qi1 - tri->p[2].y);
-		if (b1 < 0. || b1 > 1.)
-			return FALSE;
-		b2 = tri->e[0].y * (qi2 - tri->p[0].z) -
-				tri->e[0].z * (qi1 - tri->p[0].y);
-		if (b2 < 0. || b2 > 1.)
-			return FALSE;
-	} else if (tri->index == YNORMAL) {
-		qi1 = pos.x + s * dir.x;
-		qi2 = pos.z + s * dir.z;
-		b0 = tri->e[1].z * (qi1 - tri->p[1].x) -
-			tri->e[1].x * (qi2 - tri->p[1].z);
-		if (b0 < 0. || b0 > 1.)
-			return FALSE;
-		b1 = tri->e[2].z * (qi1 - tri->p[2].x) -
-			tri->e[2].x * (qi2 - tri->p[2].z);
-		if (b1 < 0. || b1 > 1.)
-			return FALSE;
-		b2 = tri->e[0].z * (qi1 - tri->p[0].x) -
-			tri->e[0].x * (qi2 - tri->p[0].z);
-		if (b2 < 0. || b2 > 1.)
-			return FALSE;
-	} else {
-		qi1 = pos.x + s * dir.x;
-		qi2 = pos.y + s * dir.y;
-		b0 = tri->e[1].x * (qi2 - tri->p[1].y) -
-			tri->e[1].y * (qi1 - tri->p[1].x);
-		if (b0 < 0. || b0 > 1.)
-			return FALSE;
-		b1 = tri->e[2].x * (qi2 - tri->p[2].y) -
-				tri->e[2].y * (qi1 - tri->p[2].x);
-		if (b1 < 0. || b1 > 1.)
-			return FALSE;
-		b2 = tri->e[0].x * (qi2 - tri->p[0].y) -
-				tri->e[0].y * (qi1 - tri->p[0].x);
-		if (b2 < 0. || b2 > 1.)
-			return FALSE;
+	TriHits++;
+	return TRUE;
+}
+
+/*
+ * Set up the given ray for triangle testing.  The axis along which
+ * the direction is largest becomes kz; kx and ky are swapped if need
+ * be to preserve the winding of the vertices.
+ */
+void
+TriRaySetup(ray, tr)
+Ray *ray;
+TriRay *tr;
+{
+	Float dir[3], ax, ay, az;
+
+	dir[X] = ray->dir.x;
+	dir[Y] = ray->dir.y;
+	dir[Z] = ray->dir.z;
+	tr->org[X] = ray->pos.x;
+	tr->org[Y] = ray->pos.y;
+	tr->org[Z] = ray->pos.z;
+
+	ax = fabs(dir[X]);
+	ay = fabs(dir[Y]);
+	az = fabs(dir[Z]);
+	if (ax > ay && ax > az)
+		tr->kz = X;
+	else if (ay > az)
+		tr->kz = Y;
+	else
+		tr->kz = Z;
+	tr->kx = (tr->kz + 1) % 3;
+	tr->ky = (tr->kx + 1) % 3;
+	if (dir[tr->kz] < 0.) {
+		int tmp = tr->kx;
+		tr->kx = tr->ky;
+		tr->ky = tmp;
 	}
+	tr->sx = dir[tr->kx] / dir[tr->kz];
+	tr->sy = dir[tr->ky] / dir[tr->kz];
+	tr->sz = 1. / dir[tr->kz];
+}
 
-	tri->b[0] = b0;
-	tri->b[1] = b1;
-	tri->b[2] = b2;
+/*
+ * Test a set-up ray against the triangle p0 p1 p2.  On a hit between
+ * mindist and *maxdist, *maxdist is set to the distance and b[] to
+ * the barycentric coordinates of the hit with respect to each vertex.
+ * TriBlockIntersect() must do exactly the same arithmetic, lane by lane.
+ */
+int
+TriRayIntersect(tr, p0, p1, p2, mindist, maxdist, b)
+TriRay *tr;
+Vector *p0, *p1, *p2;
+Float mindist, *maxdist, b[3];
+{
+	Float a[3], bb[3], c[3];
+	Float ax, ay, az, bx, by, bz, cx, cy, cz, u, v, w, det, t;
+
+	a[X] = p0->x; a[Y] = p0->y; a[Z] = p0->z;
+	bb[X] = p1->x; bb[Y] = p1->y; bb[Z] = p1->z;
+	c[X] = p2->x; c[Y] = p2->y; c[Z] = p2->z;
+
+	az = a[tr->kz] - tr->org[tr->kz];
+	bz = bb[tr->kz] - tr->org[tr->kz];
+	cz = c[tr->kz] - tr->org[tr->kz];
+	ax = (a[tr->kx] - tr->org[tr->kx]) - tr->sx * az;
+	ay = (a[tr->ky] - tr->org[tr->ky]) - tr->sy * az;
+	bx = (bb[tr->kx] - tr->org[tr->kx]) - tr->sx * bz;
+	by = (bb[tr->ky] - tr->org[tr->ky]) - tr->sy * bz;
+	cx = (c[tr->kx] - tr->org[tr->kx]) - tr->sx * cz;
+	cy = (c[tr->ky] - tr->org[tr->ky]) - tr->sy * cz;
+
+	u = cx * by - cy * bx;
+	v = ax * cy - ay * cx;
+	w = bx * ay - by * ax;
+	if ((u < 0. || v < 0. || w < 0.) && (u > 0. || v > 0. || w > 0.))
+		return FALSE;
+	det = u + v + w;
+	if (det == 0.)
+		return FALSE;
+	t = (u * tr->sz * az + v * tr->sz * bz + w * tr->sz * cz) / det;
+	if (t < mindist || t > *maxdist)
+		return FALSE;
 
-	TriHits++;
-	*maxdist = s;
+	b[0] = u / det;
+	b[1] = v / det;
+	b[2] = w / det;
+	*maxdist = t;
 	return TRUE;
 }
 
+void
+TriBlockInit(blk)
+TriBlock *blk;
+{
+	int i, j, k;
+
+	for (i = 0; i < 3; i++)
+		for (j = 0; j < 3; j++)
+			for (k = 0; k < TRIBLOCK_SIZE; k++)
+				blk->v[i][j][k] = 0.;
+	blk->n = 0;
+}
+
+/*
+ * Add the triangle p0 p1 p2 to the next free lane of the block.
+ */
+void
+TriBlockAdd(blk, p0, p1, p2)
+TriBlock *blk;
+Vector *p0, *p1, *p2;
+{
+	int i;
+
+	i = blk->n++;
+	blk->v[0][X][i] = p0->x; blk->v[0][Y][i] = p0->y; blk->v[0][Z][i] = p0->z;
+	blk->v[1][X][i] = p1->x; blk->v[1][Y][i] = p1->y; blk->v[1][Z][i] = p1->z;
+	blk->v[2][X][i] = p2->x; blk->v[2][Y][i] = p2->y; blk->v[2][Z][i] = p2->z;
+}
+
+/*
+ * Test a set-up ray against every triangle of the block.  The lanes
+ * are computed in straight-line loops over fixed-length arrays, which
+ * the compiler is free to turn into vector code; the nearest hit is
+ * then picked out among the lanes whose bit is set in mask.  Returns
+ * the lane hit, with *maxdist and b[] set as for TriRayIntersect(),
+ * or -1.
+ */
+int
+TriBlockIntersect(blk, tr, mask, mindist, maxdist, b)
+TriBlock *blk;
+TriRay *tr;
+int mask;
+Float mindist, *maxdist, b[3];
+{
+	Float u[TRIBLOCK_SIZE], v[TRIBLOCK_SIZE], w[TRIBLOCK_SIZE];
+	Float det[TRIBLOCK_SIZE], t[TRIBLOCK_SIZE];
+	Float ax, ay, az, bx, by, bz, cx, cy, cz;
+	Float *a[3], *bb[3], *c[3], ox, oy, oz, sx, sy, sz;
+	int i, hit;
+
+	for (i = 0; i < 3; i++) {
+		a[i] = blk->v[0][i];
+		bb[i] = blk->v[1][i];
+		c[i] = blk->v[2][i];
+	}
+	ox = tr->org[tr->kx]; oy = tr->org[tr->ky]; oz = tr->org[tr->kz];
+	sx = tr->sx; sy = tr->sy; sz = tr->sz;
+
+	for (i = 0; i < TRIBLOCK_SIZE; i++) {
+		az = a[tr->kz][i] - oz;
+		bz = bb[tr->kz][i] - oz;
+		cz = c[tr->kz][i] - oz;
+		ax = (a[tr->kx][i] - ox) - sx * az;
+		ay = (a[tr->ky][i] - oy) - sy * az;
+		bx = (bb[tr->kx][i] - ox) - sx * bz;
+		by = (bb[tr->ky][i] - oy) - sy * bz;
+		cx = (c[tr->kx][i] - ox) - sx * cz;
+		cy = (c[tr->ky][i] - oy) - sy * cz;
+		u[i] = cx * by - cy * bx;
+		v[i] = ax * cy - ay * cx;
+		w[i] = bx * ay - by * ax;
+		det[i] = u[i] + v[i] + w[i];
+		t[i] = u[i] * sz * az + v[i] * sz * bz + w[i] * sz * cz;
+	}
+
+	hit = -1;
+	for (i = 0; i < blk->n; i++) {
+		if (!(mask & (1 << i)))
+			continue;
+		TriTests++;
+		if ((u[i] < 0. || v[i] < 0. || w[i] < 0.) &&
+		    (u[i] > 0. || v[i] > 0. || w[i] > 0.))
+			continue;
+		if (det[i] == 0.)
+			continue;
+		t[i] /= det[i];
+		if (t[i] < mindist || t[i] > *maxdist)
+			continue;
+		*maxdist = t[i];
+		hit = i;
+	}
+	if (hit < 0)
+		return -1;
+
+	b[0] = u[hit] / det[hit];
+	b[1] = v[hit] / det[hit];
+	b[2] = w[hit] / det[hit];
+	return hit;
+}
+
 int
 TriangleNormal(tri, pos, nrm, gnrm)
 Triangle *tri;
@@ -376,7 +551,7 @@ unsigned long *tests, *hits;
  * Given three vertices of a triangle and the uv coordinates associated
  * with each, compute directions of u and v axes.
  */
-static void
+void
 TriangleSetdPdUV(p, t, dpdu, dpdv)
 Vector p[3];			/* Triangle vertices */
 Vec2d t[3];			/* uv coordinates for each vertex */
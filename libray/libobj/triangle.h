@@ -50,10 +50,34 @@ typedef struct {
 		type;		/* type (to detect if phong or flat) */
 } Triangle;
 
+#define TRIBLOCK_SIZE	4	/* triangles per TriBlock */
+
+/*
+ * Ray set up for the watertight triangle test:  vertices are taken
+ * relative to the ray origin and sheared so the ray runs along +kz.
+ */
+typedef struct {
+	int	kx, ky, kz;	/* permuted axes */
+	Float	org[3],		/* ray origin */
+		sx, sy, sz;	/* shear constants */
+} TriRay;
+
+/*
+ * Block of triangles held structure-of-arrays, so that one ray can
+ * be tested against all of them at once.  v[vertex][axis][lane].
+ * Unused lanes are degenerate and are never hit.
+ */
+typedef struct {
+	Float	v[3][3][TRIBLOCK_SIZE];
+	int	n;		/* lanes in use */
+} TriBlock;
+
 extern Triangle	*TriangleCreate();
-extern int	TriangleIntersect(), TriangleNormal();
+extern int	TriangleIntersect(), TriangleNormal(), TriangleXform();
 extern void	TriangleBounds(), TriangleUV(),
-		TriangleStats();
+		TriangleStats(), TriangleSetdPdUV(),
+		TriRaySetup(), TriBlockInit(), TriBlockAdd();
+extern int	TriRayIntersect(), TriBlockIntersect();
 extern Methods	*TriangleMethods();
 char		*TriangleName();
 #endif /* TRIANGLE_H */
@@ -54,14 +54,17 @@ Atmosphere *atmos;
 	return res;
 }
 
+/*
+ * Push a medium onto the stack 'media'.  The caller supplies the
+ * storage, 'new', which must live as long as the rays that are
+ * traced through the medium -- normally a local of the function
+ * that spawns them, so that the stack unwinds with the recursion.
+ */
 Medium *
-MediumPush(index, statten, media)
+MediumPush(index, statten, media, new)
 Float index, statten;
-Medium *media;
+Medium *media, *new;
 {
-	Medium *new;
-
-	new = (Medium *)Malloc(sizeof(Medium));
 	new->index = index;
 	new->statten = statten;
 	new->next = media;
@@ -27,6 +27,7 @@
  */
 #include "atmosphere.h"
 #include "surface.h"
+#include "libcommon/hash.h"
 
 #define blend(a, b, p, q)	(a * p + b * q)
 
@@ -79,6 +80,32 @@ Surface *surf;
 	return res;
 }
 
+/*
+ * Fold the properties of a surface, or NULL, into a hash key.
+ * The name is left out, as it does not change how the surface looks.
+ */
+unsigned long
+SurfaceHash(key, surf)
+unsigned long key;
+Surface *surf;
+{
+	if (!surf)
+		return HashBytes(key, "-", 1);
+	key = HashColor(key, &surf->amb);
+	key = HashColor(key, &surf->diff);
+	key = HashColor(key, &surf->spec);
+	key = HashColor(key, &surf->translu);
+	key = HashColor(key, &surf->body);
+	key = HashFloat(key, surf->srexp);
+	key = HashFloat(key, surf->stexp);
+	key = HashFloat(key, surf->statten);
+	key = HashFloat(key, surf->index);
+	key = HashFloat(key, surf->reflect);
+	key = HashFloat(key, surf->transp);
+	key = HashFloat(key, surf->translucency);
+	return HashInt(key, (int)surf->noshadow);
+}
+
 /*
  * Compute combination of two surfaces. Resulting surface is copied into surf1.
  */
@@ -70,4 +70,6 @@ extern void	SurfaceBlend(), ColorBlend();
 
 extern int	ComputeSurfProps();
 
+extern unsigned long SurfaceHash();
+
 #endif /* SURFACE_H */
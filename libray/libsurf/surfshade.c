@@ -31,14 +31,20 @@
 /*
  * Compute surface properties from given hitlist
  * Returns TRUE if ray is entering object, FALSE otherwise.
+ *
+ * On entry, *surf points to the surface to use, which is only read.
+ * If a texture is to modify it, it is first copied to 'copy' and
+ * *surf is pointed there instead, so that untextured hits -- the
+ * common case -- need not copy the surface at all.
  */
 int
-ComputeSurfProps(hitlist, ray, pos, norm, gnorm, surf, smooth)
+ComputeSurfProps(hitlist, ray, pos, norm, gnorm, surf, copy, smooth)
 HitList *hitlist;	/* Hit information (path through DAG) */
 Ray *ray;		/* Ray in world space */
 Vector *pos;		/* Intersection point */
 Vector *norm, *gnorm;	/* shading normal, geometric normal (return values) */
-Surface *surf;		/* Copy of surface to use, texture-modified */
+Surface **surf;		/* Surface to use, texture-modified (return value) */
+Surface *copy;		/* Space for texture-modified copy of surface */
 int *smooth;
 {
 	HitNode *hp;
@@ -47,7 +53,7 @@ int *smooth;
 	Geom *prim, *obj;
 	Float k, kp;
 	int texturing, transforming, entering;
-	Trans prim2model, world2model;
+	Trans prim2model, world2model, ttmp, *trans;
 
 	hp = hitlist->data;
 	prim = hp->obj;
@@ -55,7 +61,7 @@ int *smooth;
 	/*
 	 * Compute point of intersection in "primitive space".
 	 */
-	VecAddScaled(hp->ray.pos, hp->dist, hp->ray.dir, pos);
+	VecAddScaled(hitlist->ray.pos, hp->dist, hitlist->ray.dir, pos);
 
 	/*
 	 * Find normal to primitive at point of intersection.
@@ -78,11 +84,12 @@ int *smooth;
 			 * Here we're actually computing prim2world.
 			 * When finished, we invert it.
 			 */
+			trans = HitTrans(hp, &ttmp);
 			if (transforming) {
-				TransCompose(&world2model, &hp->trans,
+				TransCompose(&world2model, trans,
 					&world2model);
 			} else {
-				TransCopy(&hp->trans, &world2model);
+				TransCopy(trans, &world2model);
 				transforming = TRUE;
 			}
 		}
@@ -92,7 +99,7 @@ int *smooth;
 	 * Determine if we're entering or exiting the surface,
 	 * flipping surface normals if necessary.
 	 */
-	k = dotp(&hitlist->data[0].ray.dir, norm);
+	k = dotp(&hitlist->ray.dir, norm);
 	if (*smooth) {
 		/*
 		 * If gnorm and shading norm differ and
@@ -100,7 +107,7 @@ int *smooth;
 		 * different signs, use the geometric normal
 		 * instead, ala Snyder & Barr's paper.
 		 */
-		kp = dotp(&hitlist->data[0].ray.dir, gnorm);
+		kp = dotp(&hitlist->ray.dir, gnorm);
 		if (k <= 0. && kp > 0. || k >= 0. && kp < 0.)
 			k = kp;
 	}
@@ -152,7 +159,9 @@ int *smooth;
 	 */
 	TransInvert(&world2model, &world2model);
 	TransInit(&prim2model);
-	rtmp = hitlist->data[0].ray;
+	*copy = **surf;
+	*surf = copy;
+	rtmp = hitlist->ray;
 	/*
 	 * Walk down hitlist (from primitive up to World object),
 	 * transforming hit point and shading normal and applying textures.
@@ -163,21 +172,22 @@ int *smooth;
 	for (hp = hitlist->data, i = 0; i < hitlist->nodes -1; i++, hp++) {
 		obj = hp->obj;
 		if (hp->dotrans) {
-			NormalTransform(norm, &hp->trans.itrans);
+			trans = HitTrans(hp, &ttmp);
+			NormalTransform(norm, &trans->itrans);
 			if (texturing) {
 				/*
 				 * Compose prim<-->model and world<-->model
 				 * with current transformation.
 				 */
-				TransCompose(&prim2model, &hp->trans,
+				TransCompose(&prim2model, trans,
 					&prim2model);
-				TransCompose(&world2model, &hp->trans,
+				TransCompose(&world2model, trans,
 					&world2model);
 				/*
 				 * Transform point and ray to model space.
 				 */
-				PointTransform(pos, &hp->trans.trans);
-				(void)RayTransform(&rtmp, &hp->trans.trans);
+				PointTransform(pos, &trans->trans);
+				(void)RayTransform(&rtmp, &trans->trans);
 			}
 		}
 		/*
@@ -185,7 +195,7 @@ int *smooth;
 		 */
 		if (obj->texture)
 			TextApply(obj->texture, prim, &rtmp, pos, norm,
-				gnorm, surf, &prim2model, &world2model);
+				gnorm, copy, &prim2model, &world2model);
 	}
 	/* Transform geometric normal from object to world space. */
 	NormalTransform(gnorm, &world2model.trans);
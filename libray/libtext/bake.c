@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "texture.h"
+#include "bake.h"
+#ifdef I_STRING
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <unistd.h>
+
+/*
+ * Baking of expensive solid textures.
+ *
+ * The field underlying a texture (the value of fBm, say, before it is
+ * thresholded and mapped to a color) is sampled on a lattice in texture
+ * space, and looked up by trilinear interpolation.  The lattice is kept
+ * as a sparse set of bricks, hashed on their position, and each sample
+ * is found only when a lookup first needs it, so only the parts of the
+ * lattice near the surfaces actually shaded are ever computed.
+ *
+ * There are BAKE_LEVELS lattices, each with cells twice the size of
+ * the one before.  The finest has cells a quarter the size of the
+ * finest detail of the field.  Each lookup uses the finest lattice
+ * whose cells are at least as big as the footprint of a pixel at the
+ * point being shaded, as seen along the incoming ray.
+ *
+ * Bakes are kept from one frame to the next and, if a directory is
+ * given, from one run to the next in files named for the kind and
+ * parameters of the field.  A file is used only if the parameters it
+ * records, and the value of the field at a test point, match.
+ */
+
+#define BAKE_UNSET	1e30		/* sample not yet found */
+#define BAKE_MAXCOORD	1e9		/* don't bake farther out than this */
+#define BAKE_HASHSIZE	64		/* initial size of brick hash table */
+
+/*
+ * Brick containing lattice point i.
+ */
+#define BRICKOF(i)	((i) >= 0 ? (i) / BAKE_BRICK : \
+				-((-(i) - 1) / BAKE_BRICK) - 1)
+#define BAKEHASH(l,x,y,z,size)	((int)(((unsigned int)(x) * 73856093 ^ \
+				(unsigned int)(y) * 19349663 ^ \
+				(unsigned int)(z) * 83492791 ^ \
+				(unsigned int)(l) * 0x9e3779b1) & ((size) - 1)))
+
+static TextBake *Bakes;			/* all bakes */
+static int BakeOn = FALSE;		/* bake textures? */
+static char *BakeDir;			/* where to keep bakes, or NULL */
+static unsigned long BakeLookups, BakeFound, BakeBricks, BakeLoaded;
+
+static Vector BakeProbe = {0.3141, 0.2718, 0.1618};
+static char *BakeName[BAKE_KINDS] = {"marble", "fbm", "vfbm", "chaos"};
+
+static TextBake *BakeFind();
+static BakeBrick *BakeBrickGet();
+static void BakeField(), BakeRead(), BakeWrite(), BakeRehash();
+
+/*
+ * Bake textures if dir is non-null.  Bakes are kept in files in dir
+ * unless it is "-".
+ */
+void
+BakeSetup(dir)
+char *dir;
+{
+	BakeOn = dir != (char *)NULL;
+	if (BakeOn && strcmp(dir, "-") != 0)
+		BakeDir = dir;
+	else
+		BakeDir = (char *)NULL;
+}
+
+/*
+ * If textures are being baked, make sure that *bake is the bake of the
+ * given field and return TRUE.  Otherwise, the texture should evaluate
+ * the field itself.
+ */
+int
+Baking(bake, kind, a, b, c)
+TextBake **bake;
+int kind;
+Float a, b, c;
+{
+	if (!BakeOn)
+		return FALSE;
+	if (*bake == (TextBake *)NULL)
+		*bake = BakeFind(kind, a, b, c);
+	return TRUE;
+}
+
+/*
+ * Look up the baked field at pos, in texture space, as seen along
+ * ray, in model space.
+ */
+void
+BakeLookup(bake, ray, pos, vals)
+TextBake *bake;
+Ray *ray;
+Vector *pos;
+Float *vals;
+{
+	Vector p;
+	Float foot, cell, x, y, z, fx, fy, fz, found[BAKE_VALUES];
+	Float x0, x1, x2, x3;
+	float *val, *s[8];
+	int level, ix, iy, iz, lx, ly, lz, bx, by, bz, i, k;
+
+	BakeLookups++;
+	foot = TextFootprint(ray, pos, (Vector *)NULL);
+
+	cell = bake->cell;
+	for (level = 0; level < BAKE_LEVELS - 1 && cell < foot;
+	     level++)
+		cell += cell;
+
+	x = pos->x / cell; y = pos->y / cell; z = pos->z / cell;
+	if (fabs(x) > BAKE_MAXCOORD || fabs(y) > BAKE_MAXCOORD ||
+	    fabs(z) > BAKE_MAXCOORD) {
+		BakeField(bake, pos, vals);
+		return;
+	}
+	ix = (int)floor(x); iy = (int)floor(y); iz = (int)floor(z);
+	fx = x - ix; fy = y - iy; fz = z - iz;
+	bx = BRICKOF(ix); by = BRICKOF(iy); bz = BRICKOF(iz);
+	lx = ix - bx*BAKE_BRICK;
+	ly = iy - by*BAKE_BRICK;
+	lz = iz - bz*BAKE_BRICK;
+	val = BakeBrickGet(bake, level, bx, by, bz)->val;
+
+	/*
+	 * Find the corners of the cell, computing any that are unset.
+	 */
+	for (i = 0; i < 8; i++) {
+		s[i] = val + bake->nvals *
+			(((lz + (i >> 2)) * BAKE_SIDE + ly + ((i >> 1) & 1)) *
+				BAKE_SIDE + lx + (i & 1));
+		if (*s[i] != (float)BAKE_UNSET)
+			continue;
+		p.x = (ix + (i & 1)) * cell;
+		p.y = (iy + ((i >> 1) & 1)) * cell;
+		p.z = (iz + (i >> 2)) * cell;
+		BakeField(bake, &p, found);
+		for (k = 0; k < bake->nvals; k++)
+			s[i][k] = found[k];
+		BakeFound++;
+		bake->dirty = TRUE;
+	}
+
+	for (k = 0; k < bake->nvals; k++) {
+		x0 = s[0][k] + fx * (s[1][k] - s[0][k]);
+		x1 = s[2][k] + fx * (s[3][k] - s[2][k]);
+		x2 = s[4][k] + fx * (s[5][k] - s[4][k]);
+		x3 = s[6][k] + fx * (s[7][k] - s[6][k]);
+		x0 += fy * (x1 - x0);
+		x2 += fy * (x3 - x2);
+		vals[k] = x0 + fz * (x2 - x0);
+	}
+}
+
+/*
+ * Write every bake that has changed to its file.
+ */
+void
+BakeSave()
+{
+	TextBake *bake;
+
+	for (bake = Bakes; bake; bake = bake->next) {
+		if (bake->dirty && bake->name) {
+			BakeWrite(bake);
+			bake->dirty = FALSE;
+		}
+	}
+}
+
+void
+BakeStats(fp)
+FILE *fp;
+{
+	if (!BakeOn)
+		return;
+	fprintf(fp, "Texture bake lookups:\t\t%lu (%lu samples found)\n",
+		BakeLookups, BakeFound);
+	fprintf(fp, "Texture bake bricks:\t\t%lu (%lu read)\n",
+		BakeBricks, BakeLoaded);
+}
+
+/*
+ * Find the bake of the given field, creating it if need be.
+ */
+static TextBake *
+BakeFind(kind, a, b, c)
+int kind;
+Float a, b, c;
+{
+	TextBake *bake;
+	Float param[BAKE_PARAMS], found[BAKE_VALUES], f;
+	unsigned long h;
+	unsigned char *cp;
+	int i;
+
+	param[0] = a; param[1] = b; param[2] = c;
+	for (bake = Bakes; bake; bake = bake->next) {
+		if (bake->kind == kind && bake->param[0] == a &&
+		    bake->param[1] == b && bake->param[2] == c)
+			return bake;
+	}
+
+	bake = (TextBake *)Calloc(1, sizeof(TextBake));
+	bake->kind = kind;
+	bake->nvals = kind == BAKE_VFBM ? 3 : 1;
+	for (i = 0; i < BAKE_PARAMS; i++)
+		bake->param[i] = param[i];
+	/*
+	 * Find the size of the finest detail in the field.
+	 */
+	f = 1.;
+	switch (kind) {
+		case BAKE_MARBLE:
+			f = 1. / 32.;		/* Chaos(6) */
+			break;
+		case BAKE_FBM:
+		case BAKE_VFBM:
+			if (b > 1.)
+				for (i = 1; i < (int)c && f > 1e-4; i++)
+					f /= b;
+			break;
+		case BAKE_CHAOS:
+			for (i = 1; i < (int)a && f > 1e-4; i++)
+				f *= 0.5;
+			break;
+	}
+	bake->cell = 0.25 * f;
+	BakeField(bake, &BakeProbe, found);
+	for (i = 0; i < bake->nvals; i++)
+		bake->probe[i] = found[i];
+	bake->hashsize = BAKE_HASHSIZE;
+	bake->hash = (BakeBrick **)Calloc(bake->hashsize,
+				sizeof(BakeBrick *));
+	bake->next = Bakes;
+	Bakes = bake;
+
+	if (BakeDir == (char *)NULL)
+		return bake;
+	/*
+	 * The file is named for the kind and parameters of the field.
+	 */
+	h = 2166136261;
+	for (cp = (unsigned char *)param, i = 0; i < sizeof(param); i++)
+		h = ((h ^ cp[i]) * 16777619) & 0xffffffff;
+	bake->name = Malloc((unsigned)(strlen(BakeDir) + 32));
+	sprintf(bake->name, "%s/%s-%08lx.bake", BakeDir, BakeName[kind], h);
+	BakeRead(bake);
+	return bake;
+}
+
+/*
+ * Evaluate the field of a bake.
+ */
+static void
+BakeField(bake, pos, vals)
+TextBake *bake;
+Vector *pos;
+Float *vals;
+{
+	Vector v;
+
+	switch (bake->kind) {
+		case BAKE_MARBLE:
+			vals[0] = Marble(pos);
+			break;
+		case BAKE_FBM:
+			vals[0] = fBm(pos, bake->param[0], bake->param[1],
+					bake->param[2]);
+			break;
+		case BAKE_VFBM:
+			VfBm(pos, bake->param[0], bake->param[1],
+				bake->param[2], &v);
+			vals[0] = v.x; vals[1] = v.y; vals[2] = v.z;
+			break;
+		case BAKE_CHAOS:
+			vals[0] = Chaos(pos, bake->param[0]);
+			break;
+	}
+}
+
+/*
+ * Find the brick at the given level and position, creating it if need be.
+ */
+static BakeBrick *
+BakeBrickGet(bake, level, x, y, z)
+TextBake *bake;
+int level, x, y, z;
+{
+	BakeBrick **bp, *brick;
+	int i;
+
+	bp = &bake->hash[BAKEHASH(level, x, y, z, bake->hashsize)];
+	for (brick = *bp; brick; brick = brick->next) {
+		if (brick->x == x && brick->y == y && brick->z == z &&
+		    brick->level == level)
+			return brick;
+	}
+	brick = (BakeBrick *)Malloc(sizeof(BakeBrick));
+	brick->level = level;
+	brick->x = x; brick->y = y; brick->z = z;
+	brick->val = (float *)Malloc((unsigned)(bake->nvals * BAKE_SAMPLES *
+				sizeof(float)));
+	for (i = bake->nvals * BAKE_SAMPLES - 1; i >= 0; i--)
+		brick->val[i] = (float)BAKE_UNSET;
+	brick->next = *bp;
+	*bp = brick;
+	BakeBricks++;
+	if (++bake->nbricks > 2 * bake->hashsize)
+		BakeRehash(bake);
+	return brick;
+}
+
+/*
+ * Double the size of the brick hash table.
+ */
+static void
+BakeRehash(bake)
+TextBake *bake;
+{
+	BakeBrick **hash, *brick, *next;
+	int i, size, h;
+
+	size = 2 * bake->hashsize;
+	hash = (BakeBrick **)Calloc(size, sizeof(BakeBrick *));
+	for (i = 0; i < bake->hashsize; i++) {
+		for (brick = bake->hash[i]; brick; brick = next) {
+			next = brick->next;
+			h = BAKEHASH(brick->level, brick->x, brick->y, brick->z,
+					size);
+			brick->next = hash[h];
+			hash[h] = brick;
+		}
+	}
+	free((voidstar)bake->hash);
+	bake->hash = hash;
+	bake->hashsize = size;
+}
+
+/*
+ * Read the bricks of a bake from its file, if the file was made from the
+ * same field.
+ */
+static void
+BakeRead(bake)
+TextBake *bake;
+{
+	FILE *fp;
+	BakeHeader head;
+	BakeBrick *brick;
+	int i, n, pos[4];
+
+	fp = fopen(bake->name, "r");
+	if (fp == (FILE *)NULL)
+		return;
+	if (fread((char *)&head, sizeof(BakeHeader), 1, fp) != 1 ||
+	    head.magic != BAKE_MAGIC || head.version != BAKE_VERSION ||
+	    head.kind != bake->kind || head.nvals != bake->nvals ||
+	    head.side != BAKE_SIDE || head.cell != bake->cell) {
+		(void)fclose(fp);
+		return;
+	}
+	for (i = 0; i < BAKE_PARAMS; i++)
+		if (head.param[i] != bake->param[i])
+			break;
+	for (n = 0; i == BAKE_PARAMS && n < bake->nvals; n++)
+		if (head.probe[n] != bake->probe[n])
+			break;
+	if (i != BAKE_PARAMS || n != bake->nvals) {
+		RLerror(RL_WARN, "Bake \"%s\" is out of date.\n", bake->name);
+		(void)fclose(fp);
+		bake->dirty = TRUE;
+		return;
+	}
+	n = bake->nvals * BAKE_SAMPLES;
+	for (i = 0; i < head.nbricks; i++) {
+		if (fread((char *)pos, sizeof(int), 4, fp) != 4 ||
+		    pos[0] < 0 || pos[0] >= BAKE_LEVELS)
+			break;
+		brick = BakeBrickGet(bake, pos[0], pos[1], pos[2], pos[3]);
+		if (fread((char *)brick->val, sizeof(float), n, fp) != n)
+			break;
+		BakeLoaded++;
+	}
+	(void)fclose(fp);
+}
+
+/*
+ * Write a bake to its file.  As with height field caches, the file is
+ * written under a temporary name and then renamed.  Failure is not an
+ * error; the bake will just be made again next time.
+ */
+static void
+BakeWrite(bake)
+TextBake *bake;
+{
+	FILE *fp;
+	BakeHeader head;
+	BakeBrick *brick;
+	char *tmpname;
+	int i, n, ok, pos[4];
+
+	tmpname = Malloc((unsigned)(strlen(bake->name) + 16));
+	sprintf(tmpname, "%s.%d", bake->name, (int)getpid());
+	fp = fopen(tmpname, "w");
+	if (fp == (FILE *)NULL) {
+		free((voidstar)tmpname);
+		return;
+	}
+	bzero((char *)&head, sizeof(BakeHeader));
+	head.magic = BAKE_MAGIC;
+	head.version = BAKE_VERSION;
+	head.kind = bake->kind;
+	head.nvals = bake->nvals;
+	head.side = BAKE_SIDE;
+	head.nbricks = bake->nbricks;
+	for (i = 0; i < BAKE_PARAMS; i++)
+		head.param[i] = bake->param[i];
+	head.cell = bake->cell;
+	for (i = 0; i < bake->nvals; i++)
+		head.probe[i] = bake->probe[i];
+	ok = fwrite((char *)&head, sizeof(BakeHeader), 1, fp) == 1;
+	n = bake->nvals * BAKE_SAMPLES;
+	for (i = 0; ok && i < bake->hashsize; i++) {
+		for (brick = bake->hash[i]; ok && brick; brick = brick->next) {
+			pos[0] = brick->level;
+			pos[1] = brick->x; pos[2] = brick->y; pos[3] = brick->z;
+			ok = fwrite((char *)pos, sizeof(int), 4, fp) == 4 &&
+				fwrite((char *)brick->val, sizeof(float), n, fp)
+					== n;
+		}
+	}
+	if (fclose(fp) != 0 || !ok || rename(tmpname, bake->name) != 0)
+		(void)unlink(tmpname);
+	free((voidstar)tmpname);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef BAKE_H
+#define BAKE_H
+
+/*
+ * Kinds of field that may be baked.  Textures whose fields are of the
+ * same kind and have the same parameters share a bake.
+ */
+#define BAKE_MARBLE	0	/* Marble() */
+#define BAKE_FBM	1	/* fBm(omega, lambda, octaves) */
+#define BAKE_VFBM	2	/* VfBm(omega, lambda, octaves) */
+#define BAKE_CHAOS	3	/* Chaos(octaves) */
+#define BAKE_KINDS	4
+
+#define BAKE_PARAMS	3	/* Max # of parameters of a field */
+#define BAKE_VALUES	3	/* Max # of values at each point */
+#define BAKE_LEVELS	16	/* # of resolutions */
+#define BAKE_BRICK	8	/* Cells along each side of a brick */
+#define BAKE_SIDE	(BAKE_BRICK + 1)	/* Samples along each side */
+#define BAKE_SAMPLES	(BAKE_SIDE * BAKE_SIDE * BAKE_SIDE)
+
+#define BAKE_MAGIC	0x52534243	/* "RSBC" */
+#define BAKE_VERSION	1
+
+/*
+ * A brick of samples, BAKE_BRICK cells on a side, at one resolution.
+ * Samples are found as they are first needed; until then they hold
+ * BAKE_UNSET.
+ */
+typedef struct BakeBrick {
+	int level, x, y, z;		/* resolution and position */
+	float *val;			/* nvals * BAKE_SAMPLES samples */
+	struct BakeBrick *next;		/* next in hash chain */
+} BakeBrick;
+
+typedef struct TextBake {
+	int kind, nvals;		/* kind of field, # of values */
+	Float param[BAKE_PARAMS];	/* parameters of the field */
+	Float cell;			/* size of finest cell */
+	float probe[BAKE_VALUES];	/* field at BAKE_PROBE */
+	BakeBrick **hash;		/* bricks, hashed on position */
+	int hashsize, nbricks;
+	int dirty;			/* changed since read or written? */
+	char *name;			/* file in which it's kept, or NULL */
+	struct TextBake *next;		/* next bake */
+} TextBake;
+
+/*
+ * Header of a bake file.  It is followed by nbricks bricks, each of
+ * which is four ints giving the level and position of the brick and
+ * then the brick's samples.
+ */
+typedef struct {
+	int magic, version;
+	int kind, nvals, side, nbricks;
+	Float param[BAKE_PARAMS];
+	Float cell;
+	float probe[BAKE_VALUES];
+} BakeHeader;
+
+extern int	Baking();
+extern void	BakeSetup(), BakeLookup(), BakeSave(), BakeStats();
+
+#endif /* BAKE_H */
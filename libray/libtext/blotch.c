@@ -44,6 +44,19 @@ Surface *surf;
 	return blotch;
 }
 
+/*
+ * Fold the parameters of a "blotch" texture into a hash key.
+ */
+unsigned long
+BlotchHash(key, blotch)
+unsigned long key;
+Blotch *blotch;
+{
+	key = HashString(key, "blotch");
+	key = HashFloat(key, blotch->mix);
+	return SurfaceHash(key, blotch->surf);
+}
+
 /*
  * Apply "blotch" texture.
  */
@@ -28,7 +28,7 @@
 #ifndef BLOTCH_H
 
 #define TextBlotchCreate(m,s)	TextCreate((TextRef) BlotchCreate(m,s), \
-					BlotchApply)
+					BlotchApply, BlotchHash)
 typedef struct {
 	Float mix;
 	Surface *surf;
@@ -36,5 +36,6 @@ typedef struct {
 
 extern Blotch *BlotchCreate();
 extern void BlotchApply();
+extern unsigned long BlotchHash();
 
 #endif /* BLOTCH_H */
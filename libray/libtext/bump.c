@@ -42,6 +42,18 @@ Float size;
 	return bump;
 }
 
+/*
+ * Fold the parameters of a "bump" texture into a hash key.
+ */
+unsigned long
+BumpHash(key, bump)
+unsigned long key;
+Bump *bump;
+{
+	key = HashString(key, "bump");
+	return HashFloat(key, bump->size);
+}
+
 /*
  * Apply a "bump" texture.
  */
@@ -28,12 +28,13 @@
 #ifndef BUMP_H
 
 #define TextBumpCreate(s)	TextCreate((TextRef) BumpCreate(s), \
-					BumpApply)
+					BumpApply, BumpHash)
 typedef struct {
 	Float size;
 } Bump;
 
 extern Bump *BumpCreate();
 extern void BumpApply();
+extern unsigned long BumpHash();
 
 #endif /* BUMP_H */
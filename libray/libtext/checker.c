@@ -41,6 +41,18 @@ Surface *surf;
 	return checker;
 }
 
+/*
+ * Fold the parameters of a "checker" texture into a hash key.
+ */
+unsigned long
+CheckerHash(key, checker)
+unsigned long key;
+Checker *checker;
+{
+	key = HashString(key, "checker");
+	return SurfaceHash(key, checker->surf);
+}
+
 /*
  * Apply a "checker" texture.
  */
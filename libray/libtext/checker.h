@@ -28,12 +28,13 @@
 #ifndef CHECKER_H
 
 #define TextCheckerCreate(s)	TextCreate((TextRef) CheckerCreate(s), \
-					CheckerApply)
+					CheckerApply, CheckerHash)
 typedef struct {
 	Surface *surf;		/* Alternate surface */
 } Checker;
 
 extern Checker *CheckerCreate();
 extern void CheckerApply();
+extern unsigned long CheckerHash();
 
 #endif /* CHECKER_H */
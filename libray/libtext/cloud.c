@@ -27,6 +27,7 @@
  */
 #include "texture.h"
 #include "cloud.h"
+#include "bake.h"
 
 /*
  * Gardner-style textured ellipsoid.  Designed to be used on unit spheres
@@ -50,9 +51,30 @@ int octaves;
 	cloud->transcale = transcale;
 	cloud->maxval = 1. / (1. - cloud->beta);
 	cloud->octaves = octaves;
+	cloud->bake = (struct TextBake *)NULL;
 	return cloud;
 }
 
+/*
+ * Fold the parameters of a "cloud" texture into a hash key.
+ */
+unsigned long
+CloudTextHash(key, cloud)
+unsigned long key;
+CloudText *cloud;
+{
+	key = HashString(key, "cloud");
+	key = HashFloat(key, cloud->beta);
+	key = HashFloat(key, cloud->omega);
+	key = HashFloat(key, cloud->lambda);
+	key = HashFloat(key, cloud->scale);
+	key = HashFloat(key, cloud->cthresh);
+	key = HashFloat(key, cloud->range);
+	key = HashFloat(key, cloud->transcale);
+	key = HashFloat(key, cloud->maxval);
+	return HashInt(key, cloud->octaves);
+}
+
 void
 CloudTextApply(cloud, prim, ray, pos, norm, gnorm, surf)
 CloudText *cloud;
@@ -76,7 +98,12 @@ Surface *surf;
 		surf->diff.r = surf->diff.g = surf->diff.b = 0.;
 		return;
 	}
-	It = fBm(pos,cloud->omega,cloud->lambda,cloud->octaves);
+	if (Baking(&cloud->bake, BAKE_FBM, cloud->omega, cloud->lambda,
+		   (Float)cloud->octaves))
+		BakeLookup(cloud->bake, ray, pos, &It);
+	else
+		It = fBm(pos, cloud->omega, cloud->lambda,
+			TextOctaves(ray, pos, cloud->lambda, cloud->octaves));
 	It = (cloud->maxval + It) * 0.5/cloud->maxval;
 	if (It < 0.)
 		It = 0;
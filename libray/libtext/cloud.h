@@ -28,7 +28,8 @@
 #ifndef CLOUDTEXT_H
 
 #define TextCloudCreate(s,h,l,n,c,o,t) TextCreate( \
-			(TextRef)CloudTextCreate(s,h,l,n,c,o,t), CloudTextApply)
+			(TextRef)CloudTextCreate(s,h,l,n,c,o,t), \
+			CloudTextApply, CloudTextHash)
 typedef struct {
 	Float	beta,
 		omega,
@@ -39,9 +40,11 @@ typedef struct {
 		transcale,
 		maxval;
 	int	octaves;
+	struct TextBake *bake;	/* bake of fBm, if any */
 } CloudText;
 
 extern CloudText *CloudTextCreate();
 extern void CloudTextApply();
+extern unsigned long CloudTextHash();
 
 #endif /* CLOUDTEXT_H */
@@ -27,6 +27,7 @@
  */
 #include "texture.h"
 #include "fbm.h"
+#include "bake.h"
 
 FBm *
 FBmCreate(offset, scale, h, lambda, octaves, thresh, mapname)
@@ -49,9 +50,29 @@ char *mapname;
 		fbm->colormap = ColormapRead(mapname);
 	else
 		fbm->colormap = (Color *)NULL;
+	fbm->bake = (struct TextBake *)NULL;
 	return fbm;
 }
 
+/*
+ * Fold the parameters of an "fbm" texture into a hash key.
+ */
+unsigned long
+FBmHash(key, fbm)
+unsigned long key;
+FBm *fbm;
+{
+	key = HashString(key, "fbm");
+	key = HashFloat(key, fbm->beta);
+	key = HashFloat(key, fbm->omega);
+	key = HashFloat(key, fbm->lambda);
+	key = HashFloat(key, fbm->scale);
+	key = HashFloat(key, fbm->offset);
+	key = HashFloat(key, fbm->thresh);
+	key = HashInt(key, fbm->octaves);
+	return ColormapHash(key, fbm->colormap);
+}
+
 void
 FBmApply(fbm, prim, ray, pos, norm, gnorm, surf)
 FBm *fbm;
@@ -63,7 +84,12 @@ Surface *surf;
 	Float val;
 	int index;
 
-	val = fBm(pos, fbm->omega, fbm->lambda, fbm->octaves);
+	if (Baking(&fbm->bake, BAKE_FBM, fbm->omega, fbm->lambda,
+		   (Float)fbm->octaves))
+		BakeLookup(fbm->bake, ray, pos, &val);
+	else
+		val = fBm(pos, fbm->omega, fbm->lambda,
+			TextOctaves(ray, pos, fbm->lambda, fbm->octaves));
 	if (val < fbm->thresh)
 		val = fbm->offset;
 	else
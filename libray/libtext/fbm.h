@@ -29,7 +29,7 @@
 #define FBM_H
 
 #define TextFBmCreate(o,s,h,l,n,t,m) TextCreate( \
-			(TextRef)FBmCreate(o,s,h,l,n,t,m), FBmApply)
+			(TextRef)FBmCreate(o,s,h,l,n,t,m), FBmApply, FBmHash)
 typedef struct {
 	Float	beta,
 		omega,
@@ -39,9 +39,11 @@ typedef struct {
 		thresh;
 	int	octaves;
 	Color	*colormap;
+	struct TextBake *bake;	/* bake of fBm or VfBm, if any */
 } FBm;
 
 extern FBm *FBmCreate();
 extern void FBmApply();
+extern unsigned long FBmHash();
 
 #endif /* FBM_H */
@@ -28,6 +28,7 @@
 #include "texture.h"
 #include "fbm.h"
 #include "fbmbump.h"
+#include "bake.h"
 
 FBm *
 FBmBumpCreate(offset, scale, h, lambda, octaves)
@@ -39,6 +40,23 @@ int octaves;
 	return fbm;
 }
 
+/*
+ * Fold the parameters of an "fbmbump" texture into a hash key.
+ */
+unsigned long
+FBmBumpHash(key, fbm)
+unsigned long key;
+FBm *fbm;
+{
+	key = HashString(key, "fbmbump");
+	key = HashFloat(key, fbm->beta);
+	key = HashFloat(key, fbm->omega);
+	key = HashFloat(key, fbm->lambda);
+	key = HashFloat(key, fbm->scale);
+	key = HashFloat(key, fbm->offset);
+	return HashInt(key, fbm->octaves);
+}
+
 /*ARGSUSED*/
 void
 FBmBumpApply(fbm, prim, ray, pos, norm, gnorm, surf)
@@ -49,8 +67,15 @@ Vector *pos, *norm, *gnorm;
 Surface *surf;
 {
 	Vector disp;
+	Float d[3];
 
-	VfBm(pos, fbm->omega, fbm->lambda, fbm->octaves, &disp);
+	if (Baking(&fbm->bake, BAKE_VFBM, fbm->omega, fbm->lambda,
+		   (Float)fbm->octaves)) {
+		BakeLookup(fbm->bake, ray, pos, d);
+		disp.x = d[0]; disp.y = d[1]; disp.z = d[2];
+	} else
+		VfBm(pos, fbm->omega, fbm->lambda,
+			TextOctaves(ray, pos, fbm->lambda, fbm->octaves), &disp);
 	norm->x += fbm->offset + disp.x * fbm->scale;
 	norm->y += fbm->offset + disp.y * fbm->scale;
 	norm->z += fbm->offset + disp.z * fbm->scale;
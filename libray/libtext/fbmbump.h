@@ -28,8 +28,9 @@
 #ifndef FBMBUMP_H
 
 #define TextFBmBumpCreate(o,s,h,l,n) TextCreate( \
-		(TextRef)FBmBumpCreate(o, s,h,l,n),FBmBumpApply)
+		(TextRef)FBmBumpCreate(o, s,h,l,n),FBmBumpApply, FBmBumpHash)
 extern FBm *FBmBumpCreate();
 extern void FBmBumpApply();
+extern unsigned long FBmBumpHash();
 
 #endif /* FBMBUMP_H */
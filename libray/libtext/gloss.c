@@ -39,6 +39,18 @@ Float glossiness;
 	return gloss;
 }
 
+/*
+ * Fold the parameters of a "gloss" texture into a hash key.
+ */
+unsigned long
+GlossHash(key, gloss)
+unsigned long key;
+Gloss *gloss;
+{
+	key = HashString(key, "gloss");
+	return HashFloat(key, gloss->glossy);
+}
+
 void
 GlossApply(gloss, prim, ray, pos, norm, gnorm, surf)
 Gloss *gloss;
@@ -28,12 +28,13 @@
 #ifndef GLOSS_H
 
 #define TextGlossCreate(g)	TextCreate((TextRef) GlossCreate(g), \
-					GlossApply)
+					GlossApply, GlossHash)
 typedef struct {
 	Float glossy;		/* glossiness */
 } Gloss;
 
 extern Gloss *GlossCreate();
 extern void GlossApply();
+extern unsigned long GlossHash();
 
 #endif /* GLOSS_H */
@@ -31,6 +31,15 @@
 
 #define INTERP(v)	(text->lo + (v)*(text->hi - text->lo))
 
+/*
+ * Cosine of the most oblique view for which the footprint of a pixel
+ * is stretched across the surface.  Past that we would rather alias a
+ * little than blur the image away altogether.
+ */
+#define IMAGE_OBLIQUE	0.125
+
+static Float ImageTextSize();
+
 /*
  * Create Image texture.
  * Image texture has so many options that there's usually no
@@ -96,6 +105,26 @@ int component;
 	text->component = component;
 }
 
+/*
+ * Fold the parameters of an "image" texture into a hash key.
+ */
+unsigned long
+ImageTextHash(key, text)
+unsigned long key;
+ImageText *text;
+{
+	key = HashString(key, "image");
+	key = HashString(key, text->image->filename);
+	key = SurfaceHash(key, text->surf);
+	key = HashInt(key, text->component);
+	key = HashInt(key, text->smooth);
+	key = HashFloat(key, text->lo);
+	key = HashFloat(key, text->hi);
+	key = HashFloat(key, text->tileu);
+	key = HashFloat(key, text->tilev);
+	return MappingHash(key, text->mapping);
+}
+
 void
 ImageTextApply(text, prim, ray, pos, norm, gnorm, surf)
 ImageText *text;
@@ -104,18 +133,15 @@ Ray *ray;
 Vector *pos, *norm, *gnorm;
 Surface *surf;
 {
-	Float fx, fy;
 	Float outval[4], outval_u[4], outval_v[4];
-	Float u, v;
+	Float u, v, size, step;
 	Surface tmpsurf;
-	int ix, iy;
 	int rchan, gchan, bchan;
 	Vector dpdu, dpdv, ntmp;
 
 	/*
-	 * First, find the floating point location in image coords.
-	 * Then set ix, iy to the integer location in image coords and
-	 * use fx, fy to represent the subpixel position.
+	 * First, find the floating point location in image coords,
+	 * and how many pixels of the image the ray's footprint covers.
 	 */
 	if (text->component == BUMP)
 		TextToUV(text->mapping, prim, pos, gnorm, &u, &v,
@@ -128,14 +154,12 @@ Surface *surf;
 	 */
 	if (TileValue(text->tileu, text->tilev, u, v))
 		return;
+	if (text->image->nlevels > 1)
+		size = ImageTextSize(text, prim, ray, pos, gnorm, u, v);
+	else
+		size = 0.;
 	u -= floor(u);
 	v -= floor(v);
-	fx = u * (Float) text->image->width;
-	fy = v * (Float) text->image->height;
-	ix = fx;
-	iy = fy;
-	fx = fx - (Float) ix;
-	fy = fy - (Float) iy;
 
 	if (text->image->has_alpha) {
 		/* Alpha channel is 0 */
@@ -153,7 +177,7 @@ Surface *surf;
 		bchan = rchan;
 	}
 
-	ImageIndex(text->image, ix, iy, fx, fy, text->smooth, outval);
+	ImageLookup(text->image, u, v, size, text->smooth, outval);
 
 	/*
 	 * escape when alpha is zero, 'cause there is no change
@@ -212,17 +236,21 @@ Surface *surf;
 			tmpsurf.index *= INTERP(outval[rchan]);
 			break;
 		case BUMP: /* bump map */
-			ImageIndex(text->image, 
-				    (ix == text->image->width - 1) ? 0 : ix+1,
-				    iy, fx, fy,
+			/*
+			 * Take differences across a pixel of the level
+			 * being used, scaled back to a pixel of the image.
+			 */
+			step = size > 1. ? size : 1.;
+			u += step / (Float)text->image->width;
+			ImageLookup(text->image, u - floor(u), v, size,
 				    text->smooth, outval_u);
-			ImageIndex(text->image, ix, 
-				    (iy == text->image->height - 1) ? 0 : iy+1,
-				    fx, fy,
+			u -= step / (Float)text->image->width;
+			v += step / (Float)text->image->height;
+			ImageLookup(text->image, u, v - floor(v), size,
 				    text->smooth, outval_v);
 			MakeBump(norm, &dpdu, &dpdv, 
-				 INTERP(outval_u[rchan] - outval[rchan]),
-				 INTERP(outval_v[rchan] - outval[rchan]));
+				 INTERP(outval_u[rchan] - outval[rchan]) / step,
+				 INTERP(outval_v[rchan] - outval[rchan]) / step);
 			return;
 	}
 
@@ -238,3 +266,60 @@ Surface *surf;
 		*surf = tmpsurf;
 	}
 }
+
+/*
+ * Estimate the number of image pixels across the footprint of the ray
+ * at pos, whose image coordinates are (u, v), by finding the image
+ * coordinates of points a footprint away along the surface.  Across
+ * the ray's path, the footprint has the width of a pixel; along it,
+ * the footprint is stretched by the obliquity of the view.
+ */
+static Float
+ImageTextSize(text, prim, ray, pos, gnorm, u, v)
+ImageText *text;
+Geom *prim;
+Ray *ray;
+Vector *pos, *gnorm;
+Float u, v;
+{
+	Vector dir, n, along, across, p;
+	Float foot, cosine, du, dv, size, s;
+
+	foot = TextFootprint(ray, pos, &dir);
+	if (foot < EPSILON)
+		return 0.;
+	n = *gnorm;
+	ModelNormToText(&n);
+	if (VecNormalize(&n) == 0.)
+		return 0.;
+	cosine = dotp(&dir, &n);
+	VecAddScaled(dir, -cosine, n, &along);
+	if (VecNormalize(&along) == 0.)
+		VecCoordSys(&n, &along, &across);
+	else
+		VecCross(&n, &along, &across);
+	cosine = fabs(cosine);
+	if (cosine < IMAGE_OBLIQUE)
+		cosine = IMAGE_OBLIQUE;
+
+	VecAddScaled(*pos, foot / cosine, along, &p);
+	TextToUV(text->mapping, prim, &p, gnorm, &du, &dv,
+		 (Vector *)NULL, (Vector *)NULL);
+	du -= u;
+	dv -= v;
+	du = (du - floor(du + 0.5)) * (Float)text->image->width;
+	dv = (dv - floor(dv + 0.5)) * (Float)text->image->height;
+	size = du*du + dv*dv;
+
+	VecAddScaled(*pos, foot, across, &p);
+	TextToUV(text->mapping, prim, &p, gnorm, &du, &dv,
+		 (Vector *)NULL, (Vector *)NULL);
+	du -= u;
+	dv -= v;
+	du = (du - floor(du + 0.5)) * (Float)text->image->width;
+	dv = (dv - floor(dv + 0.5)) * (Float)text->image->height;
+	s = du*du + dv*dv;
+	if (s > size)
+		size = s;
+	return sqrt(size);
+}
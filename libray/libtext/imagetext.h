@@ -29,7 +29,7 @@
 #define IMAGETEXT_H
 
 #define TextImageCreate(s) TextCreate((TextRef)ImageTextCreate(s), \
-				ImageTextApply)
+				ImageTextApply, ImageTextHash)
 
 typedef struct {
 	Image	*image;		/* image to use */
@@ -43,5 +43,6 @@ typedef struct {
 
 extern ImageText *ImageTextCreate();
 extern void ImageTextApply(), ImageTextSetComponent();
+extern unsigned long ImageTextHash();
 
 #endif /* IMAGETEXT_H */
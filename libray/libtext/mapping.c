@@ -26,6 +26,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include "libobj/geom.h"
+#include "libcommon/hash.h"
 #include "mapping.h"
 
 void UVMapping(), SphereMapping(), CylinderMapping(), LinearMapping();
@@ -152,6 +153,31 @@ Vector *center, *vaxis, *uaxis;
 	return res;
 }
 
+/*
+ * Fold a mapping into a hash key, minding only those fields that the
+ * kind of mapping sets.  A NULL mapping is taken to be a uv mapping.
+ */
+unsigned long
+MappingHash(key, map)
+unsigned long key;
+Mapping *map;
+{
+	if (map == (Mapping *)NULL || map->method == UVMapping)
+		return HashString(key, "uv");
+	if (map->method == LinearMapping) {
+		key = HashString(key, "linear");
+		key = HashMatrix(key, &map->m);
+	} else
+		key = HashString(key, map->method == SphereMapping ?
+				"sphere" : "cylinder");
+	key = HashVector(key, &map->center);
+	key = HashVector(key, &map->uaxis);
+	key = HashVector(key, &map->vaxis);
+	if (map->method != LinearMapping)
+		key = HashVector(key, &map->norm);
+	return key;
+}
+
 void
 UVMapping(map, obj, pos, norm, uv, dpdu, dpdv)
 Mapping *map;
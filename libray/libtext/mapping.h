@@ -41,5 +41,6 @@ typedef struct Mapping {
 
 extern Mapping *UVMappingCreate(), *SphereMappingCreate(), *CylMappingCreate(),
 	*LinearMappingCreate();
+extern unsigned long MappingHash();
 
 #endif /* MAPPING_H */
@@ -27,6 +27,7 @@
  */
 #include "texture.h"
 #include "marble.h"
+#include "bake.h"
 
 MarbleText *
 MarbleCreate(mapname)
@@ -39,9 +40,22 @@ char *mapname;
 		marble->colormap = ColormapRead(mapname);
 	else
 		marble->colormap = (Color *)NULL;
+	marble->bake = (struct TextBake *)NULL;
 	return marble;
 }
 
+/*
+ * Fold the parameters of a "marble" texture into a hash key.
+ */
+unsigned long
+MarbleHash(key, marble)
+unsigned long key;
+MarbleText *marble;
+{
+	key = HashString(key, "marble");
+	return ColormapHash(key, marble->colormap);
+}
+
 void
 MarbleApply(marble, prim, ray, pos, norm, gnorm, surf)
 MarbleText *marble;
@@ -53,7 +67,10 @@ Surface *surf;
 	Float val;
 	int index;
 
-	val = Marble(pos);
+	if (Baking(&marble->bake, BAKE_MARBLE, 0., 0., 0.))
+		BakeLookup(marble->bake, ray, pos, &val);
+	else
+		val = Marble(pos);
 	if (marble->colormap) {
 		index = (int)(255. * val);
 		surf->diff.r *= marble->colormap[index].r;
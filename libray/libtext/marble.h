@@ -28,12 +28,14 @@
 #ifndef MARBLE_H
 
 #define TextMarbleCreate(m)	TextCreate((TextRef) MarbleCreate(m), \
-					MarbleApply)
+					MarbleApply, MarbleHash)
 typedef struct {
 	Color *colormap;	/* colormap */
+	struct TextBake *bake;	/* bake of Marble(), if any */
 } MarbleText;
 
 extern MarbleText *MarbleCreate();
 extern void MarbleApply();
+extern unsigned long MarbleHash();
 
 #endif /* MARBLE_H */
@@ -27,6 +27,7 @@
  */
 #include "texture.h"
 #include "mount.h"
+#include "bake.h"
 
 /*
  * Create and return a reference to a "mount" texture.
@@ -42,9 +43,24 @@ Float turb, slope;
 	mount->turb = turb;
 	mount->slope = slope;
 	mount->cmap = ColormapRead(cmap);
+	mount->bake = (struct TextBake *)NULL;
 	return mount;
 }
 
+/*
+ * Fold the parameters of a "mount" texture into a hash key.
+ */
+unsigned long
+MountHash(key, mount)
+unsigned long key;
+Mount *mount;
+{
+	key = HashString(key, "mount");
+	key = HashFloat(key, mount->turb);
+	key = HashFloat(key, mount->slope);
+	return ColormapHash(key, mount->cmap);
+}
+
 /*
  * Apply a "mount" texture.
  */
@@ -60,7 +76,10 @@ Surface *surf;
 	Float t;
 	Color c;
 
-	t = Chaos(pos, 7);
+	if (Baking(&mount->bake, BAKE_CHAOS, 7., 0., 0.))
+		BakeLookup(mount->bake, ray, pos, &t);
+	else
+		t = Chaos(pos, TextOctaves(ray, pos, 2., 7));
 	index = (pos->z + mount->turb*t - mount->slope*(1.-norm->z))*256;
 	if (index < 0)
 		index = 0;
@@ -28,13 +28,15 @@
 #ifndef MOUNT_H
 
 #define TextMountCreate(c,t,s)	TextCreate((TextRef) MountCreate(c,t,s), \
-					MountApply)
+					MountApply, MountHash)
 typedef struct {
 	Float turb, slope;
 	Color *cmap;
+	struct TextBake *bake;	/* bake of Chaos(), if any */
 } Mount;
 
 extern Mount *MountCreate();
 extern void MountApply();
+extern unsigned long MountHash();
 
 #endif /* MOUNT_H */
@@ -148,6 +148,58 @@ register int  count;
 }
 
 
+/*
+ * Gradients used by the hashed noise:  the twelve edge midpoints of
+ * the unit cube, padded to sixteen so that four hash bits pick one.
+ */
+static Float Grad[16][3] = {
+	{ 1., 1., 0.}, {-1., 1., 0.}, { 1.,-1., 0.}, {-1.,-1., 0.},
+	{ 1., 0., 1.}, {-1., 0., 1.}, { 1., 0.,-1.}, {-1., 0.,-1.},
+	{ 0., 1., 1.}, { 0.,-1., 1.}, { 0., 1.,-1.}, { 0.,-1.,-1.},
+	{ 1., 1., 0.}, { 0.,-1., 1.}, {-1., 1., 0.}, { 0.,-1.,-1.}
+};
+
+/*
+ * Scale factors that give the hashed noise and its gradient about the
+ * same spread as Skinner's noise and vector noise, so that existing
+ * texture parameters look much the same with either.
+ */
+#define NOISESCALE	0.944
+#define DNOISESCALE	0.36
+
+/*
+ * Multipliers for the lattice hash.  Since (i+1)*P == i*P + P, the
+ * far corners of a cell cost an add rather than a multiply.
+ */
+#define HASHX		0x8da6b343
+#define HASHY		0xd8163841
+#define HASHZ		0xcb1ab31f
+
+/*
+ * Hash a lattice point to one of the gradients; the top bits of the
+ * product are the well-mixed ones.
+ */
+#define GRAD(hx,hy,hz)	Grad[((((hx) ^ (hy) ^ (hz)) * 0x7feb352d) >> 28) & 15]
+#define GDOT(g,x,y,z)	((g)[0]*(x) + (g)[1]*(y) + (g)[2]*(z))
+
+#define FADE(a)		((a)*(a)*(a)*((a)*((a)*6.-15.)+10.))
+#define DFADE(a)	(30.*(a)*(a)*((a)-1.)*((a)-1.))
+#define LERP(t,a,b)	((a) + (t)*((b)-(a)))
+
+static int NoiseCompat = FALSE;	/* Use Skinner's tables? */
+static Float HashNoise();
+
+/*
+ * Select Skinner's table-driven noise instead of the hashed gradient
+ * noise, for compatibility with images made by older versions.
+ */
+void
+NoiseSetCompat(flag)
+int flag;
+{
+	NoiseCompat = flag;
+}
+
 /*
  * Robert Skinner's Perlin-style "Noise" function
  */
@@ -161,6 +213,8 @@ Vector *point;
 	Float	sum;
 	short	m;
 
+	if (!NoiseCompat)
+		return HashNoise(point, (Vector *)NULL);
 
 	/* ensures the values are positive. */
 	x = point->x - MINX; y = point->y - MINY; z = point->z - MINZ;
@@ -206,7 +260,9 @@ Vector *point;
 }
 
 /*
- * Vector-valued "Noise"
+ * Vector-valued "Noise".  The hashed noise returns the gradient
+ * of Noise3 at the point, scaled to about the same spread as
+ * Skinner's vector noise.
  */
 void
 DNoise3(point, result)
@@ -218,6 +274,11 @@ Vector *point, *result;
 	Float	sx, sy, sz, tx, ty, tz;
 	short	m;
 
+	if (!NoiseCompat) {
+		(void)HashNoise(point, result);
+		return;
+	}
+
 	/* ensures the values are positive. */
 	x = point->x - MINX; y = point->y - MINY; z = point->z - MINZ;
 
@@ -289,3 +350,115 @@ Vector *point, *result;
 	result->y += INCRSUM(m+4,s,px,py,pz);
 	result->z += INCRSUM(m+8,s,px,py,pz);
 }
+
+/*
+ * Evaluate Noise3 at each of n points.  Callers that need noise at
+ * several points, such as the octaves of fBm, hand them over together
+ * so that the evaluations are independent of one another.
+ */
+void
+Noise3Array(n, point, val)
+int n;
+Vector *point;
+Float *val;
+{
+	int i;
+
+	if (NoiseCompat) {
+		for (i = 0; i < n; i++)
+			val[i] = Noise3(&point[i]);
+	} else {
+		for (i = 0; i < n; i++)
+			val[i] = HashNoise(&point[i], (Vector *)NULL);
+	}
+}
+
+/*
+ * Evaluate DNoise3 at each of n points.
+ */
+void
+DNoise3Array(n, point, result)
+int n;
+Vector *point, *result;
+{
+	int i;
+
+	if (NoiseCompat) {
+		for (i = 0; i < n; i++)
+			DNoise3(&point[i], &result[i]);
+	} else {
+		for (i = 0; i < n; i++)
+			(void)HashNoise(&point[i], &result[i]);
+	}
+}
+
+/*
+ * Gradient noise, with the gradient at each lattice point picked by an
+ * integer hash of its coordinates rather than through hashTable and
+ * RTable.  The corners are straight-line code with no dependence on
+ * one another.  If grad is non-null, the analytic gradient of the
+ * noise is stored there as well.
+ */
+static Float
+HashNoise(point, grad)
+Vector *point, *grad;
+{
+	unsigned int hx, hy, hz, jx, jy, jz;
+	Float x, y, z, u, v, w;
+	Float *g0, *g1, *g2, *g3, *g4, *g5, *g6, *g7;
+	Float c0, c1, c2, c3, c4, c5, c6, c7;
+	Float x0, x1, x2, x3, y0, y1;
+
+	/* ensures the values are positive. */
+	x = point->x - MINX; y = point->y - MINY; z = point->z - MINZ;
+
+	/* hashes of the corners of the cell */
+	hx = (unsigned int)(int)x * HASHX; jx = hx + HASHX;
+	hy = (unsigned int)(int)y * HASHY; jy = hy + HASHY;
+	hz = (unsigned int)(int)z * HASHZ; jz = hz + HASHZ;
+
+	/* position within the cell */
+	x -= (int)x; y -= (int)y; z -= (int)z;
+
+	g0 = GRAD(hx, hy, hz); c0 = GDOT(g0, x, y, z);
+	g1 = GRAD(jx, hy, hz); c1 = GDOT(g1, x-1., y, z);
+	g2 = GRAD(hx, jy, hz); c2 = GDOT(g2, x, y-1., z);
+	g3 = GRAD(jx, jy, hz); c3 = GDOT(g3, x-1., y-1., z);
+	g4 = GRAD(hx, hy, jz); c4 = GDOT(g4, x, y, z-1.);
+	g5 = GRAD(jx, hy, jz); c5 = GDOT(g5, x-1., y, z-1.);
+	g6 = GRAD(hx, jy, jz); c6 = GDOT(g6, x, y-1., z-1.);
+	g7 = GRAD(jx, jy, jz); c7 = GDOT(g7, x-1., y-1., z-1.);
+
+	u = FADE(x); v = FADE(y); w = FADE(z);
+	x0 = LERP(u, c0, c1);
+	x1 = LERP(u, c2, c3);
+	x2 = LERP(u, c4, c5);
+	x3 = LERP(u, c6, c7);
+	y0 = LERP(v, x0, x1);
+	y1 = LERP(v, x2, x3);
+
+	if (grad) {
+		/*
+		 * The blend of the corner gradients, plus the change in
+		 * the blending weights along each axis.
+		 */
+		grad->x = DNOISESCALE * (DFADE(x) *
+			LERP(w, LERP(v, c1-c0, c3-c2), LERP(v, c5-c4, c7-c6)) +
+			LERP(w, LERP(v, LERP(u, g0[0], g1[0]),
+					LERP(u, g2[0], g3[0])),
+				LERP(v, LERP(u, g4[0], g5[0]),
+					LERP(u, g6[0], g7[0]))));
+		grad->y = DNOISESCALE * (DFADE(y) * LERP(w, x1-x0, x3-x2) +
+			LERP(w, LERP(v, LERP(u, g0[1], g1[1]),
+					LERP(u, g2[1], g3[1])),
+				LERP(v, LERP(u, g4[1], g5[1]),
+					LERP(u, g6[1], g7[1]))));
+		grad->z = DNOISESCALE * (DFADE(z) * (y1 - y0) +
+			LERP(w, LERP(v, LERP(u, g0[2], g1[2]),
+					LERP(u, g2[2], g3[2])),
+				LERP(v, LERP(u, g4[2], g5[2]),
+					LERP(u, g6[2], g7[2]))));
+	}
+
+	return NOISESCALE * LERP(w, y0, y1);
+}
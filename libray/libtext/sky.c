@@ -46,6 +46,24 @@ int octaves;
 	return sky;
 }
 
+/*
+ * Fold the parameters of a "sky" texture into a hash key.
+ */
+unsigned long
+SkyHash(key, sky)
+unsigned long key;
+Sky *sky;
+{
+	key = HashString(key, "sky");
+	key = HashFloat(key, sky->beta);
+	key = HashFloat(key, sky->omega);
+	key = HashFloat(key, sky->lambda);
+	key = HashFloat(key, sky->scale);
+	key = HashFloat(key, sky->cthresh);
+	key = HashFloat(key, sky->lthresh);
+	return HashInt(key, sky->octaves);
+}
+
 void
 SkyApply(sky, prim, ray, pos, norm, gnorm, surf)
 Sky *sky;
@@ -56,7 +74,8 @@ Surface *surf;
 {
 	Float It, maxval;
 
-	It = fBm(pos, sky->omega, sky->lambda, sky->octaves);
+	It = fBm(pos, sky->omega, sky->lambda,
+		TextOctaves(ray, pos, sky->lambda, sky->octaves));
 	maxval = 1. / (1. - sky->omega);
 	/*
 	 * Map from [-maxval,maxval] to [0,1]
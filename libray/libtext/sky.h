@@ -28,7 +28,7 @@
 #ifndef SKY_H
 
 #define TextSkyCreate(s,h,l,n,c,t) TextCreate((TextRef)SkyCreate(s,h,l,n,c,t),\
-					SkyApply)
+					SkyApply, SkyHash)
 typedef struct {
 	Float	beta,
 		omega,
@@ -41,5 +41,6 @@ typedef struct {
 
 extern Sky *SkyCreate();
 extern void SkyApply();
+extern unsigned long SkyHash();
 
 #endif /* SKY_H */
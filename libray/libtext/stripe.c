@@ -44,6 +44,21 @@ Mapping *mapping;
 	return stripe;
 }
 
+/*
+ * Fold the parameters of a "stripe" texture into a hash key.
+ */
+unsigned long
+StripeHash(key, stripe)
+unsigned long key;
+Stripe *stripe;
+{
+	key = HashString(key, "stripe");
+	key = SurfaceHash(key, stripe->surf);
+	key = MappingHash(key, stripe->mapping);
+	key = HashFloat(key, stripe->width);
+	return HashFloat(key, stripe->bump);
+}
+
 void
 StripeApply(stripe, prim, ray, pos, norm, gnorm, surf)
 Stripe *stripe;
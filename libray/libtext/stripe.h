@@ -28,7 +28,7 @@
 #ifndef STRIPE_H
 
 #define TextStripeCreate(s,w,b,m) TextCreate((TextRef)StripeCreate(s,w,b,m), \
-					StripeApply)
+					StripeApply, StripeHash)
 typedef struct {
 	Surface	*surf;
 	Mapping	*mapping;
@@ -38,5 +38,6 @@ typedef struct {
 
 extern Stripe *StripeCreate();
 extern void StripeApply();
+extern unsigned long StripeHash();
 
 #endif /* STRIPE_H */
@@ -62,36 +62,66 @@ char *filename;
 	return map;
 }
 
+/*
+ * Fold a colormap read by ColormapRead(), or NULL, into a hash key.
+ */
+unsigned long
+ColormapHash(key, map)
+unsigned long key;
+Color *map;
+{
+	int i;
+
+	if (map == (Color *)NULL)
+		return HashBytes(key, "-", 1);
+	for (i = 0; i < 256; i++)
+		key = HashColor(key, &map[i]);
+	return key;
+}
+
 Float
 Marble(vec)
 Vector *vec;
 {
 	Float i;
 
-	i = sin(8. * Chaos(vec, 6) + 7. * vec->z) + 1;
+	i = sin(8. * Chaos(vec, 6.) + 7. * vec->z) + 1;
 	
 	return pow(0.5 * i, 0.77);
 }
 
+/*
+ * The sums of octaves below find the points for up to NOISE_BATCH
+ * octaves at a time, evaluate the noise at all of them with one call,
+ * and then add up the octaves in the usual order.  Chaos(), VfBm()
+ * and fBm() take a fractional number of octaves, the last of which is
+ * weighted by its fraction.
+ */
 Float
 PAChaos(vec, octaves)
 Vector *vec;
 int octaves;
 {
-	Float s, t, tmp;
-	Vector tp;
+	Float s, t, tmp, n[NOISE_BATCH];
+	Vector p, tp[NOISE_BATCH];
+	int i, num;
 
 	s = 1.0;
 	t = 0.;
-	tp = *vec;
+	p = *vec;
 
-	while (octaves--) {
-		tmp = Noise3(&tp) * s;
-		t += fabs(tmp);
-		s *= 0.5;
-		tp.x *= 2.;
-		tp.y *= 2.;
-		tp.z *= 2.;
+	while (octaves > 0) {
+		for (num = 0; num < NOISE_BATCH && num < octaves; num++) {
+			tp[num] = p;
+			VecScale(2., p, &p);
+		}
+		Noise3Array(num, tp, n);
+		for (i = 0; i < num; i++) {
+			tmp = n[i] * s;
+			t += fabs(tmp);
+			s *= 0.5;
+		}
+		octaves -= num;
 	}
 
 	return t;
@@ -100,21 +130,30 @@ int octaves;
 Float
 Chaos(vec, octaves)
 Vector *vec;
-int octaves;
+Float octaves;
 {
-	Float s, t;
-	Vector tp;
+	Float s, t, n[NOISE_BATCH];
+	Vector p, tp[NOISE_BATCH];
+	int i, num;
 
 	s = 1.0;
 	t = 0.;
-	tp = *vec;
+	p = *vec;
 
-	while (octaves--) {
-		t += Noise3(&tp) * s;
-		s *= 0.5;
-		tp.x *= 2.;
-		tp.y *= 2.;
-		tp.z *= 2.;
+	while (octaves > 0.) {
+		for (num = 0; num < NOISE_BATCH && num < octaves; num++) {
+			tp[num] = p;
+			VecScale(2., p, &p);
+		}
+		Noise3Array(num, tp, n);
+		for (i = 0; i < num; i++) {
+			if (octaves - i < 1.)
+				t += (octaves - i) * n[i] * s;
+			else
+				t += n[i] * s;
+			s *= 0.5;
+		}
+		octaves -= num;
 	}
 
 	return t;
@@ -123,47 +162,62 @@ int octaves;
 void
 VfBm(vec, omega, lambda, octaves, ans)
 Vector *vec, *ans;
-Float omega, lambda;
-int octaves;
+Float omega, lambda, octaves;
 {
-	Float o;
-	Vector tp, n;
+	Float o, w[NOISE_BATCH];
+	Vector p, tp[NOISE_BATCH], n[NOISE_BATCH];
+	int i, num;
 
 	ans->x = ans->y = ans->z = 0.;
-	tp = *vec;
+	p = *vec;
 	o = 1.;
 
-	while (octaves--) {
-		DNoise3(&tp, &n);
-		ans->x += o * n.x;
-		ans->y += o * n.y;
-		ans->z += o * n.z;
-		o *= omega;
-		if (o < EPSILON)
-			break;
-		tp.x *= lambda;
-		tp.y *= lambda;
-		tp.z *= lambda;
+	while (octaves > 0.) {
+		num = 0;
+		while (num < NOISE_BATCH && octaves > 0.) {
+			tp[num] = p;
+			w[num++] = octaves < 1. ? octaves * o : o;
+			octaves -= 1.;
+			o *= omega;
+			if (o < EPSILON)
+				octaves = 0.;
+			else
+				VecScale(lambda, p, &p);
+		}
+		DNoise3Array(num, tp, n);
+		for (i = 0; i < num; i++) {
+			ans->x += w[i] * n[i].x;
+			ans->y += w[i] * n[i].y;
+			ans->z += w[i] * n[i].z;
+		}
 	}
 }
 
 Float
 fBm(vec, omega, lambda, octaves)
 register Vector *vec;
-Float omega, lambda;
-int octaves;
+Float omega, lambda, octaves;
 {
-	Float a, o;
-	Vector tp;
+	Float a, o, n[NOISE_BATCH];
+	Vector p, tp[NOISE_BATCH];
+	int i, num;
 
 	a = 0; o = 1.;
-	tp = *vec;
-	while (octaves--) {
-		a += o * Noise3(&tp);
-		tp.x *= lambda;
-		tp.y *= lambda;
-		tp.z *= lambda;
-		o *= omega;
+	p = *vec;
+	while (octaves > 0.) {
+		for (num = 0; num < NOISE_BATCH && num < octaves; num++) {
+			tp[num] = p;
+			VecScale(lambda, p, &p);
+		}
+		Noise3Array(num, tp, n);
+		for (i = 0; i < num; i++) {
+			if (octaves - i < 1.)
+				a += (octaves - i) * o * n[i];
+			else
+				a += o * n[i];
+			o *= omega;
+		}
+		octaves -= num;
 	}
 	return a;
 }
@@ -239,20 +293,25 @@ Float lambda, omega;
 int octaves;
 {
 	Float s;
-	Vector point, tmp;
+	Vector point, tp[NOISE_BATCH], tmp[NOISE_BATCH];
+	int i, num;
 
 	res->x = res->y = res->z = 0.;
 	s = 1.;
 	point = *pos;
-	while (octaves--) {
-		DNoise3(&point, &tmp);
-		point.x *= lambda;
-		point.y *= lambda;
-		point.z *= lambda;
-		res->x += tmp.x * s;
-		res->y += tmp.y * s;
-		res->z += tmp.z * s;
-		s *= omega;
+	while (octaves > 0) {
+		for (num = 0; num < NOISE_BATCH && num < octaves; num++) {
+			tp[num] = point;
+			VecScale(lambda, point, &point);
+		}
+		DNoise3Array(num, tp, tmp);
+		for (i = 0; i < num; i++) {
+			res->x += tmp[i].x * s;
+			res->y += tmp[i].y * s;
+			res->z += tmp[i].z * s;
+			s *= omega;
+		}
+		octaves -= num;
 	}
 }
 
@@ -262,15 +321,16 @@ Vector *pos, *res;
 Float windscale, chaoscale, bumpscale, tscale, hscale, offset;
 int octaves;
 {
-	Vector spoint, tmp;
+	Vector spoint, tmp, tp[NOISE_BATCH], n[NOISE_BATCH];
 	Float windfield, f, scalar;
+	int i, num;
 
 	spoint = *pos;
 	spoint.x *= windscale;
 	spoint.y *= windscale;
 	spoint.z *= windscale;
 	if (chaoscale)
-		windfield = chaoscale * Chaos(&spoint, 7);
+		windfield = chaoscale * Chaos(&spoint, 7.);
 	else
 		windfield = 1.;
 
@@ -281,16 +341,19 @@ int octaves;
 
 	f = 1.;
 	scalar = windfield;
-	while (octaves--) {
-		f *= tscale;
-		spoint.x = f*pos->x;
-		spoint.y = f*pos->y;
-		spoint.z = f*pos->z;
-		DNoise3(&spoint, &tmp);
-		res->x += scalar*tmp.x;
-		res->y += scalar*tmp.y;
-		res->z += scalar*tmp.z;
-		scalar *= hscale;
+	while (octaves > 0) {
+		for (num = 0; num < NOISE_BATCH && num < octaves; num++) {
+			f *= tscale;
+			VecScale(f, *pos, &tp[num]);
+		}
+		DNoise3Array(num, tp, n);
+		for (i = 0; i < num; i++) {
+			res->x += scalar*n[i].x;
+			res->y += scalar*n[i].y;
+			res->z += scalar*n[i].z;
+			scalar *= hscale;
+		}
+		octaves -= num;
 	}
 	res->x *= windfield + offset;
 	res->y *= windfield + offset;
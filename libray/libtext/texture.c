@@ -29,44 +29,78 @@
 
 /*
  * Transformation structures used to map from texture space to
- * model/primitive/world space.
+ * model/primitive/world space.  model2text points at the texture's
+ * own cached transformation while it is being applied; prim2text and
+ * world2text are only composed if a texture asks for them.
  */
-Trans prim2model, model2text, prim2text, world2text;
+Trans prim2model, *model2text, prim2text, world2text;
+
+static Trans TextIdentity, *world2model;
+static int prim2textok, world2textok;
+static Float TextDetail;	/* footprint scale for octaves, or 0 */
+
+static void TextTransUpdate();
 
 #define ApplyMapping(m,o,p,n,c,u,v)	(*m->method)(m, o, p, n, c, u, v)
 
 Texture *
-TextCreate(data, meth)
+TextCreate(data, meth, hash)
 TextRef data;
 void (*meth)();
+unsigned long (*hash)();
 {
 	Texture *res;
 
 	res = (Texture *)share_calloc(1, sizeof(Texture));
 	res->data = data;
 	res->method = meth;
+	res->hash = hash;
 	res->trans = (Trans *)NULL; 
 	res->next = (Texture *)NULL;
 	res->animtrans = FALSE;
+	res->timenow = -FAR_AWAY;	/* impossible value */
+	TransInit(&TextIdentity);
 	return res;
 }
 
+/*
+ * Fold a list of textures into a hash key:  the placement of each,
+ * and its kind and parameters as given by its hash method.  A texture
+ * with no hash method adds only a mark, so that changes to it go
+ * unnoticed, but the key is the same from run to run.
+ */
+unsigned long
+TextHash(key, tlist)
+unsigned long key;
+Texture *tlist;
+{
+	for (; tlist; tlist = tlist->next) {
+		key = HashTrans(key, tlist->trans);
+		if (tlist->hash)
+			key = (*tlist->hash)(key, tlist->data);
+		else
+			key = HashBytes(key, "?", 1);
+	}
+	return HashBytes(key, "-", 1);
+}
+
 /*
  * Apply appropriate textures to a surface.
  */
 void
-TextApply(tlist, prim, ray, pos, norm, gnorm, surf, p2model, world2model)
+TextApply(tlist, prim, ray, pos, norm, gnorm, surf, p2model, w2model)
 Texture *tlist;				/* Textures */
 Geom *prim;
 Ray *ray;
 Vector *pos, *norm, *gnorm;		/* pos, shading norm, geo. norm */
 Surface *surf;
-Trans *p2model, *world2model;
+Trans *p2model, *w2model;
 {
 	Vector ptmp;
 	Texture *ttmp;
 
 	prim2model = *p2model;
+	world2model = w2model;
 	/*
 	 * Walk down texture list, applying each in turn.
 	 */
@@ -76,32 +110,8 @@ Trans *p2model, *world2model;
 		 */
 		ptmp = *pos;
 		if (ttmp->trans) {
-			/*
-			 * 'take' the inverse of ttmp->trans, since
-			 * transforming a texture means applying the
-			 * inverse of the transformation
-			 * to the point of intersection, etc.
-			 */
-			if (ttmp->animtrans) {
-				/*
-				 * Resolve animated associations.
-				 * We currently do not store a time
-				 * for the texture, so we can't know if
-				 * we're already resolved for the current
-				 * ray->time.
-				 */
-				TransResolveAssoc(ttmp->trans);
-				TransComposeList(ttmp->trans, &model2text);
-				TransInvert(&model2text, &model2text);
-			} else
-				TransInvert(ttmp->trans, &model2text);
-			/*
-			 * We compose ttmp->trans, which maps from model to
-			 * texture space, with prim2model and world2model
-			 * to get prim2text and world2text.
-			 */
-			TransCompose(&model2text, &prim2model, &prim2text);
-			TransCompose(&model2text, world2model, &world2text);
+			TextTransUpdate(ttmp, ray->time);
+			model2text = &ttmp->model2text;
 			/*
 			 * Transform intersection point to texture space.
 			 * Ray and normal are passed in model space.
@@ -111,10 +121,9 @@ Trans *p2model, *world2model;
 			/*
 		 	 * By default, texture and model space are identical.
 		 	 */
-			TransInit(&model2text);
-			TransCopy(&prim2model, &prim2text);
-			TransCopy(world2model, &world2text);
+			model2text = &TextIdentity;
 		}
+		prim2textok = world2textok = FALSE;
 
 		/*
 		 * Call texture function.
@@ -123,6 +132,132 @@ Trans *p2model, *world2model;
 	}
 }
 
+/*
+ * Bring the texture's cached model-to-texture transformation up to
+ * date for the given time.  Transforming a texture means applying
+ * the inverse of its transformation to the point of intersection,
+ * etc.  A static transformation is inverted once; an animated one is
+ * resolved again only when the time changes, as is done for objects.
+ */
+static void
+TextTransUpdate(text, time)
+Texture *text;
+Float time;
+{
+	if (text->animtrans) {
+		if (equal(text->timenow, time))
+			return;
+		TransResolveAssoc(text->trans);
+		TransComposeList(text->trans, &text->model2text);
+		TransInvert(&text->model2text, &text->model2text);
+	} else {
+		if (text->timenow != -FAR_AWAY)
+			return;
+		TransInvert(text->trans, &text->model2text);
+	}
+	text->timenow = time;
+}
+
+/*
+ * Return the transformation from primitive (or world) space to the
+ * space of the texture being applied, composing model2text with
+ * prim2model (or world2model) the first time it is asked for.
+ */
+Trans *
+TextPrimToText()
+{
+	if (!prim2textok) {
+		if (model2text == &TextIdentity)
+			TransCopy(&prim2model, &prim2text);
+		else
+			TransCompose(model2text, &prim2model, &prim2text);
+		prim2textok = TRUE;
+	}
+	return &prim2text;
+}
+
+Trans *
+TextWorldToText()
+{
+	if (!world2textok) {
+		if (model2text == &TextIdentity)
+			TransCopy(world2model, &world2text);
+		else
+			TransCompose(model2text, world2model, &world2text);
+		world2textok = TRUE;
+	}
+	return &world2text;
+}
+
+/*
+ * Set the factor by which footprints are scaled when deciding how many
+ * octaves of noise are worth summing.  If 0, all of them always are.
+ */
+void
+TextSetDetail(detail)
+Float detail;
+{
+	TextDetail = detail;
+}
+
+/*
+ * Estimate the width, in texture space, of the footprint of the given
+ * (model space) ray at 'pos'.  If 'dir' is given, it is set to the
+ * unit direction of the ray in texture space.
+ */
+Float
+TextFootprint(ray, pos, dir)
+Ray *ray;
+Vector *pos, *dir;
+{
+	Ray tray;
+	Vector eye;
+	Float dist;
+
+	tray = *ray;
+	(void)ModelRayToText(&tray);
+	VecSub(*pos, tray.pos, &eye);
+	dist = sqrt(dotp(&eye, &eye));
+	if (dir) {
+		if (dist > 0.)
+			VecScale(1. / dist, eye, dir);
+		else
+			*dir = tray.dir;
+	}
+	return RayFootprint(&tray, dist);
+}
+
+/*
+ * Return how many of 'octaves' octaves of noise, each 'lambda' times
+ * the frequency of the one before, to sum at 'pos' along the given ray.
+ * Octaves finer than the ray's footprint, scaled by the detail factor,
+ * would only alias, and are dropped.  The first is always kept.  The
+ * count is fractional, the last octave kept being faded out by its
+ * fraction, so that octaves don't pop in and out where the footprint
+ * crosses from one count to the next.
+ */
+Float
+TextOctaves(ray, pos, lambda, octaves)
+Ray *ray;
+Vector *pos;
+Float lambda;
+int octaves;
+{
+	Float foot, n;
+
+	if (TextDetail <= 0. || lambda <= 1. || octaves <= 1)
+		return (Float)octaves;
+	foot = TextDetail * TextFootprint(ray, pos, (Vector *)NULL);
+	if (foot <= 0.)
+		return (Float)octaves;
+	n = 1. - log(foot) / log(lambda);
+	if (n < 1.)
+		return 1.;
+	if (n < (Float)octaves)
+		return n;
+	return (Float)octaves;
+}
+
 /*
  * Compute UV at 'pos' on given primitive.
  */
@@ -163,7 +298,7 @@ Float *u, *v;
 	ptmp.x = uv.u;
 	ptmp.y = uv.v;
 	ptmp.z = 0.;
-	PointTransform(&ptmp, &model2text.trans);
+	PointTransform(&ptmp, &model2text->trans);
 	*u = ptmp.x;
 	*v = ptmp.y;
 	if (dpdu == (Vector *)NULL || dpdv == (Vector *)NULL)
@@ -182,7 +317,7 @@ Float *u, *v;
 	/*
 	 * ... apply model2text in UVN space.
 	 */
-	MatrixMult(&model2text.itrans, &t, &t);
+	MatrixMult(&model2text->itrans, &t, &t);
 	dpdu->x = t.matrix[0][0];
 	dpdu->y = t.matrix[0][1];
 	dpdu->z = t.matrix[0][2];
@@ -30,6 +30,7 @@
 
 #include "libobj/geom.h"
 #include "libsurf/surface.h"
+#include "libcommon/hash.h"
 #include "mapping.h"
 
 /*
@@ -46,19 +47,19 @@
 #define BUMP		8
 #define INDEX		9
 
-#define TextPointToModel(p)	PointTransform(p, &model2text.itrans)
-#define TextPointToPrim(p)	PointTransform(p, &prim2text.itrans)
-#define TextPointToWorld(p)	PointTransform(p, &world2text.itrans)
-#define TextRayToModel(p)	RayTransform(r, &model2text.itrans)
-#define TextRayToPrim(r)	RayTransform(r, &prim2text.itrans)
-#define TextRayToWorld(r)	RayTransform(r, &world2text.itrans)
-#define TextNormToModel(n)	NormalTransform(n, &model2text.trans)
-#define TextNormToPrim(n)	NormalTransform(n, &prim2text.trans)
-#define TextNormToWorld(n)	NormalTransform(n, &world2text.trans)
+#define TextPointToModel(p)	PointTransform(p, &model2text->itrans)
+#define TextPointToPrim(p)	PointTransform(p, &TextPrimToText()->itrans)
+#define TextPointToWorld(p)	PointTransform(p, &TextWorldToText()->itrans)
+#define TextRayToModel(p)	RayTransform(r, &model2text->itrans)
+#define TextRayToPrim(r)	RayTransform(r, &TextPrimToText()->itrans)
+#define TextRayToWorld(r)	RayTransform(r, &TextWorldToText()->itrans)
+#define TextNormToModel(n)	NormalTransform(n, &model2text->trans)
+#define TextNormToPrim(n)	NormalTransform(n, &TextPrimToText()->trans)
+#define TextNormToWorld(n)	NormalTransform(n, &TextWorldToText()->trans)
 
-#define ModelPointToText(p)	PointTransform(p, &model2text.trans)
-#define ModelNormToText(n)	NormalTransform(n, &model2text.itrans)
-#define ModelRayToText(r)	RayTransform(r, &model2text.trans)
+#define ModelPointToText(p)	PointTransform(p, &model2text->trans)
+#define ModelNormToText(n)	NormalTransform(n, &model2text->itrans)
+#define ModelRayToText(r)	RayTransform(r, &model2text->trans)
 
 typedef char *TextRef;
 
@@ -68,17 +69,26 @@ typedef char *TextRef;
 typedef struct Texture {
 	TextRef data;			/* Texturing info */
 	void	(*method)();		/* method */
+	unsigned long (*hash)();	/* fold parameters into a hash key */
 	Trans	*trans;			/* transformation info */
 	short	animtrans;		/* is the transformation animated? */
+	Float	timenow;		/* time for which model2text is good */
+	Trans	model2text;		/* inverse of trans, at timenow */
 	struct Texture *next;		/* next in list */
 } Texture;
 
+#define NOISE_BATCH	8	/* Max # of octaves of noise found at once */
+
 extern Texture	*TextCreate(), *TextAppend();
 extern void	DNoise3(), VfBm(), TextApply(), MakeBump(), Wrinkled();
-extern Float	Noise3(), Noise2(), Chaos(), Marble(), fBm();
+extern void	Noise3Array(), DNoise3Array(), NoiseSetCompat();
+extern void	TextSetDetail();
+extern Float	Noise3(), Noise2(), Chaos(), Marble(), fBm(), TextFootprint();
+extern Float	TextOctaves();
 extern int	TileValue();
+extern unsigned long TextHash(), ColormapHash();
 Color		*ColormapRead();
 
-extern Trans	model2text, prim2text, world2text;
+extern Trans	*model2text, *TextPrimToText(), *TextWorldToText();
 
 #endif TEXTURE_H
@@ -50,6 +50,25 @@ int octaves;
 	return windy;
 }
 
+/*
+ * Fold the parameters of a "windy" texture into a hash key.
+ */
+unsigned long
+WindyHash(key, windy)
+unsigned long key;
+WindyText *windy;
+{
+	key = HashString(key, "windy");
+	key = HashFloat(key, windy->scale);
+	key = HashFloat(key, windy->windscale);
+	key = HashFloat(key, windy->chaoscale);
+	key = HashFloat(key, windy->bumpscale);
+	key = HashFloat(key, windy->tscale);
+	key = HashFloat(key, windy->hscale);
+	key = HashFloat(key, windy->offset);
+	return HashInt(key, windy->octaves);
+}
+
 /*
  * Apply a "windy" texture.
  */
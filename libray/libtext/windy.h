@@ -28,7 +28,7 @@
 #ifndef WINDY_H
 
 #define TextWindyCreate(s,w,c,b,o,t,h,i) TextCreate( \
-		(TextRef)WindyCreate(s,w,c,b,o,t,h,i), WindyApply)
+		(TextRef)WindyCreate(s,w,c,b,o,t,h,i), WindyApply, WindyHash)
 
 typedef struct {
 	Float	scale,
@@ -43,5 +43,6 @@ typedef struct {
 
 extern WindyText *WindyCreate();
 extern void WindyApply();
+extern unsigned long WindyHash();
 
 #endif /* WINDY_H */
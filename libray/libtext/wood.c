@@ -34,6 +34,18 @@ WoodCreate()
 	return (Wood *)NULL;	/* No data associated with wood texture */
 }
 
+/*
+ * Fold a "wood" texture, which has no parameters, into a hash key.
+ */
+/*ARGSUSED*/
+unsigned long
+WoodHash(key, wood)
+unsigned long key;
+Wood *wood;
+{
+	return HashString(key, "wood");
+}
+
 /*ARGSUSED*/
 void
 WoodApply(wood, prim, ray, pos, norm, gnorm, surf)
@@ -48,7 +60,7 @@ Surface *surf;
 	Float perturb, brownPerturb, greenPerturb, grnPerturb;
 	Float t;
 
-	chaos = Chaos(pos, 7);
+	chaos = Chaos(pos, TextOctaves(ray, pos, 2., 7));
 	t = sin(sin(8.*chaos + 7*pos->x +3.*pos->y));
 
 	greenLayer = brownLayer = fabs(t);
@@ -28,11 +28,12 @@
 #ifndef WOOD_H
 
 #define TextWoodCreate()	TextCreate((TextRef) WoodCreate(), \
-					WoodApply)
+					WoodApply, WoodHash)
 
 typedef char Wood;
 
 extern Wood *WoodCreate();
 extern void WoodApply();
+extern unsigned long WoodHash();
 
 #endif /* WOOD_H */
@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "rayshade.h"
+#include "libobj/csg.h"
+#include "libobj/grid.h"
+#include "libobj/instance.h"
+#include "libobj/list.h"
+#include "libsurf/surface.h"
+#include "libtext/texture.h"
+#include "libcommon/hash.h"
+#include "libcommon/sampling.h"
+#include "options.h"
+#include "stats.h"
+#include "viewing.h"
+#include "gbuffer.h"
+#include <unistd.h>
+
+/*
+ * G-buffer.
+ *
+ * The first hit of every eye ray -- where it lies, the normals there,
+ * and the properties of the surface once any textures have been
+ * applied -- may be kept in a file.  A later run that renders the same
+ * view of the same objects reads the file back and shades those hits
+ * directly, casting fresh shadow, reflected and transmitted rays.
+ * Light sources may thus be changed and the image rendered again
+ * without tracing the eye rays or evaluating textures.
+ *
+ * The file is keyed by a hash of the camera, the sampling of the
+ * screen, and the kind, placement, bounds, surface and textures of
+ * every object, aggregates and their children alike.
+ * If the key does not match that of the frame being rendered, the eye
+ * rays are traced as usual and the file is rewritten when the frame
+ * is done.  Eye rays that are not in the file, such as those of pixels
+ * supersampled only because the shading changed, are simply traced.
+ */
+#define GB_MAGIC	0x52534742	/* "RSGB" */
+#define GB_VERSION	1
+
+#define GB_OFF		0		/* not in use */
+#define GB_RECORD	1		/* recording first hits */
+#define GB_RELIGHT	2		/* shading recorded hits */
+
+typedef struct {
+	long	magic, version;
+	unsigned long key;		/* hash of view and objects */
+	long	nhits, nsurfs;		/* # of hits and surfaces */
+} GBufferHeader;
+
+/*
+ * A surface as kept in the file.  Each distinct surface is kept once,
+ * whether it is shared by many objects or was made by a texture.
+ */
+typedef struct {
+	float	color[5][3],		/* amb, diff, spec, translu, body */
+		value[7];		/* srexp ... translucency */
+	int	noshadow;
+} GSurf;
+
+static int	Mode;			/* GB_OFF, GB_RECORD or GB_RELIGHT */
+static unsigned long Key;		/* key of current frame */
+static GHit	*Hits;			/* first hits */
+static long	NHits, MaxHits;
+static GSurf	*Packed;		/* the surfaces they hit ... */
+static Surface	*Surfs;			/* ... and the same, unpacked */
+static long	NSurfs, MaxSurfs;
+static long	*HitIndex,		/* hash table of hits, by position */
+		*SurfIndex;		/* ... of surfaces, by value */
+static unsigned long HitMask, SurfMask;
+
+static unsigned long GBufferKey(), HashHit(), HashGeom();
+static int GBufferRead();
+static long SurfFind();
+static void SurfPack(), SurfUnpack(), SurfIndexBuild(), HitIndexBuild();
+static voidstar GBufferGrow();
+
+/*
+ * Prepare to use the G-buffer for the current frame.  Must be called
+ * after WorldSetup() and RSViewing().
+ */
+void
+GBufferSetup()
+{
+	Mode = GB_OFF;
+	if (Options.gbuffer == (char *)NULL)
+		return;
+
+	Key = GBufferKey();
+	if (GBufferRead(Options.gbuffer)) {
+		Mode = GB_RELIGHT;
+		return;
+	}
+	/*
+	 * Make room for a hit per pixel up front; supersampling
+	 * will call for more.
+	 */
+	Mode = GB_RECORD;
+	NHits = NSurfs = 0;
+	if (MaxHits < Screen.xsize * Screen.ysize) {
+		if (Hits)
+			free((voidstar)Hits);
+		MaxHits = Screen.xsize * Screen.ysize;
+		Hits = (GHit *)Malloc(MaxHits * sizeof(GHit));
+	}
+	if (Packed == (GSurf *)NULL) {
+		MaxSurfs = 256;
+		Packed = (GSurf *)Malloc(MaxSurfs * sizeof(GSurf));
+		Surfs = (Surface *)Malloc(MaxSurfs * sizeof(Surface));
+	}
+	SurfIndexBuild();
+}
+
+/*
+ * Look up the first hit of the eye ray through screen position (x, y)
+ * with the given sample number.  Returns NULL if it is not known, else
+ * the hit and, in 'surf', the surface hit or NULL if the ray hit nothing.
+ */
+GHit *
+GBufferFetch(x, y, sample, surf)
+Float x, y;
+int sample;
+Surface **surf;
+{
+	GHit *hit;
+	unsigned long i;
+
+	if (Mode != GB_RELIGHT)
+		return (GHit *)NULL;
+	for (i = HashHit(x, y, sample) & HitMask; HitIndex[i] >= 0;
+	     i = (i + 1) & HitMask) {
+		hit = &Hits[HitIndex[i]];
+		if (hit->x == (float)x && hit->y == (float)y &&
+		    hit->sample == sample) {
+			Stats.GBufferHits++;
+			*surf = hit->surf < 0 ? (Surface *)NULL :
+					&Surfs[hit->surf];
+			return hit;
+		}
+	}
+	Stats.GBufferMisses++;
+	return (GHit *)NULL;
+}
+
+/*
+ * Record the first hit of the eye ray through (x, y), which has just
+ * been traced, finding the properties of the surface hit as ShadeRay()
+ * would.  Returns NULL if the G-buffer is not in use, else the hit
+ * and, in 'surf', the surface hit or NULL.  The hit should be shaded
+ * as recorded, so that every eye ray is shaded the same way whether
+ * or not it was found in the G-buffer.  When relighting, the hit is
+ * not kept.
+ */
+GHit *
+GBufferRecord(x, y, sample, hitlist, ray, dist, surf)
+Float x, y;
+int sample;
+HitList *hitlist;
+Ray *ray;
+Float dist;
+Surface **surf;
+{
+	GHit *hit;
+	Vector norm, gnorm;
+	Surface copy;
+	int smooth;
+	static GHit spare;
+
+	if (Mode == GB_OFF)
+		return (GHit *)NULL;
+	if (Mode == GB_RELIGHT)
+		hit = &spare;
+	else {
+		if (NHits == MaxHits) {
+			Hits = (GHit *)GBufferGrow((voidstar)Hits, MaxHits,
+						sizeof(GHit));
+			MaxHits *= 2;
+		}
+		hit = &Hits[NHits++];
+	}
+	hit->x = x;
+	hit->y = y;
+	hit->sample = sample;
+	hit->dist = dist;
+	if (hitlist->nodes == 0) {
+		hit->surf = -1;
+		*surf = (Surface *)NULL;
+		return hit;
+	}
+	*surf = GetShadingSurf(hitlist);
+	hit->enter = ComputeSurfProps(hitlist, ray, &hit->pos, &norm,
+			&gnorm, surf, &copy, &smooth);
+	hit->smooth = smooth;
+	hit->norm[0] = norm.x;
+	hit->norm[1] = norm.y;
+	hit->norm[2] = norm.z;
+	hit->gnorm[0] = gnorm.x;
+	hit->gnorm[1] = gnorm.y;
+	hit->gnorm[2] = gnorm.z;
+	hit->surf = SurfFind(*surf);
+	*surf = &Surfs[hit->surf];
+	return hit;
+}
+
+/*
+ * Write the first hits recorded for this frame to the G-buffer file.
+ * As with height field caches, the file is written under a temporary
+ * name and then renamed.
+ */
+void
+GBufferSave()
+{
+	FILE *fp;
+	GBufferHeader head;
+	char *tmpname;
+	int ok;
+
+	if (Mode != GB_RECORD)
+		return;
+	tmpname = Malloc((unsigned)(strlen(Options.gbuffer) + 16));
+	sprintf(tmpname, "%s.%d", Options.gbuffer, (int)getpid());
+	fp = fopen(tmpname, "w");
+	if (fp == (FILE *)NULL) {
+		RLerror(RL_WARN, "Cannot write G-buffer %s.\n", tmpname);
+		free((voidstar)tmpname);
+		return;
+	}
+	bzero((char *)&head, sizeof(GBufferHeader));
+	head.magic = GB_MAGIC;
+	head.version = GB_VERSION;
+	head.key = Key;
+	head.nhits = NHits;
+	head.nsurfs = NSurfs;
+	ok = fwrite((char *)&head, sizeof(GBufferHeader), 1, fp) == 1 &&
+		fwrite((char *)Hits, sizeof(GHit), NHits, fp) == NHits &&
+		fwrite((char *)Packed, sizeof(GSurf), NSurfs, fp) == NSurfs;
+	if (fclose(fp) != 0 || !ok || rename(tmpname, Options.gbuffer) != 0) {
+		RLerror(RL_WARN, "Cannot write G-buffer %s.\n",
+			Options.gbuffer);
+		(void)unlink(tmpname);
+	}
+	free((voidstar)tmpname);
+}
+
+/*
+ * Read the G-buffer file, if it was recorded with the current key.
+ */
+static int
+GBufferRead(name)
+char *name;
+{
+	FILE *fp;
+	GBufferHeader head;
+	long i;
+	int ok;
+
+	fp = fopen(name, "r");
+	if (fp == (FILE *)NULL)
+		return FALSE;
+	if (fread((char *)&head, sizeof(GBufferHeader), 1, fp) != 1 ||
+	    head.magic != GB_MAGIC || head.version != GB_VERSION ||
+	    head.key != Key || head.nhits < 0 || head.nsurfs < 0) {
+		(void)fclose(fp);
+		return FALSE;
+	}
+	if (MaxHits < head.nhits) {
+		if (Hits)
+			free((voidstar)Hits);
+		MaxHits = head.nhits;
+		Hits = (GHit *)Malloc(MaxHits * sizeof(GHit));
+	}
+	if (MaxSurfs <= head.nsurfs) {
+		if (Packed) {
+			free((voidstar)Packed);
+			free((voidstar)Surfs);
+		}
+		MaxSurfs = head.nsurfs + 256;
+		Packed = (GSurf *)Malloc(MaxSurfs * sizeof(GSurf));
+		Surfs = (Surface *)Malloc(MaxSurfs * sizeof(Surface));
+	}
+	NHits = head.nhits;
+	NSurfs = head.nsurfs;
+	ok = fread((char *)Hits, sizeof(GHit), NHits, fp) == NHits &&
+		fread((char *)Packed, sizeof(GSurf), NSurfs, fp) == NSurfs;
+	(void)fclose(fp);
+	for (i = 0; ok && i < NHits; i++)
+		ok = Hits[i].surf >= -1 && Hits[i].surf < NSurfs;
+	if (!ok)
+		return FALSE;
+	for (i = 0; i < NSurfs; i++)
+		SurfUnpack(&Packed[i], &Surfs[i]);
+	HitIndexBuild();
+	SurfIndexBuild();
+	return TRUE;
+}
+
+/*
+ * Build the hash table used by GBufferFetch().
+ */
+static void
+HitIndexBuild()
+{
+	unsigned long size, i;
+	long n;
+
+	for (size = 1024; size < 2 * NHits; size <<= 1)
+		;
+	if (HitIndex)
+		free((voidstar)HitIndex);
+	HitIndex = (long *)Malloc(size * sizeof(long));
+	HitMask = size - 1;
+	for (i = 0; i < size; i++)
+		HitIndex[i] = -1;
+	for (n = 0; n < NHits; n++) {
+		for (i = HashHit(Hits[n].x, Hits[n].y, Hits[n].sample) &
+		     HitMask; HitIndex[i] >= 0; i = (i + 1) & HitMask)
+			;
+		HitIndex[i] = n;
+	}
+}
+
+/*
+ * Index of the given surface in Surfs, adding it if need be.
+ */
+static long
+SurfFind(surf)
+Surface *surf;
+{
+	GSurf packed;
+	unsigned long i;
+
+	SurfPack(surf, &packed);
+	for (i = HashBytes(HASH_INIT, (char *)&packed, sizeof(GSurf)) &
+	     SurfMask; SurfIndex[i] >= 0; i = (i + 1) & SurfMask) {
+		if (bcmp((char *)&packed, (char *)&Packed[SurfIndex[i]],
+		    sizeof(GSurf)) == 0)
+			return SurfIndex[i];
+	}
+	if (NSurfs == MaxSurfs) {
+		Packed = (GSurf *)GBufferGrow((voidstar)Packed, MaxSurfs,
+					sizeof(GSurf));
+		Surfs = (Surface *)GBufferGrow((voidstar)Surfs, MaxSurfs,
+					sizeof(Surface));
+		MaxSurfs *= 2;
+	}
+	Packed[NSurfs] = packed;
+	SurfUnpack(&packed, &Surfs[NSurfs]);
+	SurfIndex[i] = NSurfs++;
+	if (2 * NSurfs > SurfMask)
+		/*
+		 * Keep the table at most half full.
+		 */
+		SurfIndexBuild();
+	return NSurfs - 1;
+}
+
+/*
+ * (Re)build the hash table used by SurfFind(), leaving it at most a
+ * quarter full.
+ */
+static void
+SurfIndexBuild()
+{
+	unsigned long size, i;
+	long n;
+
+	for (size = 1024; size < 4 * NSurfs; size <<= 1)
+		;
+	if (SurfIndex)
+		free((voidstar)SurfIndex);
+	SurfIndex = (long *)Malloc(size * sizeof(long));
+	SurfMask = size - 1;
+	for (i = 0; i < size; i++)
+		SurfIndex[i] = -1;
+	for (n = 0; n < NSurfs; n++) {
+		for (i = HashBytes(HASH_INIT, (char *)&Packed[n],
+		     sizeof(GSurf)) & SurfMask; SurfIndex[i] >= 0;
+		     i = (i + 1) & SurfMask)
+			;
+		SurfIndex[i] = n;
+	}
+}
+
+static void
+SurfPack(surf, packed)
+Surface *surf;
+GSurf *packed;
+{
+	Color *c[5];
+	int i;
+
+	bzero((char *)packed, sizeof(GSurf));
+	c[0] = &surf->amb;
+	c[1] = &surf->diff;
+	c[2] = &surf->spec;
+	c[3] = &surf->translu;
+	c[4] = &surf->body;
+	for (i = 0; i < 5; i++) {
+		packed->color[i][0] = c[i]->r;
+		packed->color[i][1] = c[i]->g;
+		packed->color[i][2] = c[i]->b;
+	}
+	packed->value[0] = surf->srexp;
+	packed->value[1] = surf->stexp;
+	packed->value[2] = surf->statten;
+	packed->value[3] = surf->index;
+	packed->value[4] = surf->reflect;
+	packed->value[5] = surf->transp;
+	packed->value[6] = surf->translucency;
+	packed->noshadow = surf->noshadow;
+}
+
+static void
+SurfUnpack(packed, surf)
+GSurf *packed;
+Surface *surf;
+{
+	Color *c[5];
+	int i;
+
+	c[0] = &surf->amb;
+	c[1] = &surf->diff;
+	c[2] = &surf->spec;
+	c[3] = &surf->translu;
+	c[4] = &surf->body;
+	for (i = 0; i < 5; i++) {
+		c[i]->r = packed->color[i][0];
+		c[i]->g = packed->color[i][1];
+		c[i]->b = packed->color[i][2];
+	}
+	surf->srexp = packed->value[0];
+	surf->stexp = packed->value[1];
+	surf->statten = packed->value[2];
+	surf->index = packed->value[3];
+	surf->reflect = packed->value[4];
+	surf->transp = packed->value[5];
+	surf->translucency = packed->value[6];
+	surf->noshadow = packed->noshadow;
+	surf->name = (char *)NULL;
+	surf->next = (Surface *)NULL;
+}
+
+/*
+ * Double the size of an array of num elements of the given size.
+ */
+static voidstar
+GBufferGrow(old, num, size)
+voidstar old;
+long num;
+unsigned size;
+{
+	voidstar new;
+
+	new = Malloc((unsigned)(2 * num * size));
+	bcopy((char *)old, (char *)new, (int)(num * size));
+	free(old);
+	return new;
+}
+
+static unsigned long
+HashHit(x, y, sample)
+Float x, y;
+int sample;
+{
+	return ((unsigned long)(long)floor(x) * 73856093UL ^
+		(unsigned long)(long)floor(y) * 19349663UL ^
+		(unsigned long)sample * 83492791UL);
+}
+
+/*
+ * The key of the current frame:  a hash of everything that decides
+ * which eye rays are traced and what they hit, and of the options
+ * that change how textures are evaluated at the hits.
+ */
+static unsigned long
+GBufferKey()
+{
+	unsigned long key;
+	int view[9];
+	extern Geom *World;
+	extern Surface DefaultSurface;
+
+	key = HASH_INIT;
+	key = HashVector(key, &Camera.pos);
+	key = HashVector(key, &Screen.firstray);
+	key = HashVector(key, &Screen.scrnx);
+	key = HashVector(key, &Screen.scrny);
+	view[0] = Screen.minx;
+	view[1] = Screen.miny;
+	view[2] = Screen.maxx;
+	view[3] = Screen.maxy;
+	view[4] = Sampling.sidesamples;
+	view[5] = Options.jitter;
+	view[6] = Options.framenum;
+	view[7] = Options.noisecompat;
+	view[8] = Options.bakedir != (char *)NULL;
+	key = HashBytes(key, (char *)view, sizeof(view));
+	key = HashFloat(key, Sampling.filterwidth);
+	key = HashFloat(key, Options.framestart);
+	key = HashFloat(key, Options.detail);
+	key = SurfaceHash(key, &DefaultSurface);
+	return HashGeom(key, World);
+}
+
+/*
+ * Fold an object into the hash, followed by any objects it is made of.
+ * Shared objects are hashed wherever they are instanced.
+ */
+static unsigned long
+HashGeom(key, obj)
+unsigned long key;
+Geom *obj;
+{
+	Geom *otmp;
+
+	key = HashString(key, GeomName(obj));
+	key = HashBytes(key, (char *)obj->bounds, sizeof(obj->bounds));
+	key = HashBytes(key, (char *)&obj->prims, sizeof(obj->prims));
+	key = HashTrans(key, obj->trans);
+	key = SurfaceHash(key, obj->surf);
+	key = TextHash(key, obj->texture);
+
+	if (obj->methods == CsgMethods()) {
+		key = HashBytes(key, &((Csg *)obj->obj)->operator, 1);
+		key = HashGeom(key, ((Csg *)obj->obj)->obj1);
+		key = HashGeom(key, ((Csg *)obj->obj)->obj2);
+	} else if (obj->methods == InstanceMethods())
+		key = HashGeom(key, ((Instance *)obj->obj)->obj);
+	else if (obj->methods == ListMethods()) {
+		for (otmp = ((List *)obj->obj)->list; otmp; otmp = otmp->next)
+			key = HashGeom(key, otmp);
+		for (otmp = ((List *)obj->obj)->unbounded; otmp;
+		     otmp = otmp->next)
+			key = HashGeom(key, otmp);
+	} else if (obj->methods == GridMethods()) {
+		for (otmp = ((Grid *)obj->obj)->objects; otmp;
+		     otmp = otmp->next)
+			key = HashGeom(key, otmp);
+		for (otmp = ((Grid *)obj->obj)->unbounded; otmp;
+		     otmp = otmp->next)
+			key = HashGeom(key, otmp);
+	}
+	/*
+	 * Mark the end of the children, so that moving an object
+	 * out of an aggregate changes the key.
+	 */
+	return HashBytes(key, ".", 1);
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+/*
+ * The first hit of an eye ray, as kept in the G-buffer.  The ray
+ * itself is found again from its screen position and sample number.
+ * Only the point of intersection, from which shadow and secondary
+ * rays are cast, is kept to full precision.
+ */
+typedef struct GHit {
+	float	x, y;		/* screen position of eye ray */
+	int	sample,		/* its sample number */
+		surf;		/* index of surface hit, or -1 if none */
+	Vector	pos;		/* point of intersection */
+	float	norm[3],	/* shading normal */
+		gnorm[3],	/* geometric normal */
+		dist;		/* distance to hit */
+	short	enter,		/* entering surface? */
+		smooth;		/* norm != gnorm? */
+} GHit;
+
+extern GHit	*GBufferFetch(), *GBufferRecord();
+extern void	GBufferSetup(), GBufferSave();
+
+#endif /* GBUFFER_H */
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "rayshade.h"
+#include "libobj/cull.h"
+#include "libcommon/sampling.h"
+#include "options.h"
+#include "stats.h"
+#include "viewing.h"
+
+/*
+ * Item buffer.
+ *
+ * When rendering through a pinhole camera, the first object hit by
+ * an eye ray can be found by rasterizing the scene.  Here, the bounding
+ * box of every object in the world is projected onto the screen, and
+ * each pixel-sized cell of the screen records the object whose box
+ * lies closest to the eye, along with the distance to the closest box
+ * belonging to any other object that covers the cell.  An eye ray
+ * through the cell is intersected with that object (and with anything
+ * that could not be projected).  If the ray hits closer than the
+ * second distance, nothing else could have been hit first, and the
+ * result is exactly what tracing the whole world would have given.
+ * Otherwise, the ray is traced as usual.
+ */
+typedef struct {
+	int obj;		/* index of closest object, -1 if none */
+	Float near,		/* distance from eye to its bounds */
+	      next;		/* ... to the bounds of any other object */
+} ItemCell;
+
+static CullList	*Items;		/* every object in the world */
+static int	*Always,	/* objects tested by every eye ray */
+		NAlways,	/* # of the above */
+		ItemsValid;	/* item buffer may be used? */
+static ItemCell	*Cells;		/* the item buffer proper */
+static int	CellX0, CellY0,	/* screen position of cell 0 */
+		CellW, CellH,	/* width & height, in cells */
+		MaxCells;	/* space allocated */
+
+static int ItemProject();
+static Float ItemNear();
+
+/*
+ * Build the item buffer for the current frame.  Must be called after
+ * WorldSetup() and RSViewing().
+ */
+void
+ItemBufferSetup()
+{
+	ItemCell *cp;
+	Geom *obj;
+	Float all[2][3], margin, near, u0, u1, v0, v1;
+	int i, x, y, x0, x1, y0, y1;
+	extern Geom *World;
+
+	ItemsValid = FALSE;
+	/*
+	 * Eye rays must all leave the eye itself, and the
+	 * world must stand still.
+	 */
+	if (!Options.itembuffer || Camera.aperture > 0. ||
+	    Options.shutterspeed > 0.)
+		return;
+
+	if (Items == (CullList *)NULL)
+		Items = CullListCreate();
+	all[LOW][X] = all[LOW][Y] = all[LOW][Z] = -FAR_AWAY;
+	all[HIGH][X] = all[HIGH][Y] = all[HIGH][Z] = FAR_AWAY;
+	CullListBuild(Items, World, all, 0);
+
+	if (Always)
+		free((voidstar)Always);
+	Always = (int *)Malloc(Items->nobjs * sizeof(int));
+	NAlways = 0;
+
+	/*
+	 * Cover every position SampleScreen() may be asked to sample.
+	 */
+	margin = 0.5 * Sampling.filterwidth + 1.;
+	CellX0 = (int)floor(Screen.minx - margin);
+	CellY0 = (int)floor(Screen.miny - margin);
+	CellW = (int)ceil(Screen.maxx + margin) - CellX0 + 1;
+	CellH = (int)ceil(Screen.maxy + margin) - CellY0 + 1;
+	if (CellW * CellH > MaxCells) {
+		if (Cells)
+			free((voidstar)Cells);
+		MaxCells = CellW * CellH;
+		Cells = (ItemCell *)Malloc(MaxCells * sizeof(ItemCell));
+	}
+	for (i = 0, cp = Cells; i < CellW * CellH; i++, cp++) {
+		cp->obj = -1;
+		cp->near = cp->next = FAR_AWAY;
+	}
+
+	for (i = 0; i < Items->nobjs; i++) {
+		obj = Items->objs[i];
+		if (!CullBounded(obj) ||
+		    !ItemProject(obj->bounds, &u0, &u1, &v0, &v1)) {
+			Always[NAlways++] = i;
+			continue;
+		}
+		/*
+		 * Round outward, so that a ray that grazes the bounding
+		 * box still finds the object in its cell.
+		 */
+		x0 = (int)floor(u0 - 0.5) - CellX0;
+		x1 = (int)floor(u1 + 0.5) - CellX0;
+		y0 = (int)floor(v0 - 0.5) - CellY0;
+		y1 = (int)floor(v1 + 0.5) - CellY0;
+		if (x0 < 0) x0 = 0;
+		if (y0 < 0) y0 = 0;
+		if (x1 >= CellW) x1 = CellW -1;
+		if (y1 >= CellH) y1 = CellH -1;
+		near = ItemNear(obj->bounds);
+		for (y = y0; y <= y1; y++) {
+			cp = &Cells[y*CellW + x0];
+			for (x = x0; x <= x1; x++, cp++) {
+				if (near < cp->near) {
+					cp->next = cp->near;
+					cp->near = near;
+					cp->obj = i;
+				} else if (near < cp->next)
+					cp->next = near;
+			}
+		}
+	}
+	ItemsValid = TRUE;
+}
+
+/*
+ * Find the closest intersection of the given eye ray, which passes
+ * through screen position (x, y), using the item buffer.  Return
+ * FALSE if the buffer cannot answer, in which case the ray must be
+ * traced.  Otherwise, hitlist and dist are set as by TraceRay().
+ */
+int
+ItemBufferTrace(x, y, ray, hitlist, dist)
+Float x, y;
+Ray *ray;
+HitList *hitlist;
+Float *dist;
+{
+	ItemCell *cp;
+	int i, cx, cy, last;
+
+	if (!ItemsValid)
+		return FALSE;
+	cx = (int)floor(x) - CellX0;
+	cy = (int)floor(y) - CellY0;
+	if (cx < 0 || cy < 0 || cx >= CellW || cy >= CellH)
+		return FALSE;
+	cp = &Cells[cy*CellW + cx];
+
+	last = -1;
+	for (i = 0; i < NAlways; i++) {
+		if (intersect(Items->objs[Always[i]], ray, hitlist,
+		    EPSILON, dist))
+			last = Always[i];
+	}
+	if (cp->obj >= 0 && cp->near < *dist &&
+	    intersect(Items->objs[cp->obj], ray, hitlist, EPSILON, dist))
+		last = cp->obj;
+
+	if (last < 0 ? cp->next < FAR_AWAY : *dist >= cp->next) {
+		/*
+		 * Something else may lie in front.
+		 */
+		Stats.ItemMisses++;
+		return FALSE;
+	}
+	Stats.ItemHits++;
+	if (last >= 0)
+		CullHitPath(Items, last, hitlist, *dist);
+	return TRUE;
+}
+
+/*
+ * Project the given bounding box onto the screen.  Return FALSE
+ * if it cannot be projected because part of it lies behind the eye.
+ */
+static int
+ItemProject(bounds, u0, u1, v0, v1)
+Float bounds[2][3], *u0, *u1, *v0, *v1;
+{
+	Vector d;
+	Float w, dn, sx, sy, u, v;
+	int i;
+
+	w = dotp(&Screen.firstray, &Camera.dir);
+	sx = dotp(&Screen.scrnx, &Screen.scrnx);
+	sy = dotp(&Screen.scrny, &Screen.scrny);
+	*u0 = *v0 = FAR_AWAY;
+	*u1 = *v1 = -FAR_AWAY;
+
+	for (i = 0; i < 8; i++) {
+		d.x = bounds[i & 1][X] - Camera.pos.x;
+		d.y = bounds[(i >> 1) & 1][Y] - Camera.pos.y;
+		d.z = bounds[(i >> 2) & 1][Z] - Camera.pos.z;
+		dn = dotp(&d, &Camera.dir);
+		if (dn < EPSILON)
+			return FALSE;
+		/*
+		 * Scale d so that it ends on the screen, then
+		 * find screen coordinates.
+		 */
+		VecScale(w / dn, d, &d);
+		VecSub(d, Screen.firstray, &d);
+		u = dotp(&d, &Screen.scrnx) / sx;
+		v = dotp(&d, &Screen.scrny) / sy;
+		if (u < *u0) *u0 = u;
+		if (u > *u1) *u1 = u;
+		if (v < *v0) *v0 = v;
+		if (v > *v1) *v1 = v;
+	}
+	return TRUE;
+}
+
+/*
+ * Distance from the eye to the closest point in the given box,
+ * less a little to allow for roundoff.
+ */
+static Float
+ItemNear(bounds)
+Float bounds[2][3];
+{
+	Vector d;
+
+	d.x = d.y = d.z = 0.;
+	if (Camera.pos.x < bounds[LOW][X])
+		d.x = bounds[LOW][X] - Camera.pos.x;
+	else if (Camera.pos.x > bounds[HIGH][X])
+		d.x = Camera.pos.x - bounds[HIGH][X];
+	if (Camera.pos.y < bounds[LOW][Y])
+		d.y = bounds[LOW][Y] - Camera.pos.y;
+	else if (Camera.pos.y > bounds[HIGH][Y])
+		d.y = Camera.pos.y - bounds[HIGH][Y];
+	if (Camera.pos.z < bounds[LOW][Z])
+		d.z = bounds[LOW][Z] - Camera.pos.z;
+	else if (Camera.pos.z > bounds[HIGH][Z])
+		d.z = Camera.pos.z - bounds[HIGH][Z];
+	return sqrt(dotp(&d, &d)) * (1. - EPSILON) - EPSILON;
+}
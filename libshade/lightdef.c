@@ -63,6 +63,8 @@ LightSetup()
 		shadowopts |= SHADOW_CACHE;
 	if (Options.shutterspeed > 0.)
 		shadowopts |= SHADOW_BLUR;
+	if (Options.shadowbatch)
+		shadowopts |= SHADOW_BATCH;
 	ShadowSetOptions(shadowopts);
 
 	/*
@@ -88,6 +90,37 @@ LightSetup()
 	}
 }
 
+/*
+ * Prepare to batch the shadow rays of each light source.  Must be
+ * called after WorldSetup().
+ */
+void
+LightBatchSetup()
+{
+	Light *ltmp;
+	extern Geom *World;
+
+	for (ltmp = Lights; ltmp; ltmp = ltmp->next) {
+		if (ltmp->shadow)
+			ShadowBatchSetup(ltmp->cache, World);
+	}
+}
+
+/*
+ * Begin a new batch of shadow rays for each light source.
+ */
+void
+LightBatchNext()
+{
+	Light *ltmp;
+	extern Geom *World;
+
+	for (ltmp = Lights; ltmp; ltmp = ltmp->next) {
+		if (ltmp->shadow)
+			ShadowBatchNext(ltmp->cache, World);
+	}
+}
+
 void
 AreaLightCreate(color, corner, u, usamp, v, vsamp, shadow)
 Color *color;
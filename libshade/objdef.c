@@ -27,6 +27,7 @@
  */
 
 #include "rayshade.h"
+#include "libobj/optimize.h"
 #include "options.h"
 #include "stats.h"
 
@@ -94,6 +95,9 @@ WorldSetup()
 		if (Defstack->next)
 			RLerror(RL_ABORT, "Geom def stack is screwey.\n");
 		World->prims = AggregateConvert(World, World->next);
+		if (Options.optimize)
+			GeomOptimize(World, Options.clipsize,
+				Options.verbose ? Stats.fstats : (FILE *)NULL);
 	}
 
 	GeomComputeBounds(World);
@@ -72,6 +72,13 @@ char **argv;
 				Options.alpha = !Options.alpha;
 				break;
 #endif
+			case 'B':
+				Options.bakedir = strsave(argv[1]);
+				argv++; argc--;
+				break;
+			case 'b':
+				Options.shadowbatch = !Options.shadowbatch;
+				break;
 			case 'C':
 				Options.cutoff.r = atof(argv[1]);
 				Options.cutoff.g = atof(argv[2]);
@@ -89,6 +96,10 @@ char **argv;
 				Options.maxdepth_set = TRUE;
 				argv++; argc--;
 				break;
+			case 'd':
+				Options.gbuffer = strsave(argv[1]);
+				argv++; argc--;
+				break;
 			case 'E':
 				Options.eyesep = atof(argv[1]);
 				Options.eyesep_set = TRUE;
@@ -116,17 +127,40 @@ char **argv;
 			case 'g':
 				Options.gaussian = !Options.gaussian;
 				break;
+			case 'H':
+				Options.batchshade = !Options.batchshade;
+				break;
 			case 'h':
 				usage();
 				exit(0);
 				break;
+			case 'i':
+				Options.itembuffer = !Options.itembuffer;
+				break;
+			case 'J':
+				Options.split = atoi(argv[1]);
+				argv++; argc--;
+				break;
 			case 'j':
 				Options.jitter = !Options.jitter;
 				Options.jitter_set = TRUE;
 				break;
+			case 'k':
+				Options.noisecompat = !Options.noisecompat;
+				break;
+			case 'L':
+				Options.raybudget = atoi(argv[1]);
+				if (Options.raybudget < 0)
+					Options.raybudget = 0;
+				argv++; argc--;
+				break;
 			case 'l':
 				Options.stereo = LEFT;
 				break;
+			case 'M':
+				Options.texmem = atof(argv[1]);
+				argv++; argc--;
+				break;
 #ifdef URT
 			case 'm':
 				Options.samplemap = !Options.samplemap;
@@ -167,6 +201,12 @@ char **argv;
 				Options.samples = 1;
 				Options.samples_set = TRUE;
 				break;
+			case 'Q':
+				Options.detail = atof(argv[1]);
+				if (Options.detail < 0.)
+					Options.detail = 0.;
+				argv++; argc--;
+				break;
 			case 'q':
 				Options.quiet = TRUE;
 				break;
@@ -198,6 +238,13 @@ char **argv;
 				argv += 3;
 				argc -= 3;
 				break;
+			case 't':
+				Options.tilecull = !Options.tilecull;
+				break;
+			case 'U':
+				Options.roulette = atof(argv[1]);
+				argv++; argc--;
+				break;
 			case 'u':
 				Options.cpp = !Options.cpp;
 				break;
@@ -234,6 +281,15 @@ char **argv;
 				Options.crop_set = TRUE;
 				argv += 4; argc -= 4;
 				break;
+			case 'Z':
+				Options.clipsize = atof(argv[1]);
+				if (Options.clipsize < 1.)
+					Options.clipsize = 0.;
+				argv++; argc--;
+				break;
+			case 'z':
+				Options.optimize = !Options.optimize;
+				break;
 			default:
 				RLerror(RL_PANIC,"Bad argument: %s\n",argv[0]);
 		}
@@ -268,6 +324,17 @@ RSOptionsList()
 	fprintf(Stats.fstats,"Maximum ray depth: %d.  Cutoff thresh: %g %g %g.\n",
 			Options.maxdepth,
 			Options.cutoff.r, Options.cutoff.g, Options.cutoff.b);
+	if (Options.roulette > 0.) {
+		fprintf(Stats.fstats,"Playing roulette below %g",
+			Options.roulette);
+		if (Options.split > 1)
+			fprintf(Stats.fstats,", splitting first bounce %d ways",
+				Options.split);
+		fprintf(Stats.fstats,".\n");
+	}
+	if (Options.raybudget)
+		fprintf(Stats.fstats,"At most %d rays spawned per eye ray.\n",
+			Options.raybudget);
 	if (Options.stereo == LEFT)
 		fprintf(Stats.fstats,"Rendering image for left eye.\n");
 	else if (Options.stereo == RIGHT)
@@ -280,6 +347,36 @@ RSOptionsList()
 	}
 	if (!Options.cache)
 		fprintf(Stats.fstats,"Shadow caching is disabled.\n");
+	if (Options.shadowbatch && !Options.no_shadows)
+		fprintf(Stats.fstats,"Shadow rays are traced in batches.\n");
+	if (Options.batchshade)
+		fprintf(Stats.fstats,"Shading eye-ray hits in batches.\n");
+	if (Options.itembuffer)
+		fprintf(Stats.fstats,"Using item buffer for eye rays.\n");
+	if (Options.tilecull)
+		fprintf(Stats.fstats,"Culling world to screen tiles.\n");
+	if (!Options.optimize)
+		fprintf(Stats.fstats,"Scene optimization is disabled.\n");
+	else if (Options.clipsize > 0.)
+		fprintf(Stats.fstats,"Clipping planes to %g times scene.\n",
+			Options.clipsize);
+	if (Options.bakedir)
+		fprintf(Stats.fstats,"Baking solid textures%s%s.\n",
+			strcmp(Options.bakedir, "-") ? " in " : "",
+			strcmp(Options.bakedir, "-") ? Options.bakedir : "");
+	if (Options.gbuffer)
+		fprintf(Stats.fstats,"Keeping first hits of eye rays in %s.\n",
+			Options.gbuffer);
+	if (Options.noisecompat)
+		fprintf(Stats.fstats,"Using the original noise tables.\n");
+	if (Options.texmem > 0.)
+		fprintf(Stats.fstats,
+			"Keeping at most %g Mbytes of images in memory.\n",
+			Options.texmem);
+	if (Options.detail > 0.)
+		fprintf(Stats.fstats,
+			"Coarsening detail to %g times ray footprints.\n",
+			Options.detail);
 	if (Options.totalframes != 1)
 		fprintf(Stats.fstats,"Rendering %d frames.\n",
 			Options.totalframes);
@@ -294,11 +391,14 @@ usage()
 #ifdef URT
 	fprintf(stderr,"\t-a \t\t(Toggle writing of alpha channel.)\n");
 #endif
+	fprintf(stderr,"\t-B dir\t\t(Bake solid textures, keeping bakes in dir.)\n");
+	fprintf(stderr,"\t-b \t\t(Toggle batching of shadow rays.)\n");
 	fprintf(stderr,"\t-C thresh\t(Set adaptive ray tree cutoff value.)\n");
 #ifdef URT
 	fprintf(stderr,"\t-c \t\t(Continue interrupted rendering.)\n");
 #endif
 	fprintf(stderr,"\t-D depth\t(Set maximum ray tree depth.)\n");
+	fprintf(stderr,"\t-d file\t\t(Keep first hits of eye rays in file.)\n");
 	fprintf(stderr,"\t-E eye_sep\t(Set eye separation in stereo pairs.)\n");
 #ifdef URT
 	fprintf(stderr,"\t-e \t\t(Write exponential RLE file.)\n");
@@ -307,9 +407,15 @@ usage()
 	fprintf(stderr,"\t-f \t\t(Flip all triangle normals.)\n");
 	fprintf(stderr,"\t-G gamma\t(Use given gamma correction exponent.)\n");
 	fprintf(stderr,"\t-g \t\t(Use Gaussian pixel filter.)\n");
+	fprintf(stderr,"\t-H \t\t(Toggle batched shading of eye-ray hits.)\n");
 	fprintf(stderr,"\t-h \t\t(Print this message.)\n");
+	fprintf(stderr,"\t-i \t\t(Toggle use of item buffer for eye rays.)\n");
+	fprintf(stderr,"\t-J split\t(Split first bounce when playing roulette.)\n");
 	fprintf(stderr,"\t-j \t\t(Toggle jittered sampling.)\n");
+	fprintf(stderr,"\t-k \t\t(Toggle use of the original noise tables.)\n");
+	fprintf(stderr,"\t-L rays\t\t(Limit rays spawned per eye ray.)\n");
 	fprintf(stderr,"\t-l \t\t(Render image for left eye view.)\n");
+	fprintf(stderr,"\t-M megabytes\t(Limit memory used by image textures.)\n");
 #ifdef URT
 	fprintf(stderr,"\t-m \t\t(Output sample map in alpha channel.)\n");
 #endif
@@ -319,14 +425,19 @@ usage()
 	fprintf(stderr,"\t-o \t\t(Toggle opacity effect on shadowing.)\n");
 	fprintf(stderr,"\t-P cpp-args\t(Options to pass to C pre-processor.\n");
 	fprintf(stderr,"\t-p \t\t(Preview-quality rendering.)\n");
+	fprintf(stderr,"\t-Q detail\t(Coarsen detail finer than ray footprints.)\n");
 	fprintf(stderr,"\t-q \t\t(Run quietly.)\n");
 	fprintf(stderr,"\t-R xres yres\t(Render at given resolution.)\n");
 	fprintf(stderr,"\t-r \t\t(Render image for right eye view.)\n");
 	fprintf(stderr,"\t-S samples\t(Max density of samples^2 samples.)\n");
 	fprintf(stderr,"\t-s \t\t(Don't cache shadowing information.)\n");
 	fprintf(stderr,"\t-T r g b\t(Set contrast threshold (0. - 1.).)\n");
+	fprintf(stderr,"\t-t \t\t(Toggle culling of world to screen tiles.)\n");
+	fprintf(stderr,"\t-U thresh\t(Play Russian roulette below thresh.)\n");
 	fprintf(stderr,"\t-V filename \t(Write verbose output to filename.)\n");
 	fprintf(stderr,"\t-v \t\t(Verbose output.)\n");
 	fprintf(stderr,"\t-W x x y y \t(Render subwindow.)\n");
 	fprintf(stderr,"\t-X l r b t \t(Crop window.)\n");
+	fprintf(stderr,"\t-Z size\t\t(Clip planes to size times the scene.)\n");
+	fprintf(stderr,"\t-z \t\t(Toggle scene optimization.)\n");
 }
@@ -48,10 +48,18 @@ typedef struct RSOptions {
 		no_shadows,		/* Trace shadow rays? */
 		shadowtransp,		/* ... through transparent objects? */
 		cache,			/* Cache shadowing info? */
+		shadowbatch,		/* Batch coherent shadow rays? */
+		batchshade,		/* Shade eye-ray hits in batches? */
+		itembuffer,		/* Find first hits via item buffer? */
+		tilecull,		/* Cull world to each screen tile? */
+		optimize,		/* Optimize the scene graph? */
+		noisecompat,		/* Use the original noise tables? */
 		appending,		/* Append to image file? */
 		resolution_set,		/* resolution set on command line */
 		contrast_set,		/* contrast overridden ... */
 		samples_set,		/* samples overridden ... */
+		raybudget,		/* Max. rays spawned per eye ray */
+		split,			/* # of rays to split 1st bounce into */
 		cutoff_set,		/* cutoff ... */
 		maxdepth_set,		/* adaptive depth ... */
 		window_set,		/* subwindow ... */
@@ -79,13 +87,19 @@ typedef struct RSOptions {
 		shutterspeed,		/* time shutter is open */
 		framestart,		/* start time of the current frame */
 		framelength,		/* length of the current frame */
-		filterwidth;		/* Pixel filter width. */
+		filterwidth,		/* Pixel filter width. */
+		clipsize,		/* Size of clipped planes, or 0 */
+		roulette,		/* Russian roulette threshold, or 0 */
+		texmem,			/* Megabytes of images, or 0 */
+		detail;			/* Footprint scale for LOD, or 0 */
 	Color	contrast,		/* Max. allowable contrast */
 		cutoff,			/* Ray tree depth control */
 		ambient;		/* Ambient light multiplier */
 	char	*progname,		/* argv[0] */
 		*statsname,		/* Name of stats file. */
 		*imgname,		/* Name of output image file */
+		*bakedir,		/* Where to keep texture bakes */
+		*gbuffer,		/* File of eye rays' first hits */
 		*inputname,		/* Name of input file, NULL == stdin */
 		*cppargs;		/* arguments to pass to cpp */
 	int	window[2][2];		/* Subwindow corners */
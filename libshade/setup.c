@@ -97,6 +97,7 @@ RSSetup()
 		Options.ambient.b = 1.0;
 	Options.cutoff.r = UNSET;
 	Options.cache = TRUE;
+	Options.optimize = TRUE;
 	Options.shadowtransp = TRUE;
 	Options.crop[LOW][X] = Options.crop[LOW][Y] = 0.;
 	Options.crop[HIGH][X] = Options.crop[HIGH][Y] = 1.;
@@ -142,7 +143,8 @@ void
 RSCleanup()
 {
 	extern Light *Lights;
-	extern void OpenStatsFile();
+	extern void OpenStatsFile(), NoiseSetCompat(), BakeSetup(),
+		TextSetDetail(), HfSetDetail();
 	extern FILE *yyin;
 
 	yyin = (FILE *)NULL;	/* mark that we're done reading input */
@@ -187,7 +189,30 @@ RSCleanup()
 
 	if (Options.maxdepth < 0)
 		Options.maxdepth = 0;
+	if (Options.split < 1)
+		Options.split = 1;
 
+	/*
+	 * The eye rays recorded in a G-buffer must all leave the eye
+	 * itself, and the world must stand still.
+	 */
+	if (Options.gbuffer &&
+	    (Camera.aperture > 0. || Options.shutterspeed > 0.)) {
+		RLerror(RL_WARN,
+		  "G-buffer not used with depth of field or motion blur.\n");
+		Options.gbuffer = (char *)NULL;
+	}
+	if (Options.gbuffer && Options.batchshade) {
+		RLerror(RL_WARN,
+		  "Hits are not shaded in batches with a G-buffer.\n");
+		Options.batchshade = FALSE;
+	}
+
+	NoiseSetCompat(Options.noisecompat);
+	Screen.pixel = 2.*tan(deg2rad(0.5*Camera.hfov)) / Screen.xres;
+	TextSetDetail(Options.detail);
+	HfSetDetail(Options.detail);
+	BakeSetup(Options.bakedir);
 
 	LightSetup();
 }
@@ -196,6 +221,9 @@ void
 RSStartFrame(frame)
 int frame;
 {
+	extern void ItemBufferSetup(), TileSetup(), GBufferSetup();
+	extern void LightBatchSetup();
+
 	/*
 	 * Set the frame start time
 	 */
@@ -215,6 +243,17 @@ int frame;
 	 * Initialize world
 	 */
 	WorldSetup();
+	/*
+	 * Rasterize it and prepare to cull it to screen tiles,
+	 * if so desired.
+	 */
+	ItemBufferSetup();
+	TileSetup();
+	LightBatchSetup();
+	/*
+	 * Read the first hits of the eye rays, if they are known.
+	 */
+	GBufferSetup();
 }
 
 /*
@@ -225,6 +264,8 @@ RSInitialize(argc, argv)
 int argc;
 char **argv;
 {
+	extern void ImageCacheSetup();
+
 	/*
  	 * Initialize variables, etc.
 	 */
@@ -233,6 +274,11 @@ char **argv;
 	 * Parse options from command line.
 	 */
 	RSOptionsSet(argc, argv);
+	/*
+	 * Images are read along with the input file, so must be told
+	 * beforehand how much memory they may use.
+	 */
+	ImageCacheSetup(Options.texmem);
 	/*
 	 * Process input file.
 	 */
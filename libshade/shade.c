@@ -32,12 +32,30 @@
 #include "libsurf/atmosphere.h"
 #include "options.h"
 #include "stats.h"
+#include "gbuffer.h"
 
 Medium	TopMedium;
 Atmosphere *AtmosEffects;
 
-static void shade(), LightRay(), Lighting(), ReflectRay();
-static int TransmitRay();
+/*
+ * The terms of the shading function for one light source at a hit.
+ */
+typedef struct {
+	Float	costheta,	/* -light . normal */
+		cosalpha,	/* light . reflected ray */
+		coef,		/* specular exponent */
+		scale;		/* factor applied to the resulting color */
+	Color	light,		/* color of light reaching the hit */
+		*diff,		/* diffuse color */
+		*spec;		/* specular color */
+} LightTerm;
+
+static void shade(), LightRay(), Lighting(), ReflectRay(), SpawnRays();
+static void TransmitRay();
+static int TransmitDir(), LightTerms();
+static Float SpawnWeight();
+
+static long RaysLeft;		/* rays the current eye ray may spawn */
 
 /*
  * Calculate color of ray.
@@ -52,9 +70,12 @@ Color	*back,			/* "Background" color */
 	*contrib;		/* Contribution of this ray to final color */
 {
 	Vector norm, gnorm, pos; /* surface normal, point of intersection */
-	Surface surf, *stmp;	/* surface properties */
+	Surface *surf, scratch;	/* surface properties, textured copy */
 	int enter, smooth;	/* entering ?, gnorm != snorm ?*/
 
+	if (ray->depth == 0)
+		RaysLeft = Options.raybudget;
+
 	if (hitlist->nodes == 0) {
 		/*
 		 * No valid intersection.  Set distance for atmospheric
@@ -70,41 +91,79 @@ Color	*back,			/* "Background" color */
 	/*
 	 * Compute normal, surface properties, etc.
 	 */
-	stmp = GetShadingSurf(hitlist);
-	surf = *stmp;
+	surf = GetShadingSurf(hitlist);
 	enter = ComputeSurfProps(hitlist, ray, &pos, &norm, &gnorm, &surf,
-			&smooth);
+			&scratch, &smooth);
 	Stats.HitRays++;
 
 	/*
 	 * Calculate ray color.
 	 */
-	shade(&pos, ray, &norm, &gnorm, smooth, enter, &surf, back, color,
-			contrib);
+	shade(&pos, ray, RayFootprint(ray, dist), &norm, &gnorm, smooth,
+			enter, surf, back, color, contrib);
 	if (!ray->media && AtmosEffects)
 		Atmospherics(AtmosEffects, ray, dist, &pos, color);
 }
 
+/*
+ * Calculate color of an eye ray whose first hit has been found in, or
+ * just recorded in, the G-buffer.  'surf' is NULL if it hit nothing.
+ */
+void
+ShadeFirstHit(ray, hit, surf, back, color)
+Ray *ray;			/* Eye ray. */
+GHit *hit;			/* Its first hit. */
+Surface *surf;			/* Surface hit, texture-modified. */
+Color	*back,			/* "Background" color */
+	*color;			/* Color to assign ray. */
+{
+	Vector pos, norm, gnorm;
+	Color fullintens;
+
+	RaysLeft = Options.raybudget;
+
+	if (surf == (Surface *)NULL) {
+		*color = *back;
+		VecAddScaled(ray->pos, FAR_AWAY, ray->dir, &pos);
+		if (!ray->media && AtmosEffects)
+			Atmospherics(AtmosEffects, ray, FAR_AWAY, &pos, color);
+		return;
+	}
+	Stats.HitRays++;
+
+	pos = hit->pos;
+	norm.x = hit->norm[0];
+	norm.y = hit->norm[1];
+	norm.z = hit->norm[2];
+	gnorm.x = hit->gnorm[0];
+	gnorm.y = hit->gnorm[1];
+	gnorm.z = hit->gnorm[2];
+	fullintens.r = fullintens.g = fullintens.b = 1.;
+	shade(&pos, ray, RayFootprint(ray, hit->dist), &norm, &gnorm,
+			(int)hit->smooth, (int)hit->enter, surf, back, color,
+			&fullintens);
+	if (!ray->media && AtmosEffects)
+		Atmospherics(AtmosEffects, ray, hit->dist, &pos, color);
+}
+
 /*
  * Perform lighting calculations based on surface normal & other properties,
  * incident ray direction and position, and light source properties.
  * Spawn any necessary reflected and transmitted rays.
  */
 static void
-shade(pos, ray, nrm, gnrm, smooth, enter, surf, back, color, contrib)
+shade(pos, ray, foot, nrm, gnrm, smooth, enter, surf, back, color, contrib)
 Vector *pos, *nrm, *gnrm;	/* hit pos, shade normal, geo normal */
 int smooth;			/* true if shading norm and geo norm differ */
 int enter;			/* TRUE if entering surface */
 Ray *ray;			/* indicent ray */
+Float foot;			/* its footprint at the hit */
 Surface *surf;			/* properties of hit surface */
 Color *back, *color;		/* background color, computed color */
 Color *contrib;			/* contribution to final pixel value */
 {
 	Float	k;		/* -ray . normal */
-	Color	newcontrib;
 	Vector	refl;		/* reflected direction */
-	Color	reflectivity,	/* effective surface reflectivity */
-		intens;		/* reflected/transmitted intensity */
 	Light *lp;		/* current light source */
 	extern Light *Lights;	/* list of defined sources */
 
@@ -124,13 +183,45 @@ Color *contrib;			/* contribution to final pixel value */
 	 */
 	for (lp = Lights; lp; lp = lp->next)
 		LightRay(lp, pos, nrm, gnrm, smooth, &refl, surf,
-				ray->depth, ray->sample, ray->time, color);
+				ray->depth, ray->sample, ray->time, foot, color);
+
+	SpawnRays(ray, foot, pos, nrm, k, &refl, surf, enter, back, contrib,
+			color);
+}
+
+/*
+ * Spawn the reflected and transmitted rays called for at a hit,
+ * adding their colors to 'color'.
+ */
+static void
+SpawnRays(ray, foot, pos, nrm, k, refl, surf, enter, back, contrib, color)
+Ray *ray;			/* incident ray */
+Float foot;			/* its footprint at the hit */
+Vector *pos, *nrm, *refl;	/* hit pos, shade normal, reflected dir */
+Float k;			/* -ray . normal */
+Surface *surf;			/* properties of hit surface */
+int enter;			/* TRUE if entering surface */
+Color *back, *contrib, *color;
+{
+	Float	weight;		/* weight given to a spawned ray */
+	int	split, i;	/* # of rays to spawn in each direction */
+	Vector	tdir;		/* transmitted direction */
+	Color	newcontrib, wcontrib;
+	Color	reflectivity,	/* effective surface reflectivity */
+		intens,		/* reflected/transmitted intensity */
+		wintens;	/* ... weighted */
 
 	if (ray->depth >= Options.maxdepth)
 		/*
 		 * Don't spawn any transmitted/reflected rays.
 		 */
 		return;
+	/*
+	 * When playing roulette, the first bounce may be split into
+	 * several rays, each of which plays on its own.
+	 */
+	split = (ray->depth == 0 && Options.roulette > 0.) ? Options.split : 1;
+
 	/*
 	 * Specular transmission (refraction).
 	 */
@@ -139,45 +230,136 @@ Color *contrib;			/* contribution to final pixel value */
 	if (surf->transp > EPSILON) {
 		ColorScale(surf->transp, surf->body, &intens);
 		ColorMultiply(intens, *contrib, &newcontrib);
-		if (newcontrib.r > Options.cutoff.r ||
-		    newcontrib.g > Options.cutoff.g ||
-		    newcontrib.b > Options.cutoff.b)
+		if (TransmitDir(ray, nrm, k, surf->index, enter, &tdir)) {
 			/*
-			 * Transmit ray.  If TIR occurs, add transmitted
-			 * component to reflected component.  Kinda strange, but...
+			 * If TIR occurs, add transmitted component to
+			 * reflected component.  Kinda strange, but...
+			 * This is decided by the geometry alone, before
+			 * any roulette is played, so that the component
+			 * is added once and costs no ray.
 			 */
-			if (TransmitRay(ray, pos, nrm, k, surf->index,
-			    surf->statten, enter, back, &newcontrib, &intens, color))
+			if (Options.roulette > 0. ||
+			    newcontrib.r > Options.cutoff.r ||
+			    newcontrib.g > Options.cutoff.g ||
+			    newcontrib.b > Options.cutoff.b)
 				ColorAdd(reflectivity, intens, &reflectivity);
+		} else {
+			for (i = 0; i < split; i++) {
+				weight = SpawnWeight(&newcontrib, split);
+				if (weight == 0.)
+					continue;
+				ColorScale(weight, newcontrib, &wcontrib);
+				ColorScale(weight, intens, &wintens);
+				TransmitRay(ray, foot, pos, &tdir, surf->index,
+					surf->statten, enter, back, &wcontrib,
+					&wintens, color);
+			}
+		}
 	}
 
 	if (reflectivity.r > EPSILON ||
 	    reflectivity.g > EPSILON ||
 	    reflectivity.b > EPSILON) {
 		ColorMultiply(reflectivity, *contrib, &newcontrib);
-		if (newcontrib.r > Options.cutoff.r ||
-		    newcontrib.g > Options.cutoff.g ||
-		    newcontrib.b > Options.cutoff.b)
-			ReflectRay(ray, pos, &refl, back, &reflectivity,
-				&newcontrib, color);
+		for (i = 0; i < split; i++) {
+			weight = SpawnWeight(&newcontrib, split);
+			if (weight == 0.)
+				continue;
+			ColorScale(weight, newcontrib, &wcontrib);
+			ColorScale(weight, reflectivity, &wintens);
+			ReflectRay(ray, foot, pos, refl, back, &wintens,
+				&wcontrib, color);
+		}
 	}
 }
 
+/*
+ * Decide whether to spawn one of 'split' rays whose contribution to
+ * the final color is, together, 'contrib'.  Returns the weight to give
+ * the color of the ray, or 0 if it is not to be spawned.
+ *
+ * Ordinarily, a ray is spawned if its contribution exceeds the cutoff.
+ * When playing Russian roulette, a ray whose contribution is less than
+ * Options.roulette is instead spawned with probability in proportion
+ * to its contribution, and its color weighted by the inverse of that
+ * probability, so that the expected color of the ray tree is unchanged.
+ * Either way, no more rays are spawned once the eye ray's budget, if
+ * any, is spent.
+ */
+static Float
+SpawnWeight(contrib, split)
+Color *contrib;
+int split;
+{
+	Float c, p;
+
+	if (Options.raybudget && RaysLeft <= 0) {
+		Stats.OverBudget++;
+		return 0.;
+	}
+	if (Options.roulette > 0.) {
+		c = max(contrib->r, max(contrib->g, contrib->b)) / split;
+		if (c < Options.roulette) {
+			p = c / Options.roulette;
+			if (nrand() >= p) {
+				Stats.RouletteKills++;
+				return 0.;
+			}
+			c = 1. / (p * split);
+		} else
+			c = 1. / split;
+	} else if (contrib->r > Options.cutoff.r ||
+		   contrib->g > Options.cutoff.g ||
+		   contrib->b > Options.cutoff.b)
+		c = 1.;
+	else
+		return 0.;
+	RaysLeft--;
+	return c;
+}
+
 /*
  * Lighting calculations
  */
 static void
-LightRay(lp, pos, norm, gnorm, smooth, reflect, surf, depth, samp, time, color)
+LightRay(lp, pos, norm, gnorm, smooth, reflect, surf, depth, samp, time, foot,
+	color)
 Light *lp;			/* Light source */
 Vector *pos, *norm, *gnorm;	/* hit pos, shade norm, geo norm */
 int smooth;			/* true if shade and geo norm differ */
 Vector *reflect;		/* reflection direction */
 Surface *surf;			/* surface characteristics */
 int depth, samp;		/* ray depth, sample # */
-Float time;
+Float time, foot;		/* ray time, footprint at hit */
 Color *color;			/* resulting color */
 {
-	Color lcolor;
+	LightTerm t;
+
+	if (!LightTerms(lp, pos, norm, gnorm, smooth, reflect, surf, depth,
+			samp, time, foot, &t))
+		return;
+	Lighting(t.costheta, t.cosalpha, &t.light, t.diff, t.spec, t.coef,
+			color);
+	if (t.scale != 1.)
+		ColorScale(t.scale, *color, color);
+}
+
+/*
+ * Find the terms of the shading function for the given light source.
+ * Returns FALSE if no light reaches the hit.
+ */
+static int
+LightTerms(lp, pos, norm, gnorm, smooth, reflect, surf, depth, samp, time,
+	foot, t)
+Light *lp;			/* Light source */
+Vector *pos, *norm, *gnorm;	/* hit pos, shade norm, geo norm */
+int smooth;			/* true if shade and geo norm differ */
+Vector *reflect;		/* reflection direction */
+Surface *surf;			/* surface characteristics */
+int depth, samp;		/* ray depth, sample # */
+Float time, foot;		/* ray time, footprint at hit */
+LightTerm *t;			/* resulting terms */
+{
 	Ray newray;
 	Float costheta, cosalpha, dist;
 
@@ -186,6 +368,12 @@ Color *color;			/* resulting color */
 	newray.sample = samp;
 	newray.time = time; 
 	newray.media = (Medium *)NULL;	
+	/*
+	 * A shadow ray keeps the footprint of the hit it is cast from,
+	 * so that it sees the scene in no finer detail than that ray did.
+	 */
+	newray.width = foot;
+	newray.spread = 0.;
 
 	LightDirection(lp, pos, &newray.dir, &dist);
 
@@ -213,23 +401,29 @@ Color *color;			/* resulting color */
 		 * hence light must be transmitted through...
 		 */
 		if (surf->translucency < EPSILON)
-			return;
+			return FALSE;
 		if (!LightIntens(lp, &newray, dist,
-			(int)surf->noshadow, &lcolor))
-			return;
-		cosalpha = -dotp(reflect, &newray.dir);
-		Lighting(-costheta, cosalpha, &lcolor, &surf->translu,
-				&surf->body, surf->stexp, color);
-		ColorScale(surf->translucency, *color, color);
+			(int)surf->noshadow, &t->light))
+			return FALSE;
+		t->costheta = -costheta;
+		t->cosalpha = -dotp(reflect, &newray.dir);
+		t->diff = &surf->translu;
+		t->spec = &surf->body;
+		t->coef = surf->stexp;
+		t->scale = surf->translucency;
 	} else {
 		if (!LightIntens(lp, &newray, dist,
-			(int)surf->noshadow, &lcolor))
-			return;  /* prim is in shadow w.r.t light source */
+			(int)surf->noshadow, &t->light))
+			return FALSE;  /* prim is in shadow w.r.t light source */
 
-		cosalpha = dotp(reflect, &newray.dir);
-		Lighting(costheta, cosalpha, &lcolor, &surf->diff,
-				&surf->spec, surf->srexp, color);
+		t->costheta = costheta;
+		t->cosalpha = dotp(reflect, &newray.dir);
+		t->diff = &surf->diff;
+		t->spec = &surf->spec;
+		t->coef = surf->srexp;
+		t->scale = 1.;
 	}
+	return TRUE;
 }
 
 /*
@@ -270,43 +464,69 @@ Color *diff, *spec, *color, *lcolor;
 }
 
 /*
- * Spawn a transmitted ray.  Returns TRUE if total internal reflection
- * occurs, FALSE otherwise.
+ * Find the direction of the ray transmitted at a hit.  Returns TRUE if
+ * total internal reflection occurs instead, FALSE otherwise.
  */
 static int
-TransmitRay(ray, pos, norm, k, index, statten, enter, back, contrib, intens, color)
+TransmitDir(ray, norm, k, index, enter, dir)
+Ray *ray;
+Vector *norm, *dir;
+Float k, index;
+int enter;
+{
+	Medium *media;
+
+	media = ray->media;
+	if (enter)
+		/*
+		 * Entering surface.
+		 */
+		return Refract(dir, media ? media->index : TopMedium.index,
+				index, &ray->dir, norm, k);
+	/*
+	 * Exiting surface; the ray passes into the enclosing medium.
+	 */
+	if (media != (Medium *)0)
+		media = media->next;
+	return Refract(dir, index, media ? media->index : TopMedium.index,
+			&ray->dir, norm, k);
+}
+
+/*
+ * Spawn a transmitted ray in direction 'dir', as found by TransmitDir().
+ */
+static void
+TransmitRay(ray, foot, pos, dir, index, statten, enter, back, contrib,
+	intens, color)
 Ray *ray;
-Vector *pos, *norm;
-Float k, index, statten;
+Float foot;
+Vector *pos, *dir;
+Float index, statten;
 int enter;
 Color *back, *contrib, *intens, *color;
 {
-	int total_int_refl = FALSE;
 	Ray NewRay;
+	Medium medium;		/* Medium entered, if any */
 	Float dist;
 	Color newcol;
 	HitList hittmp;		/* Geom intersection record */
 
 	NewRay.pos = *pos;		/* Origin == hit point */
+	NewRay.dir = *dir;
 	NewRay.media = ray->media;	/* Media == old media */
 	NewRay.sample = ray->sample;
 	NewRay.time = ray->time;
 	NewRay.depth = ray->depth + 1;
+	NewRay.width = foot;		/* Footprint == that at hit */
+	NewRay.spread = ray->spread;	/* ... growing as before */
 
 	if (enter) {
 		/*
 		 * Entering surface.
+		 * Push information for new medium.
 		 */
-		if (Refract(&NewRay.dir,
-		    NewRay.media ? NewRay.media->index :
-		    TopMedium.index, index, &ray->dir, norm, k)) {
-			total_int_refl = TRUE;
-		} else {
-			/*
-			 * Push information for new medium.
-			 */
-			NewRay.media = MediumPush(index, statten, NewRay.media);
-		}
+		NewRay.media = MediumPush(index, statten,
+					NewRay.media, &medium);
 	} else {
 		/*
 		 * Exiting surface
@@ -314,49 +534,37 @@ Color *back, *contrib, *intens, *color;
 		 */
 		if (NewRay.media != (Medium *)0)
 			NewRay.media = NewRay.media->next;
-		if (Refract(&NewRay.dir, index,
-		    NewRay.media ? NewRay.media->index :
-		    TopMedium.index, &ray->dir, norm, k)) {
-			total_int_refl = TRUE;
-		}
 	}
 
 	/*
 	 * At this point, NewRay.media is the medium into which
 	 * the new ray is entering.
 	 */
-
-	if (!total_int_refl) {
-		Stats.RefractRays++;
-		hittmp.nodes = 0;
-		dist = FAR_AWAY;
-		TraceRay(&NewRay, &hittmp, EPSILON, &dist);
-		ShadeRay(&hittmp, &NewRay, dist, back, &newcol, contrib);
-		ColorMultiply(newcol, *intens, &newcol);
-		/*
-		 * Attenuate transmitted color.  Note that
-		 * if the transmitted ray hit nothing, we still
-		 * perform this computation, as it's possible
-		 * that 'air' has a non-unit statten.
-		 */
-		statten = NewRay.media ? NewRay.media->statten :
-			TopMedium.statten;
-		if (statten != 1.0) {
-			statten = pow(statten, dist);
-			ColorScale(statten, newcol, &newcol);
-		}
-		ColorAdd(*color, newcol, color);
-		/* Free pushed medium */
-		if (enter)
-			free((voidstar)NewRay.media);
+	Stats.RefractRays++;
+	hittmp.nodes = 0;
+	dist = FAR_AWAY;
+	TraceRay(&NewRay, &hittmp, EPSILON, &dist);
+	ShadeRay(&hittmp, &NewRay, dist, back, &newcol, contrib);
+	ColorMultiply(newcol, *intens, &newcol);
+	/*
+	 * Attenuate transmitted color.  Note that
+	 * if the transmitted ray hit nothing, we still
+	 * perform this computation, as it's possible
+	 * that 'air' has a non-unit statten.
+	 */
+	statten = NewRay.media ? NewRay.media->statten :
+		TopMedium.statten;
+	if (statten != 1.0) {
+		statten = pow(statten, dist);
+		ColorScale(statten, newcol, &newcol);
 	}
-
-	return total_int_refl;
+	ColorAdd(*color, newcol, color);
 }
 
 static void
-ReflectRay(ray, pos, dir, back, intens, contrib, color)
+ReflectRay(ray, foot, pos, dir, back, intens, contrib, color)
 Ray *ray;
+Float foot;
 Vector *pos, *dir;
 Color *back, *intens, *contrib, *color;
 {
@@ -371,6 +579,8 @@ Color *back, *intens, *contrib, *color;
 	NewRay.sample = ray->sample;
 	NewRay.time = ray->time;
 	NewRay.depth = ray->depth + 1;
+	NewRay.width = foot;		/* Footprint == that at hit */
+	NewRay.spread = ray->spread;	/* ... growing as before */
 	Stats.ReflectRays++;
 	hittmp.nodes = 0;
 	dist = FAR_AWAY;
@@ -379,3 +589,214 @@ Color *back, *intens, *contrib, *color;
 	ColorMultiply(newcol, *intens, &newcol);
 	ColorAdd(*color, newcol, color);
 }
+
+/*
+ * Batched shading of eye-ray hits.
+ *
+ * ShadeBatchAdd() takes the place of ShadeRay() for eye rays.  Hits on
+ * untextured surfaces are put aside until ShadeBatchFlush(), which
+ * visits each light source once for the whole batch, casting its
+ * shadow rays one after another, and then sums the diffuse and
+ * specular terms in loops over arrays that the compiler may vectorize.
+ * Specular exponents that are whole numbers are raised by repeated
+ * squaring, in step for the whole batch, rather than by pow().  Each
+ * multiplication rounds, so a highlight may differ from that found by
+ * pow() in its last few bits, and now and then a pixel by one level.
+ * Misses, hits on textured surfaces, and all hits when there are
+ * atmospheric effects are shaded at once, just as by ShadeRay().
+ */
+#define BATCH_MAXEXP	4096	/* largest exponent raised by squaring */
+
+typedef struct {
+	Ray	ray;			/* eye ray */
+	Vector	pos, norm, gnorm,	/* hit pos, shade normal, geo normal */
+		refl;			/* reflected direction */
+	Float	k,			/* -ray . normal */
+		foot;			/* footprint of ray at hit */
+	int	enter, smooth;		/* entering?, gnorm != snorm? */
+	Surface	*surf;			/* properties of hit surface */
+	Color	*back, *color;		/* background color, computed color */
+} ShadeHit;
+
+static ShadeHit	*Batch;			/* hits put aside */
+static int	BatchSize, BatchLen;	/* room for, # of hits put aside */
+static Float	*BatchCos,		/* diffuse cosine of each hit */
+		*BatchHigh,		/* specular cosine, squared in turn */
+		*BatchPow,		/* specular highlight */
+		*BatchScale;		/* factor applied to color */
+static int	*BatchExp;		/* whole specular exponent, or 0 */
+static Color	*BatchColor, *BatchLight, *BatchDiff, *BatchSpec;
+static Color	FullContrib = {1., 1., 1.};
+static Color	NoColor = {0., 0., 0.};
+
+/*
+ * Make room for batches of up to n hits.
+ */
+void
+ShadeBatchInit(n)
+int n;
+{
+	if (n <= BatchSize)
+		return;
+	Batch = (ShadeHit *)Malloc(n * sizeof(ShadeHit));
+	BatchCos = (Float *)Malloc(n * sizeof(Float));
+	BatchHigh = (Float *)Malloc(n * sizeof(Float));
+	BatchPow = (Float *)Malloc(n * sizeof(Float));
+	BatchScale = (Float *)Malloc(n * sizeof(Float));
+	BatchExp = (int *)Malloc(n * sizeof(int));
+	BatchColor = (Color *)Malloc(n * sizeof(Color));
+	BatchLight = (Color *)Malloc(n * sizeof(Color));
+	BatchDiff = (Color *)Malloc(n * sizeof(Color));
+	BatchSpec = (Color *)Malloc(n * sizeof(Color));
+	BatchSize = n;
+}
+
+/*
+ * Shade the eye ray 'ray', now or when the batch is flushed.
+ * In the latter case, 'color' must stay put until then.
+ */
+void
+ShadeBatchAdd(hitlist, ray, dist, back, color)
+HitList *hitlist;
+Ray *ray;
+Float dist;
+Color *back, *color;
+{
+	ShadeHit *h;
+	Surface *surf, scratch;
+
+	if (hitlist->nodes == 0 || AtmosEffects || BatchLen == BatchSize) {
+		ShadeRay(hitlist, ray, dist, back, color, &FullContrib);
+		return;
+	}
+
+	h = &Batch[BatchLen];
+	surf = GetShadingSurf(hitlist);
+	h->enter = ComputeSurfProps(hitlist, ray, &h->pos, &h->norm,
+			&h->gnorm, &surf, &scratch, &h->smooth);
+	Stats.HitRays++;
+	if (surf == &scratch) {
+		/*
+		 * Textured surfaces vary from hit to hit.
+		 */
+		RaysLeft = Options.raybudget;
+		shade(&h->pos, ray, RayFootprint(ray, dist), &h->norm,
+			&h->gnorm, h->smooth, h->enter, surf, back, color,
+			&FullContrib);
+		return;
+	}
+	h->ray = *ray;
+	h->foot = RayFootprint(ray, dist);
+	h->surf = surf;
+	h->back = back;
+	h->color = color;
+	h->k = -dotp(&ray->dir, &h->norm);
+	VecAddScaled(ray->dir, 2.*h->k, h->norm, &h->refl);
+	ColorMultiply(surf->amb, Options.ambient, &BatchColor[BatchLen]);
+	BatchLen++;
+	Stats.BatchShaded++;
+}
+
+/*
+ * Shade the hits put aside by ShadeBatchAdd().
+ */
+void
+ShadeBatchFlush()
+{
+	ShadeHit *h;
+	LightTerm t;
+	Light *lp;
+	int i, n, bit, maxexp, moving;
+	extern Light *Lights;
+	extern void TimeSet();
+
+	n = BatchLen;
+	/*
+	 * Under motion blur, the scene must be put back to the time
+	 * of each hit's eye ray before it is traced against again.
+	 */
+	moving = Options.shutterspeed > 0.;
+	for (lp = Lights; lp; lp = lp->next) {
+		/*
+		 * Cast the light's shadow rays for the whole batch,
+		 * gathering the terms of the shading function.
+		 */
+		maxexp = 0;
+		for (i = 0, h = Batch; i < n; i++, h++) {
+			if (moving)
+				TimeSet(h->ray.time);
+			if (!LightTerms(lp, &h->pos, &h->norm, &h->gnorm,
+			    h->smooth, &h->refl, h->surf, h->ray.depth,
+			    h->ray.sample, h->ray.time, h->foot, &t)) {
+				BatchCos[i] = BatchHigh[i] = 0.;
+				BatchScale[i] = 1.;
+				BatchExp[i] = 0;
+				BatchLight[i] = BatchDiff[i] =
+					BatchSpec[i] = NoColor;
+				continue;
+			}
+			BatchCos[i] = t.costheta;
+			BatchScale[i] = t.scale;
+			BatchLight[i] = t.light;
+			BatchDiff[i] = *t.diff;
+			BatchSpec[i] = *t.spec;
+			BatchExp[i] = 0;
+			if (t.coef < EPSILON || t.cosalpha <= 0.)
+				BatchHigh[i] = 0.;
+			else if (t.coef <= BATCH_MAXEXP &&
+				 t.coef == (Float)(int)t.coef) {
+				BatchHigh[i] = t.cosalpha;
+				BatchExp[i] = (int)t.coef;
+				if (BatchExp[i] > maxexp)
+					maxexp = BatchExp[i];
+			} else
+				BatchHigh[i] = pow(t.cosalpha, t.coef);
+		}
+		/*
+		 * Raise the highlights to their exponents.
+		 */
+		for (i = 0; i < n; i++)
+			BatchPow[i] = BatchExp[i] ? 1. : BatchHigh[i];
+		for (bit = 1; bit <= maxexp; bit <<= 1) {
+			for (i = 0; i < n; i++) {
+				if (BatchExp[i] & bit)
+					BatchPow[i] *= BatchHigh[i];
+				BatchHigh[i] *= BatchHigh[i];
+			}
+		}
+		/*
+		 * Sum diffuse reflection and specular highlight, as
+		 * Lighting() does.
+		 */
+		for (i = 0; i < n; i++) {
+			BatchColor[i].r += BatchDiff[i].r * BatchCos[i] *
+						BatchLight[i].r;
+			BatchColor[i].g += BatchDiff[i].g * BatchCos[i] *
+						BatchLight[i].g;
+			BatchColor[i].b += BatchDiff[i].b * BatchCos[i] *
+						BatchLight[i].b;
+			BatchColor[i].r += BatchSpec[i].r * BatchPow[i] *
+						BatchLight[i].r;
+			BatchColor[i].g += BatchSpec[i].g * BatchPow[i] *
+						BatchLight[i].g;
+			BatchColor[i].b += BatchSpec[i].b * BatchPow[i] *
+						BatchLight[i].b;
+			BatchColor[i].r *= BatchScale[i];
+			BatchColor[i].g *= BatchScale[i];
+			BatchColor[i].b *= BatchScale[i];
+		}
+	}
+
+	/*
+	 * Spawn reflected and transmitted rays, one hit at a time.
+	 */
+	for (i = 0, h = Batch; i < n; i++, h++) {
+		*h->color = BatchColor[i];
+		if (moving)
+			TimeSet(h->ray.time);
+		RaysLeft = Options.raybudget;
+		SpawnRays(&h->ray, h->foot, &h->pos, &h->norm, h->k, &h->refl,
+			h->surf, h->enter, h->back, &FullContrib, h->color);
+	}
+	BatchLen = 0;
+}
@@ -38,7 +38,7 @@ static void PrintGeomStats();
 void
 StatsPrint()
 {
-	extern void PrintMemoryStats();
+	extern void PrintMemoryStats(), BakeStats(), ImageStats();
 	unsigned long TotalRays;
 
 #ifndef LINDA
@@ -46,6 +46,8 @@ StatsPrint()
 #endif
 	ShadowStats(&Stats.ShadowRays, &Stats.ShadowHits,
 		    &Stats.CacheHits, &Stats.CacheMisses);
+	ShadowBatchStats(&Stats.BatchRays, &Stats.BatchMisses,
+		    &Stats.BatchBuilds);
 	IntersectStats(&Stats.BVTests);
 	
 	TotalRays = Stats.EyeRays + Stats.ShadowRays + Stats.ReflectRays
@@ -69,13 +71,39 @@ StatsPrint()
 			fprintf(Stats.fstats,
 				"Shadow cache hits:\t\t%lu (%lu misses)\n",
 				Stats.CacheHits, Stats.CacheMisses);
+		if (Options.shadowbatch)
+			fprintf(Stats.fstats,
+				"Shadow batches:\t\t\t%lu (%lu rays, %lu misses)\n",
+				Stats.BatchBuilds, Stats.BatchRays,
+				Stats.BatchMisses);
 		fprintf(Stats.fstats,"Total shadow hits:\t\t%lu (%3.3f%%)\n",
 			Stats.ShadowHits, 100.*(float)Stats.ShadowHits /
 			(float)Stats.ShadowRays);
 	}
+	if (Options.itembuffer)
+		fprintf(Stats.fstats,"Item buffer hits:\t\t%lu (%lu misses)\n",
+			Stats.ItemHits, Stats.ItemMisses);
+	if (Options.gbuffer)
+		fprintf(Stats.fstats,"G-buffer hits:\t\t\t%lu (%lu misses)\n",
+			Stats.GBufferHits, Stats.GBufferMisses);
+	if (Options.batchshade)
+		fprintf(Stats.fstats,"Hits shaded in batches:\t\t%lu\n",
+			Stats.BatchShaded);
+	if (Options.tilecull && Stats.TilesCulled != 0)
+		fprintf(Stats.fstats,
+			"Screen tiles culled:\t\t%lu (%g objects each)\n",
+			Stats.TilesCulled,
+			(Float)Stats.TileObjects / (Float)Stats.TilesCulled);
+	if (Options.roulette > 0. || Options.raybudget)
+		fprintf(Stats.fstats,
+			"Rays not spawned:\t\t%lu (%lu over budget)\n",
+			Stats.RouletteKills + Stats.OverBudget,
+			Stats.OverBudget);
 	fprintf(Stats.fstats,"Supersampled pixels:\t\t%lu\n",
 		Stats.SuperSampled);
 	fprintf(Stats.fstats,"B.V. intersection tests:\t%lu\n",Stats.BVTests);
+	BakeStats(Stats.fstats);
+	ImageStats(Stats.fstats);
 	PrintGeomStats();
 #ifdef LINDA
 	fprintf(Stats.fstats,"Average CPU time/processor:\t");
@@ -41,7 +41,19 @@ typedef struct RSStats {
 			SuperSampled,	/* # of supersampled pixels. */
 			ShadowHits,	/* # of shadow ray hits */
 			CacheHits,	/* # of shadow cache hits */
-			CacheMisses;	/* # of shadow cache misses */
+			CacheMisses,	/* # of shadow cache misses */
+			BatchRays,	/* # of shadow rays traced in batch */
+			BatchMisses,	/* # that fell outside of batch */
+			BatchBuilds,	/* # of batches culled */
+			ItemHits,	/* # of eye rays resolved by item buf. */
+			ItemMisses,	/* # of eye rays it could not resolve */
+			GBufferHits,	/* # of eye rays found in G-buffer */
+			GBufferMisses,	/* # not found there */
+			TilesCulled,	/* # of screen tiles culled to */
+			TileObjects,	/* # of objects that survived */
+			BatchShaded,	/* # of hits shaded in batches */
+			RouletteKills,	/* # of rays ended by roulette */
+			OverBudget;	/* # not spawned for want of budget */
 	Float		Utime,		/* User time */
 			Stime;		/* System time */
 	FILE		*fstats;	/* Stats/info file pointer. */
@@ -117,8 +117,15 @@ Surface *
 GetShadingSurf(hitlist)
 HitList *hitlist;
 {
+	Surface *stmp;
 	int i;
 
+	/*
+	 * A primitive may give each of its parts a surface of its own.
+	 */
+	if (hitlist->nodes > 1 &&
+	    (stmp = PrimSurface(hitlist->data[0].obj)) != (Surface *)NULL)
+		return stmp;
 	/*
 	 * -1 here because the World always has a NULL surface
 	 * (DefaultSurf is used instead)
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 1989-2015, Craig E. Kolb
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "rayshade.h"
+#include "libobj/cull.h"
+#include "libcommon/sampling.h"
+#include "options.h"
+#include "stats.h"
+#include "viewing.h"
+
+/*
+ * Per-tile culling of eye rays.
+ *
+ * The screen is divided into TILESIZE x TILESIZE pixel tiles.  The
+ * first time an eye ray is cast through a tile in a given frame, the
+ * world is culled to the frustum that the tile subtends at the eye.
+ * Every eye ray through the tile is then traced against the objects
+ * that survived.  As this assumes that eye rays leave the eye itself,
+ * tiles are not used when the camera's aperture is open.
+ */
+#define TILESIZE	16
+
+typedef struct {
+	CullList *cull;		/* objects in the tile's frustum */
+	int frame;		/* frame for which cull was built */
+} Tile;
+
+static Tile	*Tiles;		/* tiles, row by row */
+static int	TileX0, TileY0,	/* screen position of first tile */
+		TilesW, TilesH,	/* # of tiles across, down */
+		MaxTiles,	/* space allocated */
+		TileFrame,	/* incremented each frame */
+		TilesValid;	/* tiles may be used? */
+
+static void TileBuild();
+
+/*
+ * Prepare to cull the world to each tile for the current frame.
+ * Must be called after WorldSetup() and RSViewing().
+ */
+void
+TileSetup()
+{
+	Float margin;
+	int i;
+	extern Geom *World;
+
+	TilesValid = FALSE;
+	if (!Options.tilecull || Camera.aperture > 0.)
+		return;
+
+	/*
+	 * Cover every position SampleScreen() may be asked to sample.
+	 */
+	margin = 0.5 * Sampling.filterwidth + 1.;
+	TileX0 = (int)floor(Screen.minx - margin);
+	TileY0 = (int)floor(Screen.miny - margin);
+	TilesW = ((int)ceil(Screen.maxx + margin) - TileX0) / TILESIZE + 1;
+	TilesH = ((int)ceil(Screen.maxy + margin) - TileY0) / TILESIZE + 1;
+	if (TilesW * TilesH > MaxTiles) {
+		/*
+		 * Only happens on the first frame, as the
+		 * screen doesn't change from frame to frame.
+		 */
+		MaxTiles = TilesW * TilesH;
+		Tiles = (Tile *)Malloc(MaxTiles * sizeof(Tile));
+		for (i = 0; i < MaxTiles; i++) {
+			Tiles[i].cull = CullListCreate();
+			Tiles[i].frame = -1;
+		}
+	}
+	/*
+	 * The tiles are culled while rendering, so make room in their
+	 * lists now.
+	 */
+	for (i = 0; i < TilesW * TilesH; i++)
+		CullListReserve(Tiles[i].cull, World, CULL_MAXKIDS);
+	TileFrame++;
+	TilesValid = TRUE;
+}
+
+/*
+ * Return the list of objects that may be hit by an eye ray through
+ * the given screen position, or NULL if the whole world must be traced.
+ */
+CullList *
+TileCullList(x, y)
+Float x, y;
+{
+	Tile *tile;
+	int tx, ty;
+
+	if (!TilesValid)
+		return (CullList *)NULL;
+	tx = (int)floor(x - TileX0) / TILESIZE;
+	ty = (int)floor(y - TileY0) / TILESIZE;
+	if (x < TileX0 || y < TileY0 || tx >= TilesW || ty >= TilesH)
+		return (CullList *)NULL;
+	tile = &Tiles[ty*TilesW + tx];
+	if (tile->frame != TileFrame) {
+		TileBuild(tile, tx, ty);
+		tile->frame = TileFrame;
+	}
+	return tile->cull;
+}
+
+static void
+TileBuild(tile, tx, ty)
+Tile *tile;
+int tx, ty;
+{
+	Vector dir[4];
+	Float u0, u1, v0, v1;
+	extern Geom *World;
+
+	/*
+	 * Pad the tile by half a pixel to allow for roundoff.
+	 */
+	u0 = TileX0 + tx * TILESIZE - 0.5;
+	v0 = TileY0 + ty * TILESIZE - 0.5;
+	u1 = u0 + TILESIZE + 1.;
+	v1 = v0 + TILESIZE + 1.;
+	VecComb(u0, Screen.scrnx, v0, Screen.scrny, &dir[0]);
+	VecComb(u1, Screen.scrnx, v0, Screen.scrny, &dir[1]);
+	VecComb(u1, Screen.scrnx, v1, Screen.scrny, &dir[2]);
+	VecComb(u0, Screen.scrnx, v1, Screen.scrny, &dir[3]);
+	VecAdd(dir[0], Screen.firstray, &dir[0]);
+	VecAdd(dir[1], Screen.firstray, &dir[1]);
+	VecAdd(dir[2], Screen.firstray, &dir[2]);
+	VecAdd(dir[3], Screen.firstray, &dir[3]);
+
+	CullListFrustum(tile->cull, World, &Camera.pos, dir, CULL_MAXKIDS);
+	Stats.TilesCulled++;
+	Stats.TileObjects += tile->cull->nobjs;
+}
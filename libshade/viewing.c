@@ -26,17 +26,21 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 #include "rayshade.h"
+#include "libobj/cull.h"
+#include "libsurf/surface.h"
 #include "viewing.h"
 #include "libcommon/sampling.h"
 #include "options.h"
 #include "defaults.h"
 #include "picture.h"
 #include "stats.h"
+#include "gbuffer.h"
 
 RSCamera	Camera;
 RSScreen	Screen;
 
-void SampleScreen(), SampleScreenFiltered();
+void SampleScreen(), SampleScreenFiltered(), SampleScreenFlush();
+static void TraceEyeRay(), EyeRay();
 
 void
 RSViewing()
@@ -254,7 +258,151 @@ int sample;		/* sample number */
 	Float dist;
 	HitList hitlist;
 	Color ctmp, fullintens;
-	extern void focus_blur_ray(), ShadeRay();
+	GHit *hit;
+	Surface *surf;
+	int hitsome;		/* did the ray hit anything? */
+	extern void ShadeRay(), ShadeFirstHit();
+
+	/*
+	 * If the first hit of the ray is in the G-buffer, or is to
+	 * be put there, shade it from there.
+	 */
+	if ((hit = GBufferFetch(x, y, sample, &surf)) != (GHit *)NULL) {
+		EyeRay(x, y, ray, sample);
+		ShadeFirstHit(ray, hit, surf, &Screen.background, &ctmp);
+		hitsome = surf != (Surface *)NULL;
+	} else {
+		TraceEyeRay(x, y, ray, sample, &hitlist, &dist);
+		hit = GBufferRecord(x, y, sample, &hitlist, ray, dist, &surf);
+		if (hit != (GHit *)NULL) {
+			ShadeFirstHit(ray, hit, surf, &Screen.background,
+					&ctmp);
+		} else {
+			fullintens.r = fullintens.g = fullintens.b = 1.;
+			ShadeRay(&hitlist, ray, dist, &Screen.background,
+					&ctmp, &fullintens);
+		}
+		hitsome = hitlist.nodes != 0;
+	}
+	color->r = ctmp.r;
+	color->g = ctmp.g;
+	color->b = ctmp.b;
+	if (hitsome) {
+		color->alpha = 1.;
+	} else {
+		color->alpha = 0.;
+	}
+}
+
+/*
+ * Batched sampling.  SampleScreenBatch() traces an eye ray just as
+ * SampleScreen() does, but adds the color found, scaled by 'weight',
+ * to 'color'.  The shading may be put off until the next
+ * SampleScreenFlush(), when 'color' is added to.
+ */
+static Pixel	**BatchPixel;		/* pixels waiting to be added to */
+static Color	*BatchColor;		/* ... the colors to add */
+static Float	*BatchWeight;		/* ... and their weights */
+static int	BatchSize, BatchLen;
+
+void
+SampleScreenBatchInit(n)
+int n;
+{
+	extern void ShadeBatchInit();
+
+	BatchPixel = (Pixel **)Malloc(n * sizeof(Pixel *));
+	BatchColor = (Color *)Malloc(n * sizeof(Color));
+	BatchWeight = (Float *)Malloc(n * sizeof(Float));
+	BatchSize = n;
+	ShadeBatchInit(n);
+}
+
+void
+SampleScreenBatch(x, y, ray, color, sample, weight)
+Float x, y;		/* Screen position to sample */
+Ray *ray;		/* ray, with origin and medium properly set */
+Pixel *color;		/* color to add to */
+int sample;		/* sample number */
+Float weight;		/* weight of the sample */
+{
+	Float dist;
+	HitList hitlist;
+	extern void ShadeBatchAdd();
+
+	if (BatchLen == BatchSize)
+		SampleScreenFlush();
+	TraceEyeRay(x, y, ray, sample, &hitlist, &dist);
+	BatchPixel[BatchLen] = color;
+	BatchWeight[BatchLen] = weight;
+	ShadeBatchAdd(&hitlist, ray, dist, &Screen.background,
+		&BatchColor[BatchLen]);
+	BatchLen++;
+	if (hitlist.nodes != 0)
+		color->alpha += weight;
+}
+
+void
+SampleScreenFlush()
+{
+	int i;
+	extern void ShadeBatchFlush();
+
+	if (BatchLen == 0)
+		return;
+	ShadeBatchFlush();
+	for (i = 0; i < BatchLen; i++) {
+		BatchPixel[i]->r += BatchColor[i].r*BatchWeight[i];
+		BatchPixel[i]->g += BatchColor[i].g*BatchWeight[i];
+		BatchPixel[i]->b += BatchColor[i].b*BatchWeight[i];
+	}
+	BatchLen = 0;
+}
+
+/*
+ * Trace the eye ray through screen position (x, y), returning the
+ * objects hit and the distance to the nearest.
+ */
+static void
+TraceEyeRay(x, y, ray, sample, hitlist, dist)
+Float x, y;		/* Screen position to sample */
+Ray *ray;		/* ray, with origin and medium properly set */
+int sample;		/* sample number */
+HitList *hitlist;
+Float *dist;
+{
+	CullList *cull;
+	extern int ItemBufferTrace();
+	extern CullList *TileCullList();
+
+	EyeRay(x, y, ray, sample);
+
+	/*
+	 * Do the actual ray trace.
+	 */
+	*dist = FAR_AWAY;
+	hitlist->nodes = 0;
+	if (!ItemBufferTrace(x, y, ray, hitlist, dist)) {
+		*dist = FAR_AWAY;
+		hitlist->nodes = 0;
+		if ((cull = TileCullList(x, y)) != (CullList *)NULL)
+			(void)CullIntersect(cull, ray, hitlist, EPSILON,
+				dist, FALSE);
+		else
+			(void)TraceRay(ray, hitlist, EPSILON, dist);
+	}
+}
+
+/*
+ * Set up the eye ray through screen position (x, y).
+ */
+static void
+EyeRay(x, y, ray, sample)
+Float x, y;		/* Screen position to sample */
+Ray *ray;		/* ray, with origin and medium properly set */
+int sample;		/* sample number */
+{
+	extern void focus_blur_ray();
 
 	/*
 	 * Calculate ray direction.
@@ -275,21 +423,4 @@ int sample;		/* sample number */
 		 */
 		focus_blur_ray(ray);
 	}
-
-	/*
-	 * Do the actual ray trace.
-	 */
-	fullintens.r = fullintens.g = fullintens.b = 1.;
-	dist = FAR_AWAY;
-	hitlist.nodes = 0;
-	(void)TraceRay(ray, &hitlist, EPSILON, &dist);
-	ShadeRay(&hitlist, ray, dist, &Screen.background, &ctmp, &fullintens);
-	color->r = ctmp.r;
-	color->g = ctmp.g;
-	color->b = ctmp.b;
-	if (hitlist.nodes != 0) {
-		color->alpha = 1.;
-	} else {
-		color->alpha = 0.;
-	}
 }
@@ -38,6 +38,7 @@ typedef struct RSScreen {
 	Vector	scrnx, scrny,		/* Horizontal & vertical screen axes */
 		scrni, scrnj,		/* Normalized versions of the above */
 		firstray;		/* Direction from eye to screen UL  */
+	Float	pixel;			/* Width of a pixel at unit distance */
 	Color	background;		/* Background color */
 } RSScreen;
 
@@ -25,6 +25,20 @@
  * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  * POSSIBILITY OF SUCH DAMAGE.
  */
+%{
+#include "libobj/mesh.h"
+#include "libobj/spheres.h"
+
+static MeshVertList *Meshverts;		/* Vertices of the mesh being read */
+static MeshFaceList *Meshfaces;		/* Faces of the mesh being read */
+static int Nmeshverts, Nmeshfaces;
+static SphereSetList *Spherelist;	/* Members of the sphere set being read */
+static int Nspheres;
+
+static void MeshVertAdd(), SphereSetAdd();
+%}
+%token tMESH tVERTEX tFACE tSPHERES
+%type <obj> Mesh Spheres
 				$1->next = Defstack->obj->next;
 				Defstack->obj->next = $1;
 			}
@@ -76,6 +90,8 @@ PrimType	: Plane
 		| Sphere
 		| Box
 		| Triangle
+		| Mesh
+		| Spheres
 		| Cylinder
 		| Cone
 		| Poly
@@ -186,7 +202,8 @@ Texturetype	: tCHECKER Surface
 			if (Imagetext->image == (Image *)NULL)
 				$$ = (Texture *)NULL;
 			else
-				$$ = TextCreate(Imagetext, ImageTextApply);
+				$$ = TextCreate(Imagetext, ImageTextApply,
+						ImageTextHash);
 			Imagetext = (ImageText *)NULL;
 		}
 		| tSTRIPE Surface Expr Expr OptMapping
@@ -975,6 +992,70 @@ Triangle	: tTRIANGLE OptSurface Vector Vector Vector
 				$$->surf = $2;
 		}
 		;
+Mesh		: tMESH OptSurface MeshVerts MeshFaces
+		{
+			$$ = GeomMeshCreate(Meshverts, Nmeshverts,
+				Meshfaces, Nmeshfaces, Options.flipnorm);
+			if ($$)
+				$$->surf = $2;
+			Meshverts = (MeshVertList *)NULL;
+			Meshfaces = (MeshFaceList *)NULL;
+			Nmeshverts = Nmeshfaces = 0;
+		}
+		;
+MeshVerts	: /* empty */
+		| MeshVerts MeshVert
+		;
+MeshVert	: tVERTEX Vector
+		{
+			MeshVertAdd(&$2, (Vector *)NULL, (Vec2d *)NULL);
+		}
+		| tVERTEX Vector Vector
+		{
+			MeshVertAdd(&$2, &$3, (Vec2d *)NULL);
+		}
+		| tVERTEX Vector Vector Vec2d
+		{
+			MeshVertAdd(&$2, &$3, &$4);
+		}
+		;
+MeshFaces	: /* empty */
+		| MeshFaces MeshFace
+		;
+MeshFace	: tFACE Expr Expr Expr
+		{
+			MeshFaceList *ftmp;
+
+			ftmp = (MeshFaceList *)Malloc(sizeof(MeshFaceList));
+			ftmp->v[0] = (int)$2;
+			ftmp->v[1] = (int)$3;
+			ftmp->v[2] = (int)$4;
+			ftmp->next = Meshfaces;
+			Meshfaces = ftmp;
+			Nmeshfaces++;
+		}
+		;
+Spheres		: tSPHERES OptSurface SphereElts
+		{
+			$$ = GeomSphereSetCreate(Spherelist, Nspheres);
+			if ($$)
+				$$->surf = $2;
+			Spherelist = (SphereSetList *)NULL;
+			Nspheres = 0;
+		}
+		;
+SphereElts	: /* empty */
+		| SphereElts SphereElt
+		;
+SphereElt	: Expr Vector
+		{
+			SphereSetAdd($1, &$2, (Surface *)NULL);
+		}
+		| NamedSurf Expr Vector
+		{
+			SphereSetAdd($2, &$3, $1);
+		}
+		;
 Plane		: tPLANE OptSurface Vector Vector
 		{
 			$$ = GeomPlaneCreate(&($3), &($4));
@@ -1311,3 +1392,43 @@ Geom *obj;
 	obj->next = Defstack->obj->next;
 	return obj;
 }
+
+static void
+MeshVertAdd(pos, norm, uv)
+Vector *pos, *norm;
+Vec2d *uv;
+{
+	MeshVertList *vtmp;
+
+	vtmp = (MeshVertList *)Malloc(sizeof(MeshVertList));
+	vtmp->pos = *pos;
+	vtmp->flags = 0;
+	if (norm) {
+		vtmp->norm = *norm;
+		vtmp->flags |= MESH_NORMAL;
+	}
+	if (uv) {
+		vtmp->uv = *uv;
+		vtmp->flags |= MESH_UV;
+	}
+	vtmp->next = Meshverts;
+	Meshverts = vtmp;
+	Nmeshverts++;
+}
+
+static void
+SphereSetAdd(r, pos, surf)
+Float r;
+Vector *pos;
+Surface *surf;
+{
+	SphereSetList *stmp;
+
+	stmp = (SphereSetList *)Malloc(sizeof(SphereSetList));
+	stmp->r = r;
+	stmp->pos = *pos;
+	stmp->surf = surf;
+	stmp->next = Spherelist;
+	Spherelist = stmp;
+	Nspheres++;
+}
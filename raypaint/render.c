@@ -144,11 +144,13 @@ char **argv;
 	 * The top-level ray TopRay always has as its origin the
 	 * eye position and as its medium NULL, indicating that it
 	 * is passing through a medium with index of refraction
-	 * equal to DefIndex.
+	 * equal to DefIndex.  Its footprint is that of a pixel.
 	 */
 	TopRay.pos = Camera.pos;
 	TopRay.media = (Medium *)0;
 	TopRay.depth = 0;
+	TopRay.width = 0.;
+	TopRay.spread = Screen.pixel;
 	/*
 	 * Doesn't handle motion blur yet.
 	 */
@@ -46,6 +46,7 @@ char **argv;
 	Float utime, stime, lasttime;
 	int i;
 	extern Geom *World;
+	extern void BakeSave();
 
 #ifdef LINDA
 	Options.workernum = 0;	/* we're the supervisor */
@@ -108,6 +109,7 @@ char **argv;
 	 */
 	PictureFrameEnd();	/* End the last frame */
 	PictureEnd();
+	BakeSave();		/* Keep texture bakes for next time */
 	StatsPrint();
 	return 0;
 }
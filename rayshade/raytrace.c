@@ -45,6 +45,15 @@ typedef struct {
 
 static int		*SampleNumbers;
 static void	RaytraceInit();
+static Float	EyeRand();
+
+/*
+ * Random number used in placing an eye ray through pixel (x, y).
+ * When a G-buffer is kept, the eye rays must be the same from one
+ * run to the next, however many other random numbers are drawn in
+ * between, so the number is found by hashing the pixel and 'n'.
+ */
+#define EYERAND(x, y, n)	(Options.gbuffer ? EyeRand(x, y, n) : nrand())
 
 static Ray	TopRay;				/* Top-level ray. */
 Float		SampleTime();
@@ -107,6 +116,7 @@ char **argv;
 	int y, *tmpsamp;
 	Pixel *tmppix;
 	Float usertime, systime, lasttime;
+	extern void MemoryWatch(), GBufferSave(), SampleScreenFlush();
 
 	/*
 	 * If this is the first frame,
@@ -118,11 +128,17 @@ char **argv;
 	 * The top-level ray TopRay always has as its origin the
 	 * eye position and as its medium NULL, indicating that it
 	 * is passing through a medium with index of refraction
-	 * equal to DefIndex.
+	 * equal to DefIndex.  Its footprint is that of a pixel.
 	 */
 	TopRay.pos = Camera.pos;
 	TopRay.media = (Medium *)0;
 	TopRay.depth = 0;
+	TopRay.width = 0.;
+	TopRay.spread = Screen.pixel;
+	/*
+	 * Nothing traced from here on should need to allocate memory.
+	 */
+	MemoryWatch(TRUE);
 
 	/*
 	 * Always fully sample the bottom and top rows and the left
@@ -147,6 +163,8 @@ char **argv;
 		if (Sampling.sidesamples > 1)
 			AdaptiveRefineScanline(y,&scan0,&scan1,&scan2);
 
+		if (Options.batchshade)
+			SampleScreenFlush();
 		PictureWriteLine(scan0.pix);
 
 		tmppix = scan0.pix;
@@ -187,7 +205,11 @@ char **argv;
 				&scan0.pix[y],
 				&scan0.samp[y]);
 	}
+	if (Options.batchshade)
+		SampleScreenFlush();
 	PictureWriteLine(scan0.pix);
+	MemoryWatch(FALSE);
+	GBufferSave();
 }
 
 void
@@ -198,13 +220,22 @@ Scanline *data;
 	Float upos, vpos, yp;
 	int x, usamp, vsamp;
 	Pixel tmp;
+	extern void LightBatchNext(), SampleScreenBatch(), SampleScreenFlush();
+
+	/*
+	 * Eye rays along a scanline are coherent, and so are the shadow
+	 * rays cast from the points they hit.
+	 */
+	if (Options.shadowbatch)
+		LightBatchNext();
 
 	yp = line + Screen.miny - 0.5*Sampling.filterwidth;
 	for (x = 0; x < Screen.xsize; x++) {
 		/*
 		 * Pick a sample number...
 		 */
-		data->samp[x] = nrand() * Sampling.totsamples;
+		data->samp[x] = EYERAND(x + Screen.minx, line, 0) *
+				Sampling.totsamples;
 		/*
 		 * Take sample corresponding to sample #.
 		 */
@@ -215,15 +246,26 @@ Scanline *data;
 		upos = x + Screen.minx - 0.5*Sampling.filterwidth +
 				usamp*Sampling.filterdelta;
 		if (Options.jitter) {
-			vpos += nrand()*Sampling.filterdelta;
-			upos += nrand()*Sampling.filterdelta;
+			vpos += EYERAND(x + Screen.minx, line,
+				2*data->samp[x] + 2) * Sampling.filterdelta;
+			upos += EYERAND(x + Screen.minx, line,
+				2*data->samp[x] + 1) * Sampling.filterdelta;
 		}
 		TopRay.time = SampleTime(SampleNumbers[data->samp[x]]);
-		SampleScreen(upos, vpos, &TopRay,
-			&data->pix[x], SampleNumbers[data->samp[x]]);
+		if (Options.batchshade) {
+			data->pix[x].r = data->pix[x].g = data->pix[x].b =
+				data->pix[x].alpha = 0.;
+			SampleScreenBatch(upos, vpos, &TopRay,
+				&data->pix[x], SampleNumbers[data->samp[x]],
+				1.);
+		} else
+			SampleScreen(upos, vpos, &TopRay,
+				&data->pix[x], SampleNumbers[data->samp[x]]);
 		if (Options.samplemap)
 			data->pix[x].alpha = 0;
 	}
+	if (Options.batchshade)
+		SampleScreenFlush();
 }
 
 void
@@ -248,6 +290,7 @@ int *prevsamp;
 	Float upos, vpos, u, v;
 	int x, y, sampnum;
 	Pixel ctmp;
+	extern void SampleScreenBatch();
 
 	if (*prevsamp == SUPERSAMPLED)
 		return;	/* already done */
@@ -281,19 +324,30 @@ int *prevsamp;
 		     upos += Sampling.filterdelta) {
 			if (sampnum != *prevsamp) {
 				if (Options.jitter) {
-					u = upos + nrand()*Sampling.filterdelta;
-					v = vpos + nrand()*Sampling.filterdelta;
+					u = upos + EYERAND(xp, yp,
+						2*sampnum + 1) *
+						Sampling.filterdelta;
+					v = vpos + EYERAND(xp, yp,
+						2*sampnum + 2) *
+						Sampling.filterdelta;
 				} else {
 					u = upos;
 					v = vpos;
 				}
 				TopRay.time = SampleTime(SampleNumbers[sampnum]);
-				SampleScreen(u, v, &TopRay, &ctmp,
-					SampleNumbers[sampnum]);
-				pix->r += ctmp.r*Sampling.filter[x][y];
-				pix->g += ctmp.g*Sampling.filter[x][y];
-				pix->b += ctmp.b*Sampling.filter[x][y];
-				pix->alpha += ctmp.alpha*Sampling.filter[x][y];
+				if (Options.batchshade) {
+					SampleScreenBatch(u, v, &TopRay, pix,
+						SampleNumbers[sampnum],
+						Sampling.filter[x][y]);
+				} else {
+					SampleScreen(u, v, &TopRay, &ctmp,
+						SampleNumbers[sampnum]);
+					pix->r += ctmp.r*Sampling.filter[x][y];
+					pix->g += ctmp.g*Sampling.filter[x][y];
+					pix->b += ctmp.b*Sampling.filter[x][y];
+					pix->alpha += ctmp.alpha *
+						Sampling.filter[x][y];
+				}
 			}
 			if (++sampnum == Sampling.totsamples)
 				sampnum = 0;
@@ -312,17 +366,22 @@ int y;
 Scanline *scan0, *scan1, *scan2;
 {
 	int x, done;
+	extern void SampleScreenFlush();
 
 	/*
 	 * Walk down scan1, looking at 4-neighbors for excessive contrast.
 	 * If found, supersample *all* neighbors not already supersampled.
 	 * The process is repeated until either there are no
 	 * high-contrast regions or all such regions are already supersampled.
+	 * When shading in batches, the samples taken for one pixel's
+	 * neighbors are shaded together before the next pixel is looked at.
 	 */
 
 	do {
 		done = TRUE;
 		for (x = 1; x < Screen.xsize -1; x++) {
+			if (Options.batchshade)
+				SampleScreenFlush();
 			/*
 		 	 * Find min and max RGB for area we care about
 			 */
@@ -435,9 +494,24 @@ int sampnum;
 	return res;
 }
 
+static Float
+EyeRand(x, y, n)
+int x, y, n;
+{
+	unsigned long h;
+
+	h = ((unsigned long)x * 73856093UL ^ (unsigned long)y * 19349663UL ^
+		(unsigned long)n * 83492791UL) & 0xffffffffUL;
+	h = ((h >> 16) ^ h) * 0x45d9f3bUL & 0xffffffffUL;
+	h = ((h >> 16) ^ h) * 0x45d9f3bUL & 0xffffffffUL;
+	h = (h >> 16) ^ h;
+	return (Float)(h & 0xffffff) / 16777216.;
+}
+
 static void
 RaytraceInit()
 {
+	extern void SampleScreenBatchInit();
 
 	switch (Sampling.sidesamples) {
 		case 1:
@@ -480,4 +554,7 @@ RaytraceInit()
 	scan0.samp = (int *)Malloc(Screen.xsize * sizeof(int));
 	scan1.samp = (int *)Malloc(Screen.xsize * sizeof(int));
 	scan2.samp = (int *)Malloc(Screen.xsize * sizeof(int));
+
+	if (Options.batchshade)
+		SampleScreenBatchInit(Screen.xsize);
 }
@@ -586,8 +586,8 @@ Hf *hf;
 	top = del;
 
 	for (y = 0; y < hf->size -1; y++) {
-		za = hf->data[y+1][0];
-		zb = hf->data[y][0];
+		za = HfAlt(hf, 0, y+1);
+		zb = HfAlt(hf, 0, y);
 		left = 0;
 		right = del;
 		for (x = 1; x < hf->size; x++) {
@@ -597,7 +597,7 @@ Hf *hf;
 			 * B +
 			 */
 		
-			zc = hf->data[y+1][x];
+			zc = HfAlt(hf, x, y+1);
 			dz1 = za - zb;
 			delz = za - zc;
 			len = sqrt(del2*delz*delz + del2*dz1*dz1 + del4);
@@ -616,7 +616,7 @@ Hf *hf;
 			 *    /|
 			 * A +-+ C
 			 */
-			za = zb; zb = zc; zc = hf->data[y][x];
+			za = zb; zb = zc; zc = HfAlt(hf, x, y);
 			dz1 = zc - za;
 			delz = zc - zb;
 			len = sqrt(del2*dz1*dz1 + del2*delz*delz + del4);